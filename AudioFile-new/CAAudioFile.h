@@ -59,6 +59,8 @@
 #include "CAAudioChannelLayout.h"
 #include "CAXException.h"
 #include "CAMath.h"
+#include "CAMappedAudioFile.h"
+#include "CADecodedPageCache.h"
 
 #if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
 	#include <AudioToolbox/ExtendedAudioFile.h>
@@ -68,7 +70,7 @@
 
 // _______________________________________________________________________________________
 // Wrapper class for an AudioFile, supporting encode/decode to/from a PCM client format
-class CAAudioFile {
+class CAAudioFile : private CADecodedPageCache::Decoder {
 public:
 	// implementation-independent helpers
 	void	Open(const char *filePath) {
@@ -77,7 +79,7 @@ public:
 		Open(fsref);
 	}
 
-	bool							HasConverter() const { return GetConverter() != NULL; }
+	bool							HasConverter() const { return !IsMapped() && GetConverter() != NULL; }
 
 	double  GetDurationSeconds() {
 		double sr = GetFileDataFormat().mSampleRate;
@@ -87,14 +89,43 @@ public:
 				// or the file's sample rate is 0 (unknown)
 
 public:
-	CAAudioFile() : mExtAF(NULL) { }
+	CAAudioFile() : mExtAF(NULL), mFileIdentity(0), mUsesPageCache(false), mCachePosition(0) { }
 	virtual ~CAAudioFile() { if (mExtAF) Close(); }
 
 	void	Open(const FSRef &fsref) {
 				// open an existing file
 		XThrowIfError(ExtAudioFileOpen(&fsref, &mExtAF), "ExtAudioFileOpen failed");
+		mFileIdentity = CADecodedPageCache::FileIdentity(fsref);
+		mCachePosition = 0;
 	}
 	
+	void	SetUsesPageCache(bool b) {
+				// Share decoded frames with every other CAAudioFile reading this file in the same
+				// client format, through CADecodedPageCache::Shared(). Only applies to files opened
+				// from an FSRef for reading, and not to mapped files, which don't decode.
+		if (b == mUsesPageCache)
+			return;
+		if (mFileIdentity != 0 && !IsMapped()) {
+			if (b)
+				mCachePosition = Tell();
+			else
+				XThrowIfError(ExtAudioFileSeek(mExtAF, mCachePosition), "Couldn't seek in audio file");
+		}
+		mUsesPageCache = b;
+	}
+	bool	UsesPageCache() const { return mUsesPageCache; }
+	
+	bool	OpenMapped(const char *filePath) {
+				// Map an uncompressed WAV/AIFF/CAF file for reading. Read, Seek, Tell,
+				// GetNumberFrames and the data formats then work on the mapping instead of
+				// ExtAudioFile; the client format may be the file format or native float
+				// (see CAMappedAudioFile). There is no converter, the channel layouts are the
+				// default ones for the channel count, and anything that would modify the file
+				// throws. Returns false if the file can't be mapped, in which case use Open.
+		return mMapped.Open(filePath);
+	}
+	bool	IsMapped() const { return mMapped.IsOpen(); }
+	
 	void	CreateNew(const FSRef &inParentDir, CFStringRef inFileName,	AudioFileTypeID inFileType, const AudioStreamBasicDescription &inStreamDesc, const AudioChannelLayout *inChannelLayout=NULL) {
 		XThrowIfError(ExtAudioFileCreateNew(&inParentDir, inFileName, inFileType, &inStreamDesc, inChannelLayout, &mExtAF), "ExtAudioFileCreateNew failed");
 	}
@@ -105,46 +136,67 @@ public:
 	}
 	
 	void	Close() {
+		if (IsMapped()) {
+			mMapped.Close();
+			return;
+		}
 		XThrowIfError(ExtAudioFileDispose(mExtAF), "ExtAudioFileClose failed");
 		mExtAF = NULL;
+		mFileIdentity = 0;
 	}
 
 	const CAStreamBasicDescription &GetFileDataFormat() {
+		if (IsMapped())
+			return mMapped.GetFileDataFormat();
 		UInt32 size = sizeof(mFileDataFormat);
 		XThrowIfError(ExtAudioFileGetProperty(mExtAF, kExtAudioFileProperty_FileDataFormat, &size, &mFileDataFormat), "Couldn't get file's data format");
 		return mFileDataFormat;
 	}
 	
 	const CAAudioChannelLayout &	GetFileChannelLayout() {
+		if (IsMapped())
+			return mFileChannelLayout = CAAudioChannelLayout(mMapped.GetFileDataFormat().mChannelsPerFrame, false);
 		return FetchChannelLayout(mFileChannelLayout, kExtAudioFileProperty_FileChannelLayout);
 	}
 	
 	void	SetFileChannelLayout(const CAAudioChannelLayout &layout) {
+		XThrowIf(IsMapped(), kAudioFileOperationNotSupportedError, "Mapped file is read only");
 		XThrowIfError(ExtAudioFileSetProperty(mExtAF, kExtAudioFileProperty_FileChannelLayout, layout.Size(), &layout.Layout()), "Couldn't set file's channel layout");
 		mFileChannelLayout = layout;
 	}
 
 	const CAStreamBasicDescription &GetClientDataFormat() {
+		if (IsMapped())
+			return mMapped.GetClientDataFormat();
 		UInt32 size = sizeof(mClientDataFormat);
 		XThrowIfError(ExtAudioFileGetProperty(mExtAF, kExtAudioFileProperty_ClientDataFormat, &size, &mClientDataFormat), "Couldn't get client data format");
 		return mClientDataFormat;
 	}
 	
 	const CAAudioChannelLayout &	GetClientChannelLayout() {
+		if (IsMapped())
+			return mClientChannelLayout = CAAudioChannelLayout(mMapped.GetClientDataFormat().mChannelsPerFrame, false);
 		return FetchChannelLayout(mClientChannelLayout, kExtAudioFileProperty_ClientChannelLayout);
 	}
 	
 	void	SetClientFormat(const CAStreamBasicDescription &dataFormat, const CAAudioChannelLayout *layout=NULL) {
+		if (IsMapped()) {
+			XThrowIf(layout != NULL || !mMapped.SetClientFormat(dataFormat), kAudioConverterErr_FormatNotSupported, "Mapped file can't convert to client format");
+			return;
+		}
 		XThrowIfError(ExtAudioFileSetProperty(mExtAF, kExtAudioFileProperty_ClientDataFormat, sizeof(dataFormat), &dataFormat), "Couldn't set client format");
 		if (layout)
 			SetClientChannelLayout(*layout);
 	}
 	
 	void	SetClientChannelLayout(const CAAudioChannelLayout &layout) {
+		XThrowIf(IsMapped(), kAudioConverterErr_FormatNotSupported, "Mapped file can't remap channels");
 		XThrowIfError(ExtAudioFileSetProperty(mExtAF, kExtAudioFileProperty_ClientChannelLayout, layout.Size(), &layout.Layout()), "Couldn't set client channel layout");
 	}
 	
 	AudioConverterRef				GetConverter() const {
+		if (IsMapped())
+			return NULL;
 		UInt32 size = sizeof(AudioConverterRef);
 		AudioConverterRef converter;
 		XThrowIfError(ExtAudioFileGetProperty(mExtAF, kExtAudioFileProperty_AudioConverter, &size, &converter), "Couldn't get file's AudioConverter");
@@ -153,6 +205,10 @@ public:
 
 	OSStatus	SetConverterProperty(AudioConverterPropertyID inPropertyID,	UInt32 inPropertyDataSize, const void *inPropertyData, bool inCanFail=false)
 	{
+		if (IsMapped()) {
+			XThrowIf(!inCanFail, kAudioConverterErr_PropertyNotSupported, "Mapped file has no audio converter");
+			return kAudioConverterErr_PropertyNotSupported;
+		}
 		OSStatus err = AudioConverterSetProperty(GetConverter(), inPropertyID, inPropertyDataSize, inPropertyData);
 		if (!inCanFail)
 			XThrowIfError(err, "Couldn't set audio converter property");
@@ -165,6 +221,8 @@ public:
 	}
 	
 	SInt64		GetNumberFrames() {
+		if (IsMapped())
+			return mMapped.GetNumberFrames();
 		SInt64 length;
 		UInt32 size = sizeof(SInt64);
 		XThrowIfError(ExtAudioFileGetProperty(mExtAF, kExtAudioFileProperty_FileLengthFrames, &size, &length), "Couldn't get file's length");
@@ -172,44 +230,87 @@ public:
 	}
 	
 	void		SetNumberFrames(SInt64 length) {
+		XThrowIf(IsMapped(), kAudioFileOperationNotSupportedError, "Mapped file is read only");
 		XThrowIfError(ExtAudioFileSetProperty(mExtAF, kExtAudioFileProperty_FileLengthFrames, sizeof(SInt64), &length), "Couldn't set file's length");
 	}
 	
 	void		Seek(SInt64 pos) {
+		if (IsMapped()) {
+			mMapped.Seek(pos);
+			return;
+		}
+		if (ReadsFromPageCache()) {
+			mCachePosition = pos;
+			return;
+		}
 		XThrowIfError(ExtAudioFileSeek(mExtAF, pos), "Couldn't seek in audio file");
 	}
 	
 	SInt64		Tell() {
+		if (IsMapped())
+			return mMapped.Tell();
+		if (ReadsFromPageCache())
+			return mCachePosition;
 		SInt64 pos;
 		XThrowIfError(ExtAudioFileTell(mExtAF, &pos), "Couldn't get file's mark");
 		return pos;
 	}
 	
 	void		Read(UInt32 &ioFrames, AudioBufferList *ioData) {
+		if (IsMapped()) {
+			mMapped.Read(ioFrames, ioData);
+			return;
+		}
+		if (ReadsFromPageCache()) {
+			CADecodedPageCache::Shared().Read(mFileIdentity, GetClientDataFormat(), mCachePosition, ioFrames, ioData, *this);
+			mCachePosition += ioFrames;
+			return;
+		}
 		XThrowIfError(ExtAudioFileRead(mExtAF, &ioFrames, ioData), "Couldn't read audio file");
 	}
 
+	const Byte *	ReadInPlace(UInt32 &ioFrames) {
+				// Mapped files only: returns a pointer to the next ioFrames frames in the mapping,
+				// in the file's format, without copying (see CAMappedAudioFile::ReadInPlace).
+		XThrowIf(!IsMapped(), kAudioFileOperationNotSupportedError, "Only mapped files can be read in place");
+		return mMapped.ReadInPlace(ioFrames);
+	}
+
 	void		Write(UInt32 inFrames, const AudioBufferList *inData) {
+		XThrowIf(IsMapped(), kAudioFileOperationNotSupportedError, "Mapped file is read only");
 		XThrowIfError(ExtAudioFileWrite(mExtAF, inFrames, inData), "Couldn't write audio file");
 	}
 
 	void		SetIOBufferSizeBytes(UInt32 bufferSizeBytes) {
+		if (IsMapped())
+			return;		// there is no I/O buffer, the mapping is read directly
 		XThrowIfError(ExtAudioFileSetProperty(mExtAF, kExtAudioFileProperty_IOBufferSizeBytes, sizeof(UInt32), &bufferSizeBytes), "Couldn't set audio file's I/O buffer size");
 	}
 	
 	void		EnableInstrumentation(bool en) {
+		if (IsMapped())
+			return;
 		UInt32 val = en;
 		ExtAudioFileSetProperty(mExtAF, '$ins', sizeof(UInt32), &val);
 	}
 	
 	CFDictionaryRef	GetInstrumentationData() {
 		CFDictionaryRef result = NULL;
+		if (IsMapped())
+			return result;
 		UInt32 size = sizeof(result);
 		/*OSStatus err =*/ ExtAudioFileGetProperty(mExtAF, '$ind', &size, &result);
 		return result;
 	}
 
 private:
+	bool	ReadsFromPageCache() const { return mUsesPageCache && mFileIdentity != 0 && !IsMapped(); }
+
+	virtual void	DecodePage(SInt64 startFrame, UInt32 &ioFrames, AudioBufferList *ioData) {
+		XThrowIfError(ExtAudioFileSeek(mExtAF, startFrame), "Couldn't seek in audio file");
+		XThrowIfError(ExtAudioFileRead(mExtAF, &ioFrames, ioData), "Couldn't read audio file");
+	}
+
 	const CAAudioChannelLayout &	FetchChannelLayout(CAAudioChannelLayout &layoutObj, ExtAudioFilePropertyID propID) {
 		UInt32 size;
 		XThrowIfError(ExtAudioFileGetPropertyInfo(mExtAF, propID, &size, NULL), "Couldn't get info about channel layout");
@@ -227,6 +328,10 @@ private:
 
 private:
 	ExtAudioFileRef				mExtAF;
+	CAMappedAudioFile			mMapped;
+	UInt64						mFileIdentity;		// for the page cache; 0 unless opened from an FSRef
+	bool						mUsesPageCache;
+	SInt64						mCachePosition;		// read position while reading through the page cache
 
 	CAStreamBasicDescription	mFileDataFormat;
 	CAAudioChannelLayout		mFileChannelLayout;
@@ -139,7 +139,7 @@ void	CAAudioFileRecorder::SetFile(const FSRef &parentFSRef, CFStringRef filename
 							(void *)&fmt,
 							sizeof(AudioStreamBasicDescription)), "set audio input format");
 
-	GetFile().SetIOBufferSizeBytes(GetBufferSizeFrames() * fmt.mBytesPerFrame);
+	GetFile().SetIOBufferSizeBytes(std::max(GetBufferSizeFrames(), CommitFrames()) * fmt.mBytesPerFrame);
 
 	mAudioInputPtrs = CABufferList::New("audio input ptrs", fmt);
 }
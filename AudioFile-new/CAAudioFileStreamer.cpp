@@ -44,6 +44,11 @@
 =============================================================================*/
 
 #include "CAAudioFileStreamer.h"
+#include "CAHostTimeBase.h"
+#if !TARGET_OS_WIN32
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
 
 // ____________________________________________________________________________
 
@@ -57,14 +62,45 @@ void	CAAudioFileReader::FileReadBuffer::UpdateAfterRead(SInt64 curFrame, UInt32
 
 // ____________________________________________________________________________
 
+CAAudioFileReader::CAAudioFileReader(int nBuffers, UInt32 bufferSizeFrames) :
+	CAPullBufferQueue(nBuffers, bufferSizeFrames),
+	mFileMutex("CAAudioFileReader::mFileMutex"),
+	mReadFrame(0),
+	mUsesPageCache(false),
+	mCacheMutex("CAAudioFileReader::mCacheMutex"),
+	mNextHintedFrame(0),
+	mCache(NULL),
+	mCacheSize(16),
+	mUseCount(0),
+	mCacheComplete(true),
+	mSeekStartNanos(0)
+{
+	ResetReadStatistics();
+}
+
+CAAudioFileReader::~CAAudioFileReader()
+{
+	// the work thread must be done with us before the cache and file go away
+	CancelBuffers();
+	DisposeHintCache();
+}
+
 void	CAAudioFileReader::SetFile(const FSRef &inFile)
 {
 	Stop();
 	CancelAndDisposeBuffers();
 	
+	CAMutex::Locker fileLock(mFileMutex);
+	CAMutex::Locker cacheLock(mCacheMutex);
+	DisposeHintCache();
+	mHintedFrames.clear();
+	mHintedFrameIndex.clear();
+	mReadFrame = 0;
+	
 	delete mFile;   mFile = NULL;
 	mFile = new CAAudioFile;
 	mFile->Open(inFile);
+	mFile->SetUsesPageCache(mUsesPageCache);
 	
 	const CAStreamBasicDescription &fileFmt = mFile->GetFileDataFormat();
 	CAStreamBasicDescription iofmt;
@@ -73,6 +109,7 @@ void	CAAudioFileReader::SetFile(const FSRef &inFile)
 	mFile->SetClientFormat(iofmt, NULL);
 	
 	SetFormat(iofmt);
+	AllocateHintCache();
 }
 
 void	CAAudioFileReader::Start()
@@ -95,9 +132,286 @@ void	CAAudioFileReader::ReadBuffer(FileReadBuffer *b)
 	CABufferList *fileBuffers = GetBufferList();
 	fileBuffers->SetFrom(ioMemory);
 	UInt32 nFrames = GetBufferSizeFrames();
-	SInt64 curFrame = mFile->Tell();
-	mFile->Read(nFrames, &fileBuffers->GetModifiableBufferList());
+	
+	CAMutex::Locker fileLock(mFileMutex);
+	SInt64 curFrame = mReadFrame;
+	bool fromCache = false;
+	{
+		CAMutex::Locker cacheLock(mCacheMutex);
+		CachedBuffer *cb = FindCachedBuffer(curFrame);
+		if (cb != NULL) {
+			// a seek may land in the middle of a cached buffer; take the rest of it, so that
+			// the following reads line up with the next cached buffer
+			UInt32 offset = UInt32(curFrame - cb->mFileFrame);
+			nFrames = std::min(nFrames, cb->mFrameCount - offset);
+			UInt32 bytesPerFrame = GetBytesPerFrame();
+			const CABufferList *cacheMemory = cb->mMemory;
+			const AudioBufferList &src = cacheMemory->GetBufferList();
+			AudioBufferList &dest = fileBuffers->GetModifiableBufferList();
+			for (UInt32 i = 0; i < dest.mNumberBuffers; ++i) {
+				memcpy(dest.mBuffers[i].mData, (const Byte *)src.mBuffers[i].mData + offset * bytesPerFrame, nFrames * bytesPerFrame);
+				dest.mBuffers[i].mDataByteSize = nFrames * bytesPerFrame;
+			}
+			cb->mLastUse = ++mUseCount;
+			++mCacheReadCount;
+			fromCache = true;
+		}
+	}
+	if (!fromCache) {
+		// filling the cache moves the file's read position
+		if (mFile->Tell() != curFrame)
+			mFile->Seek(curFrame);
+		mFile->Read(nFrames, &fileBuffers->GetModifiableBufferList());
+		++mDiskReadCount;
+	}
+	mReadFrame = curFrame + nFrames;
 	b->UpdateAfterRead(curFrame, nFrames);
+	
+	if (mSeekStartNanos != 0) {
+		// first buffer at the new position
+		UInt64 latency = CAHostTimeBase::GetCurrentTimeInNanos() - mSeekStartNanos;
+		mSeekStartNanos = 0;
+		mLastSeekLatencyNanos = latency;
+		if (latency > mMaxSeekLatencyNanos)
+			mMaxSeekLatencyNanos = latency;
+		mTotalSeekLatencyNanos += latency;
+		++mSeekLatencyCount;
+	}
+	
+	// while priming, the client is waiting; otherwise we're on the work thread and can
+	// afford one more read towards the hinted regions
+	if (mRunning)
+		FillHintCache(1);
+}
+
+void	CAAudioFileReader::SetUsesPageCache(bool b)
+{
+	mUsesPageCache = b;
+	if (mFile == NULL)
+		return;
+	
+	// as in SetCurrentFrame, what was read ahead the old way is thrown away, so start
+	// reading again at the frame the client is about to get
+	SInt64 frameNumber = GetCurrentFrame();
+	bool wasRunning = IsRunning();
+	if (wasRunning)
+		Stop();
+	CancelBuffers();
+	
+	{
+		CAMutex::Locker lock(mFileMutex);
+		mFile->SetUsesPageCache(b);
+		try {
+			GetFile().Seek(frameNumber);
+		}
+		catch (...) {
+			frameNumber = GetFile().Tell();
+		}
+		mReadFrame = frameNumber;
+	}
+	if (wasRunning)
+		Start();
+}
+
+// ____________________________________________________________________________
+
+void	CAAudioFileReader::SetHintCacheSize(UInt32 nBuffers)
+{
+	// waits for a fill in progress on the work thread
+	CAMutex::Locker fileLock(mFileMutex);
+	CAMutex::Locker cacheLock(mCacheMutex);
+	if (nBuffers == mCacheSize)
+		return;
+	DisposeHintCache();
+	mCacheSize = nBuffers;
+	if (mHintedFrames.size() > mCacheSize) {
+		// keep the earliest hints
+		mHintedFrames.resize(mCacheSize);
+		mHintedFrameIndex = mHintedFrames;
+		std::sort(mHintedFrameIndex.begin(), mHintedFrameIndex.end());
+	}
+	AllocateHintCache();
+}
+
+void	CAAudioFileReader::AddReadHint(SInt64 startFrame, SInt64 endFrame)
+{
+	if (startFrame < 0)
+		startFrame = 0;
+	if (endFrame <= startFrame)
+		return;
+	
+	// hints are kept as the buffer start frames they ask for, so there are never more of
+	// them than the cache can hold
+	UInt32 bufferFrames = GetBufferSizeFrames();
+	CAMutex::Locker lock(mCacheMutex);
+	for (SInt64 frame = startFrame; frame < endFrame && mHintedFrames.size() < mCacheSize; frame += bufferFrames) {
+		std::vector<SInt64>::iterator it = std::lower_bound(mHintedFrameIndex.begin(), mHintedFrameIndex.end(), frame);
+		if (it != mHintedFrameIndex.end() && *it == frame)
+			continue;	// an earlier hint overlaps this one
+		mHintedFrameIndex.insert(it, frame);
+		mHintedFrames.push_back(frame);
+		mCacheComplete = false;
+	}
+}
+
+void	CAAudioFileReader::ClearReadHints()
+{
+	// what's resident stays usable until FillHintCache needs the space for new hints
+	CAMutex::Locker lock(mCacheMutex);
+	mHintedFrames.clear();
+	mHintedFrameIndex.clear();
+	mNextHintedFrame = 0;
+	mCacheComplete = true;
+}
+
+void	CAAudioFileReader::PrefetchHints()
+{
+	CAMutex::Locker lock(mFileMutex);
+	while (FillHintCache(8))
+		;
+}
+
+void	CAAudioFileReader::ResetReadStatistics()
+{
+	mSeekCount = 0;
+	mSeekHitCount = 0;
+	mCacheReadCount = 0;
+	mDiskReadCount = 0;
+	mSeekLatencyCount = 0;
+	mLastSeekLatencyNanos = 0;
+	mMaxSeekLatencyNanos = 0;
+	mTotalSeekLatencyNanos = 0;
+}
+
+void	CAAudioFileReader::AllocateHintCache()
+{
+	if (mFile == NULL || mCacheSize == 0)
+		return;
+	const CAStreamBasicDescription &fmt = mFile->GetClientDataFormat();
+	UInt32 nBytes = GetBufferSizeFrames() * fmt.mBytesPerFrame;
+	mCache = new CachedBuffer[mCacheSize];
+	for (UInt32 i = 0; i < mCacheSize; ++i) {
+		CachedBuffer &cb = mCache[i];
+		cb.mMemory = CABufferList::New("", fmt);
+		cb.mMemory->AllocateBuffers(nBytes);
+		cb.mFileFrame = -1;
+		cb.mFrameCount = 0;
+		cb.mLastUse = 0;
+	}
+	mResidentIndex.reserve(mCacheSize);
+	mNextHintedFrame = 0;
+	mCacheComplete = mHintedFrames.empty();
+}
+
+void	CAAudioFileReader::DisposeHintCache()
+{
+	if (mCache != NULL) {
+		for (UInt32 i = 0; i < mCacheSize; ++i)
+			delete mCache[i].mMemory;
+		delete[] mCache;	mCache = NULL;
+	}
+	mResidentIndex.clear();
+	mCacheComplete = true;
+}
+
+CAAudioFileReader::CachedBuffer *	CAAudioFileReader::FindCachedBuffer(SInt64 frame)
+{
+	// the last resident buffer starting at or before frame is the only one that can hold it
+	std::vector<ResidentEntry>::iterator it = std::upper_bound(mResidentIndex.begin(), mResidentIndex.end(), ResidentEntry(frame, 0xFFFFFFFF));
+	if (it == mResidentIndex.begin())
+		return NULL;
+	CachedBuffer &cb = mCache[(--it)->second];
+	return (frame < cb.mFileFrame + cb.mFrameCount) ? &cb : NULL;
+}
+
+CAAudioFileReader::CachedBuffer *	CAAudioFileReader::TakeCacheSlot()
+{
+	CachedBuffer *victim = NULL;
+	for (UInt32 i = 0; i < mCacheSize; ++i) {
+		CachedBuffer &cb = mCache[i];
+		if (cb.mFileFrame < 0)
+			return &cb;
+		if (std::binary_search(mHintedFrameIndex.begin(), mHintedFrameIndex.end(), cb.mFileFrame))
+			continue;
+		if (victim == NULL || cb.mLastUse < victim->mLastUse)
+			victim = &cb;
+	}
+	if (victim != NULL) {
+		std::vector<ResidentEntry>::iterator it = std::lower_bound(mResidentIndex.begin(), mResidentIndex.end(), ResidentEntry(victim->mFileFrame, 0));
+		mResidentIndex.erase(it);
+		victim->mFileFrame = -1;
+	}
+	return victim;
+}
+
+bool	CAAudioFileReader::FillHintCache(int maxBuffers)
+{
+	if (mFile == NULL)
+		return false;
+	
+	UInt32 bufferFrames = GetBufferSizeFrames();
+	SInt64 nFileFrames = GetNumberFrames();
+	for (int nFilled = 0; nFilled < maxBuffers; ++nFilled) {
+		CachedBuffer *cb;
+		SInt64 frame = 0;
+		{
+			CAMutex::Locker lock(mCacheMutex);
+			if (mCacheComplete || mCache == NULL)
+				return false;
+			for ( ; mNextHintedFrame < mHintedFrames.size(); ++mNextHintedFrame) {
+				frame = mHintedFrames[mNextHintedFrame];
+				if (frame >= nFileFrames)
+					continue;
+				CachedBuffer *resident = FindCachedBuffer(frame);
+				if (resident == NULL || resident->mFileFrame != frame)
+					break;
+			}
+			if (mNextHintedFrame == mHintedFrames.size()) {
+				mCacheComplete = true;
+				return false;
+			}
+			cb = TakeCacheSlot();
+			if (cb == NULL) {
+				mCacheComplete = true;
+				return false;
+			}
+			// the slot is now free but only a fill, which needs mFileMutex, takes free slots,
+			// and the cache can't be reallocated without it either, so it stays ours
+		}
+		
+		CABufferList *fileBuffers = GetBufferList();
+		fileBuffers->SetFrom(cb->mMemory);
+		UInt32 nFrames = bufferFrames;
+		bool failed = false;
+		try {
+			if (mFile->Tell() != frame)
+				mFile->Seek(frame);
+			mFile->Read(nFrames, &fileBuffers->GetModifiableBufferList());
+		}
+		catch (...) {
+			failed = true;
+		}
+		
+		CAMutex::Locker lock(mCacheMutex);
+		if (failed) {
+			++mErrorCount;
+			mCacheComplete = true;
+			return false;
+		}
+		if (nFrames == 0) {
+			// past the end after all; the loop above moves on if the hints haven't changed
+			if (mNextHintedFrame < mHintedFrames.size() && mHintedFrames[mNextHintedFrame] == frame)
+				++mNextHintedFrame;
+			continue;
+		}
+		// published even if ClearReadHints ran meanwhile: the audio is still good for hits
+		cb->mFileFrame = frame;
+		cb->mFrameCount = nFrames;
+		cb->mLastUse = ++mUseCount;
+		ResidentEntry entry(frame, UInt32(cb - mCache));
+		mResidentIndex.insert(std::lower_bound(mResidentIndex.begin(), mResidentIndex.end(), entry), entry);
+	}
+	return true;
 }
 
 double		CAAudioFileReader::GetCurrentPosition() const
@@ -136,7 +450,7 @@ double		CAAudioFileReader::GetCurrentPosition() const
 SInt64	CAAudioFileReader::GetCurrentFrame() const
 {
 	if (!mRunning)
-		return mFile->Tell();
+		return mReadFrame;
 	if (mEndOfStream)
 		return GetNumberFrames();
 	const FileReadBuffer *b = static_cast<const FileReadBuffer *>(GetCurrentBuffer());
@@ -148,16 +462,38 @@ SInt64	CAAudioFileReader::GetCurrentFrame() const
 }
 
 void	CAAudioFileReader::SetCurrentPosition(double loc)
+{
+	SetCurrentFrame(SInt64(loc * GetFile().GetNumberFrames() + 0.5));
+}
+
+void	CAAudioFileReader::SetCurrentFrame(SInt64 frameNumber)
 {
 	bool wasRunning = IsRunning();
 	if (wasRunning)
 		Stop();
-	SInt64 frameNumber = SInt64(loc * GetFile().GetNumberFrames() + 0.5);
-	try {
-		GetFile().Seek(frameNumber);
-	}
-	catch (...) {
+	// the work thread may still be reading ahead at the old position
+	CancelBuffers();
 	
+	{
+		CAMutex::Locker fileLock(mFileMutex);
+		bool hit;
+		{
+			CAMutex::Locker cacheLock(mCacheMutex);
+			hit = (FindCachedBuffer(frameNumber) != NULL);
+		}
+		++mSeekCount;
+		if (hit)
+			++mSeekHitCount;
+		else {
+			try {
+				GetFile().Seek(frameNumber);
+			}
+			catch (...) {
+				frameNumber = GetFile().Tell();
+			}
+		}
+		mReadFrame = frameNumber;
+		mSeekStartNanos = wasRunning ? CAHostTimeBase::GetCurrentTimeInNanos() : 0;
 	}
 	if (wasRunning)
 		Start();
@@ -165,6 +501,64 @@ void	CAAudioFileReader::SetCurrentPosition(double loc)
 
 // ____________________________________________________________________________
 
+CAAudioFileWriter *	CAAudioFileWriter::sGroup = NULL;
+CAMutex				CAAudioFileWriter::sGroupMutex("CAAudioFileWriter::sGroupMutex");
+
+// Best effort: reserve disk space past the end of a newly created file so that a long
+// recording doesn't fragment. The reservation lasts while ExtAudioFile has the file open.
+static void	PreallocateFile(const FSRef &parentDir, CFStringRef filename, UInt64 nBytes)
+{
+#if TARGET_OS_MAC
+	char path[1024];
+	if (FSRefMakePath(&parentDir, (UInt8 *)path, sizeof(path)) != noErr)
+		return;
+	size_t len = strlen(path);
+	if (len + 2 >= sizeof(path))
+		return;
+	path[len++] = '/';
+	if (!CFStringGetFileSystemRepresentation(filename, path + len, sizeof(path) - len))
+		return;
+	int fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return;
+	fstore_t store = { F_ALLOCATECONTIG | F_ALLOCATEALL, F_PEOFPOSMODE, 0, off_t(nBytes), 0 };
+	if (fcntl(fd, F_PREALLOCATE, &store) == -1) {
+		// no contiguous run that large; take what there is
+		store.fst_flags = F_ALLOCATEALL;
+		fcntl(fd, F_PREALLOCATE, &store);
+	}
+	close(fd);
+#endif
+}
+
+CAAudioFileWriter::CAAudioFileWriter(int nBuffers, UInt32 bufferSizeFrames) :
+	CAPushBufferQueue(nBuffers, bufferSizeFrames),
+	mStagingMutex("CAAudioFileWriter::mStagingMutex"),
+	mStaging(NULL),
+	mCommitFrames(0),
+	mStagedFrames(0),
+	mStagedSinceNanos(0),
+	mCommitBytes(0),
+	mMaxDelayNanos(0),
+	mPreallocationBytes(0),
+	mCommitCount(0),
+	mCommittedBytes(0),
+	mGroupNext(NULL)
+{
+}
+
+CAAudioFileWriter::~CAAudioFileWriter()
+{
+	WaitForBuffers();
+	LeaveGroup();
+	try {
+		CommitStaged();
+	}
+	catch (...) {
+	}
+	delete mStaging;
+}
+
 void	CAAudioFileWriter::SetFile(AudioFileID fileID)
 {
 	Stop();
@@ -181,6 +575,7 @@ void	CAAudioFileWriter::SetFile(AudioFileID fileID)
 	mFile->SetClientFormat(iofmt, NULL);
 	
 	SetFormat(iofmt);
+	AllocateStaging();
 }
 
 void	CAAudioFileWriter::SetFile(const FSRef &parentDir, CFStringRef filename, AudioFileTypeID filetype, const CAStreamBasicDescription &dataFormat, const CAAudioChannelLayout *layout)
@@ -191,6 +586,8 @@ void	CAAudioFileWriter::SetFile(const FSRef &parentDir, CFStringRef filename, Au
 	delete mFile;   mFile = NULL;
 	mFile = new CAAudioFile;
 	mFile->CreateNew(parentDir, filename, filetype, dataFormat, layout ? &layout->Layout() : NULL);
+	if (mPreallocationBytes > 0)
+		PreallocateFile(parentDir, filename, mPreallocationBytes);
 	
 	const CAStreamBasicDescription &fileFmt = mFile->GetFileDataFormat();
 	CAStreamBasicDescription iofmt;
@@ -199,6 +596,7 @@ void	CAAudioFileWriter::SetFile(const FSRef &parentDir, CFStringRef filename, Au
 	mFile->SetClientFormat(iofmt, NULL);
 	
 	SetFormat(iofmt);
+	AllocateStaging();
 }
 
 void	CAAudioFileWriter::Start()
@@ -209,12 +607,37 @@ void	CAAudioFileWriter::Start()
 
 void	CAAudioFileWriter::Stop()
 {
+	// the final partial buffer has to follow the ones still being written, and has to have
+	// been staged itself before the staged frames are committed
+	WaitForBuffers();
 	Flush();
+	WaitForBuffers();
+	CommitStaged();
 	mRunning = false;
 }
 
+void	CAAudioFileWriter::SetGroupCommit(UInt32 commitBytes, UInt32 maxDelayMilliseconds)
+{
+	CommitStaged();
+	mCommitBytes = commitBytes;
+	mMaxDelayNanos = UInt64(maxDelayMilliseconds) * 1000000;
+	if (commitBytes == 0) {
+		LeaveGroup();
+		CAMutex::Locker lock(mStagingMutex);
+		delete mStaging;	mStaging = NULL;
+		mCommitFrames = 0;
+	} else {
+		AllocateStaging();
+		JoinGroup();
+	}
+}
+
 void	CAAudioFileWriter::WriteBuffer(CABufferQueue::Buffer *b)
 {
+	if (mStaging != NULL) {
+		StageBuffer(b);
+		return;
+	}
 	CABufferList *ioMemory = b->GetBufferList();
 	CABufferList *fileBuffers = GetBufferList();
 	UInt32 nFrames = b->FrameCount();
@@ -222,3 +645,229 @@ void	CAAudioFileWriter::WriteBuffer(CABufferQueue::Buffer *b)
 	mFile->Write(nFrames, &fileBuffers->GetModifiableBufferList());
 	b->SetEmpty();
 }
+
+// ____________________________________________________________________________
+// group commit
+
+void	CAAudioFileWriter::StageBuffer(CABufferQueue::Buffer *b)
+{
+	CAMutex::Locker lock(mStagingMutex);
+	const CABufferList *ioMemory = b->GetBufferList();
+	const AudioBufferList &src = ioMemory->GetBufferList();
+	AudioBufferList &staging = mStaging->GetModifiableBufferList();
+	UInt32 bytesPerFrame = GetBytesPerFrame();
+	UInt32 nFrames = b->FrameCount();
+	UInt32 framesStaged = 0;
+	UInt64 now = CAHostTimeBase::GetCurrentTimeInNanos();
+	
+	while (framesStaged < nFrames) {
+		if (mStagedFrames == 0)
+			mStagedSinceNanos = now;
+		UInt32 n = std::min(nFrames - framesStaged, mCommitFrames - mStagedFrames);
+		for (UInt32 i = 0; i < staging.mNumberBuffers; ++i)
+			memcpy((Byte *)staging.mBuffers[i].mData + mStagedFrames * bytesPerFrame,
+				(const Byte *)src.mBuffers[i].mData + framesStaged * bytesPerFrame, n * bytesPerFrame);
+		mStagedFrames += n;
+		framesStaged += n;
+		if (mStagedFrames == mCommitFrames) {
+			CAMutex::Locker group(sGroupMutex);
+			Commit();
+			CommitStaleWriters(this);
+		}
+	}
+	b->SetEmpty();
+	
+	if (mStagedFrames > 0 && now - mStagedSinceNanos >= mMaxDelayNanos) {
+		CAMutex::Locker group(sGroupMutex);
+		Commit();
+		CommitStaleWriters(this);
+	}
+}
+
+// caller holds mStagingMutex and sGroupMutex
+void	CAAudioFileWriter::Commit()
+{
+	if (mStagedFrames == 0)
+		return;
+	UInt32 nFrames = mStagedFrames;
+	mStagedFrames = 0;
+	
+	CABufferList *fileBuffers = GetBufferList();
+	fileBuffers->SetFrom(mStaging, GetBytesPerFrame() * nFrames);
+	const AudioBufferList &abl = fileBuffers->GetModifiableBufferList();
+	mFile->Write(nFrames, &abl);
+	++mCommitCount;
+	mCommittedBytes += UInt64(nFrames) * GetBytesPerFrame() * abl.mNumberBuffers;
+}
+
+void	CAAudioFileWriter::CommitStaged()
+{
+	CAMutex::Locker lock(mStagingMutex);
+	if (mStagedFrames > 0) {
+		CAMutex::Locker group(sGroupMutex);
+		Commit();
+	}
+}
+
+// Piggyback on a commit in progress: write out the other writers' runs that have waited
+// too long, back to back. Writers that are busy staging are skipped rather than waited
+// for, since they may be waiting for sGroupMutex themselves.
+void	CAAudioFileWriter::CommitStaleWriters(CAAudioFileWriter *exclude)
+{
+	UInt64 now = CAHostTimeBase::GetCurrentTimeInNanos();
+	for (CAAudioFileWriter *w = sGroup; w != NULL; w = w->mGroupNext) {
+		if (w == exclude)
+			continue;
+		CAMutex::Tryer tryer(w->mStagingMutex);
+		if (!tryer.HasLock())
+			continue;
+		if (w->mStagedFrames > 0 && now - w->mStagedSinceNanos >= w->mMaxDelayNanos) {
+			try {
+				w->Commit();
+			}
+			catch (...) {
+				++w->mErrorCount;
+			}
+		}
+	}
+}
+
+void	CAAudioFileWriter::WaitForBuffers()
+{
+	while (BuffersInProgress())
+		usleep(1000);
+}
+
+void	CAAudioFileWriter::AllocateStaging()
+{
+	CAMutex::Locker lock(mStagingMutex);
+	delete mStaging;	mStaging = NULL;
+	mStagedFrames = 0;
+	mCommitFrames = 0;
+	if (mCommitBytes == 0 || mFile == NULL)
+		return;
+	
+	const CAStreamBasicDescription &fmt = mFile->GetClientDataFormat();
+	UInt32 bytesPerFrame = fmt.mBytesPerFrame * fmt.NumberChannelStreams();
+	UInt32 nFrames = mCommitBytes / bytesPerFrame;
+	nFrames -= nFrames % kCommitAlignmentFrames;
+	if (nFrames < kCommitAlignmentFrames)
+		nFrames = kCommitAlignmentFrames;
+	
+	mStaging = CABufferList::New("staging", fmt);
+	mStaging->AllocateBuffers(nFrames * fmt.mBytesPerFrame);
+	mCommitFrames = nFrames;
+	// let ExtAudioFile pass each commit to the file in one piece
+	mFile->SetIOBufferSizeBytes(nFrames * fmt.mBytesPerFrame);
+}
+
+void	CAAudioFileWriter::JoinGroup()
+{
+	CAMutex::Locker group(sGroupMutex);
+	for (CAAudioFileWriter *w = sGroup; w != NULL; w = w->mGroupNext)
+		if (w == this)
+			return;
+	mGroupNext = sGroup;
+	sGroup = this;
+}
+
+void	CAAudioFileWriter::LeaveGroup()
+{
+	CAMutex::Locker group(sGroupMutex);
+	for (CAAudioFileWriter **link = &sGroup; *link != NULL; link = &(*link)->mGroupNext)
+		if (*link == this) {
+			*link = mGroupNext;
+			mGroupNext = NULL;
+			return;
+		}
+}
+
+// ____________________________________________________________________________
+// benchmark
+
+bool	CAAudioFileWriter::MeasureGroupCommit(const FSRef &parentDir, UInt32 nWriters, UInt32 nChannels, Float64 sampleRate, Float64 seconds, Float64 speed, UInt32 commitBytes, GroupCommitStatistics &outStats)
+{
+	memset(&outStats, 0, sizeof(outStats));
+	outStats.mNumberWriters = nWriters;
+	if (nWriters == 0 || nChannels == 0 || sampleRate <= 0. || seconds <= 0. || speed <= 0.)
+		return false;
+	
+	// the sizes of a typical multitrack recorder
+	const int kQueueBuffers = 4;
+	const UInt32 kQueueBufferFrames = 16384, kCycleFrames = 512;
+	
+	CAStreamBasicDescription fileFormat;
+	fileFormat.SetCanonical(nChannels, true);
+	fileFormat.mSampleRate = sampleRate;
+	CAStreamBasicDescription ioFormat;
+	ioFormat.SetCanonical(nChannels, false);
+	ioFormat.mSampleRate = sampleRate;
+	
+	CABufferList *cycle = CABufferList::New("cycle", ioFormat);
+	cycle->AllocateBuffers(kCycleFrames * ioFormat.mBytesPerFrame);
+	
+	CAAudioFileWriter **writers = new CAAudioFileWriter *[nWriters];
+	memset(writers, 0, nWriters * sizeof(CAAudioFileWriter *));
+	bool ok = true;
+	UInt64 start = 0, end = 0;
+	try {
+		for (UInt32 i = 0; i < nWriters; ++i) {
+			CFStringRef filename = CFStringCreateWithFormat(NULL, NULL, CFSTR("GroupCommit-%03u.caf"), (unsigned)i);
+			writers[i] = new CAAudioFileWriter(kQueueBuffers, kQueueBufferFrames);
+			writers[i]->SetGroupCommit(commitBytes);
+			try {
+				writers[i]->SetFile(parentDir, filename, kAudioFileCAFType, fileFormat, NULL);
+			}
+			catch (...) {
+				CFRelease(filename);
+				throw;
+			}
+			CFRelease(filename);
+			writers[i]->Start();
+		}
+		
+		// one cycle at a time to every writer, on the cycle's schedule
+		UInt64 nCycles = UInt64(seconds * sampleRate / kCycleFrames);
+		Float64 nanosPerCycle = Float64(kCycleFrames) * 1.0e9 / (sampleRate * speed);
+		start = CAHostTimeBase::GetCurrentTimeInNanos();
+		for (UInt64 c = 0; c < nCycles; ++c) {
+			UInt64 due = start + UInt64(Float64(c) * nanosPerCycle);
+			UInt64 now = CAHostTimeBase::GetCurrentTimeInNanos();
+			if (due > now)
+				usleep(useconds_t((due - now) / 1000));
+			for (UInt32 i = 0; i < nWriters; ++i)
+				writers[i]->PushBuffer(kCycleFrames, &cycle->GetModifiableBufferList());
+		}
+		for (UInt32 i = 0; i < nWriters; ++i)
+			writers[i]->Stop();
+		end = CAHostTimeBase::GetCurrentTimeInNanos();
+		
+		// every frame pushed has to have reached the file, and in group-commit mode been committed
+		SInt64 framesPerWriter = SInt64(nCycles * kCycleFrames);
+		UInt64 bytesPerWriter = UInt64(framesPerWriter) * ioFormat.mBytesPerFrame * nChannels;
+		outStats.mRecordedBytes = bytesPerWriter * nWriters;
+		for (UInt32 i = 0; i < nWriters; ++i) {
+			CAAudioFileWriter *w = writers[i];
+			SInt64 fileFrames = w->GetFile().GetNumberFrames();
+			if (fileFrames != framesPerWriter)
+				outStats.mNumberLostFrames += UInt64((fileFrames < framesPerWriter) ? framesPerWriter - fileFrames : fileFrames - framesPerWriter);
+			if (commitBytes != 0 && w->CommittedBytes() != bytesPerWriter)
+				++outStats.mNumberIncompleteCommits;
+			outStats.mMaxPushNanos = std::max(outStats.mMaxPushNanos, w->MaxPushNanos());
+			outStats.mCommitCount += w->CommitCount();
+			outStats.mErrorCount += w->ErrorCount();
+			outStats.mDeadlineMissCount += w->DeadlineMissCount();
+		}
+	}
+	catch (...) {
+		ok = false;
+	}
+	if (end > start)
+		outStats.mMBPerSecond = Float64(outStats.mRecordedBytes) * 1000. / Float64(end - start);
+	
+	for (UInt32 i = 0; i < nWriters; ++i)
+		delete writers[i];
+	delete[] writers;
+	delete cycle;
+	return ok && outStats.mErrorCount == 0 && outStats.mDeadlineMissCount == 0 && outStats.mNumberLostFrames == 0 && outStats.mNumberIncompleteCommits == 0;
+}
@@ -48,6 +48,8 @@
 
 #include "CABufferQueue.h"
 #include "CAAudioFile.h"
+#include "CAMutex.h"
+#include <vector>
 
 // ____________________________________________________________________________
 // Base class for CAAudioFileReader and CAAudioFileWriter
@@ -68,10 +70,14 @@ protected:
 
 // ____________________________________________________________________________
 
+// Reads ahead on the work thread. Regions the client expects to jump to (loop points,
+// cue lists) can be hinted; their decoded buffers are kept resident in a bounded cache, so a
+// seek or loop wrap into a hinted region primes from memory instead of the disk. Buffers no
+// longer hinted stay usable until their space is needed, least recently used first.
 class CAAudioFileReader : public CAPullBufferQueue, public CAAudioFileStreamer {
 public:
-	CAAudioFileReader(int nBuffers, UInt32 bufferSizeFrames) :
-		CAPullBufferQueue(nBuffers, bufferSizeFrames) { }
+	CAAudioFileReader(int nBuffers, UInt32 bufferSizeFrames);
+	virtual ~CAAudioFileReader();
 	
 	void				SetFile(const FSRef &inFile);
 	virtual void		Start();
@@ -81,8 +87,47 @@ public:
 	SInt64				GetNumberFrames() const { return mFile->GetNumberFrames(); }
 
 	void				SetCurrentPosition(double loc);	// 0-1
+	void				SetCurrentFrame(SInt64 frame);
+	
+	void				SetUsesPageCache(bool b);
+							// share decoded audio with other readers of the same file (see CAAudioFile)
+	
+	// read hints
+	void				SetHintCacheSize(UInt32 nBuffers);
+							// maximum number of buffers kept resident for hinted regions
+	void				AddReadHint(SInt64 startFrame, SInt64 endFrame);
+							// earlier hints are cached first; what doesn't fit in the cache
+							// when the hint is added is dropped, so set the size first
+	void				ClearReadHints();
+	void				PrefetchHints();
+							// fill the cache now, on the caller's thread; otherwise it is filled
+							// one buffer at a time by the work thread while running
+	
+	// read statistics
+	UInt32				SeekCount() const { return mSeekCount; }
+	UInt32				SeekHitCount() const { return mSeekHitCount; }
+							// seeks landing in a resident hinted buffer
+	double				SeekHitRate() const { return (mSeekCount > 0) ? double(mSeekHitCount) / mSeekCount : 0.; }
+	UInt32				CacheReadCount() const { return mCacheReadCount; }
+	UInt32				DiskReadCount() const { return mDiskReadCount; }
+	UInt64				LastSeekLatencyNanos() const { return mLastSeekLatencyNanos; }
+							// from the seek until the first buffer at the new position was ready
+	UInt64				MaxSeekLatencyNanos() const { return mMaxSeekLatencyNanos; }
+	UInt64				AverageSeekLatencyNanos() const { return (mSeekLatencyCount > 0) ? mTotalSeekLatencyNanos / mSeekLatencyCount : 0; }
+	void				ResetReadStatistics();
 
 private:
+	// one buffer's worth of decoded audio, starting at a hinted region's start plus a
+	// multiple of the buffer size
+	struct CachedBuffer {
+		CABufferList *	mMemory;
+		SInt64			mFileFrame;			// -1 if free
+		UInt32			mFrameCount;
+		UInt32			mLastUse;			// larger is more recent
+	};
+	
+	typedef std::pair<SInt64, UInt32>	ResidentEntry;	// file frame, cache slot
+	
 	class FileReadBuffer : public CABufferQueue::Buffer {
 	public:
 		FileReadBuffer(CABufferQueue *queue, const CAStreamBasicDescription &fmt, UInt32 nBytes) :
@@ -104,19 +149,96 @@ private:
 							ReadBuffer(static_cast<FileReadBuffer *>(b));
 						}
 	void				ReadBuffer(FileReadBuffer *b);
+	
+	// the following are called with mCacheMutex held, and the first two with mFileMutex too
+	void				AllocateHintCache();
+	void				DisposeHintCache();
+	CachedBuffer *		FindCachedBuffer(SInt64 frame);
+	CachedBuffer *		TakeCacheSlot();
+							// a free slot, or the least recently used one that isn't hinted
+	
+	bool				FillHintCache(int maxBuffers);
+							// called with mFileMutex held and mCacheMutex not; returns false
+							// when every hinted buffer is resident
+	
+	CAMutex				mFileMutex;				// serializes seeks and reads of mFile, and mReadFrame
+	SInt64				mReadFrame;				// file position of the next buffer to be read
+	bool				mUsesPageCache;
+	
+	CAMutex				mCacheMutex;			// protects the hints and the cache; never held during I/O
+	std::vector<SInt64>	mHintedFrames;			// buffers to cache, earliest hint first, at most mCacheSize
+	std::vector<SInt64>	mHintedFrameIndex;		// the same, sorted
+	UInt32				mNextHintedFrame;		// where FillHintCache picks up
+	CachedBuffer *		mCache;
+	UInt32				mCacheSize;
+	std::vector<ResidentEntry>	mResidentIndex;	// the slots holding audio, sorted by file frame
+	UInt32				mUseCount;
+	bool				mCacheComplete;			// nothing more to fill for the current hints
+	
+	UInt64				mSeekStartNanos;		// 0 unless waiting for the first buffer after a seek
+	UInt32				mSeekCount;
+	UInt32				mSeekHitCount;
+	UInt32				mCacheReadCount;
+	UInt32				mDiskReadCount;
+	UInt32				mSeekLatencyCount;		// seeks made while running
+	UInt64				mLastSeekLatencyNanos;
+	UInt64				mMaxSeekLatencyNanos;
+	UInt64				mTotalSeekLatencyNanos;
 };
 
 // ____________________________________________________________________________
 
+// Writes on the work thread, by default one file write per queue buffer. In group-commit
+// mode the buffers are staged and written in large runs instead, once enough has piled up
+// or the oldest staged frame is too old. All group-commit writers commit one at a time, and
+// a writer committing also commits the other writers' stale runs, so that recording many
+// files at once produces a few large sequential writes rather than many small interleaved
+// ones.
 class CAAudioFileWriter : public CAPushBufferQueue, public CAAudioFileStreamer {
 public:
-	CAAudioFileWriter(int nBuffers, UInt32 bufferSizeFrames) :
-		CAPushBufferQueue(nBuffers, bufferSizeFrames) { }
+	CAAudioFileWriter(int nBuffers, UInt32 bufferSizeFrames);
+	virtual ~CAAudioFileWriter();
 
 	void				SetFile(AudioFileID file);
 	void				SetFile(const FSRef &parentDir, CFStringRef filename, AudioFileTypeID filetype, const CAStreamBasicDescription &dataFormat, const CAAudioChannelLayout *layout);
 	virtual void		Start();
 	virtual void		Stop();
+	
+	void				SetGroupCommit(UInt32 commitBytes, UInt32 maxDelayMilliseconds = 500);
+							// commitBytes is rounded to a multiple of kCommitAlignmentFrames;
+							// 0 turns group commit off. Call while stopped.
+	void				SetPreallocationBytes(UInt64 nBytes) { mPreallocationBytes = nBytes; }
+							// reserve disk space for files subsequently created with
+							// SetFile(parentDir, ...), e.g. the expected size of a take
+	
+	UInt32				CommitFrames() const { return mCommitFrames; }
+							// 0 unless in group-commit mode
+	UInt32				CommitCount() const { return mCommitCount; }
+	UInt64				CommittedBytes() const { return mCommittedBytes; }
+							// client format bytes handed to the file
+	
+	enum { kCommitAlignmentFrames = 4096 };
+							// with power-of-two frame sizes, commits stay page-aligned in the file
+	
+	struct GroupCommitStatistics {
+		UInt32			mNumberWriters;
+		UInt64			mRecordedBytes;			// client format bytes pushed, by all the writers
+		Float64			mMBPerSecond;			// recorded bytes per second of wall time, stopping included
+		UInt64			mMaxPushNanos;			// worst PushBuffer of any writer, i.e. enqueue on the audio thread
+		UInt32			mCommitCount;			// 0 unless in group-commit mode
+		int				mErrorCount;			// overruns and failed writes
+		int				mDeadlineMissCount;
+		UInt64			mNumberLostFrames;		// difference between the frames pushed and the files' lengths
+		UInt32			mNumberIncompleteCommits;	// writers whose committed bytes don't add up to what was pushed
+	};
+	
+	static bool			MeasureGroupCommit(const FSRef &parentDir, UInt32 nWriters, UInt32 nChannels, Float64 sampleRate, Float64 seconds, Float64 speed, UInt32 commitBytes, GroupCommitStatistics &outStats);
+							// Records nWriters CAF files into parentDir at once, pushing from the
+							// calling thread the way an audio thread would, speed times faster than
+							// real time. commitBytes is passed to SetGroupCommit, so 0 measures the
+							// default mode. Returns false if anything failed or overran, or if any
+							// frame pushed didn't make it to its file. The files are left in
+							// parentDir.
 
 private:
 	virtual CABufferQueue::Buffer *	CreateBuffer(const CAStreamBasicDescription &fmt, UInt32 nBytes) {
@@ -126,6 +248,30 @@ private:
 							WriteBuffer(b);
 						}
 	void				WriteBuffer(CABufferQueue::Buffer *b);
+	
+	void				StageBuffer(CABufferQueue::Buffer *b);
+	void				Commit();				// caller holds mStagingMutex
+	void				CommitStaged();
+	void				WaitForBuffers();
+	void				AllocateStaging();
+	void				JoinGroup();
+	void				LeaveGroup();
+	static void			CommitStaleWriters(CAAudioFileWriter *exclude);	// caller holds sGroupMutex
+	
+	CAMutex				mStagingMutex;
+	CABufferList *		mStaging;				// NULL unless in group-commit mode
+	UInt32				mCommitFrames;			// staging capacity
+	UInt32				mStagedFrames;
+	UInt64				mStagedSinceNanos;		// when the oldest staged frame arrived
+	UInt32				mCommitBytes;
+	UInt64				mMaxDelayNanos;
+	UInt64				mPreallocationBytes;
+	UInt32				mCommitCount;
+	UInt64				mCommittedBytes;
+	
+	CAAudioFileWriter *	mGroupNext;
+	static CAAudioFileWriter *	sGroup;			// writers in group-commit mode
+	static CAMutex		sGroupMutex;			// guards sGroup and serializes commits
 };
 
 #endif // __CAAudioFileStreamer_h__
@@ -44,84 +44,229 @@
 =============================================================================*/
 
 #include "CABufferQueue.h"
+#include "CAHostTimeBase.h"
+#include "CAAtomic.h"
 
 #if TARGET_OS_WIN32
 	#include "CAWindows.h"
+#else
+	#include <unistd.h>
+#endif
+#if defined(__linux__)
+	#include "CAFutex.h"
+	#include <limits.h>
 #endif
 
 // ____________________________________________________________________________
 
-CABufferQueue::WorkThread *CABufferQueue::sWorkThread = NULL;
+CABufferQueue::WorkThread **CABufferQueue::sWorkThreads = NULL;
+int CABufferQueue::sNumberWorkThreads = 0;
+volatile SInt32 CABufferQueue::sNextWorkThread = 0;
 
+// not started here: StealBuffer needs mIndex and sWorkThreads as soon as the thread runs
 CABufferQueue::WorkThread::WorkThread() :
 	CAPThread(ThreadEntry, this, CAPThread::kMaxThreadPriority, true),
+	mIndex(0),
 	mStopped(false),
+	mIdle(false),
+	mWakeSequence(0),
+	mWorkQueue(NULL),
 	mRunGuard("CABufferQueue::mRunGuard")
 {
-	// prime the container to have some elements so we're not calling malloc dynamically
-	Buffer *b = NULL;
-	for (int i = 0; i < 64; ++i)
-		mWorkQueue.push_back(b);
-	mWorkQueue.clear();
-	Start();
+#if TARGET_OS_MAC && !defined(__linux__)
+	semaphore_create(mach_task_self(), &mWakeSemaphore, SYNC_POLICY_FIFO, 0);
+#endif
 }
 
 void	CABufferQueue::WorkThread::Run()
 {
 	while (!mStopped) {
-		CAGuard::Locker lock(mRunGuard);
-		mRunGuard.Wait();
-		
-		while (!mStopped) {
-			Buffer *b, *next;
-			
-			// add buffers from the other thread
-			TAtomicStack<Buffer> reversed;
-			
-			b = mBuffersToAdd.pop_all();	// these are in reverse order
-			while (b != NULL) {
-				next = b->get_next();
-				reversed.push_NA(b);
-				b = next;
+		Buffer *b;
+		{
+			CAGuard::Locker lock(mRunGuard);
+			b = TakeBuffer();
+		}
+		if (b == NULL)
+			b = StealBuffer();
+		if (b == NULL) {
+			// say we're going to sleep, then look once more: whoever queues a buffer either
+			// queued it before the barrier and we find it here, or sees mIdle and bumps the
+			// wake sequence, in which case the wait returns at once
+			SInt32 wakeSequence = mWakeSequence;
+			mIdle = true;
+			CAMemoryBarrier();
+			{
+				CAGuard::Locker lock(mRunGuard);
+				b = TakeBuffer();
 			}
-			while ((b = reversed.pop_NA()) != NULL)
-				mWorkQueue.push_back(b);
-			
-			if (mWorkQueue.empty())
-				break;
-			b = mWorkQueue.front();
-			mWorkQueue.pop_front();
-			
-			b->Queue()->ProcessBuffer(b);
-			b->SetInProgress(false);
+			if (b == NULL)
+				b = StealBuffer();
+			if (b == NULL && !mStopped)
+				WaitForWake(wakeSequence);
+			mIdle = false;
+			if (b == NULL)
+				continue;
+		}
+		
+		CABufferQueue *owner = b->Queue();
+		owner->ProcessBuffer(b);
+		owner->BufferDone(b);
+	}
+}
+
+// move buffers from the other threads into the work queue, keeping it in deadline order;
+// buffers with equal deadlines stay in the order they were added.
+// A buffer is only ever on one of mBuffersToAdd and mWorkQueue, so both share its next link
+// and moving buffers between the client and the work threads never allocates.
+void	CABufferQueue::WorkThread::InsertBuffers()
+{
+	Buffer *b = mBuffersToAdd.pop_all_reversed();
+	while (b != NULL) {
+		Buffer *next = b->get_next();
+		Buffer *prev = NULL, *p = mWorkQueue;
+		while (p != NULL && p->DeadlineNanos() <= b->DeadlineNanos()) {
+			prev = p;
+			p = p->get_next();
+		}
+		b->set_next(p);
+		if (prev != NULL)
+			prev->set_next(b);
+		else
+			mWorkQueue = b;
+		b = next;
+	}
+}
+
+// the most urgent buffer whose queue isn't already being processed
+CABufferQueue::Buffer *	CABufferQueue::WorkThread::TakeBuffer()
+{
+	InsertBuffers();
+	for (Buffer *prev = NULL, *b = mWorkQueue; b != NULL; prev = b, b = b->get_next()) {
+		if (!b->Queue()->mBusy) {
+			b->Queue()->mBusy = true;
+			if (prev != NULL)
+				prev->set_next(b->get_next());
+			else
+				mWorkQueue = b->get_next();
+			b->set_next(NULL);
+			return b;
 		}
 	}
+	return NULL;
+}
+
+CABufferQueue::Buffer *	CABufferQueue::WorkThread::StealBuffer()
+{
+	for (int i = 1; i < sNumberWorkThreads; ++i) {
+		WorkThread *victim = sWorkThreads[(mIndex + i) % sNumberWorkThreads];
+		bool needsRelease = false;
+		// don't wait for a thread that is busy with its own work queue
+		if (!victim->mRunGuard.Try(needsRelease))
+			continue;
+		Buffer *b = victim->TakeBuffer();
+		if (needsRelease)
+			victim->mRunGuard.Unlock();
+		if (b != NULL)
+			return b;
+	}
+	return NULL;
 }
 
 void	CABufferQueue::WorkThread::Stop()
 {
 	mStopped = true;
-	mRunGuard.Notify();
+	Wake();
+}
+
+// called on the client's thread, so this must never block
+void	CABufferQueue::WorkThread::Wake()
+{
+	CAAtomicIncrement32Barrier(&mWakeSequence);
+#if defined(__linux__)
+	CAFutex::Wake(&mWakeSequence, INT_MAX);
+#elif TARGET_OS_MAC
+	semaphore_signal(mWakeSemaphore);
+#else
+	mRunGuard.NotifyAll();
+#endif
+}
+
+void	CABufferQueue::WorkThread::WaitForWake(SInt32 inWakeSequence)
+{
+#if defined(__linux__)
+	// returns at once if the sequence has moved on since it was read
+	CAFutex::Wait(&mWakeSequence, inWakeSequence, NULL);
+#elif TARGET_OS_MAC
+	// the semaphore counts the signals, including any sent since the sequence was read
+	if (mWakeSequence == inWakeSequence)
+		semaphore_wait(mWakeSemaphore);
+#else
+	// the notification isn't made with the guard held, so the timeout bounds a missed one
+	CAGuard::Locker lock(mRunGuard);
+	if (mWakeSequence == inWakeSequence)
+		mRunGuard.WaitFor(5000000ULL);
+#endif
+}
+
+// wake a sleeping thread to steal work that its home thread is too busy to get to
+void	CABufferQueue::WorkThread::WakeIdleThread()
+{
+	for (int i = 0; i < sNumberWorkThreads; ++i) {
+		WorkThread *thread = sWorkThreads[i];
+		if (thread->mIdle) {
+			thread->Wake();
+			return;
+		}
+	}
 }
 
 void	CABufferQueue::WorkThread::AddBuffer(Buffer *b)
 {
 	b->SetInProgress(true);
 	mBuffersToAdd.push_atomic(b);
-	mRunGuard.Notify();
+	CAMemoryBarrier();
+	// the client only blocks on the guard when there's a sleeping thread to wake
+	if (mIdle)
+		Wake();
+	else
+		WakeIdleThread();
 }
 
 void	CABufferQueue::WorkThread::RemoveBuffers(CABufferQueue *owner)
 {
 	CAGuard::Locker lock(mRunGuard);
-	for (WorkQueue::iterator it = mWorkQueue.begin(); it != mWorkQueue.end(); ) {
-		if ((*it)->Queue() == owner) {
-			WorkQueue::iterator next = it;	++next;
-			mWorkQueue.erase(it);
-			it = next;
+	InsertBuffers();
+	for (Buffer *prev = NULL, *b = mWorkQueue; b != NULL; ) {
+		Buffer *next = b->get_next();
+		if (b->Queue() == owner) {
+			if (prev != NULL)
+				prev->set_next(next);
+			else
+				mWorkQueue = next;
+			b->set_next(NULL);
+			b->SetInProgress(false);
+			CAAtomicDecrement32Barrier(&owner->mBuffersInProgress);
 		} else
-			++it;
+			prev = b;
+		b = next;
+	}
+	// another thread may have stolen one of owner's buffers
+	while (owner->mBusy)
+		mRunGuard.Wait();
+}
+
+void	CABufferQueue::WorkThread::BufferDone(CABufferQueue *owner)
+{
+	{
+		CAGuard::Locker lock(mRunGuard);
+		owner->mBusy = false;
+		// for anyone in RemoveBuffers
+		mRunGuard.NotifyAll();
 	}
+	// and this thread for owner's next buffer. The thread that called us goes straight back to
+	// looking for work, so it steals owner's next buffer if this thread is busy with someone else's
+	if (mIdle)
+		Wake();
 }
 
 // ____________________________________________________________________________
@@ -187,6 +332,10 @@ bool	CABufferQueue::Buffer::CopyFrom(const AudioBufferList *srcBufferList, int b
 // ____________________________________________________________________________
 
 CABufferQueue::CABufferQueue(int nBuffers, UInt32 bufferSizeFrames) :
+	mBusy(false),
+	mBuffersInProgress(0),
+	mSampleRate(0.),
+	mLastDeadlineNanos(0),
 	mNumberBuffers(nBuffers),
 	mBuffers(NULL),
 	mBufferSizeFrames(bufferSizeFrames),
@@ -194,10 +343,35 @@ CABufferQueue::CABufferQueue(int nBuffers, UInt32 bufferSizeFrames) :
 {
 	mCurrentBuffer = 0;
 	mErrorCount = 0;
+	ResetStatistics();
+	// the clock's one time setup can allocate (on Linux it reads /proc/cpuinfo), so get it
+	// done here rather than in the client's first PushBuffer or PullBuffer
+	CAHostTimeBase::GetFrequency();
 	
-	if (sWorkThread == NULL)
-		sWorkThread = new WorkThread();
-	mWorkThread = sWorkThread;  // for now
+	if (sWorkThreads == NULL) {
+		if (sNumberWorkThreads <= 0) {
+#if TARGET_OS_WIN32
+			sNumberWorkThreads = 1;
+#else
+			long nCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+			sNumberWorkThreads = (nCPUs < 1) ? 1 : ((nCPUs > 8) ? 8 : int(nCPUs));
+#endif
+		}
+		WorkThread **threads = new WorkThread*[sNumberWorkThreads];
+		for (int i = 0; i < sNumberWorkThreads; ++i) {
+			threads[i] = new WorkThread();
+			threads[i]->mIndex = i;
+		}
+		// every thread has to be able to see all the others before any of them runs
+		CAMemoryBarrier();
+		sWorkThreads = threads;
+		CAMemoryBarrier();
+		for (int i = 0; i < sNumberWorkThreads; ++i)
+			threads[i]->Start();
+	}
+	// spread queues over the threads; stealing evens out the load from there
+	UInt32 nextWorkThread = UInt32(CAAtomicIncrement32Barrier(&sNextWorkThread) - 1);
+	mWorkThread = sWorkThreads[nextWorkThread % UInt32(sNumberWorkThreads)];
 }
 
 CABufferQueue::~CABufferQueue()
@@ -205,9 +379,58 @@ CABufferQueue::~CABufferQueue()
 	CancelAndDisposeBuffers();
 }
 
+void	CABufferQueue::SetNumberWorkThreads(int n)
+{
+	if (sWorkThreads == NULL)
+		sNumberWorkThreads = n;
+}
+
+void	CABufferQueue::ResetStatistics()
+{
+	mDeadlineMissCount = 0;
+	mProcessedCount = 0;
+	mMaxLatencyNanos = 0;
+	mTotalLatencyNanos = 0;
+}
+
 void	CABufferQueue::CancelBuffers()
 {
 	mWorkThread->RemoveBuffers(this);
+	mLastDeadlineNanos = 0;
+}
+
+// called from the client's thread when b has been filled or emptied
+void	CABufferQueue::AddBuffer(Buffer *b)
+{
+	UInt64 now = CAHostTimeBase::GetCurrentTimeInNanos();
+	int inProgress = CAAtomicIncrement32Barrier(&mBuffersInProgress);
+	
+	// the client can keep going on the buffers that aren't in progress
+	UInt64 slack = 0;
+	if (mSampleRate > 0. && inProgress < mNumberBuffers)
+		slack = UInt64((mNumberBuffers - inProgress) * (Float64)mBufferSizeFrames * 1.0e9 / mSampleRate);
+	// never earlier than the buffer before it, so that our buffers are processed in ring order
+	UInt64 deadline = std::max(now + slack, mLastDeadlineNanos);
+	mLastDeadlineNanos = deadline;
+	b->SetSchedule(now, deadline);
+	mWorkThread->AddBuffer(b);
+}
+
+// called on the work thread that processed b
+void	CABufferQueue::BufferDone(Buffer *b)
+{
+	UInt64 now = CAHostTimeBase::GetCurrentTimeInNanos();
+	UInt64 latency = now - b->QueuedNanos();
+	if (now > b->DeadlineNanos())
+		++mDeadlineMissCount;
+	if (latency > mMaxLatencyNanos)
+		mMaxLatencyNanos = latency;
+	mTotalLatencyNanos += latency;
+	++mProcessedCount;
+	
+	CAAtomicDecrement32Barrier(&mBuffersInProgress);
+	b->SetInProgress(false);
+	mWorkThread->BufferDone(this);
 }
 
 void	CABufferQueue::CancelAndDisposeBuffers()
@@ -226,6 +449,8 @@ void	CABufferQueue::SetFormat(const CAStreamBasicDescription &fmt)
 	CancelAndDisposeBuffers();
 	
 	mBytesPerFrame = fmt.mBytesPerFrame;
+	mSampleRate = fmt.mSampleRate;
+	mBuffersInProgress = 0;
 	mBuffers = new Buffer*[mNumberBuffers];
 	for (int i = 0; i < mNumberBuffers; ++i)
 		mBuffers[i] = CreateBuffer(fmt, mBufferSizeFrames * mBytesPerFrame);
@@ -236,6 +461,7 @@ void	CABufferQueue::SetFormat(const CAStreamBasicDescription &fmt)
 
 void	CAPushBufferQueue::PushBuffer(UInt32 inNumberFrames, const AudioBufferList *inBufferList)
 {
+	UInt64 startNanos = CAHostTimeBase::GetCurrentTimeInNanos();
 	UInt32 framesRequired = inNumberFrames;
 	UInt32 framesProduced = 0;
 	
@@ -249,11 +475,15 @@ void	CAPushBufferQueue::PushBuffer(UInt32 inNumberFrames, const AudioBufferList
 		
 		if (b->CopyFrom(inBufferList, mBytesPerFrame, framesProduced, framesRequired)) {
 			// buffer was filled, we're done with it
-			sWorkThread->AddBuffer(b);
+			AddBuffer(b);
 			if (++mCurrentBuffer == mNumberBuffers)
 				mCurrentBuffer = 0;
 		}
 	} while (framesRequired > 0);
+	
+	UInt64 elapsed = CAHostTimeBase::GetCurrentTimeInNanos() - startNanos;
+	if (elapsed > mMaxPushNanos)
+		mMaxPushNanos = elapsed;
 }
 
 void	CAPushBufferQueue::Flush()
@@ -286,7 +516,7 @@ void	CAPullBufferQueue::PullBuffer(UInt32 &ioFrames, AudioBufferList *outBufferL
 		
 		if (b->CopyInto(outBufferList, mBytesPerFrame, framesProduced, framesRequired)) {
 			// buffer emptied
-			sWorkThread->AddBuffer(b);
+			AddBuffer(b);
 	
 			if (++mCurrentBuffer == mNumberBuffers)
 				mCurrentBuffer = 0;
@@ -310,3 +540,150 @@ void	CAPullBufferQueue::Prime()
 	mCurrentBuffer = 0;
 }
 
+// ____________________________________________________________________________
+
+// mono SInt32 frames, each the number of frames before it in the stream
+class CAMeasurePushQueue : public CAPushBufferQueue {
+public:
+	CAMeasurePushQueue(int nBuffers, UInt32 bufferSizeFrames) :
+		CAPushBufferQueue(nBuffers, bufferSizeFrames), mNextFrame(0), mDataErrors(0) { }
+	
+	virtual Buffer *	CreateBuffer(const CAStreamBasicDescription &fmt, UInt32 nBytes) {
+							return new Buffer(this, fmt, nBytes);
+						}
+	virtual void		ProcessBuffer(Buffer *b) {
+							const CABufferList *memory = b->GetBufferList();
+							const SInt32 *p = (const SInt32 *)memory->GetBufferList().mBuffers[0].mData;
+							for (UInt32 i = 0, n = b->FrameCount(); i < n; ++i)
+								if (p[i] != mNextFrame++)
+									++mDataErrors;
+							b->SetEmpty();
+						}
+	bool				IsIdle() const { return !BuffersInProgress(); }
+	
+	SInt32				mNextFrame;				// on the work threads
+	UInt32				mDataErrors;
+};
+
+class CAMeasurePullQueue : public CAPullBufferQueue {
+public:
+	CAMeasurePullQueue(int nBuffers, UInt32 bufferSizeFrames) :
+		CAPullBufferQueue(nBuffers, bufferSizeFrames), mNextFrame(0), mNextPulledFrame(0) { }
+	
+	class FillBuffer : public Buffer {
+	public:
+		FillBuffer(CABufferQueue *queue, const CAStreamBasicDescription &fmt, UInt32 nBytes) :
+			Buffer(queue, fmt, nBytes) { }
+		void			Fill(SInt32 &ioNextFrame, UInt32 nFrames) {
+							SInt32 *p = (SInt32 *)mMemory->GetModifiableBufferList().mBuffers[0].mData;
+							for (UInt32 i = 0; i < nFrames; ++i)
+								p[i] = ioNextFrame++;
+							mStartFrame = 0;
+							mEndFrame = nFrames;
+						}
+	};
+	
+	virtual Buffer *	CreateBuffer(const CAStreamBasicDescription &fmt, UInt32 nBytes) {
+							return new FillBuffer(this, fmt, nBytes);
+						}
+	virtual void		ProcessBuffer(Buffer *b) {
+							static_cast<FillBuffer *>(b)->Fill(mNextFrame, GetBufferSizeFrames());
+						}
+	bool				IsIdle() const { return !BuffersInProgress(); }
+	
+	SInt32				mNextFrame;				// on the work threads
+	SInt32				mNextPulledFrame;		// on the client's thread
+};
+
+bool	CABufferQueue::MeasureAllocations(int nQueues, UInt32 nCycles, AllocationCounter counter, AllocationStatistics &outStats)
+{
+	memset(&outStats, 0, sizeof(outStats));
+	outStats.mNumberQueues = nQueues;
+	if (nQueues < 1)
+		return false;
+	
+	const int kBuffers = 4;
+	const UInt32 kBufferFrames = 256, kSliceFrames = kBufferFrames / 2;
+	CAStreamBasicDescription fmt;
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.mSampleRate = 44100.;
+	fmt.mFormatID = kAudioFormatLinearPCM;
+	fmt.mFormatFlags = kAudioFormatFlagIsSignedInteger | kAudioFormatFlagIsPacked;
+	fmt.mBytesPerPacket = fmt.mBytesPerFrame = sizeof(SInt32);
+	fmt.mFramesPerPacket = 1;
+	fmt.mChannelsPerFrame = 1;
+	fmt.mBitsPerChannel = 32;
+	
+	// everything is allocated up front, as a client does before it starts its audio thread
+	CAMeasurePushQueue **pushQueues = new CAMeasurePushQueue*[nQueues];
+	CAMeasurePullQueue **pullQueues = new CAMeasurePullQueue*[nQueues];
+	for (int i = 0; i < nQueues; ++i) {
+		pushQueues[i] = new CAMeasurePushQueue(kBuffers, kBufferFrames);
+		pushQueues[i]->SetFormat(fmt);
+		pullQueues[i] = new CAMeasurePullQueue(kBuffers, kBufferFrames);
+		pullQueues[i]->SetFormat(fmt);
+		pullQueues[i]->Prime();
+	}
+	SInt32 slice[kSliceFrames];
+	AudioBufferList abl;
+	abl.mNumberBuffers = 1;
+	abl.mBuffers[0].mNumberChannels = 1;
+	abl.mBuffers[0].mDataByteSize = sizeof(slice);
+	abl.mBuffers[0].mData = slice;
+	
+	for (UInt32 cycle = 0; cycle < nCycles; ++cycle) {
+		for (int i = 0; i < nQueues; ++i) {
+			for (UInt32 f = 0; f < kSliceFrames; ++f)
+				slice[f] = SInt32(cycle * kSliceFrames + f);
+			int errors = pushQueues[i]->ErrorCount();
+			
+			UInt64 allocations = (counter != NULL) ? (*counter)() : 0;
+			UInt64 startNanos = CAHostTimeBase::GetCurrentTimeInNanos();
+			pushQueues[i]->PushBuffer(kSliceFrames, &abl);
+			UInt64 elapsed = CAHostTimeBase::GetCurrentTimeInNanos() - startNanos;
+			if (counter != NULL)
+				outStats.mAllocations += (*counter)() - allocations;
+			
+			outStats.mMaxCallNanos = std::max(outStats.mMaxCallNanos, elapsed);
+			outStats.mOverruns += pushQueues[i]->ErrorCount() - errors;
+			++outStats.mNumberCalls;
+		}
+		for (int i = 0; i < nQueues; ++i) {
+			CAMeasurePullQueue *q = pullQueues[i];
+			int errors = q->ErrorCount();
+			UInt32 nFrames = kSliceFrames;
+			
+			UInt64 allocations = (counter != NULL) ? (*counter)() : 0;
+			UInt64 startNanos = CAHostTimeBase::GetCurrentTimeInNanos();
+			q->PullBuffer(nFrames, &abl);
+			UInt64 elapsed = CAHostTimeBase::GetCurrentTimeInNanos() - startNanos;
+			if (counter != NULL)
+				outStats.mAllocations += (*counter)() - allocations;
+			
+			outStats.mMaxCallNanos = std::max(outStats.mMaxCallNanos, elapsed);
+			outStats.mOverruns += q->ErrorCount() - errors;
+			++outStats.mNumberCalls;
+			for (UInt32 f = 0; f < nFrames; ++f)
+				if (slice[f] != q->mNextPulledFrame++)
+					++outStats.mDataErrors;
+		}
+		
+		// let the work threads catch up, so that the client never runs into a buffer in progress
+		for (int i = 0; i < nQueues; ++i)
+			while (!pushQueues[i]->IsIdle() || !pullQueues[i]->IsIdle())
+#if TARGET_OS_WIN32
+				Sleep(1);
+#else
+				usleep(100);
+#endif
+	}
+	
+	for (int i = 0; i < nQueues; ++i) {
+		outStats.mDataErrors += pushQueues[i]->mDataErrors;
+		delete pushQueues[i];
+		delete pullQueues[i];
+	}
+	delete[] pushQueues;
+	delete[] pullQueues;
+	return outStats.mAllocations == 0 && outStats.mDataErrors == 0 && outStats.mOverruns == 0;
+}
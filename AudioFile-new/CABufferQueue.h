@@ -50,8 +50,11 @@
 #include "CAGuard.h"
 #include "CAStreamBasicDescription.h"
 #include "CABufferList.h"
-#include <list>
+#include <algorithm>
 #include "CAAtomicStack.h"
+#if TARGET_OS_MAC && !defined(__linux__)
+	#include <mach/mach.h>
+#endif
 
 // ____________________________________________________________________________
 
@@ -68,6 +71,37 @@ public:
 	UInt32				GetBufferSizeFrames() const { return mBufferSizeFrames; }
 	int					ErrorCount() const { return mErrorCount; }
 	
+	// scheduling statistics, maintained by the work threads
+	int					DeadlineMissCount() const { return mDeadlineMissCount; }
+							// buffers finished after the client would have needed them
+	UInt32				ProcessedBufferCount() const { return mProcessedCount; }
+	UInt64				MaxLatencyNanos() const { return mMaxLatencyNanos; }
+							// longest time from handing a buffer to the work threads until it was done
+	UInt64				AverageLatencyNanos() const { return (mProcessedCount > 0) ? mTotalLatencyNanos / mProcessedCount : 0; }
+	void				ResetStatistics();
+	
+	static void			SetNumberWorkThreads(int n);
+							// takes effect if called before the first queue is constructed
+	
+	// Stress test: nQueues push and nQueues pull queues share the work threads while the client
+	// pushes and pulls nCycles half-buffer slices through each of them, checking the data. The
+	// client's PushBuffer and PullBuffer calls are bracketed with counter, which returns a running
+	// total of the calling thread's allocations; a test program gets one by replacing malloc and
+	// operator new. Without a counter only the data and the call times are checked.
+	typedef UInt64		(*AllocationCounter)();
+	
+	struct AllocationStatistics {
+		int				mNumberQueues;		// of each kind
+		UInt32			mNumberCalls;		// to PushBuffer and PullBuffer
+		UInt64			mAllocations;		// made inside those calls
+		UInt64			mMaxCallNanos;
+		UInt32			mDataErrors;		// frames out of order or with the wrong contents
+		UInt32			mOverruns;			// calls that found the next buffer still in progress
+	};
+	
+	static bool			MeasureAllocations(int nQueues, UInt32 nCycles, AllocationCounter counter, AllocationStatistics &outStats);
+							// false if a call allocated, or on any data error or overrun
+	
 	// -----
 	class Buffer {
 	public:
@@ -91,6 +125,10 @@ public:
 		Buffer *		get_next() { return mNext; }
 		void			set_next(Buffer *b) { mNext = b; }
 		
+		void			SetSchedule(UInt64 queuedNanos, UInt64 deadlineNanos) { mQueuedNanos = queuedNanos; mDeadlineNanos = deadlineNanos; }
+		UInt64			QueuedNanos() const { return mQueuedNanos; }
+		UInt64			DeadlineNanos() const { return mDeadlineNanos; }
+		
 #if DEBUG
 		void			print() {
 							printf("Buffer %p:\n  inProgress %d, endOfStream %d, frames %d-%d\n", this, mInProgress, mEndOfStream, (int)mStartFrame, (int)mEndFrame);
@@ -106,6 +144,8 @@ public:
 		bool			mInProgress;				// true if in the work queue
 		bool			mEndOfStream;				// true if the operation resulted in end-of-stream
 		UInt32			mStartFrame, mEndFrame;		// produce/consume pointers within the buffer
+		UInt64			mQueuedNanos;				// when handed to the work threads
+		UInt64			mDeadlineNanos;				// when the client will underrun without it
 	};
 	
 #if DEBUG
@@ -131,10 +171,22 @@ protected:
 	CABufferList *		GetBufferList() { return mBufferList; }
 	const Buffer *		GetCurrentBuffer() const { return mBuffers[mCurrentBuffer]; }
 	UInt32				GetBytesPerFrame() const { return mBytesPerFrame; }
+	bool				BuffersInProgress() const { return mBuffersInProgress > 0; }
 
 private:
+	void				AddBuffer(Buffer *b);
+	void				BufferDone(Buffer *b);
 	
 	// -----
+	// Each queue has a home work thread, and its buffers wait on that thread's work queue in
+	// deadline order. A queue's deadlines never go backwards, so its own buffers are processed
+	// in the order they were added. A thread with nothing runnable steals the most urgent
+	// buffer from the other threads, and sleeps when there is nothing to steal; queueing work
+	// wakes the home thread, or an idle thread if the home thread is busy. A queue's buffers
+	// are never processed concurrently (mBusy), which keeps reads and writes for a file in order.
+	// Waking a thread never takes a lock, since the client does it from the audio thread; an
+	// idle thread sleeps on a wake sequence number (a futex on Linux, a Mach semaphore on Mac OS
+	// X) that it reads before its last look for work, so a wake can't fall in between.
 	class WorkThread : public CAPThread {
 	public:
 		WorkThread();
@@ -146,24 +198,44 @@ private:
 		}
 		void	Run();
 		void	Stop();
+		void	Wake();
 		
 		void	AddBuffer(Buffer *buffer);
 		void	RemoveBuffers(CABufferQueue *owner);
+		void	BufferDone(CABufferQueue *owner);
+		
+		int		mIndex;					// in sWorkThreads
+		
+		static void	WakeIdleThread();
 	
 	private:
-		typedef std::list<Buffer *> WorkQueue;
+		Buffer *	TakeBuffer();			// caller holds mRunGuard
+		void		InsertBuffers();		// caller holds mRunGuard
+		Buffer *	StealBuffer();
+		void		WaitForWake(SInt32 inWakeSequence);
 
 		bool			mStopped;
-		WorkQueue		mWorkQueue;
+		volatile bool	mIdle;				// about to wait, or waiting, for work
+		volatile SInt32	mWakeSequence;		// bumped by Wake
+#if TARGET_OS_MAC && !defined(__linux__)
+		semaphore_t		mWakeSemaphore;
+#endif
+		Buffer *		mWorkQueue;			// sorted by deadline, linked through Buffer::get_next/set_next
 		CAGuard			mRunGuard;
 		TAtomicStack<Buffer>  mBuffersToAdd;
 	};
 	
-	static WorkThread *	sWorkThread;
+	static WorkThread **	sWorkThreads;
+	static int				sNumberWorkThreads;
+	static volatile SInt32	sNextWorkThread;
 	
 	// -----
 private:
-	WorkThread *		mWorkThread;
+	WorkThread *		mWorkThread;		// home thread
+	bool				mBusy;				// a work thread is processing one of our buffers; guarded by mWorkThread's mRunGuard
+	volatile SInt32		mBuffersInProgress;
+	Float64				mSampleRate;
+	UInt64				mLastDeadlineNanos;			// of the last buffer added; only used on the client's thread
 
 	int					mCurrentBuffer;
 	int					mNumberBuffers;
@@ -173,6 +245,11 @@ private:
 	CABufferList *		mBufferList;				// maintained in SetFormat
 protected:
 	int					mErrorCount;
+	
+	int					mDeadlineMissCount;
+	UInt32				mProcessedCount;
+	UInt64				mMaxLatencyNanos;
+	UInt64				mTotalLatencyNanos;
 };
 
 // ____________________________________________________________________________
@@ -183,12 +260,20 @@ protected:
 class CAPushBufferQueue : public CABufferQueue {
 public:
 	CAPushBufferQueue(int nBuffers, UInt32 bufferSizeFrames) :
-		CABufferQueue(nBuffers, bufferSizeFrames) { }
+		CABufferQueue(nBuffers, bufferSizeFrames),
+		mMaxPushNanos(0) { }
 
 	void			PushBuffer(UInt32 inNumberFrames, const AudioBufferList *inBufferList);
 						// push a buffer in
 	void			Flush();
 						// emit a possibly incomplete final buffer
+	
+	UInt64			MaxPushNanos() const { return mMaxPushNanos; }
+						// worst time spent in PushBuffer, i.e. on the client's (audio) thread
+	void			ResetMaxPushNanos() { mMaxPushNanos = 0; }
+
+protected:
+	UInt64			mMaxPushNanos;
 };
 
 // ____________________________________________________________________________
@@ -50,6 +50,10 @@
 	#include <AudioToolbox.h>
 #endif
 
+#include <stdlib.h>
+#include <stddef.h>
+#include <math.h>
+
 #if DEBUG
 	//#define VERBOSE 1
 #endif
@@ -68,7 +72,11 @@ CAChannelMapper::CAChannelMapper(	const CAStreamBasicDescription &srcFormat,
 									const CAAudioChannelLayout *	inSrcLayout,
 									const CAAudioChannelLayout *	inDestLayout) :
 	mSrcNChannels(srcFormat.mChannelsPerFrame),
-	mDestNChannels(destFormat.mChannelsPerFrame)
+	mDestNChannels(destFormat.mChannelsPerFrame),
+	mMixMap(srcFormat.mChannelsPerFrame, destFormat.mChannelsPerFrame),
+	mMixEngine(srcFormat.mChannelsPerFrame, destFormat.mChannelsPerFrame),
+	mUsesMatrixMixerAU(false),
+	mDownmixKernel(NULL)
 {
 	if (inSrcLayout && inSrcLayout->IsValid())
 		mSrcLayout = *inSrcLayout;
@@ -134,6 +142,12 @@ OSStatus	CAChannelMapper::ResetMixer()
 	int nin = mSrcNChannels, nout = mDestNChannels;
 	int i, j;
 
+	mDownmixKernel = NULL;
+	mMixMap.Clear();
+	mMixEngine.SetMixMap(mMixMap);
+	if (!mMatrixMixer.IsValid())
+		return noErr;
+
 	// set global, input and output volumes
 	mMatrixMixer.SetParameter(kMatrixMixerParam_Volume, kAudioUnitScope_Global, 0xFFFFFFFF, 1.);
 	for (i = 0; i < nout; ++i) {
@@ -188,33 +202,75 @@ OSStatus	CAChannelMapper::ConfigureDownmix()
 #if VERBOSE
 	printf("mix map:");
 #endif
-	mMatrixMixer.SetParameter(kMatrixMixerParam_Volume, kAudioUnitScope_Global, 0xFFFFFFFF, 1.);
-	// set the crosspoint volumes
+	CAMixMap map(nin, nout);
 	val = (Float32 *)mixmap;
 	for (i = 0; i < nin; ++i) {
 		for (j = 0; j < nout; ++j) {
 #if VERBOSE
 			printf("  %5.3f", *val);
 #endif
-			mMatrixMixer.SetParameter(kMatrixMixerParam_Volume, kAudioUnitScope_Global, (i<<16) | j, *val++);
+			map.SetCrossPoint(i, j, *val);
+			++val;
 		}
 #if VERBOSE
 		putchar('\n');
 #endif
 	}
-
 	free(mixmap);
+
+	// set the crosspoint volumes
+	err = SetMixMap(map);
+	if (err)
+		return err;
+	
+	// a specialized kernel applies the engine's gains, so it only needs to cover the map's terms
+	const CADownmixKernelInfo *kernel = CAFindDownmixKernel(mSrcLayout.Tag(), mDestLayout.Tag());
+	if (kernel != NULL && CADownmixKernelSupportsMixMap(*kernel, map))
+		mDownmixKernel = kernel;
 	return noErr;
 }
 
 OSStatus	CAChannelMapper::ConnectChannelToChannel(UInt32 inChannel, UInt32 outChannel)
 {
+	mDownmixKernel = NULL;
+	mMixMap.SetCrossPoint(inChannel, outChannel, 1.f);
+	mMixEngine.SetMixMap(mMixMap);
+	if (!mMatrixMixer.IsValid())
+		return noErr;
 	return mMatrixMixer.SetParameter(kMatrixMixerParam_Volume, kAudioUnitScope_Global,
 								(inChannel << 16) | outChannel, 1.);
 }
 
+OSStatus	CAChannelMapper::SetMixMap(const CAMixMap &map, UInt32 rampFrames)
+{
+	mDownmixKernel = NULL;
+	for (UInt32 i = 0; i < mSrcNChannels; ++i)
+		for (UInt32 j = 0; j < mDestNChannels; ++j)
+			mMixMap.SetCrossPoint(i, j, map.GetCrossPoint(i, j));
+	mMixEngine.SetMixMap(mMixMap, rampFrames);
+	if (!mMatrixMixer.IsValid())
+		return noErr;
+	for (UInt32 i = 0; i < mSrcNChannels; ++i)
+		for (UInt32 j = 0; j < mDestNChannels; ++j) {
+			OSStatus err = mMatrixMixer.SetParameter(kMatrixMixerParam_Volume, kAudioUnitScope_Global, (i<<16) | j, mMixMap.GetCrossPoint(i, j));
+			if (err)
+				return err;
+		}
+	return noErr;
+}
+
 OSStatus	CAChannelMapper::Mix(const AudioBufferList *src, AudioBufferList *dest, UInt32 nFrames)
 {
+	if (!mUsesMatrixMixerAU || !mMatrixMixer.IsValid()) {
+		// the kernel renders with the engine's gains, so take any new map first; a new map
+		// from SetMixMap has already cleared mDownmixKernel
+		mMixEngine.TakeMixMap();
+		if (mDownmixKernel != NULL && !mMixEngine.IsRamping())
+			mDownmixKernel->mMix(src, dest, nFrames, mMixEngine.GetGains());
+		else
+			mMixEngine.Mix(src, dest, nFrames);
+		return noErr;
+	}
 	mMixInputBufferList = src;
 	AudioUnitRenderActionFlags flags = 0;
 	AudioTimeStamp ts;
@@ -237,3 +293,87 @@ OSStatus	CAChannelMapper::MixerInputProc(
 	
 	return noErr;
 }
+
+// ____________________________________________________________________________
+
+static AudioBufferList *	AllocateBufferList(UInt32 nBuffers, UInt32 nFrames)
+{
+	AudioBufferList *abl = (AudioBufferList *)calloc(1, offsetof(AudioBufferList, mBuffers) + nBuffers * sizeof(AudioBuffer));
+	abl->mNumberBuffers = nBuffers;
+	for (UInt32 i = 0; i < nBuffers; ++i) {
+		abl->mBuffers[i].mNumberChannels = 1;
+		abl->mBuffers[i].mDataByteSize = nFrames * sizeof(Float32);
+		abl->mBuffers[i].mData = calloc(nFrames, sizeof(Float32));
+	}
+	return abl;
+}
+
+static void	FreeBufferList(AudioBufferList *abl)
+{
+	for (UInt32 i = 0; i < abl->mNumberBuffers; ++i)
+		free(abl->mBuffers[i].mData);
+	free(abl);
+}
+
+bool	CAChannelMapper::TestDownmixKernels(UInt32 nFrames, Float32 tolerance, FILE *report)
+{
+	if (nFrames == 0)
+		nFrames = 1;
+	bool passed = true;
+	UInt32 nKernels;
+	const CADownmixKernelInfo *kernels = CAGetDownmixKernels(nKernels);
+	for (UInt32 k = 0; k < nKernels; ++k) {
+		const CADownmixKernelInfo &kernel = kernels[k];
+		CAStreamBasicDescription srcFormat, destFormat;
+		srcFormat.mSampleRate = destFormat.mSampleRate = 44100.;
+		srcFormat.SetCanonical(kernel.mNumIns, false);
+		destFormat.SetCanonical(kernel.mNumOuts, false);
+		CAAudioChannelLayout srcLayout(kernel.mSrcTag), destLayout(kernel.mDestTag);
+		
+		// the same path a converter takes: AudioFormat's map, then the kernel if it fits
+		CAChannelMapper mapper(srcFormat, destFormat, &srcLayout, &destLayout);
+		OSStatus err = mapper.ConfigureDownmix();
+		bool selected = (err == noErr && mapper.UsesDownmixKernel());
+		
+		AudioBufferList *src = AllocateBufferList(kernel.mNumIns, nFrames);
+		AudioBufferList *kernelOut = AllocateBufferList(kernel.mNumOuts, nFrames);
+		AudioBufferList *genericOut = AllocateBufferList(kernel.mNumOuts, nFrames);
+		
+		// full scale noise on every input
+		UInt32 seed = 1 + k;
+		for (UInt32 i = 0; i < kernel.mNumIns; ++i) {
+			Float32 *in = (Float32 *)src->mBuffers[i].mData;
+			for (UInt32 f = 0; f < nFrames; ++f) {
+				seed = seed * 1664525 + 1013904223;
+				in[f] = Float32(seed >> 8) / Float32(1 << 23) - 1.f;
+			}
+		}
+		
+		mapper.Mix(src, kernelOut, nFrames);
+		CAMatrixMixEngine engine(kernel.mNumIns, kernel.mNumOuts);
+		engine.SetMixMap(mapper.GetMixMap());
+		engine.Mix(src, genericOut, nFrames);
+		
+		Float32 maxError = 0.f;
+		for (UInt32 j = 0; j < kernel.mNumOuts; ++j) {
+			const Float32 *a = (const Float32 *)kernelOut->mBuffers[j].mData;
+			const Float32 *b = (const Float32 *)genericOut->mBuffers[j].mData;
+			for (UInt32 f = 0; f < nFrames; ++f) {
+				Float32 e = fabsf(a[f] - b[f]);
+				if (e > maxError)
+					maxError = e;
+			}
+		}
+		bool ok = selected && maxError <= tolerance;
+		if (!ok)
+			passed = false;
+		if (report != NULL)
+			fprintf(report, "downmix 0x%x -> 0x%x: err %d, kernel %s, max error %g %s\n", (int)kernel.mSrcTag, (int)kernel.mDestTag,
+				(int)err, selected ? "selected" : "NOT selected", maxError, ok ? "ok" : "FAILED");
+		
+		FreeBufferList(src);
+		FreeBufferList(kernelOut);
+		FreeBufferList(genericOut);
+	}
+	return passed;
+}
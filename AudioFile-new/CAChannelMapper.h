@@ -55,6 +55,8 @@
 #include "CAStreamBasicDescription.h"
 #include "CAAudioUnit.h"
 #include "MatrixMixerVolumes.h"
+#include "CAMatrixMixEngine.h"
+#include "CADownmixKernels.h"
 
 class CAChannelMapper {
 public:
@@ -74,10 +76,27 @@ public:
 	OSStatus		OpenMixer(double sampleRate);
 	OSStatus		ResetMixer();		// enables all ins/outs, zeroes all crosspoints
 	OSStatus		ConfigureDownmix();
+						// uses a specialized kernel for common layout pairs, with the gains from
+						// AudioFormat's mix map, when the map fits it (see CADownmixKernels.h)
+	bool			UsesDownmixKernel() const { return mDownmixKernel != NULL; }
 	OSStatus		ConnectChannelToChannel(UInt32 inChannel, UInt32 outChannel);
 	OSStatus		Mix(const AudioBufferList *src, AudioBufferList *dest, UInt32 nFrames);
 	void			PrintMatrixMixerVolumes(FILE *f) { ::PrintMatrixMixerVolumes(f, mMatrixMixer.AU()); }
 	
+	// The crosspoints are kept in a CAMixMap as well as in the matrix mixer, and Mix applies
+	// them with a CAMatrixMixEngine unless told to render the AudioUnit. The mixer unit is
+	// still opened by OpenMixer, for clients that connect it into a graph (GetMixer), but Mix
+	// and the crosspoint setters work without it.
+	void			SetUsesMatrixMixerAU(bool b) { mUsesMatrixMixerAU = b; }
+	const CAMixMap &GetMixMap() const { return mMixMap; }
+	OSStatus		SetMixMap(const CAMixMap &map, UInt32 rampFrames = 0);
+						// ramps are only applied by the built-in engine
+	
+	static bool		TestDownmixKernels(UInt32 nFrames = 4096, Float32 tolerance = 1.0e-5f, FILE *report = NULL);
+						// configures a downmix for each registered kernel's layout pair, and
+						// returns false if the kernel isn't selected or its output differs from
+						// CAMatrixMixEngine's with the same map
+	
 private:
 	static OSStatus	MixerInputProc(
 							void *						inRefCon,
@@ -91,6 +110,11 @@ private:
 	CAAudioChannelLayout	mSrcLayout, mDestLayout;
 	CAAudioUnit				mMatrixMixer;
 	const AudioBufferList *	mMixInputBufferList;
+	
+	CAMixMap				mMixMap;
+	CAMatrixMixEngine		mMixEngine;
+	bool					mUsesMatrixMixerAU;
+	const CADownmixKernelInfo *	mDownmixKernel;		// set by ConfigureDownmix; cleared by other crosspoint changes
 };
 
 #endif // __CAChannelMapper_h__
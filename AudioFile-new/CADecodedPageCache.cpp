@@ -0,0 +1,373 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CADecodedPageCache.cpp
+	
+=============================================================================*/
+
+#include "CADecodedPageCache.h"
+#include "CABufferList.h"
+#include "CAAtomic.h"
+#include <algorithm>
+
+// a reader that wanders onto a recycled page can follow it into another bucket;
+// give up after this many steps and treat it as a miss
+enum { kMaxChainWalk = 64, kNumberBuckets = 4096 };
+
+static CADecodedPageCache *	sSharedPageCache = NULL;
+
+// ____________________________________________________________________________
+
+bool	CADecodedPageCache::Page::Matches(UInt64 fileID, const CAStreamBasicDescription &format, SInt64 pageIndex) const
+{
+	return mFileID == fileID && mPageIndex == pageIndex
+		&& mFormat.mSampleRate == format.mSampleRate
+		&& mFormat.mFormatID == format.mFormatID
+		&& mFormat.mFormatFlags == format.mFormatFlags
+		&& mFormat.mBytesPerPacket == format.mBytesPerPacket
+		&& mFormat.mFramesPerPacket == format.mFramesPerPacket
+		&& mFormat.mBytesPerFrame == format.mBytesPerFrame
+		&& mFormat.mChannelsPerFrame == format.mChannelsPerFrame
+		&& mFormat.mBitsPerChannel == format.mBitsPerChannel;
+}
+
+// ____________________________________________________________________________
+
+CADecodedPageCache::CADecodedPageCache(UInt64 maxBytes, UInt32 pageFrames) :
+	mMaxBytes(maxBytes),
+	mPageFrames(pageFrames),
+	mNumberBuckets(kNumberBuckets),
+	mMutex("CADecodedPageCache::mMutex"),
+	mAllPages(NULL),
+	mSparePages(NULL),
+	mUseClock(0),
+	mResidentBytes(0),
+	mResidentPageCount(0)
+{
+	mBuckets = new Page *[mNumberBuckets];
+	for (UInt32 i = 0; i < mNumberBuckets; ++i)
+		mBuckets[i] = NULL;
+	ResetStatistics();
+}
+
+CADecodedPageCache::~CADecodedPageCache()
+{
+	Page *p = mAllPages;
+	while (p != NULL) {
+		Page *next = p->mAllNext;
+		delete[] p->mData;
+		delete p;
+		p = next;
+	}
+	delete[] mBuckets;
+}
+
+CADecodedPageCache &	CADecodedPageCache::Shared()
+{
+	if (sSharedPageCache == NULL) {
+		CADecodedPageCache *cache = new CADecodedPageCache;
+		if (!CAAtomicCompareAndSwapPtrBarrier(NULL, cache, (void * volatile *)&sSharedPageCache))
+			delete cache;	// another thread got there first
+	}
+	return *sSharedPageCache;
+}
+
+UInt64	CADecodedPageCache::FileIdentity(const FSRef &fsref)
+{
+	FSCatalogInfo info;
+	if (FSGetCatalogInfo(&fsref, kFSCatInfoVolume | kFSCatInfoNodeID, &info, NULL, NULL, NULL) != noErr)
+		return 0;
+	return (UInt64(UInt16(info.volume)) << 32) | info.nodeID;
+}
+
+void	CADecodedPageCache::SetMaxBytes(UInt64 maxBytes)
+{
+	CAMutex::Locker lock(mMutex);
+	mMaxBytes = maxBytes;
+	EvictFor(0);
+}
+
+void	CADecodedPageCache::ResetStatistics()
+{
+	mHitCount = 0;
+	mMissCount = 0;
+	mEvictionCount = 0;
+}
+
+// ____________________________________________________________________________
+
+void	CADecodedPageCache::Read(UInt64 fileID, const CAStreamBasicDescription &format, SInt64 startFrame, UInt32 &ioFrames, AudioBufferList *ioData, Decoder &decoder)
+{
+	UInt32 bytesPerFrame = format.mBytesPerFrame;
+	UInt32 framesRequired = ioFrames;
+	UInt32 framesProduced = 0;
+	
+	while (framesProduced < framesRequired) {
+		SInt64 frame = startFrame + framesProduced;
+		SInt64 pageIndex = frame / mPageFrames;
+		UInt32 offset = UInt32(frame - pageIndex * mPageFrames);
+		
+		Page *page = Acquire(fileID, format, pageIndex);
+		if (page != NULL)
+			CAAtomicIncrement32(&mHitCount);
+		else {
+			CAAtomicIncrement32(&mMissCount);
+			page = Decode(fileID, format, pageIndex, decoder);
+			if (page == NULL)
+				break;	// past the end of the file
+		}
+		
+		UInt32 pageFrameCount = page->mFrameCount;
+		UInt32 nFrames = 0;
+		if (offset < pageFrameCount) {
+			nFrames = std::min(pageFrameCount - offset, framesRequired - framesProduced);
+			UInt32 nBuffers = std::min(page->mNumberBuffers, ioData->mNumberBuffers);
+			for (UInt32 i = 0; i < nBuffers; ++i)
+				memcpy((Byte *)ioData->mBuffers[i].mData + framesProduced * bytesPerFrame,
+					page->BufferData(i) + offset * bytesPerFrame, nFrames * bytesPerFrame);
+		}
+		Release(page);
+		framesProduced += nFrames;
+		
+		if (nFrames == 0 || (pageFrameCount < mPageFrames && offset + nFrames >= pageFrameCount))
+			break;	// a short page is the last one
+	}
+	
+	for (UInt32 i = 0; i < ioData->mNumberBuffers; ++i)
+		ioData->mBuffers[i].mDataByteSize = framesProduced * bytesPerFrame;
+	ioFrames = framesProduced;
+}
+
+void	CADecodedPageCache::RemoveFile(UInt64 fileID)
+{
+	CAMutex::Locker lock(mMutex);
+	for (Page *p = mAllPages; p != NULL; p = p->mAllNext) {
+		if (p->mInTable && p->mFileID == fileID) {
+			Unlink(p);
+			if (CAAtomicDecrement32Barrier(&p->mRefCount) == 0)
+				RecyclePage(p);
+		}
+	}
+}
+
+// ____________________________________________________________________________
+
+UInt32	CADecodedPageCache::Bucket(UInt64 fileID, const CAStreamBasicDescription &format, SInt64 pageIndex) const
+{
+	UInt64 h = fileID * UInt64(0x9E3779B97F4A7C15LL);
+	h ^= UInt64(pageIndex) + (h << 6) + (h >> 2);
+	h ^= (UInt64(format.mChannelsPerFrame) << 40) ^ (UInt64(format.mFormatFlags) << 20) ^ UInt64(format.mSampleRate);
+	h ^= h >> 29;
+	h *= UInt64(0xBF58476D1CE4E5B9LL);
+	h ^= h >> 32;
+	return UInt32(h) & (mNumberBuckets - 1);
+}
+
+// lock-free
+CADecodedPageCache::Page *	CADecodedPageCache::Acquire(UInt64 fileID, const CAStreamBasicDescription &format, SInt64 pageIndex)
+{
+	int steps = 0;
+	for (Page *p = mBuckets[Bucket(fileID, format, pageIndex)]; p != NULL && steps < kMaxChainWalk; p = p->mHashNext, ++steps) {
+		SInt32 generation = p->mGeneration;
+		CAMemoryBarrier();
+		if ((generation & 1) != 0 || !p->Matches(fileID, format, pageIndex))
+			continue;
+		
+		// retain, unless it is already on its way to being recycled
+		SInt32 refCount;
+		do {
+			refCount = p->mRefCount;
+			if (refCount <= 0)
+				break;
+		} while (!CAAtomicCompareAndSwap32Barrier(refCount, refCount + 1, &p->mRefCount));
+		if (refCount <= 0)
+			continue;
+		
+		// the page may have been recycled and reused between the match and the retain
+		if (p->mGeneration != generation) {
+			Release(p);
+			continue;
+		}
+		p->mLastUse = CAAtomicIncrement32(&mUseClock);
+		return p;
+	}
+	return NULL;
+}
+
+CADecodedPageCache::Page *	CADecodedPageCache::Decode(UInt64 fileID, const CAStreamBasicDescription &format, SInt64 pageIndex, Decoder &decoder)
+{
+	Page *page;
+	{
+		CAMutex::Locker lock(mMutex);
+		page = NewPage();
+	}
+	page->mFileID = fileID;
+	page->mPageIndex = pageIndex;
+	page->mFormat = format;
+	page->mNumberBuffers = format.NumberChannelStreams();
+	page->mBufferBytes = mPageFrames * format.mBytesPerFrame;
+	page->mDataBytes = page->mNumberBuffers * page->mBufferBytes;
+	page->mData = new Byte[page->mDataBytes];
+	
+	// decode without holding the lock; other pages stay available meanwhile
+	CABufferList *pageBuffers = CABufferList::New("", format);
+	AudioBufferList &abl = pageBuffers->GetModifiableBufferList();
+	for (UInt32 i = 0; i < abl.mNumberBuffers; ++i) {
+		abl.mBuffers[i].mData = page->BufferData(i);
+		abl.mBuffers[i].mDataByteSize = page->mBufferBytes;
+	}
+	UInt32 nFrames = mPageFrames;
+	try {
+		decoder.DecodePage(pageIndex * mPageFrames, nFrames, &abl);
+	}
+	catch (...) {
+		delete pageBuffers;
+		CAMutex::Locker lock(mMutex);
+		RecyclePage(page);
+		throw;
+	}
+	delete pageBuffers;
+	page->mFrameCount = nFrames;
+	
+	CAMutex::Locker lock(mMutex);
+	if (nFrames == 0) {
+		RecyclePage(page);
+		return NULL;
+	}
+	
+	// another reader may have decoded the same page meanwhile
+	Page * volatile *bucket = &mBuckets[Bucket(fileID, format, pageIndex)];
+	for (Page *p = *bucket; p != NULL; p = p->mHashNext) {
+		if (p->mInTable && p->Matches(fileID, format, pageIndex)) {
+			CAAtomicIncrement32Barrier(&p->mRefCount);
+			p->mLastUse = CAAtomicIncrement32(&mUseClock);
+			RecyclePage(page);
+			return p;
+		}
+	}
+	
+	EvictFor(page->mDataBytes);
+	page->mRefCount = 2;	// the cache's and the caller's
+	page->mLastUse = CAAtomicIncrement32(&mUseClock);
+	CAMemoryBarrier();
+	++page->mGeneration;	// even: readers may match it from now on
+	page->mHashNext = *bucket;
+	CAMemoryBarrier();
+	*bucket = page;
+	page->mInTable = true;
+	mResidentBytes += page->mDataBytes;
+	++mResidentPageCount;
+	return page;
+}
+
+void	CADecodedPageCache::Release(Page *page)
+{
+	// pages in the table hold the cache's reference, so this only reaches 0 for evicted pages
+	if (CAAtomicDecrement32Barrier(&page->mRefCount) == 0)
+		mReleasedPages.push_atomic(page);
+}
+
+// ____________________________________________________________________________
+
+CADecodedPageCache::Page *	CADecodedPageCache::NewPage()
+{
+	CollectFreedPages();
+	Page *page = mSparePages;
+	if (page != NULL)
+		mSparePages = page->mFreeNext;
+	else {
+		page = new Page;
+		page->mAllNext = mAllPages;
+		mAllPages = page;
+	}
+	++page->mGeneration;	// odd: readers still walking over it won't match it
+	CAMemoryBarrier();
+	return page;
+}
+
+void	CADecodedPageCache::RecyclePage(Page *page)
+{
+	if (page->mGeneration & 1) {
+		CAMemoryBarrier();
+		++page->mGeneration;
+	}
+	delete[] page->mData;
+	page->mData = NULL;
+	page->mDataBytes = 0;
+	// leave mHashNext alone: a reader may be standing on this page
+	page->mFreeNext = mSparePages;
+	mSparePages = page;
+}
+
+void	CADecodedPageCache::CollectFreedPages()
+{
+	Page *p = mReleasedPages.pop_all();
+	while (p != NULL) {
+		Page *next = p->mFreeNext;
+		RecyclePage(p);
+		p = next;
+	}
+}
+
+void	CADecodedPageCache::Unlink(Page *page)
+{
+	Page * volatile *link = &mBuckets[Bucket(page->mFileID, page->mFormat, page->mPageIndex)];
+	while (*link != page)
+		link = &(*link)->mHashNext;
+	*link = page->mHashNext;
+	page->mInTable = false;
+	mResidentBytes -= page->mDataBytes;
+	--mResidentPageCount;
+}
+
+void	CADecodedPageCache::EvictFor(UInt64 nBytes)
+{
+	while (mResidentPageCount > 0 && mResidentBytes + nBytes > mMaxBytes) {
+		Page *oldest = NULL;
+		for (Page *p = mAllPages; p != NULL; p = p->mAllNext)
+			if (p->mInTable && (oldest == NULL || SInt32(p->mLastUse - oldest->mLastUse) < 0))
+				oldest = p;
+		Unlink(oldest);
+		++mEvictionCount;
+		if (CAAtomicDecrement32Barrier(&oldest->mRefCount) == 0)
+			RecyclePage(oldest);
+	}
+}
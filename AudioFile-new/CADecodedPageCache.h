@@ -0,0 +1,168 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CADecodedPageCache.h
+	
+=============================================================================*/
+
+#ifndef __CADecodedPageCache_h__
+#define __CADecodedPageCache_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+	#include <CoreServices/CoreServices.h>
+#else
+	#include <CoreAudioTypes.h>
+	#include <CoreServices.h>
+#endif
+
+#include "CAStreamBasicDescription.h"
+#include "CAMutex.h"
+#include "CAAtomicStack.h"
+
+// _______________________________________________________________________________________
+// Process-wide cache of decoded audio, shared by every CAAudioFile reading the same file in
+// the same client format, so that N players of one asset cost one decode.
+//
+// Audio is cached in pages of PageFrames() frames, keyed by file identity, client format
+// and page index. A hit takes no locks: the buckets are walked with atomic loads and the
+// page is retained with a compare-and-swap on its reference count. Misses decode outside
+// the lock and then publish the page, evicting the least recently used pages to stay
+// under the size limit. Page headers are never freed while the cache exists, so a reader
+// racing with an eviction at worst sees a miss.
+class CADecodedPageCache {
+public:
+	// supplies the frames for a missing page
+	class Decoder {
+	public:
+		virtual ~Decoder() { }
+		virtual void	DecodePage(SInt64 startFrame, UInt32 &ioFrames, AudioBufferList *ioData) = 0;
+							// fill ioData from startFrame; fewer frames than asked for means end of file
+	};
+	
+	enum { kDefaultPageFrames = 8192, kDefaultMaxBytes = 64 * 1024 * 1024 };
+	
+	CADecodedPageCache(UInt64 maxBytes = kDefaultMaxBytes, UInt32 pageFrames = kDefaultPageFrames);
+	~CADecodedPageCache();
+	
+	static CADecodedPageCache &	Shared();
+	
+	static UInt64	FileIdentity(const FSRef &fsref);
+						// volume and node ID; 0 if unknown
+	
+	void			SetMaxBytes(UInt64 maxBytes);
+	UInt64			MaxBytes() const { return mMaxBytes; }
+	UInt32			PageFrames() const { return mPageFrames; }
+	
+	void			Read(UInt64 fileID, const CAStreamBasicDescription &format, SInt64 startFrame, UInt32 &ioFrames, AudioBufferList *ioData, Decoder &decoder);
+						// ioFrames returns short at the end of the file
+	void			RemoveFile(UInt64 fileID);
+						// e.g. when the file has been modified
+	
+	// statistics
+	UInt32			HitCount() const { return mHitCount; }
+	UInt32			MissCount() const { return mMissCount; }
+	double			HitRate() const { UInt32 n = mHitCount + mMissCount; return (n > 0) ? double(mHitCount) / n : 0.; }
+	UInt32			EvictionCount() const { return mEvictionCount; }
+	UInt64			ResidentBytes() const { return mResidentBytes; }
+	UInt32			ResidentPageCount() const { return mResidentPageCount; }
+	void			ResetStatistics();
+
+private:
+	class Page {
+	public:
+		Page() : mRefCount(0), mGeneration(0), mHashNext(NULL), mAllNext(NULL), mFreeNext(NULL),
+			mData(NULL), mDataBytes(0), mInTable(false) { }
+		
+		bool		Matches(UInt64 fileID, const CAStreamBasicDescription &format, SInt64 pageIndex) const;
+		Byte *		BufferData(UInt32 i) const { return mData + i * mBufferBytes; }
+		
+		Page *		get_next() { return mFreeNext; }
+		void		set_next(Page *p) { mFreeNext = p; }
+		
+		volatile SInt32		mRefCount;		// 0: unused; 1: the cache's reference; +1 per reader
+		volatile SInt32		mGeneration;	// odd while the key and data are being changed
+		Page * volatile		mHashNext;		// bucket chain
+		Page *				mAllNext;		// every page header, for eviction and cleanup
+		Page *				mFreeNext;
+		
+		UInt64				mFileID;
+		SInt64				mPageIndex;
+		CAStreamBasicDescription	mFormat;
+		UInt32				mFrameCount;
+		UInt32				mNumberBuffers;
+		UInt32				mBufferBytes;	// per buffer, for a full page
+		Byte *				mData;
+		UInt32				mDataBytes;
+		volatile SInt32		mLastUse;
+		bool				mInTable;		// guarded by mMutex
+	};
+	
+	UInt32			Bucket(UInt64 fileID, const CAStreamBasicDescription &format, SInt64 pageIndex) const;
+	Page *			Acquire(UInt64 fileID, const CAStreamBasicDescription &format, SInt64 pageIndex);
+	Page *			Decode(UInt64 fileID, const CAStreamBasicDescription &format, SInt64 pageIndex, Decoder &decoder);
+	void			Release(Page *page);
+	
+	// the following are called with mMutex held
+	Page *			NewPage();
+	void			RecyclePage(Page *page);
+	void			CollectFreedPages();
+	void			Unlink(Page *page);
+	void			EvictFor(UInt64 nBytes);
+	
+	UInt64			mMaxBytes;
+	UInt32			mPageFrames;
+	UInt32			mNumberBuckets;			// power of 2
+	Page * volatile *	mBuckets;
+	CAMutex			mMutex;					// for changes to the buckets
+	Page *			mAllPages;
+	Page *			mSparePages;			// unused headers, linked through mFreeNext
+	TAtomicStack<Page>	mReleasedPages;		// unlinked pages whose last reader let go
+	volatile SInt32	mUseClock;
+	
+	volatile SInt32	mHitCount;
+	volatile SInt32	mMissCount;
+	UInt32			mEvictionCount;
+	UInt64			mResidentBytes;
+	UInt32			mResidentPageCount;
+};
+
+#endif // __CADecodedPageCache_h__
@@ -0,0 +1,551 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CAMappedAudioFile.cpp
+	
+=============================================================================*/
+
+#include "CAMappedAudioFile.h"
+#include "CASampleTools.h"
+#include "CAHostTimeBase.h"
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#if !TARGET_OS_WIN32
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+// ____________________________________________________________________________
+// header parsing
+
+static inline UInt32	ReadBE32(const Byte *p) { return (UInt32(p[0]) << 24) | (UInt32(p[1]) << 16) | (UInt32(p[2]) << 8) | p[3]; }
+static inline UInt32	ReadLE32(const Byte *p) { return (UInt32(p[3]) << 24) | (UInt32(p[2]) << 16) | (UInt32(p[1]) << 8) | p[0]; }
+static inline UInt16	ReadBE16(const Byte *p) { return UInt16((p[0] << 8) | p[1]); }
+static inline UInt16	ReadLE16(const Byte *p) { return UInt16((p[1] << 8) | p[0]); }
+static inline UInt64	ReadBE64(const Byte *p) { return (UInt64(ReadBE32(p)) << 32) | ReadBE32(p + 4); }
+
+static inline Float64	ReadBEFloat64(const Byte *p)
+{
+	UInt64 bits = ReadBE64(p);
+	Float64 result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+// AIFF's 80 bit IEEE extended sample rate
+static Float64	ReadBEFloat80(const Byte *p)
+{
+	int exponent = ((p[0] & 0x7F) << 8) | p[1];
+	UInt64 mantissa = ReadBE64(p + 2);
+	if (exponent == 0 && mantissa == 0)
+		return 0.;
+	Float64 result = ldexp((Float64)mantissa, exponent - 16383 - 63);
+	return (p[0] & 0x80) ? -result : result;
+}
+
+static inline bool	ChunkIDIs(const Byte *p, const char *inID) { return memcmp(p, inID, 4) == 0; }
+
+// ____________________________________________________________________________
+
+CAMappedAudioFile::CAMappedAudioFile() :
+	mMapping(NULL),
+	mMappingSize(0),
+	mAudioData(NULL),
+	mNumberFrames(0),
+	mPosition(0),
+	mConversion(kConversion_None),
+	mScratch(NULL)
+{
+}
+
+bool	CAMappedAudioFile::Open(const char *filePath)
+{
+	Close();
+#if TARGET_OS_WIN32
+	return false;
+#else
+	int fd = open(filePath, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < 12 || UInt64(st.st_size) != UInt64(size_t(st.st_size))) {
+		close(fd);
+		return false;
+	}
+	void *mapping = mmap(NULL, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);	// the mapping keeps the file
+	if (mapping == MAP_FAILED)
+		return false;
+	mMapping = mapping;
+	mMappingSize = size_t(st.st_size);
+	
+	const Byte *p = static_cast<const Byte *>(mMapping), *end = p + mMappingSize;
+	bool ok = false;
+	if (ChunkIDIs(p, "RIFF") && ChunkIDIs(p + 8, "WAVE"))
+		ok = ParseWAVE(p + 12, end);
+	else if (ChunkIDIs(p, "FORM") && (ChunkIDIs(p + 8, "AIFF") || ChunkIDIs(p + 8, "AIFC")))
+		ok = ParseAIFF(p + 12, end, ChunkIDIs(p + 8, "AIFC"));
+	else if (ChunkIDIs(p, "caff"))
+		ok = ParseCAF(p + 8, end);
+	
+	if (!ok || mAudioData == NULL) {
+		Close();
+		return false;
+	}
+	// most clients stream from the start; Seek advises the kernel again for random access
+	madvise(mMapping, mMappingSize, MADV_SEQUENTIAL);
+	mClientDataFormat = mFileDataFormat;
+	mConversion = kConversion_None;
+	return true;
+#endif
+}
+
+void	CAMappedAudioFile::Close()
+{
+#if !TARGET_OS_WIN32
+	if (mMapping != NULL)
+		munmap(mMapping, mMappingSize);
+#endif
+	mMapping = NULL;
+	mMappingSize = 0;
+	mAudioData = NULL;
+	mNumberFrames = 0;
+	mPosition = 0;
+	delete[] mScratch;	mScratch = NULL;
+}
+
+void	CAMappedAudioFile::SetFileFormat(Float64 sampleRate, UInt32 nChannels, UInt32 bitsPerChannel, UInt32 bytesPerFrame, bool isFloat, bool isSigned, bool isBigEndian)
+{
+	UInt32 flags = isFloat ? kAudioFormatFlagIsFloat : (isSigned ? kAudioFormatFlagIsSignedInteger : 0);
+	UInt32 wordSize = (nChannels > 0) ? bytesPerFrame / nChannels : 0;
+	if (isBigEndian && wordSize > 1)
+		flags |= kAudioFormatFlagIsBigEndian;
+	// WAV, AIFF and CAF all left-justify samples narrower than their container
+	if (bitsPerChannel == wordSize * 8)
+		flags |= kAudioFormatFlagIsPacked;
+	else
+		flags |= kAudioFormatFlagIsAlignedHigh;
+	
+	mFileDataFormat = CAStreamBasicDescription();
+	mFileDataFormat.mSampleRate = sampleRate;
+	mFileDataFormat.mFormatID = kAudioFormatLinearPCM;
+	mFileDataFormat.mFormatFlags = flags;
+	mFileDataFormat.mBytesPerPacket = bytesPerFrame;
+	mFileDataFormat.mFramesPerPacket = 1;
+	mFileDataFormat.mBytesPerFrame = bytesPerFrame;
+	mFileDataFormat.mChannelsPerFrame = nChannels;
+	mFileDataFormat.mBitsPerChannel = bitsPerChannel;
+}
+
+bool	CAMappedAudioFile::ParseWAVE(const Byte *p, const Byte *end)
+{
+	bool haveFormat = false;
+	while (end - p >= 8) {
+		UInt32 chunkSize = ReadLE32(p + 4);
+		const Byte *chunk = p + 8;
+		if (ChunkIDIs(p, "fmt ") && chunkSize >= 16 && end - chunk >= 16) {
+			UInt16 formatTag = ReadLE16(chunk);
+			UInt16 nChannels = ReadLE16(chunk + 2);
+			UInt32 sampleRate = ReadLE32(chunk + 4);
+			UInt16 blockAlign = ReadLE16(chunk + 12);
+			UInt16 bitsPerSample = ReadLE16(chunk + 14);
+			if (formatTag == 0xFFFE && chunkSize >= 40 && end - chunk >= 40) {
+				// WAVE_FORMAT_EXTENSIBLE: the sub format GUID starts with the real tag,
+				// and the valid bits are the significant ones
+				UInt16 validBits = ReadLE16(chunk + 18);
+				formatTag = ReadLE16(chunk + 24);
+				if (validBits > 0 && validBits < bitsPerSample)
+					bitsPerSample = validBits;
+			}
+			if ((formatTag != 1 && formatTag != 3) || nChannels == 0 || blockAlign == 0)
+				return false;
+			// 8 bit WAV samples are unsigned
+			SetFileFormat(sampleRate, nChannels, bitsPerSample, blockAlign, formatTag == 3, bitsPerSample > 8, false);
+			haveFormat = true;
+		} else if (ChunkIDIs(p, "data") && haveFormat) {
+			SInt64 available = end - chunk;
+			SInt64 dataSize = std::min(SInt64(chunkSize), available);
+			mAudioData = chunk;
+			mNumberFrames = dataSize / mFileDataFormat.mBytesPerFrame;
+			return true;
+		}
+		if (SInt64(chunkSize) > end - chunk)
+			break;
+		p = chunk + chunkSize + (chunkSize & 1);	// chunks are padded to even sizes
+	}
+	return false;
+}
+
+bool	CAMappedAudioFile::ParseAIFF(const Byte *p, const Byte *end, bool isAIFC)
+{
+	bool haveFormat = false;
+	UInt32 fileFrames = 0;
+	while (end - p >= 8) {
+		UInt32 chunkSize = ReadBE32(p + 4);
+		const Byte *chunk = p + 8;
+		if (ChunkIDIs(p, "COMM") && chunkSize >= 18 && end - chunk >= 18) {
+			UInt16 nChannels = ReadBE16(chunk);
+			fileFrames = ReadBE32(chunk + 2);
+			UInt16 bitsPerSample = ReadBE16(chunk + 6);
+			Float64 sampleRate = ReadBEFloat80(chunk + 8);
+			bool isFloat = false, isBigEndian = true;
+			if (isAIFC) {
+				if (chunkSize < 22 || end - chunk < 22)
+					return false;
+				const Byte *compression = chunk + 18;
+				if (ChunkIDIs(compression, "sowt"))
+					isBigEndian = false;
+				else if (ChunkIDIs(compression, "fl32") || ChunkIDIs(compression, "FL32")) {
+					isFloat = true;
+					bitsPerSample = 32;
+				} else if (!ChunkIDIs(compression, "NONE") && !ChunkIDIs(compression, "twos"))
+					return false;
+			}
+			if (nChannels == 0 || bitsPerSample == 0 || bitsPerSample > 32)
+				return false;
+			UInt32 bytesPerFrame = nChannels * ((bitsPerSample + 7) / 8);
+			SetFileFormat(sampleRate, nChannels, bitsPerSample, bytesPerFrame, isFloat, true, isBigEndian);
+			haveFormat = true;
+		} else if (ChunkIDIs(p, "SSND") && haveFormat && chunkSize >= 8 && end - chunk >= 8) {
+			UInt32 offset = ReadBE32(chunk);
+			const Byte *data = chunk + 8 + offset;
+			if (data > end)
+				return false;
+			SInt64 available = (end - data) / mFileDataFormat.mBytesPerFrame;
+			mAudioData = data;
+			mNumberFrames = std::min(SInt64(fileFrames), available);
+			return true;
+		}
+		if (SInt64(chunkSize) > end - chunk)
+			break;
+		p = chunk + chunkSize + (chunkSize & 1);
+	}
+	return false;
+}
+
+bool	CAMappedAudioFile::ParseCAF(const Byte *p, const Byte *end)
+{
+	bool haveFormat = false;
+	while (end - p >= 12) {
+		SInt64 chunkSize = SInt64(ReadBE64(p + 4));
+		const Byte *chunk = p + 12;
+		if (ChunkIDIs(p, "desc") && chunkSize >= 32 && end - chunk >= 32) {
+			Float64 sampleRate = ReadBEFloat64(chunk);
+			UInt32 formatID = ReadBE32(chunk + 8);
+			UInt32 formatFlags = ReadBE32(chunk + 12);
+			UInt32 bytesPerPacket = ReadBE32(chunk + 16);
+			UInt32 framesPerPacket = ReadBE32(chunk + 20);
+			UInt32 nChannels = ReadBE32(chunk + 24);
+			UInt32 bitsPerChannel = ReadBE32(chunk + 28);
+			if (formatID != kAudioFormatLinearPCM || framesPerPacket != 1 || nChannels == 0 || bytesPerPacket == 0)
+				return false;
+			SetFileFormat(sampleRate, nChannels, bitsPerChannel, bytesPerPacket,
+				(formatFlags & kAudioFormatFlagIsFloat) != 0,
+				true,
+				(formatFlags & kAudioFormatFlagIsBigEndian) != 0);
+			haveFormat = true;
+		} else if (ChunkIDIs(p, "data") && haveFormat) {
+			// the data chunk starts with an edit count; a size of -1 means "to the end of the file"
+			if (end - chunk < 4 || (chunkSize >= 0 && chunkSize < 4))
+				return false;
+			SInt64 available = (end - chunk) - 4;
+			SInt64 dataSize = (chunkSize < 0) ? available : std::min(chunkSize - 4, available);
+			mAudioData = chunk + 4;
+			mNumberFrames = dataSize / mFileDataFormat.mBytesPerFrame;
+			return true;
+		}
+		if (chunkSize < 0 || chunkSize > end - chunk)
+			break;
+		p = chunk + chunkSize;
+	}
+	return false;
+}
+
+// ____________________________________________________________________________
+
+bool	CAMappedAudioFile::SetClientFormat(const CAStreamBasicDescription &dataFormat)
+{
+	const CAStreamBasicDescription &fileFormat = mFileDataFormat;
+	if (dataFormat.mFormatID == fileFormat.mFormatID
+	&& dataFormat.mFormatFlags == fileFormat.mFormatFlags
+	&& dataFormat.mBytesPerFrame == fileFormat.mBytesPerFrame
+	&& dataFormat.mChannelsPerFrame == fileFormat.mChannelsPerFrame
+	&& dataFormat.mBitsPerChannel == fileFormat.mBitsPerChannel
+	&& dataFormat.mSampleRate == fileFormat.mSampleRate) {
+		mClientDataFormat = dataFormat;
+		mConversion = kConversion_None;
+		return true;
+	}
+	
+	// otherwise only native float at the file's rate and channel count
+	if (!dataFormat.IsPCM() || dataFormat.mSampleRate != fileFormat.mSampleRate || dataFormat.mChannelsPerFrame != fileFormat.mChannelsPerFrame)
+		return false;
+	if ((dataFormat.mFormatFlags & ~kAudioFormatFlagIsNonInterleaved) != kAudioFormatFlagsNativeFloatPacked || dataFormat.mBitsPerChannel != 32)
+		return false;
+	
+	// make sure CASampleTools has a routine for this file format
+	Float32 probe;
+	if (mNumberFrames > 0 && !CASampleTools::ConvertSamples(fileFormat, mAudioData, dataFormat, &probe, 1))
+		return false;
+	
+	mClientDataFormat = dataFormat;
+	delete[] mScratch;	mScratch = NULL;
+	if (dataFormat.IsInterleaved() || dataFormat.mChannelsPerFrame == 1)
+		mConversion = kConversion_Interleaved;
+	else {
+		mScratch = new Float32[kScratchFrames * dataFormat.mChannelsPerFrame];
+		mConversion = kConversion_Deinterleaved;
+	}
+	return true;
+}
+
+void	CAMappedAudioFile::Seek(SInt64 frame)
+{
+	mPosition = std::max(SInt64(0), std::min(frame, mNumberFrames));
+#if !TARGET_OS_WIN32
+	// start paging in around the new position rather than waiting for the first fault
+	if (mMapping != NULL && mPosition < mNumberFrames) {
+		size_t pageSize = size_t(getpagesize());
+		const Byte *start = GetFrameData(mPosition);
+		size_t pageOffset = size_t(start - static_cast<const Byte *>(mMapping)) & ~(pageSize - 1);
+		size_t length = std::min(size_t(256 * 1024), mMappingSize - pageOffset);
+		madvise(static_cast<Byte *>(mMapping) + pageOffset, length, MADV_WILLNEED);
+	}
+#endif
+}
+
+void	CAMappedAudioFile::Read(UInt32 &ioFrames, AudioBufferList *ioData)
+{
+	UInt32 frames = UInt32(std::min(SInt64(ioFrames), mNumberFrames - mPosition));
+	const Byte *src = GetFrameData(mPosition);
+	const CAStreamBasicDescription &fileFormat = mFileDataFormat;
+	UInt32 nChannels = fileFormat.mChannelsPerFrame;
+	
+	switch (mConversion) {
+	case kConversion_None:
+		{
+			AudioBuffer &buf = ioData->mBuffers[0];
+			memcpy(buf.mData, src, frames * fileFormat.mBytesPerFrame);
+			buf.mDataByteSize = frames * fileFormat.mBytesPerFrame;
+		}
+		break;
+	case kConversion_Interleaved:
+		{
+			AudioBuffer &buf = ioData->mBuffers[0];
+			CASampleTools::ConvertSamples(fileFormat, src, mClientDataFormat, buf.mData, frames * nChannels);
+			buf.mDataByteSize = frames * nChannels * sizeof(Float32);
+		}
+		break;
+	case kConversion_Deinterleaved:
+		{
+			CAStreamBasicDescription interleavedFloat = mClientDataFormat;
+			interleavedFloat.mFormatFlags &= ~kAudioFormatFlagIsNonInterleaved;
+			interleavedFloat.mBytesPerPacket = interleavedFloat.mBytesPerFrame = nChannels * sizeof(Float32);
+			for (UInt32 done = 0; done < frames; ) {
+				UInt32 n = std::min(frames - done, UInt32(kScratchFrames));
+				CASampleTools::ConvertSamples(fileFormat, src + done * fileFormat.mBytesPerFrame, interleavedFloat, mScratch, n * nChannels);
+				for (UInt32 ch = 0; ch < nChannels; ++ch) {
+					Float32 *dest = static_cast<Float32 *>(ioData->mBuffers[ch].mData) + done;
+					const Float32 *s = mScratch + ch;
+					for (UInt32 i = 0; i < n; ++i, s += nChannels)
+						dest[i] = *s;
+				}
+				done += n;
+			}
+			for (UInt32 ch = 0; ch < nChannels; ++ch)
+				ioData->mBuffers[ch].mDataByteSize = frames * sizeof(Float32);
+		}
+		break;
+	}
+	mPosition += frames;
+	ioFrames = frames;
+}
+
+const Byte *	CAMappedAudioFile::ReadInPlace(UInt32 &ioFrames)
+{
+	UInt32 frames = UInt32(std::min(SInt64(ioFrames), mNumberFrames - mPosition));
+	const Byte *src = GetFrameData(mPosition);
+	mPosition += frames;
+	ioFrames = frames;
+	return src;
+}
+
+// ____________________________________________________________________________
+// benchmark
+
+static AudioBufferList *	AllocateBufferList(UInt32 nBuffers, UInt32 bytesPerBuffer)
+{
+	AudioBufferList *abl = (AudioBufferList *)calloc(1, offsetof(AudioBufferList, mBuffers) + nBuffers * sizeof(AudioBuffer));
+	abl->mNumberBuffers = nBuffers;
+	for (UInt32 i = 0; i < nBuffers; ++i) {
+		abl->mBuffers[i].mNumberChannels = 1;
+		abl->mBuffers[i].mDataByteSize = bytesPerBuffer;
+		abl->mBuffers[i].mData = calloc(1, bytesPerBuffer);
+	}
+	return abl;
+}
+
+static void	FreeBufferList(AudioBufferList *abl)
+{
+	for (UInt32 i = 0; i < abl->mNumberBuffers; ++i)
+		free(abl->mBuffers[i].mData);
+	free(abl);
+}
+
+static inline Float64	MBPerSecond(UInt64 bytes, UInt64 nanos)
+{
+	return (nanos > 0) ? (Float64(bytes) * 1000.) / Float64(nanos) : 0.;
+}
+
+bool	CAMappedAudioFile::MeasureReads(const char *filePath, UInt32 framesPerRead, UInt32 nSeeks, ReadStatistics &outStats)
+{
+	memset(&outStats, 0, sizeof(outStats));
+#if TARGET_OS_WIN32
+	return false;
+#else
+	CAMappedAudioFile file;
+	if (framesPerRead == 0 || !file.Open(filePath) || file.GetNumberFrames() == 0)
+		return false;
+	int fd = open(filePath, O_RDONLY);
+	if (fd < 0)
+		return false;
+	
+	const CAStreamBasicDescription fileFormat = file.GetFileDataFormat();
+	const UInt32 bpf = fileFormat.mBytesPerFrame, nChannels = fileFormat.mChannelsPerFrame;
+	const off_t dataOffset = off_t(file.mAudioData - static_cast<const Byte *>(file.mMapping));
+	const UInt64 dataBytes = UInt64(file.GetNumberFrames()) * bpf;
+	outStats.mNumberFrames = file.GetNumberFrames();
+	outStats.mBytesPerFrame = bpf;
+	
+	AudioBufferList *copyBuffer = AllocateBufferList(1, framesPerRead * bpf);
+	AudioBufferList *floatBuffers = AllocateBufferList(nChannels, framesPerRead * sizeof(Float32));
+	Byte *ioBuffer = new Byte[framesPerRead * bpf];
+	
+	// in place, reading a byte from every cache line so that the data really is fetched
+	UInt32 sum = 0;
+	UInt64 start = CAHostTimeBase::GetCurrentTimeInNanos();
+	file.Seek(0);
+	for (;;) {
+		UInt32 frames = framesPerRead;
+		const Byte *p = file.ReadInPlace(frames);
+		if (frames == 0)
+			break;
+		for (UInt32 i = 0; i < frames * bpf; i += 64)
+			sum += p[i];
+	}
+	outStats.mInPlaceMBPerSecond = MBPerSecond(dataBytes, CAHostTimeBase::GetCurrentTimeInNanos() - start);
+	
+	start = CAHostTimeBase::GetCurrentTimeInNanos();
+	file.Seek(0);
+	for (;;) {
+		UInt32 frames = framesPerRead;
+		file.Read(frames, copyBuffer);
+		if (frames == 0)
+			break;
+	}
+	outStats.mCopyMBPerSecond = MBPerSecond(dataBytes, CAHostTimeBase::GetCurrentTimeInNanos() - start);
+	
+	CAStreamBasicDescription floatFormat = fileFormat;
+	floatFormat.mFormatID = kAudioFormatLinearPCM;
+	floatFormat.mFormatFlags = kAudioFormatFlagsNativeFloatPacked | kAudioFormatFlagIsNonInterleaved;
+	floatFormat.mBitsPerChannel = 32;
+	floatFormat.mBytesPerFrame = floatFormat.mBytesPerPacket = sizeof(Float32);
+	floatFormat.mFramesPerPacket = 1;
+	if (file.SetClientFormat(floatFormat)) {
+		start = CAHostTimeBase::GetCurrentTimeInNanos();
+		file.Seek(0);
+		for (;;) {
+			UInt32 frames = framesPerRead;
+			file.Read(frames, floatBuffers);
+			if (frames == 0)
+				break;
+		}
+		outStats.mFloatMBPerSecond = MBPerSecond(dataBytes, CAHostTimeBase::GetCurrentTimeInNanos() - start);
+		file.SetClientFormat(fileFormat);
+	}
+	
+	// what a read costs without the mapping: into the I/O buffer, then out to the client's
+	start = CAHostTimeBase::GetCurrentTimeInNanos();
+	for (UInt64 offset = 0; offset < dataBytes; ) {
+		size_t bytes = size_t(std::min(UInt64(framesPerRead) * bpf, dataBytes - offset));
+		ssize_t n = pread(fd, ioBuffer, bytes, dataOffset + off_t(offset));
+		if (n <= 0)
+			break;
+		memcpy(copyBuffer->mBuffers[0].mData, ioBuffer, size_t(n));
+		offset += UInt64(n);
+	}
+	outStats.mPReadMBPerSecond = MBPerSecond(dataBytes, CAHostTimeBase::GetCurrentTimeInNanos() - start);
+	
+	// random seeks, each checked against the same bytes read from the file
+	UInt32 seed = sum | 1;
+	UInt64 totalNanos = 0;
+	for (UInt32 s = 0; s < nSeeks; ++s) {
+		seed = seed * 1664525 + 1013904223;
+		SInt64 frame = SInt64((UInt64(seed) * UInt64(file.GetNumberFrames())) >> 32);
+		UInt32 frames = framesPerRead;
+		start = CAHostTimeBase::GetCurrentTimeInNanos();
+		file.Seek(frame);
+		file.Read(frames, copyBuffer);
+		UInt64 nanos = CAHostTimeBase::GetCurrentTimeInNanos() - start;
+		totalNanos += nanos;
+		if (Float64(nanos) / 1000. > outStats.mWorstSeekReadMicroseconds)
+			outStats.mWorstSeekReadMicroseconds = Float64(nanos) / 1000.;
+		
+		ssize_t n = pread(fd, ioBuffer, frames * bpf, dataOffset + off_t(frame * bpf));
+		if (n != ssize_t(frames * bpf) || memcmp(ioBuffer, copyBuffer->mBuffers[0].mData, frames * bpf) != 0)
+			++outStats.mNumberMismatches;
+	}
+	if (nSeeks > 0)
+		outStats.mSeekReadMicroseconds = Float64(totalNanos) / (1000. * nSeeks);
+	
+	delete[] ioBuffer;
+	FreeBufferList(copyBuffer);
+	FreeBufferList(floatBuffers);
+	close(fd);
+	return outStats.mNumberMismatches == 0;
+#endif
+}
@@ -0,0 +1,139 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CAMappedAudioFile.h
+	
+=============================================================================*/
+
+#ifndef __CAMappedAudioFile_h__
+#define __CAMappedAudioFile_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+#include "CAStreamBasicDescription.h"
+
+// _______________________________________________________________________________________
+// Read-only, memory-mapped access to an uncompressed WAV, AIFF/AIFC or CAF file.
+// Only the file's header is parsed; sample data is read straight out of the mapping.
+// ReadInPlace hands back pointers into the mapping instead of copying. Read copies when
+// the client format is the file's format, and otherwise converts from the mapping to
+// native 32 bit float, interleaved or not, via CASampleTools. Sample rate and channel
+// count are never converted; use CAAudioFile for that.
+class CAMappedAudioFile {
+public:
+	CAMappedAudioFile();
+	~CAMappedAudioFile() { Close(); }
+	
+	bool	Open(const char *filePath);
+				// returns false, leaving the object closed, if the file can't be mapped or
+				// isn't linear PCM in one of the supported containers
+	void	Close();
+	bool	IsOpen() const { return mMapping != NULL; }
+	
+	const CAStreamBasicDescription &GetFileDataFormat() const { return mFileDataFormat; }
+	const CAStreamBasicDescription &GetClientDataFormat() const { return mClientDataFormat; }
+	bool	SetClientFormat(const CAStreamBasicDescription &dataFormat);
+				// returns false if there is no conversion from the file's format
+	bool	ClientFormatIsFileFormat() const { return mConversion == kConversion_None; }
+	
+	SInt64	GetNumberFrames() const { return mNumberFrames; }
+	void	Seek(SInt64 frame);
+	SInt64	Tell() const { return mPosition; }
+	
+	void	Read(UInt32 &ioFrames, AudioBufferList *ioData);
+				// copies or converts the frames into ioData's buffers
+	const Byte *	ReadInPlace(UInt32 &ioFrames);
+				// Returns a pointer to the next ioFrames frames (fewer at the end of the file) in
+				// the mapping, in the file's format, without copying, and advances past them.
+				// The frames are read only and stay valid until Close.
+	
+	const Byte *	GetFrameData(SInt64 frame) const { return mAudioData + frame * mFileDataFormat.mBytesPerFrame; }
+				// the file's frame, in the file's format
+	
+	struct ReadStatistics {
+		SInt64		mNumberFrames;
+		UInt32		mBytesPerFrame;
+		Float64		mInPlaceMBPerSecond;	// ReadInPlace, touching every cache line
+		Float64		mCopyMBPerSecond;		// Read in the file's format
+		Float64		mFloatMBPerSecond;		// Read to deinterleaved float (MB of the file's data)
+		Float64		mPReadMBPerSecond;		// pread into an I/O buffer then copied out, as without the mapping
+		Float64		mSeekReadMicroseconds;	// Seek to a random frame and Read from there, on average
+		Float64		mWorstSeekReadMicroseconds;
+		UInt32		mNumberMismatches;		// random reads whose data differs from pread's
+	};
+	
+	static bool	MeasureReads(const char *filePath, UInt32 framesPerRead, UInt32 nSeeks, ReadStatistics &outStats);
+					// Sequential passes over the whole file, then nSeeks random seeks. Returns false
+					// if the file can't be opened or a mapped read differs from the file's bytes.
+
+private:
+	bool	ParseWAVE(const Byte *p, const Byte *end);
+	bool	ParseAIFF(const Byte *p, const Byte *end, bool isAIFC);
+	bool	ParseCAF(const Byte *p, const Byte *end);
+	void	SetFileFormat(Float64 sampleRate, UInt32 nChannels, UInt32 bitsPerChannel, UInt32 bytesPerFrame, bool isFloat, bool isSigned, bool isBigEndian);
+	
+	enum {
+		kConversion_None,					// client format is the file format
+		kConversion_Interleaved,			// file format to interleaved float
+		kConversion_Deinterleaved			// file format to deinterleaved float, through mScratch
+	};
+	enum { kScratchFrames = 1024 };
+	
+	void *						mMapping;
+	size_t						mMappingSize;
+	const Byte *				mAudioData;
+	SInt64						mNumberFrames;
+	SInt64						mPosition;
+	int							mConversion;
+	Float32 *					mScratch;
+	
+	CAStreamBasicDescription	mFileDataFormat;
+	CAStreamBasicDescription	mClientDataFormat;
+	
+	CAMappedAudioFile(const CAMappedAudioFile &);
+	CAMappedAudioFile &operator=(const CAMappedAudioFile &);
+};
+
+#endif // __CAMappedAudioFile_h__
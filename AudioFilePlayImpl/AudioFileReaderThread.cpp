@@ -39,7 +39,11 @@
 // AudioFileReaderThread.cpp
 //
 #include "AudioFilePlayer.h"
-#include <mach/mach.h> //used for setting policy of thread
+#if defined(__linux__)
+	#include "CAThreadScheduling.h"
+#else
+	#include <mach/mach.h> //used for setting policy of thread
+#endif
 #include "CAGuard.h"
 #include <pthread.h>
 
@@ -90,7 +94,9 @@ private:
 	void 						ReadNextChunk ();
 	
 	void 						StartFixedPriorityThread ();
+#if !defined(__linux__)
     static UInt32				GetThreadBasePriority (pthread_t inThread);
+#endif
     
 	static void*				DiskReaderEntry (void *inRefCon);
 };
@@ -150,6 +156,7 @@ void 	FileReaderThread::StartFixedPriorityThread ()
 	
 	pthread_attr_destroy(&theThreadAttrs);
     
+#if !defined(__linux__)
 	// we've now created the thread and started it
 	// we'll now set the priority of the thread to the nominated priority
 	// and we'll also make the thread fixed
@@ -168,8 +175,10 @@ void 	FileReaderThread::StartFixedPriorityThread ()
     thePrecedencePolicy.importance = relativePriority;
     result = thread_policy_set (pthread_mach_thread_np(pThread), THREAD_PRECEDENCE_POLICY, (thread_policy_t)&thePrecedencePolicy, THREAD_PRECEDENCE_POLICY_COUNT);
         THROW_RESULT("thread_policy - Couldn't set thread priority.")
+#endif
 }
 
+#if !defined(__linux__)
 UInt32	FileReaderThread::GetThreadBasePriority (pthread_t inThread)
 {
     thread_basic_info_data_t			threadInfo;
@@ -210,10 +219,16 @@ UInt32	FileReaderThread::GetThreadBasePriority (pthread_t inThread)
     
     return 0;
 }
+#endif
 
 void	*FileReaderThread::DiskReaderEntry (void *inRefCon)
 {
 	FileReaderThread *This = (FileReaderThread *)inRefCon;
+#if defined(__linux__)
+	// on Linux the thread has to make itself fixed priority, as only it knows its kernel thread ID
+	CAThreadScheduling::PrepareCurrentThread();
+	CAThreadScheduling::SetPriority (CAThreadScheduling::GetCurrentThreadID(), This->mThreadPriority, true);
+#endif
 	This->ReadNextChunk();
 	#if DEBUG
 	printf ("finished with reading file\n");
@@ -53,11 +53,95 @@ full barrier.
 #if TARGET_OS_WIN32
 	#include <windows.h>
 	#include <intrin.h>
+#elif defined(__linux__)
+	#include <CoreAudio/CoreAudioTypes.h>
+	#include <stdint.h>
+	#include <unistd.h>
 #else
 	#include <CoreFoundation/CFBase.h>
 	#include <libkern/OSAtomic.h>
 #endif
 
+#if defined(__linux__)
+//	There is no libkern on Linux, so the OSAtomic functions used below are
+//	implemented here with the compiler's __sync builtins, all of which are full
+//	barriers. Like OSAtomic, the bit operations number the bits
+//	starting with the most significant bit of the first byte.
+inline void OSMemoryBarrier()
+{
+	__sync_synchronize();
+}
+
+inline int32_t OSAtomicAdd32Barrier(int32_t theAmt, volatile int32_t* theValue)
+{
+	return __sync_add_and_fetch(theValue, theAmt);
+}
+
+inline int32_t OSAtomicOr32Barrier(uint32_t theMask, volatile uint32_t* theValue)
+{
+	return (int32_t)__sync_or_and_fetch(theValue, theMask);
+}
+
+inline int32_t OSAtomicAnd32Barrier(uint32_t theMask, volatile uint32_t* theValue)
+{
+	return (int32_t)__sync_and_and_fetch(theValue, theMask);
+}
+
+inline bool OSAtomicCompareAndSwap32Barrier(int32_t oldValue, int32_t newValue, volatile int32_t* theValue)
+{
+	return __sync_bool_compare_and_swap(theValue, oldValue, newValue);
+}
+
+inline bool OSAtomicCompareAndSwap64Barrier(int64_t oldValue, int64_t newValue, volatile int64_t* theValue)
+{
+	return __sync_bool_compare_and_swap(theValue, oldValue, newValue);
+}
+
+inline bool OSAtomicCompareAndSwapPtrBarrier(void* oldValue, void* newValue, void* volatile* theValue)
+{
+	return __sync_bool_compare_and_swap(theValue, oldValue, newValue);
+}
+
+inline int32_t OSAtomicIncrement32(volatile int32_t* theValue)
+{
+	return __sync_add_and_fetch(theValue, 1);
+}
+
+inline int32_t OSAtomicDecrement32(volatile int32_t* theValue)
+{
+	return __sync_sub_and_fetch(theValue, 1);
+}
+
+inline int32_t OSAtomicIncrement32Barrier(volatile int32_t* theValue)
+{
+	return __sync_add_and_fetch(theValue, 1);
+}
+
+inline int32_t OSAtomicDecrement32Barrier(volatile int32_t* theValue)
+{
+	return __sync_sub_and_fetch(theValue, 1);
+}
+
+inline bool OSAtomicTestAndClearBarrier(uint32_t theBit, volatile void* theAddress)
+{
+	volatile uint8_t* theByte = ((volatile uint8_t*)theAddress) + (theBit >> 3);
+	uint8_t theMask = (uint8_t)(0x80 >> (theBit & 7));
+	return (__sync_fetch_and_and(theByte, (uint8_t)~theMask) & theMask) != 0;
+}
+
+inline bool OSAtomicTestAndClear(uint32_t theBit, volatile void* theAddress)
+{
+	return OSAtomicTestAndClearBarrier(theBit, theAddress);
+}
+
+inline bool OSAtomicTestAndSetBarrier(uint32_t theBit, volatile void* theAddress)
+{
+	volatile uint8_t* theByte = ((volatile uint8_t*)theAddress) + (theBit >> 3);
+	uint8_t theMask = (uint8_t)(0x80 >> (theBit & 7));
+	return (__sync_fetch_and_or(theByte, theMask) & theMask) != 0;
+}
+#endif
+
 inline void CAMemoryBarrier() 
 {
 #if TARGET_OS_WIN32
@@ -235,12 +319,23 @@ inline int32_t CAAtomicDecrement32Barrier(volatile int32_t* theValue)
 }
 #endif // __cplusplus && !__LP64__
 
-#if __LP64__
 inline bool CAAtomicCompareAndSwap64Barrier( int64_t __oldValue, int64_t __newValue, volatile int64_t *__theValue )
 {
+#if TARGET_OS_WIN32
+	return InterlockedCompareExchange64((volatile LONGLONG*)__theValue, __newValue, __oldValue) == __oldValue;
+#else
 	return OSAtomicCompareAndSwap64Barrier(__oldValue, __newValue, __theValue );
+#endif
 }
+
+inline bool CAAtomicCompareAndSwapPtrBarrier(void *oldValue, void *newValue, void * volatile *theValue)
+{
+#if TARGET_OS_WIN32
+	return InterlockedCompareExchangePointer(theValue, newValue, oldValue) == oldValue;
+#else
+	return OSAtomicCompareAndSwapPtrBarrier(oldValue, newValue, theValue);
 #endif
+}
 
 /* Spinlocks.  These use memory barriers as required to synchronize access to shared
  * memory protected by the lock.  The lock operation spins, but employs various strategies
@@ -0,0 +1,172 @@
+/*	Copyright: 	 Copyright 2004 Apple Computer, Inc. All rights reserved.
+
+	Disclaimer:	IMPORTANT:  This Apple software is supplied to you by Apple Computer, Inc.
+			("Apple") in consideration of your agreement to the following terms, and your
+			use, installation, modification or redistribution of this Apple software
+			constitutes acceptance of these terms.  If you do not agree with these terms,
+			please do not use, install, modify or redistribute this Apple software.
+
+			In consideration of your agreement to abide by the following terms, and subject
+			to these terms, Apple grants you a personal, non-exclusive license, under Apples
+			copyrights in this original Apple software (the "Apple Software"), to use,
+			reproduce, modify and redistribute the Apple Software, with or without
+			modifications, in source and/or binary forms; provided that if you redistribute
+			the Apple Software in its entirety and without modifications, you must retain
+			this notice and the following text and disclaimers in all such redistributions of
+			the Apple Software.  Neither the name, trademarks, service marks or logos of
+			Apple Computer, Inc. may be used to endorse or promote products derived from the
+			Apple Software without specific prior written permission from Apple.  Except as
+			expressly stated in this notice, no other rights or licenses, express or implied,
+			are granted by Apple herein, including but not limited to any patent rights that
+			may be infringed by your derivative works or by other works in which the Apple
+			Software may be incorporated.
+
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+			WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+			WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+			PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION ALONE OR IN
+			COMBINATION WITH YOUR PRODUCTS.
+
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+			CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+			GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+			ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION AND/OR DISTRIBUTION
+			OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER UNDER THEORY OF CONTRACT, TORT
+			(INCLUDING NEGLIGENCE), STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN
+			ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CAAtomicFIFO.cpp
+	
+=============================================================================*/
+
+#include "CAAtomicFIFO.h"
+#include "CAHostTimeBase.h"
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <vector>
+
+// ____________________________________________________________________________
+
+// each value is (producer << 24) | (sequence number + 1), so 0 is never pushed
+enum { kFIFOSequenceBits = 24 };
+
+struct CAAtomicFIFOStress {
+	TAtomicBoundedFIFO<UInt32> *	mFIFO;
+	UInt32							mNumberProducers;
+	UInt32							mNumberItems;			// per producer
+	volatile SInt32					mNextProducer;
+	volatile SInt32					mNumberThreadsReady;
+	volatile SInt32					mGo;
+	volatile SInt32					mNumberProducersDone;
+	volatile SInt32					mNumberPopped;
+	volatile SInt32					mFullPushes;
+	volatile SInt32					mNumberOutOfOrderItems;
+};
+
+static void *	FIFOProducerEntry(void *param)
+{
+	CAAtomicFIFOStress *stress = static_cast<CAAtomicFIFOStress *>(param);
+	UInt32 producer = UInt32(CAAtomicIncrement32Barrier(&stress->mNextProducer) - 1);
+	CAAtomicIncrement32Barrier(&stress->mNumberThreadsReady);
+	while (stress->mGo == 0)
+		;
+	
+	SInt32 fullPushes = 0;
+	for (UInt32 i = 0; i < stress->mNumberItems; ++i) {
+		UInt32 value = (producer << kFIFOSequenceBits) | (i + 1);
+		while (!stress->mFIFO->push(value)) {
+			++fullPushes;
+			sched_yield();		// let a consumer run, in case they share a CPU
+		}
+	}
+	CAAtomicAdd32Barrier(fullPushes, &stress->mFullPushes);
+	CAAtomicIncrement32Barrier(&stress->mNumberProducersDone);
+	return NULL;
+}
+
+static void *	FIFOConsumerEntry(void *param)
+{
+	CAAtomicFIFOStress *stress = static_cast<CAAtomicFIFOStress *>(param);
+	CAAtomicIncrement32Barrier(&stress->mNumberThreadsReady);
+	while (stress->mGo == 0)
+		;
+	
+	// one consumer sees each producer's values in the order they were pushed, with gaps
+	// where other consumers took some
+	std::vector<UInt32> lastSequence(stress->mNumberProducers, 0);
+	SInt32 outOfOrder = 0;
+	for (;;) {
+		bool producersDone = (stress->mNumberProducersDone == SInt32(stress->mNumberProducers));
+		CAMemoryBarrier();
+		UInt32 value;
+		if (!stress->mFIFO->pop(value)) {
+			if (producersDone)
+				break;		// everything was pushed before the FIFO was found empty
+			sched_yield();
+			continue;
+		}
+		CAAtomicIncrement32Barrier(&stress->mNumberPopped);
+		UInt32 producer = value >> kFIFOSequenceBits;
+		UInt32 sequence = value & ((1U << kFIFOSequenceBits) - 1);
+		if (producer >= stress->mNumberProducers || sequence <= lastSequence[producer])
+			++outOfOrder;
+		else
+			lastSequence[producer] = sequence;
+	}
+	CAAtomicAdd32Barrier(outOfOrder, &stress->mNumberOutOfOrderItems);
+	return NULL;
+}
+
+bool	CAMeasureAtomicFIFO(UInt32 inNumberProducers, UInt32 inNumberConsumers, UInt32 inNumberItems, UInt32 inCapacity, CAAtomicFIFOStatistics &outStatistics)
+{
+	memset(&outStatistics, 0, sizeof(outStatistics));
+	if (inNumberProducers == 0)
+		inNumberProducers = 1;
+	if (inNumberProducers > 255)
+		inNumberProducers = 255;
+	if (inNumberConsumers == 0)
+		inNumberConsumers = 1;
+	if (inNumberItems >= (1U << kFIFOSequenceBits))
+		inNumberItems = (1U << kFIFOSequenceBits) - 1;
+	if (inNumberProducers * inNumberItems > 0x7FFFFFFFU)
+		inNumberItems = 0x7FFFFFFFU / inNumberProducers;
+	outStatistics.mNumberProducers = inNumberProducers;
+	outStatistics.mNumberConsumers = inNumberConsumers;
+	
+	TAtomicBoundedFIFO<UInt32> fifo(inCapacity);
+	CAAtomicFIFOStress stress = { &fifo, inNumberProducers, inNumberItems, 0, 0, 0, 0, 0, 0, 0 };
+	UInt32 nThreads = inNumberProducers + inNumberConsumers;
+	pthread_t *threads = new pthread_t[nThreads];
+	UInt32 nStarted = 0;
+	while (nStarted < nThreads && pthread_create(&threads[nStarted], NULL,
+				(nStarted < inNumberProducers) ? FIFOProducerEntry : FIFOConsumerEntry, &stress) == 0)
+		++nStarted;
+	if (nStarted < nThreads) {
+		// without all of them, the consumers would wait forever for the missing producers
+		stress.mNumberProducersDone = SInt32(inNumberProducers);
+		stress.mNumberItems = 0;
+		CAAtomicIncrement32Barrier(&stress.mGo);
+		for (UInt32 i = 0; i < nStarted; ++i)
+			pthread_join(threads[i], NULL);
+		delete[] threads;
+		return false;
+	}
+	while (stress.mNumberThreadsReady < SInt32(nThreads))
+		;
+	UInt64 start = CAHostTimeBase::GetCurrentTimeInNanos();
+	CAAtomicIncrement32Barrier(&stress.mGo);
+	for (UInt32 i = 0; i < nThreads; ++i)
+		pthread_join(threads[i], NULL);
+	UInt64 elapsed = CAHostTimeBase::GetCurrentTimeInNanos() - start;
+	delete[] threads;
+	
+	UInt32 total = inNumberProducers * inNumberItems;
+	outStatistics.mNanosPerItem = (total > 0) ? Float64(elapsed) / total : 0.;
+	outStatistics.mFullPushes = UInt32(stress.mFullPushes);
+	outStatistics.mNumberOutOfOrderItems = UInt32(stress.mNumberOutOfOrderItems);
+	UInt32 popped = UInt32(stress.mNumberPopped);
+	outStatistics.mNumberLostItems = (popped < total) ? total - popped : popped - total;
+	return outStatistics.mNumberLostItems == 0 && outStatistics.mNumberOutOfOrderItems == 0;
+}
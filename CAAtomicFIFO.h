@@ -40,8 +40,10 @@
 	
 =============================================================================*/
 
-#ifndef __TStack_h__
-#define __TStack_h__
+#ifndef __CAAtomicFIFO_h__
+#define __CAAtomicFIFO_h__
+
+#include "CAAtomic.h"
 
 //  linked list FIFO stack, elements are pushed and popped atomically
 //  class T must implement set_next() and get_next()
@@ -74,7 +76,7 @@ public:
 		do {
 			head = mHead;
 			item->set_next(head);
-		} while (!CompareAndSwap(UInt32(head), UInt32(item), (UInt32 *)&mHead));
+		} while (!CAAtomicCompareAndSwapPtrBarrier(head, item, (void * volatile *)&mHead));
 	}
 	
 	T *		pop_atomic()
@@ -83,7 +85,7 @@ public:
 		do {
 			if ((result = mHead) == NULL)
 				break;
-		} while (!CompareAndSwap(UInt32(result), UInt32(result->get_next()), (UInt32 *)&mHead));
+		} while (!CAAtomicCompareAndSwapPtrBarrier(result, result->get_next(), (void * volatile *)&mHead));
 		return result;
 	}
 	
@@ -91,4 +93,105 @@ private:
 	T *		mHead;
 };
 
-#endif // __TStack_h__
+//  bounded FIFO of values (typically pointers) that any number of threads may push to and
+//  pop from without locks. Every slot carries a sequence number telling producers and
+//  consumers whose turn it is, so push and pop each claim a position with one CAS and
+//  never touch a slot another thread is still using. The capacity is rounded up to a power
+//  of two and allocated up front; push fails when full and pop when empty.
+template <class T>
+class TAtomicBoundedFIFO {
+public:
+	TAtomicBoundedFIFO(UInt32 inCapacity) : mEnqueuePos(0), mDequeuePos(0)
+	{
+		UInt32 capacity = 2;
+		while (capacity < inCapacity)
+			capacity <<= 1;
+		mMask = capacity - 1;
+		mCells = new Cell[capacity];
+		for (UInt32 i = 0; i < capacity; ++i)
+			mCells[i].mSequence = SInt32(i);
+	}
+	~TAtomicBoundedFIFO() { delete[] mCells; }
+	
+	UInt32	capacity() const { return mMask + 1; }
+	
+	bool	push(const T &item)
+	{
+		Cell *cell;
+		UInt32 pos = UInt32(mEnqueuePos);
+		for (;;) {
+			cell = &mCells[pos & mMask];
+			SInt32 dif = SInt32(UInt32(cell->mSequence) - pos);
+			if (dif == 0) {
+				// the slot is free for position pos; claim the position
+				if (CAAtomicCompareAndSwap32Barrier(SInt32(pos), SInt32(pos + 1), &mEnqueuePos))
+					break;
+				pos = UInt32(mEnqueuePos);
+			} else if (dif < 0)
+				return false;	// the slot still holds the item from a lap ago: full
+			else
+				pos = UInt32(mEnqueuePos);
+		}
+		CAMemoryBarrier();
+		cell->mValue = item;
+		CAMemoryBarrier();
+		cell->mSequence = SInt32(pos + 1);	// hand the slot to the consumer of pos
+		return true;
+	}
+	
+	bool	pop(T &outItem)
+	{
+		Cell *cell;
+		UInt32 pos = UInt32(mDequeuePos);
+		for (;;) {
+			cell = &mCells[pos & mMask];
+			SInt32 dif = SInt32(UInt32(cell->mSequence) - (pos + 1));
+			if (dif == 0) {
+				if (CAAtomicCompareAndSwap32Barrier(SInt32(pos), SInt32(pos + 1), &mDequeuePos))
+					break;
+				pos = UInt32(mDequeuePos);
+			} else if (dif < 0)
+				return false;	// nothing has been pushed at pos yet: empty
+			else
+				pos = UInt32(mDequeuePos);
+		}
+		CAMemoryBarrier();
+		outItem = cell->mValue;
+		CAMemoryBarrier();
+		cell->mSequence = SInt32(pos + mMask + 1);	// hand the slot to the producer one lap on
+		return true;
+	}
+	
+private:
+	struct Cell {
+		volatile SInt32	mSequence;
+		T				mValue;
+	};
+	
+	Cell *			mCells;
+	UInt32			mMask;
+	// producers and consumers hit different positions; keep them off one cache line
+	volatile SInt32	mEnqueuePos;
+	char			mPad[64 - sizeof(SInt32)];
+	volatile SInt32	mDequeuePos;
+	
+	TAtomicBoundedFIFO(const TAtomicBoundedFIFO &);
+	TAtomicBoundedFIFO &operator=(const TAtomicBoundedFIFO &);
+};
+
+//  Stress test and benchmark of TAtomicBoundedFIFO, in CAAtomicFIFO.cpp: inNumberProducers
+//  threads each push inNumberItems values through a FIFO of inCapacity to inNumberConsumers
+//  threads, which check that each producer's values arrive once and in order.
+struct CAAtomicFIFOStatistics {
+	UInt32		mNumberProducers;
+	UInt32		mNumberConsumers;
+	Float64		mNanosPerItem;				// wall time over all the items
+	UInt32		mFullPushes;				// pushes that found the FIFO full and were retried
+	UInt32		mNumberLostItems;			// missing, or popped more than once; must be 0
+	UInt32		mNumberOutOfOrderItems;		// must be 0
+};
+
+//  Returns false if a thread couldn't be started or an item was lost, repeated or reordered.
+bool	CAMeasureAtomicFIFO(UInt32 inNumberProducers, UInt32 inNumberConsumers, UInt32 inNumberItems, UInt32 inCapacity, CAAtomicFIFOStatistics &outStatistics);
+
+#endif // __CAAtomicFIFO_h__
@@ -0,0 +1,146 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CAAtomicStack.cpp
+	
+=============================================================================*/
+
+#include "CAAtomicStack.h"
+#include "CAHostTimeBase.h"
+#include <pthread.h>
+#include <string.h>
+
+// ____________________________________________________________________________
+
+struct CAAtomicStackTestItem {
+	CAAtomicStackTestItem *	mNext;
+	volatile SInt32			mHeld;		// by the thread that popped it
+	
+	void					set_next(CAAtomicStackTestItem *item) { mNext = item; }
+	CAAtomicStackTestItem *	get_next() { return mNext; }
+};
+
+template <class Stack>
+struct CAAtomicStackStress {
+	Stack *			mStack;
+	UInt32			mNumberIterations;
+	volatile SInt32	mNumberThreadsReady;
+	volatile SInt32	mGo;
+	volatile SInt32	mEmptyPops;
+	volatile SInt32	mDoublePops;
+};
+
+template <class Stack>
+static void *	StackStressEntry(void *param)
+{
+	CAAtomicStackStress<Stack> *stress = static_cast<CAAtomicStackStress<Stack> *>(param);
+	CAAtomicIncrement32Barrier(&stress->mNumberThreadsReady);
+	while (stress->mGo == 0)
+		;
+	
+	SInt32 emptyPops = 0, doublePops = 0;
+	for (UInt32 i = 0; i < stress->mNumberIterations; ++i) {
+		CAAtomicStackTestItem *item = stress->mStack->pop_atomic();
+		if (item == NULL) {
+			++emptyPops;
+			continue;
+		}
+		if (!CAAtomicCompareAndSwap32Barrier(0, 1, &item->mHeld)) {
+			// another thread has it too; pushing it again would only spread the damage
+			++doublePops;
+			continue;
+		}
+		CAAtomicCompareAndSwap32Barrier(1, 0, &item->mHeld);
+		stress->mStack->push_atomic(item);
+	}
+	CAAtomicAdd32Barrier(emptyPops, &stress->mEmptyPops);
+	CAAtomicAdd32Barrier(doublePops, &stress->mDoublePops);
+	return NULL;
+}
+
+template <class Stack>
+static bool	MeasureStack(UInt32 nThreads, UInt32 nItems, UInt32 nIterations, Float64 &outNanos, UInt32 &outEmptyPops, UInt32 &outDoublePops)
+{
+	Stack stack;
+	CAAtomicStackTestItem *items = new CAAtomicStackTestItem[nItems];
+	for (UInt32 i = 0; i < nItems; ++i) {
+		items[i].mHeld = 0;
+		stack.push_atomic(&items[i]);
+	}
+	
+	CAAtomicStackStress<Stack> stress = { &stack, nIterations, 0, 0, 0, 0 };
+	pthread_t *threads = new pthread_t[nThreads];
+	UInt32 nStarted = 0;
+	while (nStarted < nThreads && pthread_create(&threads[nStarted], NULL, StackStressEntry<Stack>, &stress) == 0)
+		++nStarted;
+	while (stress.mNumberThreadsReady < SInt32(nStarted))
+		;
+	UInt64 start = CAHostTimeBase::GetCurrentTimeInNanos();
+	CAAtomicIncrement32Barrier(&stress.mGo);
+	for (UInt32 i = 0; i < nStarted; ++i)
+		pthread_join(threads[i], NULL);
+	UInt64 elapsed = CAHostTimeBase::GetCurrentTimeInNanos() - start;
+	
+	outNanos = (nStarted > 0) ? Float64(elapsed) / (Float64(nIterations) * nStarted) : 0.;
+	outEmptyPops = UInt32(stress.mEmptyPops);
+	outDoublePops = UInt32(stress.mDoublePops);
+	delete[] threads;
+	delete[] items;
+	return nStarted == nThreads;
+}
+
+bool	CAMeasureAtomicStacks(UInt32 inNumberThreads, UInt32 inNumberItems, UInt32 inNumberIterations, CAAtomicStackStatistics &outStatistics)
+{
+	memset(&outStatistics, 0, sizeof(outStatistics));
+	if (inNumberThreads == 0)
+		inNumberThreads = 1;
+	if (inNumberItems < inNumberThreads)
+		inNumberItems = inNumberThreads;	// so that a pop that finds nothing is the stack's doing
+	outStatistics.mNumberThreads = inNumberThreads;
+	
+	UInt32 doublePops = 0, taggedDoublePops = 0;
+	bool started = MeasureStack<TAtomicStack<CAAtomicStackTestItem> >(inNumberThreads, inNumberItems, inNumberIterations,
+						outStatistics.mStackNanos, outStatistics.mStackEmptyPops, doublePops);
+	started &= MeasureStack<TAtomicTaggedStack<CAAtomicStackTestItem> >(inNumberThreads, inNumberItems, inNumberIterations,
+						outStatistics.mTaggedStackNanos, outStatistics.mTaggedStackEmptyPops, taggedDoublePops);
+	outStatistics.mNumberDoublePops = doublePops + taggedDoublePops;
+	return started && outStatistics.mNumberDoublePops == 0;
+}
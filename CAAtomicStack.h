@@ -52,6 +52,9 @@
 	#include <CoreServices/CoreServices.h>
 #endif
 
+#include "CAAtomic.h"
+#include <stdlib.h>
+
 //  linked list LIFO or FIFO (pop_all_reversed) stack, elements are pushed and popped atomically
 //  class T must implement set_next() and get_next()
 template <class T>
@@ -164,8 +167,7 @@ public:
 			return ::CompareAndSwap(UInt32(oldvalue), UInt32(newvalue), (UInt32 *)pvalue);
 	#endif
 #else
-			//return ::CompareAndSwap(UInt32(oldvalue), UInt32(newvalue), (UInt32 *)pvalue);
-			return CAAtomicCompareAndSwap32Barrier(SInt32(oldvalue), SInt32(newvalue), (SInt32*)pvalue);
+			return CAAtomicCompareAndSwapPtrBarrier(oldvalue, newvalue, (void * volatile *)pvalue);
 #endif
 	}
 	
@@ -173,6 +175,105 @@ protected:
 	T *		mHead;
 };
 
+//  linked list LIFO stack that any number of threads may push to and pop from atomically, in O(1).
+//  The head pairs the top pointer with a generation count that every pop advances, so a pop
+//  whose CAS races with another thread popping and re-pushing the same item fails and
+//  retries instead of installing a stale next pointer (the ABA problem of pop_atomic above).
+//  On 64-bit the count is kept in the pointer's top 16 bits, which are 0 in user space with
+//  48 bit virtual addresses. With 57 bit addresses (5-level paging) Linux only maps memory
+//  above 47 bits for a process that asks for it, so push aborts on an item up there rather
+//  than corrupt the stack. On 32-bit the pointer and a 32 bit count share one 64 bit word.
+//  Items must stay valid memory while the stack is in use (e.g. come from a pool): a popper
+//  may read get_next() of an item another thread has just popped.
+//  class T must implement set_next() and get_next()
+template <class T>
+class TAtomicTaggedStack {
+public:
+	TAtomicTaggedStack() : mHead(0) { }
+	
+	bool	empty() const { return Pointer(mHead) == NULL; }
+	
+	void	push_atomic(T *item)
+	{
+		int64_t head;
+		do {
+			head = mHead;
+			item->set_next(Pointer(head));
+		} while (!CAAtomicCompareAndSwap64Barrier(head, Pack(item, Tag(head)), &mHead));
+	}
+	
+	void	push_multiple_atomic(T *item)
+		// pushes entire linked list headed by item
+	{
+		T *tail = item;
+		while (tail->get_next() != NULL)
+			tail = tail->get_next();
+		int64_t head;
+		do {
+			head = mHead;
+			tail->set_next(Pointer(head));
+		} while (!CAAtomicCompareAndSwap64Barrier(head, Pack(item, Tag(head)), &mHead));
+	}
+	
+	T *		pop_atomic()
+	{
+		int64_t head;
+		T *result;
+		do {
+			head = mHead;
+			if ((result = Pointer(head)) == NULL)
+				break;
+		} while (!CAAtomicCompareAndSwap64Barrier(head, Pack(result->get_next(), Tag(head) + 1), &mHead));
+		return result;
+	}
+	
+	T *		pop_all()
+	{
+		int64_t head;
+		T *result;
+		do {
+			head = mHead;
+			if ((result = Pointer(head)) == NULL)
+				break;
+		} while (!CAAtomicCompareAndSwap64Barrier(head, Pack(NULL, Tag(head) + 1), &mHead));
+		return result;
+	}
+	
+private:
+#if __LP64__ || defined(_WIN64)
+	enum { kPointerBits = 48 };
+	static T *		Pointer(int64_t head) { return reinterpret_cast<T *>(uintptr_t(uint64_t(head) & ((1ULL << kPointerBits) - 1))); }
+	static uint64_t	Tag(int64_t head) { return uint64_t(head) >> kPointerBits; }
+	static int64_t	Pack(T *p, uint64_t tag)
+	{
+		if ((uint64_t(uintptr_t(p)) >> kPointerBits) != 0)
+			abort();	// the tag would overwrite part of the pointer
+		return int64_t(uint64_t(uintptr_t(p)) | (tag << kPointerBits));
+	}
+#else
+	static T *		Pointer(int64_t head) { return reinterpret_cast<T *>(uintptr_t(uint32_t(head))); }
+	static uint64_t	Tag(int64_t head) { return uint64_t(head) >> 32; }
+	static int64_t	Pack(T *p, uint64_t tag) { return int64_t(uint64_t(uintptr_t(p)) | (tag << 32)); }
+#endif
+
+	volatile int64_t	mHead;
+};
+
+//  Stress test and benchmark of TAtomicStack::pop_atomic against TAtomicTaggedStack, in
+//  CAAtomicStack.cpp. inNumberThreads threads each pop an item from a shared pool of
+//  inNumberItems and push it back, inNumberIterations times. Times are per pop and push.
+struct CAAtomicStackStatistics {
+	UInt32		mNumberThreads;
+	Float64		mStackNanos;
+	Float64		mTaggedStackNanos;
+	UInt32		mStackEmptyPops;			// pops that found no item, though some were free
+	UInt32		mTaggedStackEmptyPops;
+	UInt32		mNumberDoublePops;			// items held by two threads at once; must be 0
+};
+
+//  Returns false if a thread couldn't be started or an item was popped twice.
+bool	CAMeasureAtomicStacks(UInt32 inNumberThreads, UInt32 inNumberItems, UInt32 inNumberIterations, CAAtomicStackStatistics &outStatistics);
+
 #if ((MAC_OS_X_VERSION_MAX_ALLOWED >= MAC_OS_X_VERSION_10_5) && !TARGET_OS_WIN32)
 #include <libkern/OSAtomic.h>
 
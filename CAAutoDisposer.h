@@ -59,15 +59,23 @@ class	CAAutoFree
 
 //	Construction/Destruction
 public:
+	CAAutoFree() : mPointer(NULL) {}
 	CAAutoFree(UInt32 inSize) { mPointer = static_cast<T*>(malloc(inSize)); if(mPointer == NULL) { throw std::bad_alloc(); } }
 	CAAutoFree(void* inPointer) : mPointer(static_cast<T*>(inPointer)) {}
 	CAAutoFree(T* inPointer) : mPointer(inPointer) {}
-	~CAAutoFree() { free(mPointer); }
+	~CAAutoFree() { free(); }
 	operator T*() const { return mPointer; }
+	T* operator()() const { return mPointer; }
 	T& operator*() const { return *mPointer; }
 	T* operator->() const { return mPointer; }
 	T& operator[](int inIndex) const { return mPointer[inIndex]; }
 
+//	Allocation
+public:
+	void allocBytes(UInt32 inNumberBytes, bool inClear = false) { free(); mPointer = static_cast<T*>(inClear ? calloc(1, inNumberBytes) : malloc(inNumberBytes)); if((mPointer == NULL) && (inNumberBytes > 0)) { throw std::bad_alloc(); } }
+	void alloc(UInt32 inNumberItems, bool inClear = false) { allocBytes(inNumberItems * static_cast<UInt32>(sizeof(T)), inClear); }
+	void free() { ::free(mPointer); mPointer = NULL; }
+
 private:
 	T*	mPointer;
 
@@ -105,12 +113,19 @@ class	CAAutoArrayDelete
 
 //	Construction/Destruction
 public:
+	CAAutoArrayDelete() : mPointer(NULL) {}
 	CAAutoArrayDelete(UInt32 inNumberItems) { mPointer = new T[inNumberItems]; }
 	CAAutoArrayDelete(T* inPointer) : mPointer(inPointer) {}
-	~CAAutoArrayDelete() { delete[] mPointer; }
+	~CAAutoArrayDelete() { free(); }
 	operator T*() const { return mPointer; }
+	T* operator()() const { return mPointer; }
 	T& operator[](int inIndex) const { return mPointer[inIndex]; }
 
+//	Allocation
+public:
+	void alloc(UInt32 inNumberItems) { free(); mPointer = new T[inNumberItems]; }
+	void free() { delete[] mPointer; mPointer = NULL; }
+
 private:
 	T*	mPointer;
 
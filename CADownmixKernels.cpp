@@ -0,0 +1,170 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CADownmixKernels.cpp
+	
+=============================================================================*/
+
+#include "CADownmixKernels.h"
+#include "CAMatrixMixEngine.h"
+#include <stdlib.h>
+#include <stddef.h>
+#include <math.h>
+
+#define DOWNMIX_KERNEL(srcTag, destTag, Kernel) \
+	{ srcTag, destTag, Kernel::kNumIns, Kernel::kNumOuts, CADownmixKernel<Kernel>::Mix, CADownmixKernel<Kernel>::GetTerms }
+
+static const CADownmixKernelInfo sDownmixKernels[] = {
+	DOWNMIX_KERNEL(kAudioChannelLayoutTag_MPEG_5_1_A, kAudioChannelLayoutTag_Stereo, CADownmix_5_1_To_Stereo),
+	DOWNMIX_KERNEL(kAudioChannelLayoutTag_MPEG_7_1_C, kAudioChannelLayoutTag_MPEG_5_1_A, CADownmix_7_1_To_5_1),
+	DOWNMIX_KERNEL(kAudioChannelLayoutTag_Quadraphonic, kAudioChannelLayoutTag_Stereo, CADownmix_Quad_To_Stereo)
+};
+
+const CADownmixKernelInfo *	CAFindDownmixKernel(AudioChannelLayoutTag srcTag, AudioChannelLayoutTag destTag)
+{
+	for (size_t i = 0; i < sizeof(sDownmixKernels) / sizeof(sDownmixKernels[0]); ++i) {
+		const CADownmixKernelInfo &k = sDownmixKernels[i];
+		if (k.mSrcTag == srcTag && k.mDestTag == destTag)
+			return &k;
+	}
+	return NULL;
+}
+
+const CADownmixKernelInfo *	CAGetDownmixKernels(UInt32 &outNumberKernels)
+{
+	outNumberKernels = UInt32(sizeof(sDownmixKernels) / sizeof(sDownmixKernels[0]));
+	return sDownmixKernels;
+}
+
+bool	CADownmixKernelSupportsMixMap(const CADownmixKernelInfo &kernel, const CAMixMap &map)
+{
+	if (map.NumIns() != kernel.mNumIns || map.NumOuts() != kernel.mNumOuts)
+		return false;
+	CAMixMap terms;
+	kernel.mGetTerms(terms);
+	for (UInt32 i = 0; i < kernel.mNumIns; ++i)
+		for (UInt32 j = 0; j < kernel.mNumOuts; ++j)
+			if (terms.GetCrossPoint(i, j) == 0.f && map.GetCrossPoint(i, j) != 0.f)
+				return false;
+	return true;
+}
+
+// ____________________________________________________________________________
+
+static AudioBufferList *	AllocateBufferList(UInt32 nBuffers, UInt32 nFrames)
+{
+	AudioBufferList *abl = (AudioBufferList *)calloc(1, offsetof(AudioBufferList, mBuffers) + nBuffers * sizeof(AudioBuffer));
+	abl->mNumberBuffers = nBuffers;
+	for (UInt32 i = 0; i < nBuffers; ++i) {
+		abl->mBuffers[i].mNumberChannels = 1;
+		abl->mBuffers[i].mDataByteSize = nFrames * sizeof(Float32);
+		abl->mBuffers[i].mData = calloc(nFrames, sizeof(Float32));
+	}
+	return abl;
+}
+
+static void	FreeBufferList(AudioBufferList *abl)
+{
+	for (UInt32 i = 0; i < abl->mNumberBuffers; ++i)
+		free(abl->mBuffers[i].mData);
+	free(abl);
+}
+
+bool	CATestDownmixKernels(UInt32 nFrames, Float32 tolerance, FILE *report)
+{
+	if (nFrames == 0)
+		nFrames = 1;
+	bool passed = true;
+	for (size_t k = 0; k < sizeof(sDownmixKernels) / sizeof(sDownmixKernels[0]); ++k) {
+		const CADownmixKernelInfo &kernel = sDownmixKernels[k];
+		AudioBufferList *src = AllocateBufferList(kernel.mNumIns, nFrames);
+		AudioBufferList *kernelOut = AllocateBufferList(kernel.mNumOuts, nFrames);
+		AudioBufferList *genericOut = AllocateBufferList(kernel.mNumOuts, nFrames);
+		
+		// full scale noise on every input
+		UInt32 seed = 1 + UInt32(k);
+		for (UInt32 i = 0; i < kernel.mNumIns; ++i) {
+			Float32 *in = (Float32 *)src->mBuffers[i].mData;
+			for (UInt32 f = 0; f < nFrames; ++f) {
+				seed = seed * 1664525 + 1013904223;
+				in[f] = Float32(seed >> 8) / Float32(1 << 23) - 1.f;
+			}
+		}
+		
+		// a gain between -1 and 1 on each of the kernel's terms
+		CAMixMap map;
+		kernel.mGetTerms(map);
+		for (UInt32 i = 0; i < kernel.mNumIns; ++i)
+			for (UInt32 j = 0; j < kernel.mNumOuts; ++j)
+				if (map.GetCrossPoint(i, j) != 0.f) {
+					seed = seed * 1664525 + 1013904223;
+					map.SetCrossPoint(i, j, Float32(seed >> 8) / Float32(1 << 23) - 1.f);
+				}
+		if (!CADownmixKernelSupportsMixMap(kernel, map))
+			passed = false;
+		
+		CAMatrixMixEngine engine(kernel.mNumIns, kernel.mNumOuts);
+		engine.SetMixMap(map);
+		engine.Mix(src, genericOut, nFrames);
+		kernel.mMix(src, kernelOut, nFrames, engine.GetGains());
+		
+		Float32 maxError = 0.f;
+		for (UInt32 j = 0; j < kernel.mNumOuts; ++j) {
+			const Float32 *a = (const Float32 *)kernelOut->mBuffers[j].mData;
+			const Float32 *b = (const Float32 *)genericOut->mBuffers[j].mData;
+			for (UInt32 f = 0; f < nFrames; ++f) {
+				Float32 e = fabsf(a[f] - b[f]);
+				if (e > maxError)
+					maxError = e;
+			}
+		}
+		if (maxError > tolerance)
+			passed = false;
+		if (report != NULL)
+			fprintf(report, "downmix kernel %d -> %d channels: max error %g %s\n", (int)kernel.mNumIns, (int)kernel.mNumOuts,
+				maxError, (maxError > tolerance) ? "FAILED" : "ok");
+		
+		FreeBufferList(src);
+		FreeBufferList(kernelOut);
+		FreeBufferList(genericOut);
+	}
+	return passed;
+}
@@ -0,0 +1,179 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CADownmixKernels.h
+	
+=============================================================================*/
+
+#ifndef __CADownmixKernels_h__
+#define __CADownmixKernels_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include "CAMixMap.h"
+
+// _______________________________________________________________________________________
+// Downmixes for the layout pairs that make up most conversions. A kernel fixes which
+// crosspoints it applies, so that the compiler can unroll a frame and keep it in registers;
+// the gains themselves come from the mix map in effect, normally the one AudioFormat
+// returns for the pair (kAudioFormatProperty_MatrixMixMap), so a kernel renders exactly
+// what the generic path would. Each kernel is a traits class whose Frame() mixes one frame;
+// CADownmixKernel<> runs it over deinterleaved Float32 buffers. Anything not registered here
+// goes through the generic matrix path (CAMatrixMixEngine).
+
+typedef void (*CADownmixProc)(const AudioBufferList *src, AudioBufferList *dest, UInt32 nFrames, const Float32 *gains);
+					// gains are [in * numOuts + out], as CAMatrixMixEngine::GetGains
+
+struct CADownmixKernelInfo {
+	AudioChannelLayoutTag	mSrcTag;
+	AudioChannelLayoutTag	mDestTag;
+	UInt32					mNumIns;
+	UInt32					mNumOuts;
+	CADownmixProc			mMix;
+	void					(*mGetTerms)(CAMixMap &outTerms);
+								// 1 at each crosspoint the kernel applies, 0 where it
+								// assumes the map is 0
+};
+
+// returns NULL if the pair has no specialized kernel
+const CADownmixKernelInfo *	CAFindDownmixKernel(AudioChannelLayoutTag srcTag, AudioChannelLayoutTag destTag);
+const CADownmixKernelInfo *	CAGetDownmixKernels(UInt32 &outNumberKernels);
+
+// A kernel can render a map of its size that is 0 at every crosspoint the kernel doesn't
+// apply; the values of the others don't matter.
+bool	CADownmixKernelSupportsMixMap(const CADownmixKernelInfo &kernel, const CAMixMap &map);
+
+// Renders noise through each registered kernel and through CAMatrixMixEngine, with random
+// gains on the kernel's terms, and returns false if any output sample differs by more than
+// tolerance. Prints one line per kernel to report, if not NULL. CAChannelMapper::
+// TestDownmixKernels does the same with the maps AudioFormat returns.
+bool	CATestDownmixKernels(UInt32 nFrames = 4096, Float32 tolerance = 1.0e-5f, FILE *report = NULL);
+
+// _______________________________________________________________________________________
+
+// in Frame(); g is the gains array, in the kernel's dimensions
+#define CADownmix_Gain(in, out)		g[(in) * kNumOuts + (out)]
+
+// L R C LFE Ls Rs -> L R; center and LFE go to both sides
+struct CADownmix_5_1_To_Stereo {
+	enum { kNumIns = 6, kNumOuts = 2 };
+	static inline void Frame(const Float32 *in, Float32 *out, const Float32 *g) {
+		out[0] = in[0] * CADownmix_Gain(0, 0) + in[2] * CADownmix_Gain(2, 0) + in[3] * CADownmix_Gain(3, 0) + in[4] * CADownmix_Gain(4, 0);
+		out[1] = in[1] * CADownmix_Gain(1, 1) + in[2] * CADownmix_Gain(2, 1) + in[3] * CADownmix_Gain(3, 1) + in[5] * CADownmix_Gain(5, 1);
+	}
+};
+
+// L R C LFE Ls Rs Rls Rrs -> L R C LFE Ls Rs; each surround takes its side and rear
+struct CADownmix_7_1_To_5_1 {
+	enum { kNumIns = 8, kNumOuts = 6 };
+	static inline void Frame(const Float32 *in, Float32 *out, const Float32 *g) {
+		out[0] = in[0] * CADownmix_Gain(0, 0);
+		out[1] = in[1] * CADownmix_Gain(1, 1);
+		out[2] = in[2] * CADownmix_Gain(2, 2);
+		out[3] = in[3] * CADownmix_Gain(3, 3);
+		out[4] = in[4] * CADownmix_Gain(4, 4) + in[6] * CADownmix_Gain(6, 4);
+		out[5] = in[5] * CADownmix_Gain(5, 5) + in[7] * CADownmix_Gain(7, 5);
+	}
+};
+
+// L R Ls Rs -> L R
+struct CADownmix_Quad_To_Stereo {
+	enum { kNumIns = 4, kNumOuts = 2 };
+	static inline void Frame(const Float32 *in, Float32 *out, const Float32 *g) {
+		out[0] = in[0] * CADownmix_Gain(0, 0) + in[2] * CADownmix_Gain(2, 0);
+		out[1] = in[1] * CADownmix_Gain(1, 1) + in[3] * CADownmix_Gain(3, 1);
+	}
+};
+
+template <class Kernel>
+class CADownmixKernel {
+public:
+	static void	Mix(const AudioBufferList *src, AudioBufferList *dest, UInt32 nFrames, const Float32 *gains)
+	{
+		const Float32 *inBufs[Kernel::kNumIns];
+		Float32 *outBufs[Kernel::kNumOuts];
+		for (UInt32 i = 0; i < UInt32(Kernel::kNumIns); ++i)
+			inBufs[i] = (const Float32 *)src->mBuffers[i].mData;
+		for (UInt32 j = 0; j < UInt32(Kernel::kNumOuts); ++j) {
+			outBufs[j] = (Float32 *)dest->mBuffers[j].mData;
+			dest->mBuffers[j].mDataByteSize = nFrames * sizeof(Float32);
+		}
+		
+		// a local copy, so the compiler knows the outputs can't change the gains
+		Float32 g[Kernel::kNumIns * Kernel::kNumOuts];
+		memcpy(g, gains, sizeof(g));
+		
+		Float32 in[Kernel::kNumIns], out[Kernel::kNumOuts];
+		for (UInt32 f = 0; f < nFrames; ++f) {
+			for (UInt32 i = 0; i < UInt32(Kernel::kNumIns); ++i)
+				in[i] = inBufs[i][f];
+			Kernel::Frame(in, out, g);
+			for (UInt32 j = 0; j < UInt32(Kernel::kNumOuts); ++j)
+				outBufs[j][f] = out[j];
+		}
+	}
+	
+	static void	GetTerms(CAMixMap &outTerms)
+	{
+		// run the kernel with every gain 1 on each unit impulse, so the terms are only
+		// written once
+		outTerms = CAMixMap(Kernel::kNumIns, Kernel::kNumOuts);
+		Float32 g[Kernel::kNumIns * Kernel::kNumOuts];
+		for (UInt32 k = 0; k < UInt32(Kernel::kNumIns * Kernel::kNumOuts); ++k)
+			g[k] = 1.f;
+		Float32 in[Kernel::kNumIns], out[Kernel::kNumOuts];
+		for (UInt32 i = 0; i < UInt32(Kernel::kNumIns); ++i) {
+			for (UInt32 k = 0; k < UInt32(Kernel::kNumIns); ++k)
+				in[k] = (k == i) ? 1.f : 0.f;
+			Kernel::Frame(in, out, g);
+			for (UInt32 j = 0; j < UInt32(Kernel::kNumOuts); ++j)
+				outTerms.SetCrossPoint(i, j, (out[j] != 0.f) ? 1.f : 0.f);
+		}
+	}
+};
+
+#endif // __CADownmixKernels_h__
@@ -0,0 +1,361 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+//==================================================================================================
+//	Includes
+//==================================================================================================
+
+//	Self Include
+#include "CAFutex.h"
+
+#if defined(__linux__)
+
+//	PublicUtility Includes
+#include "CAAtomic.h"
+#include "CAGuard.h"
+#include "CAHostTimeBase.h"
+
+//	System Includes
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+//==================================================================================================
+//	Constants
+//==================================================================================================
+
+//	about 5-10 microseconds of spinning on current hardware
+static const SInt32	kMaximumSpinCount	= 2048;
+
+//==================================================================================================
+//	CAFutex
+//==================================================================================================
+
+int	CAFutex::InitializeMutex(pthread_mutex_t& outMutex)
+{
+	pthread_mutexattr_t theAttributes;
+	int theError = pthread_mutexattr_init(&theAttributes);
+	if(theError == 0)
+	{
+		//	fall back to a plain mutex if the kernel doesn't do priority inheritance
+		if(pthread_mutexattr_setprotocol(&theAttributes, PTHREAD_PRIO_INHERIT) != 0)
+		{
+			pthread_mutexattr_setprotocol(&theAttributes, PTHREAD_PRIO_NONE);
+		}
+		theError = pthread_mutex_init(&outMutex, &theAttributes);
+		pthread_mutexattr_destroy(&theAttributes);
+	}
+	return theError;
+}
+
+int	CAFutex::LockMutex(pthread_mutex_t& ioMutex, volatile SInt32& ioSpinCount)
+{
+	int theError = pthread_mutex_trylock(&ioMutex);
+	if((theError == EBUSY) && IsMultiprocessor())
+	{
+		//	spin for up to twice as long as it has recently taken to get the lock
+		SInt32 theSpinLimit = (2 * ioSpinCount) + 16;
+		if(theSpinLimit > kMaximumSpinCount)
+		{
+			theSpinLimit = kMaximumSpinCount;
+		}
+		SInt32 theNumberSpins = 0;
+		while((theError == EBUSY) && (theNumberSpins < theSpinLimit))
+		{
+			Pause();
+			++theNumberSpins;
+			theError = pthread_mutex_trylock(&ioMutex);
+		}
+		
+		//	the spin count is only a hint, so it's updated without being atomic
+		ioSpinCount += (theNumberSpins - ioSpinCount) / 8;
+	}
+	if(theError == EBUSY)
+	{
+		theError = pthread_mutex_lock(&ioMutex);
+	}
+	return theError;
+}
+
+bool	CAFutex::Wait(volatile SInt32* inAddress, SInt32 inValue, const struct timespec* inDeadline)
+{
+	//	returns true if the deadline passed, FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC time
+	long theResult = syscall(SYS_futex, inAddress, FUTEX_WAIT_BITSET_PRIVATE, inValue, inDeadline, NULL, FUTEX_BITSET_MATCH_ANY);
+	return (theResult != 0) && (errno == ETIMEDOUT);
+}
+
+void	CAFutex::Wake(volatile SInt32* inAddress, SInt32 inNumberThreads)
+{
+	syscall(SYS_futex, inAddress, FUTEX_WAKE_PRIVATE, inNumberThreads, NULL, NULL, 0);
+}
+
+void	CAFutex::GetDeadline(UInt64 inNanos, struct timespec& outDeadline)
+{
+	static const UInt64	kNanosPerSecond = 1000000000ULL;
+	clock_gettime(CLOCK_MONOTONIC, &outDeadline);
+	UInt64 theNanos = static_cast<UInt64>(outDeadline.tv_nsec) + (inNanos % kNanosPerSecond);
+	outDeadline.tv_sec += static_cast<time_t>((inNanos / kNanosPerSecond) + (theNanos / kNanosPerSecond));
+	outDeadline.tv_nsec = static_cast<long>(theNanos % kNanosPerSecond);
+}
+
+bool	CAFutex::IsMultiprocessor()
+{
+	//	spinning on a single processor only keeps the owner of the lock from running
+	static SInt32 sNumberProcessors = 0;
+	if(sNumberProcessors == 0)
+	{
+		sNumberProcessors = static_cast<SInt32>(sysconf(_SC_NPROCESSORS_ONLN));
+	}
+	return sNumberProcessors > 1;
+}
+
+void	CAFutex::Pause()
+{
+	#if defined(__i386__) || defined(__x86_64__)
+		__asm__ __volatile__("pause");
+	#elif defined(__arm__) || defined(__aarch64__)
+		__asm__ __volatile__("yield");
+	#endif
+}
+
+//==================================================================================================
+//	CAFutexCondition
+//==================================================================================================
+
+CAFutexCondition::CAFutexCondition()
+:
+	mSequence(0),
+	mNumberSleepers(0),
+	mSpinCount(0)
+{
+}
+
+void	CAFutexCondition::Wait(pthread_mutex_t& ioMutex, volatile SInt32& ioMutexSpinCount)
+{
+	//	the sequence number has to be read while the mutex is still held
+	SInt32 theSequence = mSequence;
+	pthread_mutex_unlock(&ioMutex);
+	WaitForNotification(theSequence, NULL);
+	CAFutex::LockMutex(ioMutex, ioMutexSpinCount);
+}
+
+bool	CAFutexCondition::WaitUntil(pthread_mutex_t& ioMutex, volatile SInt32& ioMutexSpinCount, const struct timespec& inDeadline)
+{
+	SInt32 theSequence = mSequence;
+	pthread_mutex_unlock(&ioMutex);
+	bool theAnswer = WaitForNotification(theSequence, &inDeadline);
+	CAFutex::LockMutex(ioMutex, ioMutexSpinCount);
+	return theAnswer;
+}
+
+void	CAFutexCondition::Notify()
+{
+	//	the increment is a barrier, which the sleeper count has to be read after
+	CAAtomicIncrement32Barrier(&mSequence);
+	if(mNumberSleepers > 0)
+	{
+		CAFutex::Wake(&mSequence, 1);
+	}
+}
+
+void	CAFutexCondition::NotifyAll()
+{
+	CAAtomicIncrement32Barrier(&mSequence);
+	if(mNumberSleepers > 0)
+	{
+		CAFutex::Wake(&mSequence, INT_MAX);
+	}
+}
+
+bool	CAFutexCondition::WaitForNotification(SInt32 inSequence, const struct timespec* inDeadline)
+{
+	//	spin first, since the notification often comes within a few microseconds
+	if(CAFutex::IsMultiprocessor())
+	{
+		SInt32 theSpinLimit = (2 * mSpinCount) + 16;
+		if(theSpinLimit > kMaximumSpinCount)
+		{
+			theSpinLimit = kMaximumSpinCount;
+		}
+		SInt32 theNumberSpins = 0;
+		while((mSequence == inSequence) && (theNumberSpins < theSpinLimit))
+		{
+			CAFutex::Pause();
+			++theNumberSpins;
+		}
+		
+		//	spin longer next time if that worked and less if it didn't
+		if(mSequence != inSequence)
+		{
+			mSpinCount += ((theNumberSpins - mSpinCount) / 8) + 1;
+			return false;
+		}
+		mSpinCount -= (mSpinCount / 8) + ((mSpinCount > 0) ? 1 : 0);
+	}
+	
+	//	the sleeper count has to be incremented before the futex checks the sequence number, so a
+	//	Notify either sees the sleeper or changes the sequence number before the futex checks it
+	bool theAnswer = false;
+	CAAtomicIncrement32Barrier(&mNumberSleepers);
+	while((mSequence == inSequence) && !theAnswer)
+	{
+		theAnswer = CAFutex::Wait(&mSequence, inSequence, inDeadline);
+	}
+	CAAtomicDecrement32Barrier(&mNumberSleepers);
+	return theAnswer && (mSequence == inSequence);
+}
+
+//==================================================================================================
+//	Benchmarks
+//==================================================================================================
+
+struct	CAFutexContentionParameters
+{
+	CAGuard*			mGuard;
+	UInt32				mNumberIterations;
+	volatile SInt32		mNumberThreadsReady;
+	volatile SInt32		mGo;
+	volatile SInt32		mTurn;
+};
+
+bool	CAFutex::MeasureContention(UInt32 inNumberThreads, UInt32 inNumberIterations, ContentionStatistics& outStatistics)
+{
+	if((inNumberThreads == 0) || (inNumberIterations == 0))
+	{
+		return false;
+	}
+	
+	CAGuard theGuard("CAFutex::MeasureContention");
+	CAFutexContentionParameters theParameters = { &theGuard, inNumberIterations, 0, 0, 0 };
+	outStatistics.mNumberThreads = inNumberThreads;
+	
+	//	the uncontended costs
+	UInt64 theStartTime = CAHostTimeBase::GetCurrentTimeInNanos();
+	for(UInt32 theIteration = 0; theIteration < inNumberIterations; ++theIteration)
+	{
+		theGuard.Lock();
+		theGuard.Unlock();
+	}
+	outStatistics.mUncontendedLockNanos = static_cast<Float64>(CAHostTimeBase::GetCurrentTimeInNanos() - theStartTime) / inNumberIterations;
+	
+	theStartTime = CAHostTimeBase::GetCurrentTimeInNanos();
+	for(UInt32 theIteration = 0; theIteration < inNumberIterations; ++theIteration)
+	{
+		theGuard.Notify();
+	}
+	outStatistics.mNotifyNanos = static_cast<Float64>(CAHostTimeBase::GetCurrentTimeInNanos() - theStartTime) / inNumberIterations;
+	
+	//	the contended cost, with all the threads starting at once
+	pthread_t* theThreads = new pthread_t[inNumberThreads];
+	UInt32 theNumberThreads = 0;
+	while((theNumberThreads < inNumberThreads) && (pthread_create(&theThreads[theNumberThreads], NULL, ContentionEntry, &theParameters) == 0))
+	{
+		++theNumberThreads;
+	}
+	while(theParameters.mNumberThreadsReady < static_cast<SInt32>(theNumberThreads))
+	{
+		Pause();
+	}
+	theStartTime = CAHostTimeBase::GetCurrentTimeInNanos();
+	CAAtomicIncrement32Barrier(&theParameters.mGo);
+	for(UInt32 theThreadIndex = 0; theThreadIndex < theNumberThreads; ++theThreadIndex)
+	{
+		pthread_join(theThreads[theThreadIndex], NULL);
+	}
+	outStatistics.mContendedLockNanos = (theNumberThreads > 0) ? static_cast<Float64>(CAHostTimeBase::GetCurrentTimeInNanos() - theStartTime) / (static_cast<Float64>(inNumberIterations) * theNumberThreads) : 0.0;
+	delete[] theThreads;
+	
+	//	the hand off latency, from bouncing the turn back and forth with another thread
+	pthread_t theThread;
+	bool theAnswer = pthread_create(&theThread, NULL, HandOffEntry, &theParameters) == 0;
+	if(theAnswer)
+	{
+		theStartTime = CAHostTimeBase::GetCurrentTimeInNanos();
+		for(UInt32 theIteration = 0; theIteration < inNumberIterations; ++theIteration)
+		{
+			CAGuard::Locker theLocker(theGuard);
+			++theParameters.mTurn;
+			theLocker.NotifyAll();
+			while((theParameters.mTurn & 1) != 0)
+			{
+				theLocker.Wait();
+			}
+		}
+		pthread_join(theThread, NULL);
+		outStatistics.mHandOffMicroseconds = static_cast<Float64>(CAHostTimeBase::GetCurrentTimeInNanos() - theStartTime) / (2000.0 * inNumberIterations);
+	}
+	return theAnswer && (theNumberThreads == inNumberThreads);
+}
+
+void*	CAFutex::ContentionEntry(void* inParameters)
+{
+	CAFutexContentionParameters* theParameters = static_cast<CAFutexContentionParameters*>(inParameters);
+	CAAtomicIncrement32Barrier(&theParameters->mNumberThreadsReady);
+	while(theParameters->mGo == 0)
+	{
+		Pause();
+	}
+	for(UInt32 theIteration = 0; theIteration < theParameters->mNumberIterations; ++theIteration)
+	{
+		theParameters->mGuard->Lock();
+		theParameters->mGuard->Unlock();
+	}
+	return NULL;
+}
+
+void*	CAFutex::HandOffEntry(void* inParameters)
+{
+	CAFutexContentionParameters* theParameters = static_cast<CAFutexContentionParameters*>(inParameters);
+	CAGuard::Locker theLocker(*theParameters->mGuard);
+	for(UInt32 theIteration = 0; theIteration < theParameters->mNumberIterations; ++theIteration)
+	{
+		while((theParameters->mTurn & 1) == 0)
+		{
+			theLocker.Wait();
+		}
+		++theParameters->mTurn;
+		theLocker.NotifyAll();
+	}
+	return NULL;
+}
+
+#endif
@@ -0,0 +1,148 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+#if !defined(__CAFutex_h__)
+#define __CAFutex_h__
+
+//==================================================================================================
+//	Includes
+//==================================================================================================
+
+//	System Includes
+#include <CoreAudio/CoreAudioTypes.h>
+
+#if defined(__linux__)
+
+#include <pthread.h>
+#include <time.h>
+
+//==================================================================================================
+//	CAFutex
+//
+//	These are the Linux primitives CAMutex and CAGuard are built on. Mutexes are pthread mutexes
+//	that use priority inheritance, so a real time thread blocked on a lock held by a lower
+//	priority thread lends that thread its priority instead of waiting behind everything in
+//	between. Uncontended, locking and unlocking one stays in user space. Contended, the locking
+//	thread spins on it for a while before going to sleep in the kernel. How long it spins adapts
+//	to how long it has taken to get the lock by spinning recently.
+//
+//	Deadlines are absolute CLOCK_MONOTONIC times, so a wait that gets interrupted and restarted
+//	doesn't end up longer than asked for.
+//==================================================================================================
+
+class CAFutex
+{
+
+//	Types
+public:
+	struct	ContentionStatistics
+	{
+		UInt32	mNumberThreads;
+		Float64	mUncontendedLockNanos;		//	Lock and Unlock with no other threads around
+		Float64	mContendedLockNanos;		//	Lock and Unlock with all the threads doing the same
+		Float64	mNotifyNanos;				//	Notify with nobody waiting
+		Float64	mHandOffMicroseconds;		//	from Notify to the waiting thread running
+	};
+
+//	Mutexes
+public:
+	static int			InitializeMutex(pthread_mutex_t& outMutex);
+	static int			LockMutex(pthread_mutex_t& ioMutex, volatile SInt32& ioSpinCount);
+
+//	Futexes
+public:
+	static bool			Wait(volatile SInt32* inAddress, SInt32 inValue, const struct timespec* inDeadline);
+	static void			Wake(volatile SInt32* inAddress, SInt32 inNumberThreads);
+	
+	static void			GetDeadline(UInt64 inNanos, struct timespec& outDeadline);
+	static bool			IsMultiprocessor();
+	static void			Pause();
+
+//	Benchmarks
+public:
+	static bool			MeasureContention(UInt32 inNumberThreads, UInt32 inNumberIterations, ContentionStatistics& outStatistics);
+
+//	Implementation
+private:
+	static void*		ContentionEntry(void* inParameters);
+	static void*		HandOffEntry(void* inParameters);
+
+};
+
+//==================================================================================================
+//	CAFutexCondition
+//
+//	A condition variable that goes with a pthread mutex. Every Notify bumps a sequence number that
+//	waiters watch. A waiter spins on the sequence number for a while before sleeping on it in the
+//	kernel, and Notify only makes a system call when a thread is actually asleep. Like a pthread
+//	condition variable, waiters can be woken spuriously and should check their predicate again.
+//==================================================================================================
+
+class CAFutexCondition
+{
+
+//	Construction/Destruction
+public:
+					CAFutexCondition();
+
+//	Operations
+public:
+	void			Wait(pthread_mutex_t& ioMutex, volatile SInt32& ioMutexSpinCount);
+	bool			WaitUntil(pthread_mutex_t& ioMutex, volatile SInt32& ioMutexSpinCount, const struct timespec& inDeadline);
+	
+	void			Notify();
+	void			NotifyAll();
+
+//	Implementation
+private:
+					CAFutexCondition(const CAFutexCondition&);
+	CAFutexCondition&	operator=(const CAFutexCondition&);
+	
+	bool			WaitForNotification(SInt32 inSequence, const struct timespec* inDeadline);
+	
+	volatile SInt32	mSequence;
+	volatile SInt32	mNumberSleepers;
+	volatile SInt32	mSpinCount;
+
+};
+
+#endif
+
+#endif
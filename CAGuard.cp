@@ -49,6 +49,10 @@
 #include "CAException.h"
 #include "CAHostTimeBase.h"
 
+#if defined(__linux__)
+	#include <errno.h>
+#endif
+
 #if CoreAudio_Debug
 //	#define	Log_Ownership		1
 //	#define	Log_WaitOwnership	1
@@ -65,17 +69,25 @@
 CAGuard::CAGuard(const char* inName)
 :
 	mName(inName),
+#if defined(__linux__)
+	mSpinCount(0),
+#endif
 	mOwner(0)
 #if	Log_Average_Latency
 	,mAverageLatencyAccumulator(0.0),
 	mAverageLatencyCount(0)
 #endif
 {
+#if defined(__linux__)
+	OSStatus theError = CAFutex::InitializeMutex(mMutex);
+	ThrowIf(theError != 0, CAException(theError), "CAGuard::CAGuard: Could not init the mutex");
+#else
 	OSStatus theError = pthread_mutex_init(&mMutex, NULL);
 	ThrowIf(theError != 0, CAException(theError), "CAGuard::CAGuard: Could not init the mutex");
 	
 	theError = pthread_cond_init(&mCondVar, NULL);
 	ThrowIf(theError != 0, CAException(theError), "CAGuard::CAGuard: Could not init the cond var");
+#endif
 	
 	mOwner = 0;
 	
@@ -90,7 +102,9 @@ CAGuard::~CAGuard()
 		DebugPrintfRtn(DebugPrintfFile, "%p %.4f: CAGuard::~CAGuard: destroying %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), mName, mOwner);
 	#endif
 	pthread_mutex_destroy(&mMutex);
+#if !defined(__linux__)
 	pthread_cond_destroy(&mCondVar);
+#endif
 }
 
 bool	CAGuard::Lock()
@@ -103,7 +117,11 @@ bool	CAGuard::Lock()
 			DebugPrintfRtn(DebugPrintfFile, "%p %.4f: CAGuard::Lock: thread %p is locking %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), pthread_self(), mName, mOwner);
 		#endif
 
+	#if defined(__linux__)
+		OSStatus theError = CAFutex::LockMutex(mMutex, mSpinCount);
+	#else
 		OSStatus theError = pthread_mutex_lock(&mMutex);
+	#endif
 		ThrowIf(theError != 0, CAException(theError), "CAGuard::Lock: Could not lock the mutex");
 		mOwner = pthread_self();
 		theAnswer = true;
@@ -162,8 +180,12 @@ void	CAGuard::Wait()
 		DebugPrintfRtn(DebugPrintfFile, "%p %.4f: CAGuard::Wait: thread %p is waiting on %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), pthread_self(), mName, mOwner);
 	#endif
 
+#if defined(__linux__)
+	mCondition.Wait(mMutex, mSpinCount);
+#else
 	OSStatus theError = pthread_cond_wait(&mCondVar, &mMutex);
 	ThrowIf(theError != 0, CAException(theError), "CAGuard::Wait: Could not wait for a signal");
+#endif
 	mOwner = pthread_self();
 
 	#if	Log_WaitOwnership
@@ -179,6 +201,11 @@ bool	CAGuard::WaitFor(UInt64 inNanos)
 		DebugMessageN1("CAGuard::WaitFor: waiting %.0f", (Float64)inNanos);
 	#endif
 
+#if defined(__linux__)
+	//	the deadline is absolute, so being woken early and waiting again doesn't stretch the wait
+	struct timespec	theDeadline;
+	CAFutex::GetDeadline(inNanos, theDeadline);
+#else
 	struct timespec	theTimeSpec;
 	static const UInt64	kNanosPerSecond = 1000000000ULL;
 	if(inNanos > kNanosPerSecond)
@@ -191,6 +218,7 @@ bool	CAGuard::WaitFor(UInt64 inNanos)
 		theTimeSpec.tv_sec = 0;
 		theTimeSpec.tv_nsec = inNanos;
 	}
+#endif
 	
 	#if	Log_TimedWaits || Log_Latency || Log_Average_Latency
 		UInt64	theStartNanos = CAHostTimeBase::GetCurrentTimeInNanos();
@@ -202,8 +230,12 @@ bool	CAGuard::WaitFor(UInt64 inNanos)
 		DebugPrintfRtn(DebugPrintfFile, "%p %.4f: CAGuard::WaitFor: thread %p is waiting on %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), pthread_self(), mName, mOwner);
 	#endif
 
+#if defined(__linux__)
+	OSStatus theError = mCondition.WaitUntil(mMutex, mSpinCount, theDeadline) ? ETIMEDOUT : 0;
+#else
 	OSStatus theError = pthread_cond_timedwait_relative_np(&mCondVar, &mMutex, &theTimeSpec);
 	ThrowIf((theError != 0) && (theError != ETIMEDOUT), CAException(theError), "CAGuard::WaitFor: Wait got an error");
+#endif
 	mOwner = pthread_self();
 	
 	#if	Log_TimedWaits || Log_Latency || Log_Average_Latency
@@ -271,8 +303,13 @@ void	CAGuard::Notify()
 		DebugPrintfRtn(DebugPrintfFile, "%p %.4f: CAGuard::Notify: thread %p is notifying %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), pthread_self(), mName, mOwner);
 	#endif
 
+#if defined(__linux__)
+	//	this doesn't make a system call unless a thread is asleep waiting
+	mCondition.Notify();
+#else
 	OSStatus theError = pthread_cond_signal(&mCondVar);
 	ThrowIf(theError != 0, CAException(theError), "CAGuard::Notify: failed");
+#endif
 }
 
 void	CAGuard::NotifyAll()
@@ -281,6 +318,10 @@ void	CAGuard::NotifyAll()
 		DebugPrintfRtn(DebugPrintfFile, "%p %.4f: CAGuard::NotifyAll: thread %p is notifying %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), pthread_self(), mName, mOwner);
 	#endif
 
+#if defined(__linux__)
+	mCondition.NotifyAll();
+#else
 	OSStatus theError = pthread_cond_broadcast(&mCondVar);
 	ThrowIf(theError != 0, CAException(theError), "CAGuard::NotifyAll: failed");
+#endif
 }
@@ -45,7 +45,7 @@
 //	Self Include
 #include "CAGuard.h"
 
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || defined(__linux__)
 	#include <errno.h>
 #endif
 
@@ -79,7 +79,9 @@ CAGuard::CAGuard(const char* inName)
 	mAverageLatencyCount(0)
 #endif
 {
-#if TARGET_OS_MAC
+#if defined(__linux__)
+	//	mCondition needs no setting up
+#elif TARGET_OS_MAC
 	OSStatus theError = pthread_cond_init(&mCondVar, NULL);
 	ThrowIf(theError != 0, CAException(theError), "CAGuard::CAGuard: Could not init the cond var");
 #elif TARGET_OS_WIN32
@@ -90,7 +92,9 @@ CAGuard::CAGuard(const char* inName)
 
 CAGuard::~CAGuard()
 {
-#if TARGET_OS_MAC
+#if defined(__linux__)
+	//	mCondition needs no tearing down
+#elif TARGET_OS_MAC
 	pthread_cond_destroy(&mCondVar);
 #elif TARGET_OS_WIN32
 	if(mEvent != NULL)
@@ -102,7 +106,7 @@ CAGuard::~CAGuard()
 
 void	CAGuard::Wait()
 {
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || defined(__linux__)
 	ThrowIf(!pthread_equal(pthread_self(), mOwner), CAException(1), "CAGuard::Wait: A thread has to have locked a guard before it can wait");
 
 	mOwner = 0;
@@ -111,8 +115,12 @@ void	CAGuard::Wait()
 		DebugPrintfRtn(DebugPrintfFileComma "%p %.4f: CAGuard::Wait: thread %p is waiting on %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), pthread_self(), mName, mOwner);
 	#endif
 
-	OSStatus theError = pthread_cond_wait(&mCondVar, &mMutex);
-	ThrowIf(theError != 0, CAException(theError), "CAGuard::Wait: Could not wait for a signal");
+	#if defined(__linux__)
+		mCondition.Wait(mMutex, mSpinCount);
+	#else
+		OSStatus theError = pthread_cond_wait(&mCondVar, &mMutex);
+		ThrowIf(theError != 0, CAException(theError), "CAGuard::Wait: Could not wait for a signal");
+	#endif
 	mOwner = pthread_self();
 
 	#if	Log_WaitOwnership
@@ -144,25 +152,31 @@ bool	CAGuard::WaitFor(UInt64 inNanos)
 {
 	bool theAnswer = false;
 
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || defined(__linux__)
 	ThrowIf(!pthread_equal(pthread_self(), mOwner), CAException(1), "CAGuard::WaitFor: A thread has to have locked a guard be for it can wait");
 
 	#if	Log_TimedWaits
 		DebugMessageN1("CAGuard::WaitFor: waiting %.0f", (Float64)inNanos);
 	#endif
 
-	struct timespec	theTimeSpec;
-	static const UInt64	kNanosPerSecond = 1000000000ULL;
-	if(inNanos >= kNanosPerSecond)
-	{
-		theTimeSpec.tv_sec = static_cast<UInt32>(inNanos / kNanosPerSecond);
-		theTimeSpec.tv_nsec = static_cast<UInt32>(inNanos % kNanosPerSecond);
-	}
-	else
-	{
-		theTimeSpec.tv_sec = 0;
-		theTimeSpec.tv_nsec = static_cast<UInt32>(inNanos);
-	}
+	#if defined(__linux__)
+		//	the deadline is absolute, so being woken early and waiting again doesn't stretch the wait
+		struct timespec	theDeadline;
+		CAFutex::GetDeadline(inNanos, theDeadline);
+	#else
+		struct timespec	theTimeSpec;
+		static const UInt64	kNanosPerSecond = 1000000000ULL;
+		if(inNanos >= kNanosPerSecond)
+		{
+			theTimeSpec.tv_sec = static_cast<UInt32>(inNanos / kNanosPerSecond);
+			theTimeSpec.tv_nsec = static_cast<UInt32>(inNanos % kNanosPerSecond);
+		}
+		else
+		{
+			theTimeSpec.tv_sec = 0;
+			theTimeSpec.tv_nsec = static_cast<UInt32>(inNanos);
+		}
+	#endif
 	
 	#if	Log_TimedWaits || Log_Latency || Log_Average_Latency
 		UInt64	theStartNanos = CAHostTimeBase::GetCurrentTimeInNanos();
@@ -174,8 +188,12 @@ bool	CAGuard::WaitFor(UInt64 inNanos)
 		DebugPrintfRtn(DebugPrintfFileComma "%p %.4f: CAGuard::WaitFor: thread %p is waiting on %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), pthread_self(), mName, mOwner);
 	#endif
 
-	OSStatus theError = pthread_cond_timedwait_relative_np(&mCondVar, &mMutex, &theTimeSpec);
-	ThrowIf((theError != 0) && (theError != ETIMEDOUT), CAException(theError), "CAGuard::WaitFor: Wait got an error");
+	#if defined(__linux__)
+		OSStatus theError = mCondition.WaitUntil(mMutex, mSpinCount, theDeadline) ? ETIMEDOUT : 0;
+	#else
+		OSStatus theError = pthread_cond_timedwait_relative_np(&mCondVar, &mMutex, &theTimeSpec);
+		ThrowIf((theError != 0) && (theError != ETIMEDOUT), CAException(theError), "CAGuard::WaitFor: Wait got an error");
+	#endif
 	mOwner = pthread_self();
 	
 	#if	Log_TimedWaits || Log_Latency || Log_Average_Latency
@@ -298,13 +316,18 @@ bool	CAGuard::WaitUntil(UInt64 inNanos)
 
 void	CAGuard::Notify()
 {
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || defined(__linux__)
 	#if	Log_WaitOwnership
 		DebugPrintfRtn(DebugPrintfFileComma "%p %.4f: CAGuard::Notify: thread %p is notifying %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), pthread_self(), mName, mOwner);
 	#endif
 
-	OSStatus theError = pthread_cond_signal(&mCondVar);
-	ThrowIf(theError != 0, CAException(theError), "CAGuard::Notify: failed");
+	#if defined(__linux__)
+		//	this doesn't make a system call unless a thread is asleep waiting
+		mCondition.Notify();
+	#else
+		OSStatus theError = pthread_cond_signal(&mCondVar);
+		ThrowIf(theError != 0, CAException(theError), "CAGuard::Notify: failed");
+	#endif
 #elif TARGET_OS_WIN32
 	#if	Log_WaitOwnership
 		DebugPrintfRtn(DebugPrintfFileComma "%lu %.4f: CAGuard::Notify: thread %lu is notifying %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), GetCurrentThreadId(), mName, mOwner);
@@ -316,13 +339,17 @@ void	CAGuard::Notify()
 
 void	CAGuard::NotifyAll()
 {
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || defined(__linux__)
 	#if	Log_WaitOwnership
 		DebugPrintfRtn(DebugPrintfFileComma "%p %.4f: CAGuard::NotifyAll: thread %p is notifying %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), pthread_self(), mName, mOwner);
 	#endif
 
-	OSStatus theError = pthread_cond_broadcast(&mCondVar);
-	ThrowIf(theError != 0, CAException(theError), "CAGuard::NotifyAll: failed");
+	#if defined(__linux__)
+		mCondition.NotifyAll();
+	#else
+		OSStatus theError = pthread_cond_broadcast(&mCondVar);
+		ThrowIf(theError != 0, CAException(theError), "CAGuard::NotifyAll: failed");
+	#endif
 #elif TARGET_OS_WIN32
 	#if	Log_WaitOwnership
 		DebugPrintfRtn(DebugPrintfFileComma "%lu %.4f: CAGuard::NotifyAll: thread %lu is notifying %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), GetCurrentThreadId(), mName, mOwner);
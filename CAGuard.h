@@ -49,6 +49,10 @@
 #include <CoreAudio/CoreAudioTypes.h>
 #include <pthread.h>
 
+#if defined(__linux__)
+	#include "CAFutex.h"
+#endif
+
 #if CoreAudio_Debug
 //	#define	Log_Average_Latency	1
 #endif
@@ -90,7 +94,12 @@ public:
 protected:
 	const char*		mName;
 	pthread_mutex_t	mMutex;
+#if defined(__linux__)
+	CAFutexCondition	mCondition;
+	volatile SInt32		mSpinCount;
+#else
 	pthread_cond_t	mCondVar;
+#endif
 	pthread_t		mOwner;
 #if	Log_Average_Latency
 	Float64			mAverageLatencyAccumulator;
@@ -49,20 +49,273 @@
 #include "CAAutoDisposer.h"
 #include "CADebugMacros.h"
 #include "CAException.h"
+#include "CAHALPropertyBackend.h"
+#include "CAMutex.h"
 #include "CAPropertyAddress.h"
 
+//	Standard Library Includes
+#include <map>
+#include <stdint.h>
+#include <string.h>
+
+//==================================================================================================
+//	CAHALAudioObject::PropertyCache
+//==================================================================================================
+
+struct	CAHALAudioObject::PropertyCache
+{
+	struct	Entry
+	{
+		bool				mHasPropertyIsCached;
+		bool				mHasPropertyIsValid;
+		bool				mHasProperty;
+		bool				mDataIsCached;
+		bool				mDataIsCFType;
+		bool				mDataIsValid;
+		std::vector<UInt8>	mData;
+		
+							Entry() : mHasPropertyIsCached(false), mHasPropertyIsValid(false), mHasProperty(false), mDataIsCached(false), mDataIsCFType(false), mDataIsValid(false), mData() {}
+		
+		bool				HasPropertyIsCached() const { return mHasPropertyIsCached || mDataIsCached; }
+	};
+	typedef std::map<CAPropertyAddress, Entry, CAPropertyAddress::LessThan>	EntryMap;
+	typedef std::map<UInt32, PropertyCache*>									CacheMap;
+	
+							PropertyCache(AudioObjectID inObjectID, CAHALPropertyBackend& inBackend);
+							~PropertyCache();
+	
+	//	The listener is handed the cache's ID rather than the cache, as a notification that is
+	//	already on its way can still arrive after the listener is removed. It looks the ID up and
+	//	holds a reference while it works, so the cache goes away with whichever lets go last.
+	static PropertyCache*	Create(AudioObjectID inObjectID, CAHALPropertyBackend& inBackend);
+	static PropertyCache*	RetainLiveCache(UInt32 inCacheID);
+	static void				Retire(PropertyCache* inCache);
+	static void				Release(PropertyCache* inCache);
+	
+	static bool				IsCacheable(const AudioObjectPropertyAddress& inAddress);
+	static void				ReleaseData(bool inDataIsCFType, const std::vector<UInt8>& inData);
+	static void				InvalidateData(Entry& ioEntry);
+	static void				StoreData(Entry& ioEntry, const std::vector<UInt8>& inData);
+	static bool				CopyData(const std::vector<UInt8>& inData, bool inDataIsCFType, UInt32* outDataSize, UInt32* ioDataSize, void* outData);
+	Entry&					AddCachedProperty(const AudioObjectPropertyAddress& inAddress, bool inDataIsCFType);
+	void					Invalidate(const AudioObjectPropertyAddress& inAddress);
+	
+	CAMutex					mMutex;
+	AudioObjectID			mObjectID;
+	CAHALPropertyBackend&	mBackend;
+	EntryMap				mEntries;
+	UInt64					mGeneration;
+	UInt64					mNumberHits;
+	UInt64					mNumberMisses;
+	UInt32					mCacheID;
+	UInt32					mRetainCount;
+	
+	static CAMutex			sLiveCachesMutex;
+	static CacheMap			sLiveCaches;
+	static UInt32			sNextCacheID;
+};
+
+CAMutex								CAHALAudioObject::PropertyCache::sLiveCachesMutex("CAHALAudioObject::PropertyCache::sLiveCaches");
+CAHALAudioObject::PropertyCache::CacheMap	CAHALAudioObject::PropertyCache::sLiveCaches;
+UInt32								CAHALAudioObject::PropertyCache::sNextCacheID = 1;
+
+CAHALAudioObject::PropertyCache::PropertyCache(AudioObjectID inObjectID, CAHALPropertyBackend& inBackend)
+:
+	mMutex("CAHALAudioObject::PropertyCache"),
+	mObjectID(inObjectID),
+	mBackend(inBackend),
+	mEntries(),
+	mGeneration(0),
+	mNumberHits(0),
+	mNumberMisses(0),
+	mCacheID(0),
+	mRetainCount(1)
+{
+}
+
+CAHALAudioObject::PropertyCache::~PropertyCache()
+{
+	for(EntryMap::iterator theIterator = mEntries.begin(); theIterator != mEntries.end(); ++theIterator)
+	{
+		InvalidateData(theIterator->second);
+	}
+}
+
+CAHALAudioObject::PropertyCache*	CAHALAudioObject::PropertyCache::Create(AudioObjectID inObjectID, CAHALPropertyBackend& inBackend)
+{
+	//	the new cache has one reference, which belongs to the object
+	PropertyCache* theCache = new PropertyCache(inObjectID, inBackend);
+	CAMutex::Locker theLocker(sLiveCachesMutex);
+	theCache->mCacheID = sNextCacheID++;
+	if(sNextCacheID == 0)
+	{
+		sNextCacheID = 1;
+	}
+	sLiveCaches[theCache->mCacheID] = theCache;
+	return theCache;
+}
+
+CAHALAudioObject::PropertyCache*	CAHALAudioObject::PropertyCache::RetainLiveCache(UInt32 inCacheID)
+{
+	//	returns NULL if the cache has been retired
+	PropertyCache* theAnswer = NULL;
+	CAMutex::Locker theLocker(sLiveCachesMutex);
+	CacheMap::iterator theIterator = sLiveCaches.find(inCacheID);
+	if(theIterator != sLiveCaches.end())
+	{
+		theAnswer = theIterator->second;
+		++theAnswer->mRetainCount;
+	}
+	return theAnswer;
+}
+
+void	CAHALAudioObject::PropertyCache::Retire(PropertyCache* inCache)
+{
+	//	no new notification can find the cache after this, and the object lets go of it
+	{
+		CAMutex::Locker theLocker(sLiveCachesMutex);
+		sLiveCaches.erase(inCache->mCacheID);
+	}
+	Release(inCache);
+}
+
+void	CAHALAudioObject::PropertyCache::Release(PropertyCache* inCache)
+{
+	bool theCacheIsUnused = false;
+	{
+		CAMutex::Locker theLocker(sLiveCachesMutex);
+		--inCache->mRetainCount;
+		theCacheIsUnused = inCache->mRetainCount == 0;
+	}
+	if(theCacheIsUnused)
+	{
+		delete inCache;
+	}
+}
+
+bool	CAHALAudioObject::PropertyCache::IsCacheable(const AudioObjectPropertyAddress& inAddress)
+{
+	//	an address with a wildcard in it doesn't name a single property
+	return (inAddress.mSelector != kAudioObjectPropertySelectorWildcard) && (inAddress.mScope != kAudioObjectPropertyScopeWildcard) && (inAddress.mElement != kAudioObjectPropertyElementWildcard);
+}
+
+void	CAHALAudioObject::PropertyCache::ReleaseData(bool inDataIsCFType, const std::vector<UInt8>& inData)
+{
+	//	the cache owns a reference to the CF object in the data of a CF type property
+	if(inDataIsCFType && (inData.size() == sizeof(CFTypeRef)))
+	{
+		CFTypeRef theObject = NULL;
+		memcpy(&theObject, &inData[0], sizeof(CFTypeRef));
+		if(theObject != NULL)
+		{
+			CFRelease(theObject);
+		}
+	}
+}
+
+void	CAHALAudioObject::PropertyCache::InvalidateData(Entry& ioEntry)
+{
+	if(ioEntry.mDataIsValid)
+	{
+		ReleaseData(ioEntry.mDataIsCFType, ioEntry.mData);
+		ioEntry.mData.clear();
+		ioEntry.mDataIsValid = false;
+	}
+}
+
+void	CAHALAudioObject::PropertyCache::StoreData(Entry& ioEntry, const std::vector<UInt8>& inData)
+{
+	InvalidateData(ioEntry);
+	ioEntry.mData = inData;
+	ioEntry.mDataIsValid = true;
+	ioEntry.mHasPropertyIsValid = true;
+	ioEntry.mHasProperty = true;
+}
+
+bool	CAHALAudioObject::PropertyCache::CopyData(const std::vector<UInt8>& inData, bool inDataIsCFType, UInt32* outDataSize, UInt32* ioDataSize, void* outData)
+{
+	//	returns whether or not a reference to a CF object was handed out
+	bool theAnswer = false;
+	UInt32 theDataSize = ToUInt32(inData.size());
+	if(outDataSize != NULL)
+	{
+		*outDataSize = theDataSize;
+	}
+	if(ioDataSize != NULL)
+	{
+		if(*ioDataSize > theDataSize)
+		{
+			*ioDataSize = theDataSize;
+		}
+		if(*ioDataSize > 0)
+		{
+			memcpy(outData, &inData[0], *ioDataSize);
+		}
+		theAnswer = inDataIsCFType && (*ioDataSize == sizeof(CFTypeRef));
+	}
+	return theAnswer;
+}
+
+CAHALAudioObject::PropertyCache::Entry&	CAHALAudioObject::PropertyCache::AddCachedProperty(const AudioObjectPropertyAddress& inAddress, bool inDataIsCFType)
+{
+	Entry& theEntry = mEntries[inAddress];
+	if(!theEntry.mDataIsCached || (theEntry.mDataIsCFType != inDataIsCFType))
+	{
+		InvalidateData(theEntry);
+		theEntry.mDataIsCached = true;
+		theEntry.mDataIsCFType = inDataIsCFType;
+	}
+	return theEntry;
+}
+
+void	CAHALAudioObject::PropertyCache::Invalidate(const AudioObjectPropertyAddress& inAddress)
+{
+	//	bumping the generation keeps fetches that are in flight from storing stale data
+	++mGeneration;
+	for(EntryMap::iterator theIterator = mEntries.begin(); theIterator != mEntries.end(); ++theIterator)
+	{
+		if(CAPropertyAddress::IsCongruentAddress(theIterator->first, inAddress))
+		{
+			InvalidateData(theIterator->second);
+			theIterator->second.mHasPropertyIsValid = false;
+		}
+	}
+}
+
 //==================================================================================================
 //	CAHALAudioObject
 //==================================================================================================
 
+CAHALPropertyBackend*	CAHALAudioObject::sPropertyBackend = NULL;
+
 CAHALAudioObject::CAHALAudioObject(AudioObjectID inObjectID)
 :
-	mObjectID(inObjectID)
+	mObjectID(inObjectID),
+	mPropertyCache(NULL)
+{
+}
+
+CAHALAudioObject::CAHALAudioObject(const CAHALAudioObject& inObject)
+:
+	mObjectID(inObject.mObjectID),
+	mPropertyCache(NULL)
 {
 }
 
+CAHALAudioObject&	CAHALAudioObject::operator=(const CAHALAudioObject& inObject)
+{
+	//	the cache belongs to the object it was enabled on, so it isn't copied
+	if(this != &inObject)
+	{
+		DisablePropertyCache();
+		mObjectID = inObject.mObjectID;
+	}
+	return *this;
+}
+
 CAHALAudioObject::~CAHALAudioObject()
 {
+	DisablePropertyCache();
 }
 
 AudioObjectID	CAHALAudioObject::GetObjectID() const
@@ -72,7 +325,17 @@ AudioObjectID	CAHALAudioObject::GetObjectID() const
 
 void	CAHALAudioObject::SetObjectID(AudioObjectID inObjectID)
 {
-	mObjectID = inObjectID;
+	if(inObjectID != mObjectID)
+	{
+		//	start over with an empty cache for the new object
+		bool theCacheWasEnabled = IsPropertyCacheEnabled();
+		DisablePropertyCache();
+		mObjectID = inObjectID;
+		if(theCacheWasEnabled)
+		{
+			EnablePropertyCache();
+		}
+	}
 }
 
 AudioClassID	CAHALAudioObject::GetClassID() const
@@ -313,13 +576,47 @@ AudioObjectID	CAHALAudioObject::GetOwnedObjectByIndex(AudioClassID inClass, UInt
 
 bool	CAHALAudioObject::HasProperty(const AudioObjectPropertyAddress& inAddress) const
 {
-	return AudioObjectHasProperty(mObjectID, &inAddress);
+	if((mPropertyCache == NULL) || !PropertyCache::IsCacheable(inAddress))
+	{
+		return GetPropertyBackend().HasProperty(mObjectID, inAddress);
+	}
+	
+	//	look in the cache first, if the answer for this address is one that gets cached
+	UInt64 theGeneration = 0;
+	{
+		CAMutex::Locker theLocker(mPropertyCache->mMutex);
+		PropertyCache::EntryMap::const_iterator theIterator = mPropertyCache->mEntries.find(inAddress);
+		if((theIterator == mPropertyCache->mEntries.end()) || !theIterator->second.HasPropertyIsCached())
+		{
+			return mPropertyCache->mBackend.HasProperty(mObjectID, inAddress);
+		}
+		if(theIterator->second.mHasPropertyIsValid)
+		{
+			++mPropertyCache->mNumberHits;
+			return theIterator->second.mHasProperty;
+		}
+		++mPropertyCache->mNumberMisses;
+		theGeneration = mPropertyCache->mGeneration;
+	}
+	
+	//	ask without holding the lock and only remember the answer if nothing changed in the meantime
+	bool theAnswer = mPropertyCache->mBackend.HasProperty(mObjectID, inAddress);
+	{
+		CAMutex::Locker theLocker(mPropertyCache->mMutex);
+		PropertyCache::EntryMap::iterator theIterator = mPropertyCache->mEntries.find(inAddress);
+		if((theGeneration == mPropertyCache->mGeneration) && (theIterator != mPropertyCache->mEntries.end()) && theIterator->second.HasPropertyIsCached())
+		{
+			theIterator->second.mHasPropertyIsValid = true;
+			theIterator->second.mHasProperty = theAnswer;
+		}
+	}
+	return theAnswer;
 }
 
 bool	CAHALAudioObject::IsPropertySettable(const AudioObjectPropertyAddress& inAddress) const
 {
 	Boolean isSettable = false;
-	OSStatus theError = AudioObjectIsPropertySettable(mObjectID, &inAddress, &isSettable);
+	OSStatus theError = GetPropertyBackend().IsPropertySettable(mObjectID, inAddress, isSettable);
 	ThrowIfError(theError, CAException(theError), "CAHALAudioObject::IsPropertySettable: got an error getting info about a property");
 	return isSettable != 0;
 }
@@ -327,31 +624,274 @@ bool	CAHALAudioObject::IsPropertySettable(const AudioObjectPropertyAddress& inAd
 UInt32	CAHALAudioObject::GetPropertyDataSize(const AudioObjectPropertyAddress& inAddress, UInt32 inQualifierDataSize, const void* inQualifierData) const
 {
 	UInt32 theDataSize = 0;
-	OSStatus theError = AudioObjectGetPropertyDataSize(mObjectID, &inAddress, inQualifierDataSize, inQualifierData, &theDataSize);
-	ThrowIfError(theError, CAException(theError), "CAHALAudioObject::GetPropertyDataSize: got an error getting the property data size");
+	if((inQualifierDataSize != 0) || !GetCachedPropertyData(inAddress, &theDataSize, NULL, NULL))
+	{
+		OSStatus theError = GetPropertyBackend().GetPropertyDataSize(mObjectID, inAddress, inQualifierDataSize, inQualifierData, theDataSize);
+		ThrowIfError(theError, CAException(theError), "CAHALAudioObject::GetPropertyDataSize: got an error getting the property data size");
+	}
 	return theDataSize;
 }
 
 void	CAHALAudioObject::GetPropertyData(const AudioObjectPropertyAddress& inAddress, UInt32 inQualifierDataSize, const void* inQualifierData, UInt32& ioDataSize, void* outData) const
 {
-	OSStatus theError = AudioObjectGetPropertyData(mObjectID, &inAddress, inQualifierDataSize, inQualifierData, &ioDataSize, outData);
-	ThrowIfError(theError, CAException(theError), "CAHALAudioObject::GetPropertyData: got an error getting the property data");
+	if((inQualifierDataSize != 0) || !GetCachedPropertyData(inAddress, NULL, &ioDataSize, outData))
+	{
+		OSStatus theError = GetPropertyBackend().GetPropertyData(mObjectID, inAddress, inQualifierDataSize, inQualifierData, ioDataSize, outData);
+		ThrowIfError(theError, CAException(theError), "CAHALAudioObject::GetPropertyData: got an error getting the property data");
+	}
 }
 
 void	CAHALAudioObject::SetPropertyData(const AudioObjectPropertyAddress& inAddress, UInt32 inQualifierDataSize, const void* inQualifierData, UInt32 inDataSize, const void* inData)
 {
-	OSStatus theError = AudioObjectSetPropertyData(mObjectID, &inAddress, inQualifierDataSize, inQualifierData, inDataSize, inData);
+	OSStatus theError = GetPropertyBackend().SetPropertyData(mObjectID, inAddress, inQualifierDataSize, inQualifierData, inDataSize, inData);
 	ThrowIfError(theError, CAException(theError), "CAHALAudioObject::SetPropertyData: got an error setting the property data");
+	
+	//	don't wait for the notification to stop handing out the old value
+	if(mPropertyCache != NULL)
+	{
+		InvalidatePropertyCache(inAddress);
+	}
 }
 
 void	CAHALAudioObject::AddPropertyListener(const AudioObjectPropertyAddress& inAddress, AudioObjectPropertyListenerProc inListenerProc, void* inClientData)
 {
-	OSStatus theError = AudioObjectAddPropertyListener(mObjectID, &inAddress, inListenerProc, inClientData);
+	OSStatus theError = GetPropertyBackend().AddPropertyListener(mObjectID, inAddress, inListenerProc, inClientData);
 	ThrowIfError(theError, CAException(theError), "CAHALAudioObject::AddPropertyListener: got an error adding a property listener");
 }
 
 void	CAHALAudioObject::RemovePropertyListener(const AudioObjectPropertyAddress& inAddress, AudioObjectPropertyListenerProc inListenerProc, void* inClientData)
 {
-	OSStatus theError = AudioObjectRemovePropertyListener(mObjectID, &inAddress, inListenerProc, inClientData);
+	OSStatus theError = GetPropertyBackend().RemovePropertyListener(mObjectID, inAddress, inListenerProc, inClientData);
 	ThrowIfError(theError, CAException(theError), "CAHALAudioObject::RemovePropertyListener: got an error removing a property listener");
 }
+
+CAHALPropertyBackend&	CAHALAudioObject::GetPropertyBackend()
+{
+	return (sPropertyBackend != NULL) ? *sPropertyBackend : CAHALPropertyBackend::GetHALBackend();
+}
+
+void	CAHALAudioObject::SetPropertyBackend(CAHALPropertyBackend* inBackend)
+{
+	//	passing NULL goes back to using the HAL
+	sPropertyBackend = inBackend;
+}
+
+void	CAHALAudioObject::EnablePropertyCache()
+{
+	if(mPropertyCache == NULL)
+	{
+		//	one listener for all the properties of the object keeps the whole cache up to date
+		CAHALPropertyBackend& theBackend = GetPropertyBackend();
+		PropertyCache* theCache = PropertyCache::Create(mObjectID, theBackend);
+		CAPropertyAddress theAddress(kAudioObjectPropertySelectorWildcard, kAudioObjectPropertyScopeWildcard, kAudioObjectPropertyElementWildcard);
+		OSStatus theError = theBackend.AddPropertyListener(mObjectID, theAddress, PropertyCacheListener, reinterpret_cast<void*>(static_cast<uintptr_t>(theCache->mCacheID)));
+		if(theError != 0)
+		{
+			PropertyCache::Retire(theCache);
+		}
+		ThrowIfError(theError, CAException(theError), "CAHALAudioObject::EnablePropertyCache: got an error adding the property listener");
+		mPropertyCache = theCache;
+	}
+}
+
+void	CAHALAudioObject::DisablePropertyCache()
+{
+	if(mPropertyCache != NULL)
+	{
+		CAPropertyAddress theAddress(kAudioObjectPropertySelectorWildcard, kAudioObjectPropertyScopeWildcard, kAudioObjectPropertyElementWildcard);
+		mPropertyCache->mBackend.RemovePropertyListener(mPropertyCache->mObjectID, theAddress, PropertyCacheListener, reinterpret_cast<void*>(static_cast<uintptr_t>(mPropertyCache->mCacheID)));
+		
+		//	a notification in flight may still be using the cache, in which case it deletes it
+		PropertyCache::Retire(mPropertyCache);
+		mPropertyCache = NULL;
+	}
+}
+
+void	CAHALAudioObject::CacheHasProperty(const AudioObjectPropertyAddress& inAddress)
+{
+	ThrowIfNULL(mPropertyCache, CAException(kAudioHardwareIllegalOperationError), "CAHALAudioObject::CacheHasProperty: the property cache isn't enabled");
+	ThrowIf(!PropertyCache::IsCacheable(inAddress), CAException(kAudioHardwareIllegalOperationError), "CAHALAudioObject::CacheHasProperty: can't cache a wildcard address");
+	CAMutex::Locker theLocker(mPropertyCache->mMutex);
+	mPropertyCache->mEntries[inAddress].mHasPropertyIsCached = true;
+}
+
+void	CAHALAudioObject::CacheProperty(const AudioObjectPropertyAddress& inAddress, bool inDataIsCFType)
+{
+	ThrowIfNULL(mPropertyCache, CAException(kAudioHardwareIllegalOperationError), "CAHALAudioObject::CacheProperty: the property cache isn't enabled");
+	ThrowIf(!PropertyCache::IsCacheable(inAddress), CAException(kAudioHardwareIllegalOperationError), "CAHALAudioObject::CacheProperty: can't cache a wildcard address");
+	CAMutex::Locker theLocker(mPropertyCache->mMutex);
+	mPropertyCache->AddCachedProperty(inAddress, inDataIsCFType);
+}
+
+void	CAHALAudioObject::PrefetchProperties(UInt32 inNumberAddresses, const AudioObjectPropertyAddress* inAddresses, bool inDataIsCFType)
+{
+	ThrowIfNULL(mPropertyCache, CAException(kAudioHardwareIllegalOperationError), "CAHALAudioObject::PrefetchProperties: the property cache isn't enabled");
+	
+	//	mark all the properties as cached and make the requests for the ones that aren't there yet
+	CAHALPropertyBackend::PropertyRequestList theRequests;
+	UInt64 theGeneration = 0;
+	{
+		CAMutex::Locker theLocker(mPropertyCache->mMutex);
+		for(UInt32 theAddressIndex = 0; theAddressIndex < inNumberAddresses; ++theAddressIndex)
+		{
+			ThrowIf(!PropertyCache::IsCacheable(inAddresses[theAddressIndex]), CAException(kAudioHardwareIllegalOperationError), "CAHALAudioObject::PrefetchProperties: can't cache a wildcard address");
+			PropertyCache::Entry& theEntry = mPropertyCache->AddCachedProperty(inAddresses[theAddressIndex], inDataIsCFType);
+			if(!theEntry.mDataIsValid)
+			{
+				theRequests.push_back(CAHALPropertyBackend::PropertyRequest(inAddresses[theAddressIndex]));
+			}
+		}
+		theGeneration = mPropertyCache->mGeneration;
+	}
+	
+	//	get them all in one go
+	if(!theRequests.empty())
+	{
+		mPropertyCache->mBackend.GetPropertyDataForAddresses(mObjectID, theRequests);
+		
+		CAMutex::Locker theLocker(mPropertyCache->mMutex);
+		for(CAHALPropertyBackend::PropertyRequestList::const_iterator theRequest = theRequests.begin(); theRequest != theRequests.end(); ++theRequest)
+		{
+			bool theDataIsFetched = theRequest->mHasProperty && (theRequest->mError == 0);
+			bool theDataIsStored = false;
+			if(theGeneration == mPropertyCache->mGeneration)
+			{
+				PropertyCache::Entry& theEntry = mPropertyCache->mEntries[theRequest->mAddress];
+				if(theDataIsFetched && theEntry.mDataIsCached && (theEntry.mDataIsCFType == inDataIsCFType))
+				{
+					PropertyCache::StoreData(theEntry, theRequest->mData);
+					theDataIsStored = true;
+				}
+				else
+				{
+					theEntry.mHasPropertyIsValid = true;
+					theEntry.mHasProperty = theRequest->mHasProperty;
+				}
+			}
+			if(theDataIsFetched && !theDataIsStored)
+			{
+				PropertyCache::ReleaseData(inDataIsCFType, theRequest->mData);
+			}
+		}
+	}
+}
+
+void	CAHALAudioObject::InvalidatePropertyCache(const AudioObjectPropertyAddress& inAddress)
+{
+	if(mPropertyCache != NULL)
+	{
+		CAMutex::Locker theLocker(mPropertyCache->mMutex);
+		mPropertyCache->Invalidate(inAddress);
+	}
+}
+
+void	CAHALAudioObject::GetPropertyCacheStatistics(UInt64& outNumberHits, UInt64& outNumberMisses) const
+{
+	outNumberHits = 0;
+	outNumberMisses = 0;
+	if(mPropertyCache != NULL)
+	{
+		CAMutex::Locker theLocker(mPropertyCache->mMutex);
+		outNumberHits = mPropertyCache->mNumberHits;
+		outNumberMisses = mPropertyCache->mNumberMisses;
+	}
+}
+
+bool	CAHALAudioObject::GetCachedPropertyData(const AudioObjectPropertyAddress& inAddress, UInt32* outDataSize, UInt32* ioDataSize, void* outData) const
+{
+	//	returns false if the property isn't one whose data is cached
+	if((mPropertyCache == NULL) || !PropertyCache::IsCacheable(inAddress))
+	{
+		return false;
+	}
+	
+	UInt64 theGeneration = 0;
+	bool theDataIsCFType = false;
+	{
+		CAMutex::Locker theLocker(mPropertyCache->mMutex);
+		PropertyCache::EntryMap::const_iterator theIterator = mPropertyCache->mEntries.find(inAddress);
+		if((theIterator == mPropertyCache->mEntries.end()) || !theIterator->second.mDataIsCached)
+		{
+			return false;
+		}
+		
+		const PropertyCache::Entry& theEntry = theIterator->second;
+		if(theEntry.mDataIsValid)
+		{
+			++mPropertyCache->mNumberHits;
+			if(PropertyCache::CopyData(theEntry.mData, theEntry.mDataIsCFType, outDataSize, ioDataSize, outData))
+			{
+				//	the caller gets its own reference
+				CFTypeRef theObject = NULL;
+				memcpy(&theObject, outData, sizeof(CFTypeRef));
+				if(theObject != NULL)
+				{
+					CFRetain(theObject);
+				}
+			}
+			return true;
+		}
+		++mPropertyCache->mNumberMisses;
+		theGeneration = mPropertyCache->mGeneration;
+		theDataIsCFType = theEntry.mDataIsCFType;
+	}
+	
+	//	fetch the whole value without holding the lock, even if the caller only wants part of it
+	UInt32 theDataSize = 0;
+	OSStatus theError = mPropertyCache->mBackend.GetPropertyDataSize(mObjectID, inAddress, 0, NULL, theDataSize);
+	ThrowIfError(theError, CAException(theError), "CAHALAudioObject::GetCachedPropertyData: got an error getting the property data size");
+	std::vector<UInt8> theData(theDataSize);
+	theError = mPropertyCache->mBackend.GetPropertyData(mObjectID, inAddress, 0, NULL, theDataSize, theData.empty() ? NULL : &theData[0]);
+	ThrowIfError(theError, CAException(theError), "CAHALAudioObject::GetCachedPropertyData: got an error getting the property data");
+	theData.resize(theDataSize);
+	
+	//	only keep the value if nothing changed while it was being fetched
+	bool theDataIsStored = false;
+	{
+		CAMutex::Locker theLocker(mPropertyCache->mMutex);
+		if(theGeneration == mPropertyCache->mGeneration)
+		{
+			PropertyCache::Entry& theEntry = mPropertyCache->mEntries[inAddress];
+			if(theEntry.mDataIsCached && (theEntry.mDataIsCFType == theDataIsCFType))
+			{
+				PropertyCache::StoreData(theEntry, theData);
+				theDataIsStored = true;
+			}
+		}
+	}
+	
+	//	the fetched reference to a CF object goes to the cache if it kept it and to the caller if not
+	bool theObjectWasHandedOut = PropertyCache::CopyData(theData, theDataIsCFType, outDataSize, ioDataSize, outData);
+	if(theDataIsStored && theObjectWasHandedOut)
+	{
+		CFTypeRef theObject = NULL;
+		memcpy(&theObject, outData, sizeof(CFTypeRef));
+		if(theObject != NULL)
+		{
+			CFRetain(theObject);
+		}
+	}
+	else if(!theDataIsStored && !theObjectWasHandedOut)
+	{
+		PropertyCache::ReleaseData(theDataIsCFType, theData);
+	}
+	return true;
+}
+
+OSStatus	CAHALAudioObject::PropertyCacheListener(AudioObjectID /*inObjectID*/, UInt32 inNumberAddresses, const AudioObjectPropertyAddress inAddresses[], void* inClientData)
+{
+	//	the cache may have been retired since the notification was sent
+	PropertyCache* theCache = PropertyCache::RetainLiveCache(static_cast<UInt32>(reinterpret_cast<uintptr_t>(inClientData)));
+	if(theCache != NULL)
+	{
+		{
+			CAMutex::Locker theLocker(theCache->mMutex);
+			for(UInt32 theAddressIndex = 0; theAddressIndex < inNumberAddresses; ++theAddressIndex)
+			{
+				theCache->Invalidate(inAddresses[theAddressIndex]);
+			}
+		}
+		PropertyCache::Release(theCache);
+	}
+	return 0;
+}
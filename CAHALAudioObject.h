@@ -57,8 +57,25 @@
 	#include <CoreFoundation.h>
 #endif
 
+//==================================================================================================
+//	Types
+//==================================================================================================
+
+class	CAHALPropertyBackend;
+
 //==================================================================================================
 //	CAHALAudioObject
+//
+//	All the property calls go through the CAHALPropertyBackend set with SetPropertyBackend, which
+//	is the HAL unless something else has been put in its place.
+//
+//	An object can optionally keep a cache of its properties, which is kept up to date with a
+//	listener for all of them. Nothing is cached until asked for. The answer from HasProperty is
+//	cached for the addresses passed to CacheHasProperty and for those whose data is cached. The
+//	data of a property is only cached for the addresses passed to CacheProperty or
+//	PrefetchProperties and only when no qualifier is used. Properties whose data is a CF object
+//	need to say so, as the cache then hands out a new reference each time. Properties that take
+//	input in their data, such as the ones using AudioValueTranslation, must never be cached.
 //==================================================================================================
 
 class CAHALAudioObject
@@ -67,6 +84,8 @@ class CAHALAudioObject
 //	Construction/Destruction
 public:
 								CAHALAudioObject(AudioObjectID inObjectID);
+								CAHALAudioObject(const CAHALAudioObject& inObject);
+	CAHALAudioObject&			operator=(const CAHALAudioObject& inObject);
 	virtual						~CAHALAudioObject();
 
 //	Attributes
@@ -122,9 +141,33 @@ public:
 	void						AddPropertyListener(const AudioObjectPropertyAddress& inAddress, AudioObjectPropertyListenerProc inListenerProc, void* inClientData);
 	void						RemovePropertyListener(const AudioObjectPropertyAddress& inAddress, AudioObjectPropertyListenerProc inListenerProc, void* inClientData);
 
+	static CAHALPropertyBackend&	GetPropertyBackend();
+	static void					SetPropertyBackend(CAHALPropertyBackend* inBackend);
+
+//	Property Cache
+public:
+	void						EnablePropertyCache();
+	void						DisablePropertyCache();
+	bool						IsPropertyCacheEnabled() const { return mPropertyCache != NULL; }
+	
+	void						CacheHasProperty(const AudioObjectPropertyAddress& inAddress);
+	void						CacheProperty(const AudioObjectPropertyAddress& inAddress, bool inDataIsCFType = false);
+	void						PrefetchProperties(UInt32 inNumberAddresses, const AudioObjectPropertyAddress* inAddresses, bool inDataIsCFType = false);
+	void						InvalidatePropertyCache(const AudioObjectPropertyAddress& inAddress);
+	
+	void						GetPropertyCacheStatistics(UInt64& outNumberHits, UInt64& outNumberMisses) const;
+
 //	Implementation
 protected:
+	struct						PropertyCache;
+	
+	bool						GetCachedPropertyData(const AudioObjectPropertyAddress& inAddress, UInt32* outDataSize, UInt32* ioDataSize, void* outData) const;
+	static OSStatus				PropertyCacheListener(AudioObjectID inObjectID, UInt32 inNumberAddresses, const AudioObjectPropertyAddress inAddresses[], void* inClientData);
+	
 	AudioObjectID				mObjectID;
+	PropertyCache*				mPropertyCache;
+	
+	static CAHALPropertyBackend*	sPropertyBackend;
 
 };
 
@@ -0,0 +1,347 @@
+/*	Copyright: 	 Copyright 2003 Apple Computer, Inc. All rights reserved.
+
+	Disclaimer:	IMPORTANT:  This Apple software is supplied to you by Apple Computer, Inc.
+			("Apple") in consideration of your agreement to the following terms, and your
+			use, installation, modification or redistribution of this Apple software
+			constitutes acceptance of these terms.  If you do not agree with these terms,
+			please do not use, install, modify or redistribute this Apple software.
+
+			In consideration of your agreement to abide by the following terms, and subject
+			to these terms, Apple grants you a personal, non-exclusive license, under Apples
+			copyrights in this original Apple software (the "Apple Software"), to use,
+			reproduce, modify and redistribute the Apple Software, with or without
+			modifications, in source and/or binary forms; provided that if you redistribute
+			the Apple Software in its entirety and without modifications, you must retain
+			this notice and the following text and disclaimers in all such redistributions of
+			the Apple Software.  Neither the name, trademarks, service marks or logos of
+			Apple Computer, Inc. may be used to endorse or promote products derived from the
+			Apple Software without specific prior written permission from Apple.  Except as
+			expressly stated in this notice, no other rights or licenses, express or implied,
+			are granted by Apple herein, including but not limited to any patent rights that
+			may be infringed by your derivative works or by other works in which the Apple
+			Software may be incorporated.
+
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+			WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+			WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+			PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION ALONE OR IN
+			COMBINATION WITH YOUR PRODUCTS.
+
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+			CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+			GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+			ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION AND/OR DISTRIBUTION
+			OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER UNDER THEORY OF CONTRACT, TORT
+			(INCLUDING NEGLIGENCE), STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN
+			ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CAHALIOCycleLoadStatistics.cpp
+
+=============================================================================*/
+
+//=============================================================================
+//	Includes
+//=============================================================================
+
+//	Self Include
+#include "CAHALIOCycleLoadStatistics.h"
+
+//	Standard Library Includes
+#include <string.h>
+
+//=============================================================================
+//	CAHALTelemetryHistogram
+//=============================================================================
+
+CAHALTelemetryHistogram::CAHALTelemetryHistogram()
+{
+	Clear();
+}
+
+void	CAHALTelemetryHistogram::Record(UInt64 inValue)
+{
+	UInt64 theLargestValue = (1ULL << kMaximumValueBits) - 1;
+	if(inValue > theLargestValue)
+	{
+		inValue = theLargestValue;
+	}
+	++mCounts[GetBucketIndex(inValue)];
+	++mTotalCount;
+	if(inValue > mMaximum)
+	{
+		mMaximum = inValue;
+	}
+}
+
+void	CAHALTelemetryHistogram::Add(const CAHALTelemetryHistogram& inHistogram)
+{
+	for(UInt32 theBucketIndex = 0; theBucketIndex < kNumberBuckets; ++theBucketIndex)
+	{
+		mCounts[theBucketIndex] += inHistogram.mCounts[theBucketIndex];
+	}
+	mTotalCount += inHistogram.mTotalCount;
+	if(inHistogram.mMaximum > mMaximum)
+	{
+		mMaximum = inHistogram.mMaximum;
+	}
+}
+
+void	CAHALTelemetryHistogram::Clear()
+{
+	memset(mCounts, 0, sizeof(mCounts));
+	mTotalCount = 0;
+	mMaximum = 0;
+}
+
+UInt64	CAHALTelemetryHistogram::GetValueAtPercentile(Float64 inPercentile) const
+{
+	UInt64 theAnswer = 0;
+	if(mTotalCount > 0)
+	{
+		//	find the bucket holding the value that this percentage of the values are at or below
+		UInt64 theTargetCount = (UInt64)((inPercentile / 100.0) * mTotalCount + 0.5);
+		if(theTargetCount < 1)
+		{
+			theTargetCount = 1;
+		}
+		UInt64 theCount = 0;
+		UInt32 theBucketIndex = 0;
+		while((theBucketIndex < kNumberBuckets) && (theCount + mCounts[theBucketIndex] < theTargetCount))
+		{
+			theCount += mCounts[theBucketIndex];
+			++theBucketIndex;
+		}
+		theAnswer = (theBucketIndex < kNumberBuckets) ? GetHighestValueInBucket(theBucketIndex) : mMaximum;
+		if(theAnswer > mMaximum)
+		{
+			theAnswer = mMaximum;
+		}
+	}
+	return theAnswer;
+}
+
+UInt32	CAHALTelemetryHistogram::GetBucketIndex(UInt64 inValue)
+{
+	UInt32 theAnswer = (UInt32)inValue;
+	if(inValue >= kSubBucketCount)
+	{
+		//	the top kSubBucketBits bits of the value pick the bucket within its power of two
+		UInt32 theHighestBit = kSubBucketBits;
+		while((inValue >> (theHighestBit + 1)) != 0)
+		{
+			++theHighestBit;
+		}
+		UInt32 theShift = theHighestBit - (kSubBucketBits - 1);
+		UInt32 theSubBucket = (UInt32)(inValue >> theShift);
+		theAnswer = kSubBucketCount + ((theShift - 1) * kSubBucketHalfCount) + (theSubBucket - kSubBucketHalfCount);
+	}
+	return theAnswer;
+}
+
+UInt64	CAHALTelemetryHistogram::GetHighestValueInBucket(UInt32 inBucketIndex)
+{
+	UInt64 theAnswer = inBucketIndex;
+	if(inBucketIndex >= kSubBucketCount)
+	{
+		UInt32 theShift = ((inBucketIndex - kSubBucketCount) / kSubBucketHalfCount) + 1;
+		UInt64 theSubBucket = ((inBucketIndex - kSubBucketCount) % kSubBucketHalfCount) + kSubBucketHalfCount;
+		theAnswer = ((theSubBucket + 1) << theShift) - 1;
+	}
+	return theAnswer;
+}
+
+//=============================================================================
+//	CAHALIOCycleLoadStatistics
+//=============================================================================
+
+//	loads are recorded in parts per million and jitter in nanoseconds
+static const Float64	kComponentRecordingScale[CAHALIOCycleLoadStatistics::kNumberComponents] = { 1000000.0, 1000000.0, 1000000.0, 1000000.0, 1000000.0, 1000.0 };
+
+CAHALIOCycleLoadStatistics::CAHALIOCycleLoadStatistics()
+:
+	mSliceNanos(1000000000ULL),
+	mNumberSlices(kDefaultNumberWindowSlices),
+	mCurrentSlice(0),
+	mCurrentSliceStart(0),
+	mWindowIsStarted(false),
+	mNumberIOCycles(0),
+	mSlices(kDefaultNumberWindowSlices * kNumberComponents)
+{
+}
+
+CAHALIOCycleLoadStatistics::~CAHALIOCycleLoadStatistics()
+{
+}
+
+void	CAHALIOCycleLoadStatistics::SetWindow(UInt64 inWindowNanos, UInt32 inNumberSlices)
+{
+	if(inNumberSlices < 1)
+	{
+		inNumberSlices = 1;
+	}
+	if(inNumberSlices > kMaximumNumberWindowSlices)
+	{
+		inNumberSlices = kMaximumNumberWindowSlices;
+	}
+	mNumberSlices = inNumberSlices;
+	mSliceNanos = inWindowNanos / inNumberSlices;
+	if(mSliceNanos < 1)
+	{
+		mSliceNanos = 1;
+	}
+
+	//	the old slices don't line up with the new ones, so start the window over
+	mSlices.assign(mNumberSlices * kNumberComponents, CAHALTelemetryHistogram());
+	mCurrentSlice = 0;
+	mWindowIsStarted = false;
+}
+
+void	CAHALIOCycleLoadStatistics::AddIOCycle(UInt64 inStartNanos, const Float64 inValues[kNumberComponents], UInt32 inComponentsPresent)
+{
+	AdvanceWindow(inStartNanos);
+
+	for(UInt32 theComponent = 0; theComponent < kNumberComponents; ++theComponent)
+	{
+		if((inComponentsPresent & (1UL << theComponent)) != 0)
+		{
+			//	the histograms only hold magnitudes
+			Float64 theValue = inValues[theComponent] * kComponentRecordingScale[theComponent];
+			if(theValue < 0)
+			{
+				theValue = -theValue;
+			}
+			UInt64 theRecordedValue = (UInt64)(theValue + 0.5);
+			mLifetime[theComponent].Record(theRecordedValue);
+			GetSlice(mCurrentSlice, theComponent).Record(theRecordedValue);
+		}
+	}
+	++mNumberIOCycles;
+}
+
+void	CAHALIOCycleLoadStatistics::Clear()
+{
+	for(UInt32 theComponent = 0; theComponent < kNumberComponents; ++theComponent)
+	{
+		mLifetime[theComponent].Clear();
+	}
+	SetWindow(GetWindowNanos(), mNumberSlices);
+	mNumberIOCycles = 0;
+}
+
+void	CAHALIOCycleLoadStatistics::GetWindowSummary(UInt32 inComponent, Summary& outSummary) const
+{
+	memset(&outSummary, 0, sizeof(Summary));
+	if(inComponent < kNumberComponents)
+	{
+		CAHALTelemetryHistogram theWindow;
+		for(UInt32 theSliceIndex = 0; theSliceIndex < mNumberSlices; ++theSliceIndex)
+		{
+			theWindow.Add(mSlices[(theSliceIndex * kNumberComponents) + inComponent]);
+		}
+		Summarize(theWindow, inComponent, outSummary);
+	}
+}
+
+void	CAHALIOCycleLoadStatistics::GetLifetimeSummary(UInt32 inComponent, Summary& outSummary) const
+{
+	memset(&outSummary, 0, sizeof(Summary));
+	if(inComponent < kNumberComponents)
+	{
+		Summarize(mLifetime[inComponent], inComponent, outSummary);
+	}
+}
+
+void	CAHALIOCycleLoadStatistics::WriteCSV(FILE* inFile) const
+{
+	fprintf(inFile, "component,range,count,p50,p99,p99.9,max\n");
+	for(UInt32 theComponent = 0; theComponent < kNumberComponents; ++theComponent)
+	{
+		Summary theSummary;
+		GetWindowSummary(theComponent, theSummary);
+		fprintf(inFile, "%s,window,%llu,%.6f,%.6f,%.6f,%.6f\n", GetComponentName(theComponent), (unsigned long long)theSummary.mCount, theSummary.mP50, theSummary.mP99, theSummary.mP999, theSummary.mMaximum);
+		GetLifetimeSummary(theComponent, theSummary);
+		fprintf(inFile, "%s,lifetime,%llu,%.6f,%.6f,%.6f,%.6f\n", GetComponentName(theComponent), (unsigned long long)theSummary.mCount, theSummary.mP50, theSummary.mP99, theSummary.mP999, theSummary.mMaximum);
+	}
+}
+
+void	CAHALIOCycleLoadStatistics::WriteJSON(FILE* inFile) const
+{
+	fprintf(inFile, "{\n\t\"window_seconds\": %.3f,\n\t\"io_cycles\": %llu,\n\t\"components\": {\n", GetWindowNanos() / 1000000000.0, (unsigned long long)mNumberIOCycles);
+	for(UInt32 theComponent = 0; theComponent < kNumberComponents; ++theComponent)
+	{
+		Summary theWindowSummary;
+		Summary theLifetimeSummary;
+		GetWindowSummary(theComponent, theWindowSummary);
+		GetLifetimeSummary(theComponent, theLifetimeSummary);
+		fprintf(inFile, "\t\t\"%s\": {\n", GetComponentName(theComponent));
+		fprintf(inFile, "\t\t\t\"window\": { \"count\": %llu, \"p50\": %.6f, \"p99\": %.6f, \"p99.9\": %.6f, \"max\": %.6f },\n", (unsigned long long)theWindowSummary.mCount, theWindowSummary.mP50, theWindowSummary.mP99, theWindowSummary.mP999, theWindowSummary.mMaximum);
+		fprintf(inFile, "\t\t\t\"lifetime\": { \"count\": %llu, \"p50\": %.6f, \"p99\": %.6f, \"p99.9\": %.6f, \"max\": %.6f }\n", (unsigned long long)theLifetimeSummary.mCount, theLifetimeSummary.mP50, theLifetimeSummary.mP99, theLifetimeSummary.mP999, theLifetimeSummary.mMaximum);
+		fprintf(inFile, "\t\t}%s\n", (theComponent + 1 < kNumberComponents) ? "," : "");
+	}
+	fprintf(inFile, "\t}\n}\n");
+}
+
+const char*	CAHALIOCycleLoadStatistics::GetComponentName(UInt32 inComponent)
+{
+	const char* theAnswer = "unknown";
+	switch(inComponent)
+	{
+		case kComponentTotalLoad:
+			theAnswer = "total_load";
+			break;
+		case kComponentSchedulingLoad:
+			theAnswer = "scheduling_load";
+			break;
+		case kComponentReadLoad:
+			theAnswer = "read_load";
+			break;
+		case kComponentIOProcLoad:
+			theAnswer = "ioproc_load";
+			break;
+		case kComponentWriteLoad:
+			theAnswer = "write_load";
+			break;
+		case kComponentWakeUpJitter:
+			theAnswer = "wake_up_jitter_us";
+			break;
+	};
+	return theAnswer;
+}
+
+void	CAHALIOCycleLoadStatistics::Summarize(const CAHALTelemetryHistogram& inHistogram, UInt32 inComponent, Summary& outSummary)
+{
+	Float64 theScale = kComponentRecordingScale[inComponent];
+	outSummary.mCount = inHistogram.GetTotalCount();
+	outSummary.mP50 = inHistogram.GetValueAtPercentile(50.0) / theScale;
+	outSummary.mP99 = inHistogram.GetValueAtPercentile(99.0) / theScale;
+	outSummary.mP999 = inHistogram.GetValueAtPercentile(99.9) / theScale;
+	outSummary.mMaximum = inHistogram.GetMaximum() / theScale;
+}
+
+void	CAHALIOCycleLoadStatistics::AdvanceWindow(UInt64 inNanos)
+{
+	if(!mWindowIsStarted)
+	{
+		mCurrentSliceStart = inNanos;
+		mWindowIsStarted = true;
+	}
+	else if(inNanos >= mCurrentSliceStart + mSliceNanos)
+	{
+		//	clear out the slices that have gone by, but no more than the whole window
+		UInt64 theNumberSlicesToAdvance = (inNanos - mCurrentSliceStart) / mSliceNanos;
+		UInt32 theNumberSlicesToClear = (theNumberSlicesToAdvance < mNumberSlices) ? (UInt32)theNumberSlicesToAdvance : mNumberSlices;
+		for(UInt32 theSliceCount = 1; theSliceCount <= theNumberSlicesToClear; ++theSliceCount)
+		{
+			UInt32 theSliceIndex = (mCurrentSlice + theSliceCount) % mNumberSlices;
+			for(UInt32 theComponent = 0; theComponent < kNumberComponents; ++theComponent)
+			{
+				GetSlice(theSliceIndex, theComponent).Clear();
+			}
+		}
+		mCurrentSlice = (UInt32)((mCurrentSlice + theNumberSlicesToAdvance) % mNumberSlices);
+		mCurrentSliceStart += theNumberSlicesToAdvance * mSliceNanos;
+	}
+
+	//	anything that appears to come from before the current slice, such as after a timeline reset, goes in the current slice
+}
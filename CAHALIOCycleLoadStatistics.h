@@ -0,0 +1,188 @@
+/*	Copyright: 	 Copyright 2003 Apple Computer, Inc. All rights reserved.
+
+	Disclaimer:	IMPORTANT:  This Apple software is supplied to you by Apple Computer, Inc.
+			("Apple") in consideration of your agreement to the following terms, and your
+			use, installation, modification or redistribution of this Apple software
+			constitutes acceptance of these terms.  If you do not agree with these terms,
+			please do not use, install, modify or redistribute this Apple software.
+
+			In consideration of your agreement to abide by the following terms, and subject
+			to these terms, Apple grants you a personal, non-exclusive license, under Apples
+			copyrights in this original Apple software (the "Apple Software"), to use,
+			reproduce, modify and redistribute the Apple Software, with or without
+			modifications, in source and/or binary forms; provided that if you redistribute
+			the Apple Software in its entirety and without modifications, you must retain
+			this notice and the following text and disclaimers in all such redistributions of
+			the Apple Software.  Neither the name, trademarks, service marks or logos of
+			Apple Computer, Inc. may be used to endorse or promote products derived from the
+			Apple Software without specific prior written permission from Apple.  Except as
+			expressly stated in this notice, no other rights or licenses, express or implied,
+			are granted by Apple herein, including but not limited to any patent rights that
+			may be infringed by your derivative works or by other works in which the Apple
+			Software may be incorporated.
+
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+			WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+			WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+			PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION ALONE OR IN
+			COMBINATION WITH YOUR PRODUCTS.
+
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+			CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+			GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+			ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION AND/OR DISTRIBUTION
+			OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER UNDER THEORY OF CONTRACT, TORT
+			(INCLUDING NEGLIGENCE), STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN
+			ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CAHALIOCycleLoadStatistics.h
+
+=============================================================================*/
+#if !defined(__CAHALIOCycleLoadStatistics_h__)
+#define __CAHALIOCycleLoadStatistics_h__
+
+//=============================================================================
+//	Includes
+//=============================================================================
+
+//	System Includes
+#include <CoreAudio/CoreAudioTypes.h>
+
+//	Standard Library Includes
+#include <stdio.h>
+#include <vector>
+
+//=============================================================================
+//	CAHALTelemetryHistogram
+//
+//	A fixed size histogram of unsigned integer values in the style of an HDR
+//	histogram. Values below 128 are counted exactly. Above that, each power of
+//	two is split into 64 buckets, so any value reported back is within 1/64 of
+//	what was recorded. Values of 2^40 and up are counted as 2^40 - 1.
+//=============================================================================
+
+class CAHALTelemetryHistogram
+{
+
+//	Construction/Destruction
+public:
+				CAHALTelemetryHistogram();
+
+//	Operations
+public:
+	void		Record(UInt64 inValue);
+	void		Add(const CAHALTelemetryHistogram& inHistogram);
+	void		Clear();
+
+	UInt64		GetTotalCount() const { return mTotalCount; }
+	UInt64		GetMaximum() const { return mMaximum; }
+	UInt64		GetValueAtPercentile(Float64 inPercentile) const;
+
+//	Implementation
+private:
+	enum
+	{
+		kSubBucketBits		= 7,
+		kMaximumValueBits	= 40,
+		kSubBucketCount		= 1 << kSubBucketBits,
+		kSubBucketHalfCount	= kSubBucketCount / 2,
+		kNumberBuckets		= kSubBucketCount + ((kMaximumValueBits - kSubBucketBits) * kSubBucketHalfCount)
+	};
+
+	static UInt32	GetBucketIndex(UInt64 inValue);
+	static UInt64	GetHighestValueInBucket(UInt32 inBucketIndex);
+
+	UInt32		mCounts[kNumberBuckets];
+	UInt64		mTotalCount;
+	UInt64		mMaximum;
+
+};
+
+//=============================================================================
+//	CAHALIOCycleLoadStatistics
+//
+//	This class aggregates the load of IO cycles as they come in. Each component
+//	is kept in a histogram covering everything seen since the last Clear and in
+//	a ring of histograms that together cover a sliding window of time ending at
+//	the most recent IO cycle. The window advances a slice at a time, so it spans
+//	between (slices - 1) / slices and all of the requested length.
+//
+//	Loads are fractions of the IO cycle's period. Wake up jitter is the distance
+//	in microseconds between when the cycle was scheduled to start and when it
+//	actually did, whichever way it went.
+//=============================================================================
+
+class CAHALIOCycleLoadStatistics
+{
+
+//	Constants
+public:
+	enum
+	{
+		kComponentTotalLoad			= 0,
+		kComponentSchedulingLoad	= 1,
+		kComponentReadLoad			= 2,
+		kComponentIOProcLoad		= 3,
+		kComponentWriteLoad			= 4,
+		kComponentWakeUpJitter		= 5,
+		kNumberComponents			= 6
+	};
+
+	enum
+	{
+		kDefaultNumberWindowSlices	= 10,
+		kMaximumNumberWindowSlices	= 100
+	};
+
+	struct	Summary
+	{
+		UInt64	mCount;
+		Float64	mP50;
+		Float64	mP99;
+		Float64	mP999;
+		Float64	mMaximum;
+	};
+
+//	Construction/Destruction
+public:
+					CAHALIOCycleLoadStatistics();
+					~CAHALIOCycleLoadStatistics();
+
+//	Operations
+public:
+	void			SetWindow(UInt64 inWindowNanos, UInt32 inNumberSlices = kDefaultNumberWindowSlices);
+	UInt64			GetWindowNanos() const { return mSliceNanos * mNumberSlices; }
+
+	void			AddIOCycle(UInt64 inStartNanos, const Float64 inValues[kNumberComponents], UInt32 inComponentsPresent);
+	void			Clear();
+
+	UInt64			GetNumberIOCycles() const { return mNumberIOCycles; }
+	void			GetWindowSummary(UInt32 inComponent, Summary& outSummary) const;
+	void			GetLifetimeSummary(UInt32 inComponent, Summary& outSummary) const;
+
+	void			WriteCSV(FILE* inFile) const;
+	void			WriteJSON(FILE* inFile) const;
+
+	static const char*	GetComponentName(UInt32 inComponent);
+
+//	Implementation
+private:
+	typedef std::vector<CAHALTelemetryHistogram>	HistogramList;
+
+	CAHALTelemetryHistogram&	GetSlice(UInt32 inSliceIndex, UInt32 inComponent)	{ return mSlices[(inSliceIndex * kNumberComponents) + inComponent]; }
+	static void		Summarize(const CAHALTelemetryHistogram& inHistogram, UInt32 inComponent, Summary& outSummary);
+	void			AdvanceWindow(UInt64 inNanos);
+
+	UInt64						mSliceNanos;
+	UInt32						mNumberSlices;
+	UInt32						mCurrentSlice;
+	UInt64						mCurrentSliceStart;
+	bool						mWindowIsStarted;
+	UInt64						mNumberIOCycles;
+	CAHALTelemetryHistogram		mLifetime[kNumberComponents];
+	HistogramList				mSlices;
+
+};
+
+#endif
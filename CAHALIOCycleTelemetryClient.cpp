@@ -56,9 +56,7 @@
 #include "CACFMessagePort.h"
 #include "CADebugMacros.h"
 #include "CAException.h"
-
-//	System Includes
-#include <CoreAudio/HostTime.h>
+#include "CAHostTimeBase.h"
 
 //	Standard Library Includes
 #include <math.h>
@@ -82,17 +80,21 @@ static inline SInt64	SubtractUInt64(UInt64 inX, UInt64 inY)
 	return theAnswer;
 }
 
-static inline Float64	ConvertHostTimeToDisplayTime(SInt64 inHostTime)
+static inline Float64	ConvertHostTimeToDisplayTime(SInt64 inHostTime, Float64 inHostTicksPerSecond)
 {
-	//	convert to milliseconds
+	//	convert to milliseconds, with this host's time base unless the times came from a capture
+	UInt64 theHostTime = (inHostTime >= 0) ? inHostTime : -1 * inHostTime;
 	Float64 theAnswer = 0;
-	if(inHostTime >= 0)
+	if(inHostTicksPerSecond > 0)
 	{
-		theAnswer = AudioConvertHostTimeToNanos(inHostTime);
+		theAnswer = static_cast<Float64>(theHostTime) * (1000000000.0 / inHostTicksPerSecond);
 	}
 	else
 	{
-		theAnswer = AudioConvertHostTimeToNanos(-1 * inHostTime);
+		theAnswer = CAHostTimeBase::ConvertToNanos(theHostTime);
+	}
+	if(inHostTime < 0)
+	{
 		theAnswer *= -1;
 	}
 	theAnswer /= 1000000.0;
@@ -102,7 +104,8 @@ static inline Float64	ConvertHostTimeToDisplayTime(SInt64 inHostTime)
 CAHALIOCycleTelemetry::CAHALIOCycleTelemetry()
 :
 	mLastCycleEnd(),
-	mRawEvents()
+	mRawEvents(),
+	mHostTicksPerSecond(0)
 {
 }
 
@@ -173,7 +176,7 @@ Float64	CAHALIOCycleTelemetry::GetDuration() const
 		theEndTime = theEvent.mEventTime;
 	}
 	
-	return ConvertHostTimeToDisplayTime(theEndTime - theStartTime);
+	return ConvertHostTimeToDisplayTime(theEndTime - theStartTime, mHostTicksPerSecond);
 }
 
 Float64	CAHALIOCycleTelemetry::GetRateScalar() const
@@ -325,29 +328,84 @@ bool	CAHALIOCycleTelemetry::GetNextWakeUpTime(AudioTimeStamp& outWakeTime) const
 	return theAnswer;
 }
 
+Float64	CAHALIOCycleTelemetry::GetWakeUpJitter() const
+{
+	//	how far from the intended start time the cycle actually started, in microseconds
+	Float64 theAnswer = 0;
+	if(GetIntendedStartTime() > 0)
+	{
+		theAnswer = ConvertHostTimeToDisplayTime(SubtractUInt64(GetStartTime(), GetIntendedStartTime()), mHostTicksPerSecond) * 1000.0;
+	}
+	return theAnswer;
+}
+
+//	The loads are all expressed as a fraction of the IO cycle's period, which
+//	runs from when this cycle was scheduled to wake up to when the next one is.
+
 Float64	CAHALIOCycleTelemetry::GetTotalLoad() const
 {
-	return 0;
+	Float64 theAnswer = 0;
+	CAHALIOCycleRawTelemetryEvent theEvent;
+	if(GetRawEventByKind(kHALIOCycleTelemetryEventWorkLoopEnd, theEvent))
+	{
+		theAnswer = GetLoad(GetIntendedStartTime(), theEvent.mEventTime);
+	}
+	return theAnswer;
 }
 
 Float64	CAHALIOCycleTelemetry::GetSchedulingLoad() const
 {
-	return 0;
+	return GetLoad(GetIntendedStartTime(), GetStartTime());
 }
 
 Float64	CAHALIOCycleTelemetry::GetReadLoad() const
 {
-	return 0;
+	return GetLoadBetweenEvents(kHALIOCycleTelemetryEventInputReadBegin, kHALIOCycleTelemetryEventInputReadEnd);
 }
 
 Float64	CAHALIOCycleTelemetry::GetIOProcLoad() const
 {
-	return 0;
+	return GetLoadBetweenEvents(kHALIOCycleTelemetryEventIOProcsBegin, kHALIOCycleTelemetryEventIOProcsEnd);
 }
 
 Float64	CAHALIOCycleTelemetry::GetWriteLoad() const
 {
-	return 0;
+	return GetLoadBetweenEvents(kHALIOCycleTelemetryEventOutputWriteBegin, kHALIOCycleTelemetryEventOutputWriteEnd);
+}
+
+UInt64	CAHALIOCycleTelemetry::GetPeriod() const
+{
+	//	the next wake up time is in the second time stamp of the work loop end event
+	UInt64 theAnswer = 0;
+	CAHALIOCycleRawTelemetryEvent theEvent;
+	if((GetIntendedStartTime() > 0) && GetRawEventByKind(kHALIOCycleTelemetryEventWorkLoopEnd, theEvent) && (theEvent.mHostTime2 > GetIntendedStartTime()))
+	{
+		theAnswer = theEvent.mHostTime2 - GetIntendedStartTime();
+	}
+	return theAnswer;
+}
+
+Float64	CAHALIOCycleTelemetry::GetLoad(UInt64 inBeginTime, UInt64 inEndTime) const
+{
+	Float64 theAnswer = 0;
+	UInt64 thePeriod = GetPeriod();
+	if((thePeriod > 0) && (inBeginTime > 0) && (inEndTime >= inBeginTime))
+	{
+		theAnswer = (Float64)(inEndTime - inBeginTime) / (Float64)thePeriod;
+	}
+	return theAnswer;
+}
+
+Float64	CAHALIOCycleTelemetry::GetLoadBetweenEvents(UInt32 inBeginEventKind, UInt32 inEndEventKind) const
+{
+	Float64 theAnswer = 0;
+	CAHALIOCycleRawTelemetryEvent theBeginEvent;
+	CAHALIOCycleRawTelemetryEvent theEndEvent;
+	if(GetRawEventByKind(inBeginEventKind, theBeginEvent) && GetRawEventByKind(inEndEventKind, theEndEvent))
+	{
+		theAnswer = GetLoad(theBeginEvent.mEventTime, theEndEvent.mEventTime);
+	}
+	return theAnswer;
 }
 
 bool	CAHALIOCycleTelemetry::AssimilateRawEvent(const CAHALIOCycleRawTelemetryEvent& inRawEvent)
@@ -458,10 +516,10 @@ static void	CAHALIOCycleTelemetryClient_MessagePortIsInvalid(CFMessagePortRef in
 CAHALIOCycleTelemetryClient::CAHALIOCycleTelemetryClient()
 :
 	mMessagePort(NULL),
-	mRawTelemetry(),
-	mIOCycleList(),
-	mErrorCycleList(),
-	mZerosCycleList()
+	mServerIsFlipped(false),
+	mStore(),
+	mLoadStatistics(),
+	mNextIOCycleToAggregate(0)
 {
 }
 
@@ -469,7 +527,7 @@ CAHALIOCycleTelemetryClient::~CAHALIOCycleTelemetryClient()
 {
 }
 
-bool	CAHALIOCycleTelemetryClient::Initialize(pid_t inProcess, AudioDeviceID inDevice)
+bool	CAHALIOCycleTelemetryClient::Initialize(pid_t inProcess, AudioDeviceID inDevice, const char* inCapturePath, UInt32 inMaximumNumberEvents)
 {
 	bool theAnswer = false;
 	
@@ -489,15 +547,22 @@ bool	CAHALIOCycleTelemetryClient::Initialize(pid_t inProcess, AudioDeviceID inDe
 				ThrowIfError(theError, CAException(theError), "CAHALIOCycleTelemetryClient::Initialize: couldn't get the endianness of the server");
 				mServerIsFlipped = theServerIsFlipped;
 				
+				//	set up the store, which is bounded so that long captures don't grow without limit
+				bool theStoreIsOpen = mStore.Open(inCapturePath, inMaximumNumberEvents);
+				ThrowIf(!theStoreIsOpen, CAException(kAudioHardwareUnspecifiedError), "CAHALIOCycleTelemetryClient::Initialize: couldn't open the telemetry store");
+				
 				//	tell the HAL to enable telemetry
 				theError = SetIsEnabledOnServer(true);
 				ThrowIfError(theError, CAException(theError), "CAHALIOCycleTelemetryClient::Initialize: couldn't enable telemetry on the server");
 				
 				//	clear out the existing data
 				Clear();
+				
+				theAnswer = true;
 			}
 			catch(...)
 			{
+				mStore.Close();
 				delete mMessagePort;
 				mMessagePort = NULL;
 			}
@@ -512,18 +577,39 @@ bool	CAHALIOCycleTelemetryClient::Initialize(pid_t inProcess, AudioDeviceID inDe
 	return theAnswer;
 }
 
+bool	CAHALIOCycleTelemetryClient::OpenCapture(const char* inCapturePath)
+{
+	//	a capture is only for looking at, so there can't be a connection to the HAL
+	Teardown();
+	
+	mLoadStatistics.Clear();
+	mNextIOCycleToAggregate = 0;
+	
+	bool theAnswer = mStore.OpenCapture(inCapturePath);
+	if(theAnswer)
+	{
+		//	nothing more is coming, so the last IO cycle is as complete as it will get
+		AggregateIOCycles(true);
+	}
+	return theAnswer;
+}
+
 void	CAHALIOCycleTelemetryClient::Teardown()
 {
-	Clear();
-				
 	if(mMessagePort != NULL)
 	{
+		ClearDataOnServer();
+		
 		UInt32 theError = SetIsEnabledOnServer(false);
 		ThrowIfError(theError, CAException(theError), "CAHALIOCycleTelemetryClient::Teardown: couldn't disable telemetry on the server");
 	
 		delete mMessagePort;
 		mMessagePort = NULL;
 	}
+	
+	//	closing the store leaves whatever was recorded in the capture file intact
+	mStore.Flush();
+	mStore.Close();
 }
 
 static inline Float64	SwapFloat64(Float64 inNumber)
@@ -607,42 +693,19 @@ bool	CAHALIOCycleTelemetryClient::Update()
 					theEvent.mFlags = CFSwapInt64(theEvent.mFlags);
 				}
 				
-				//	stick it into the list
-				mRawTelemetry.push_back(theEvent);
-				
-				//	figure out which cycle telemetry this raw event belongs to
-				
-				//	starting with the last one on the list
-				bool wasPlaced = false;
-				if(mIOCycleList.size() > 0)
-				{
-					wasPlaced = mIOCycleList.back().AssimilateRawEvent(theEvent);
-				}
-				
-				//	didn't belong there
-				if(!wasPlaced)
-				{
-					//	so make a new one
-					CAHALIOCycleTelemetry theIOCycle;
-					
-					//	assimilate this event
-					theIOCycle.AssimilateRawEvent(theEvent);
-					
-					//	set the end event
-					CAHALIOCycleRawTelemetryEvent theLastEvent;
-					if(mIOCycleList.size() > 0)
-					{
-						wasPlaced = mIOCycleList.back().GetEndRawEvent(theLastEvent);
-					}
-					theIOCycle.SetLastCycleEnd(theLastEvent);
-					
-					//	push it onto the list
-					mIOCycleList.push_back(theIOCycle);
-				}
+				//	stick it into the store, which takes care of figuring out which IO cycle it belongs to
+				mStore.AppendEvent(theEvent, IsRawEventError(theEvent), IsRawEventSignal(theEvent));
 			}
 			theAnswer = theAnswer || (theNumberEvents > 0);
 		}
 		while(theNumberEvents > 0);
+		
+		if(theAnswer)
+		{
+			//	the last IO cycle may still be picking up events, so leave it for next time
+			AggregateIOCycles(false);
+			mStore.Flush();
+		}
 	}
 	catch(const CAException& inException)
 	{
@@ -656,126 +719,155 @@ bool	CAHALIOCycleTelemetryClient::Update()
 
 void	CAHALIOCycleTelemetryClient::Clear()
 {
-	mRawTelemetry.clear();
-	mIOCycleList.clear();
-	mErrorCycleList.clear();
-	mZerosCycleList.clear();
+	mStore.Clear();
+	mLoadStatistics.Clear();
+	mNextIOCycleToAggregate = 0;
 	ClearDataOnServer();
 }
 
 UInt32	CAHALIOCycleTelemetryClient::GetNumberIOCycles() const
 {
-	return mIOCycleList.size();
+	return mStore.GetNumberIOCycles();
 }
 
 UInt32	CAHALIOCycleTelemetryClient::GetPreviousErrorIOCycleIndex(UInt32 inCurrentIndex) const
 {
-	UInt32 theAnswer = 0xFFFFFFFF;
-	IOCycleList::const_iterator theIOCycleIterator = mIOCycleList.begin();
-	if(inCurrentIndex < mIOCycleList.size())
-	{
-		std::advance(theIOCycleIterator, inCurrentIndex);
-	}
-	if(theIOCycleIterator->HasError())
-	{
-		--inCurrentIndex;
-		--theIOCycleIterator;
-	}
-	while((theAnswer == 0xFFFFFFFF) && (theIOCycleIterator != mIOCycleList.begin()))
+	return mStore.GetPreviousErrorIOCycleIndex(inCurrentIndex);
+}
+
+UInt32	CAHALIOCycleTelemetryClient::GetNextErrorIOCycleIndex(UInt32 inCurrentIndex) const
+{
+	return mStore.GetNextErrorIOCycleIndex(inCurrentIndex);
+}
+
+UInt32	CAHALIOCycleTelemetryClient::GetPreviousOverloadIOCycleIndex(UInt32 inCurrentIndex) const
+{
+	return mStore.GetPreviousOverloadIOCycleIndex(inCurrentIndex);
+}
+
+UInt32	CAHALIOCycleTelemetryClient::GetNextOverloadIOCycleIndex(UInt32 inCurrentIndex) const
+{
+	return mStore.GetNextOverloadIOCycleIndex(inCurrentIndex);
+}
+
+bool	CAHALIOCycleTelemetryClient::GetIOCycle(UInt32 inIOCycleIndex, CAHALIOCycleTelemetry& outIOCycle) const
+{
+	CAHALIOCycleTelemetry theIOCycle;
+	bool theAnswer = AssembleIOCycle(inIOCycleIndex, theIOCycle);
+	if(theAnswer)
 	{
-		if(theIOCycleIterator->HasError())
+		//	the intended start time comes from the end of the previous IO cycle
+		if(inIOCycleIndex > 0)
 		{
-			theAnswer = inCurrentIndex;
+			CAHALIOCycleTelemetry thePreviousIOCycle;
+			CAHALIOCycleRawTelemetryEvent theLastEvent;
+			if(AssembleIOCycle(inIOCycleIndex - 1, thePreviousIOCycle) && thePreviousIOCycle.GetEndRawEvent(theLastEvent))
+			{
+				theIOCycle.SetLastCycleEnd(theLastEvent);
+			}
 		}
-		else
+		outIOCycle = theIOCycle;
+	}
+	return theAnswer;
+}
+
+bool	CAHALIOCycleTelemetryClient::AssembleIOCycle(UInt32 inIOCycleIndex, CAHALIOCycleTelemetry& outIOCycle) const
+{
+	UInt32 theFirstEventIndex = 0;
+	UInt32 theNumberEvents = 0;
+	bool theAnswer = mStore.GetIOCycleEvents(inIOCycleIndex, theFirstEventIndex, theNumberEvents);
+	outIOCycle.SetHostTicksPerSecond(GetCaptureHostTicksPerSecond());
+	for(UInt32 theEventIndex = 0; theAnswer && (theEventIndex < theNumberEvents); ++theEventIndex)
+	{
+		CAHALIOCycleRawTelemetryEvent theEvent;
+		if(mStore.GetEvent(theFirstEventIndex + theEventIndex, theEvent))
 		{
-			--inCurrentIndex;
-			--theIOCycleIterator;
+			outIOCycle.AssimilateRawEvent(theEvent);
 		}
 	}
-	
 	return theAnswer;
 }
 
-UInt32	CAHALIOCycleTelemetryClient::GetNextErrorIOCycleIndex(UInt32 inCurrentIndex) const
+void	CAHALIOCycleTelemetryClient::AggregateIOCycles(bool inIncludeLastIOCycle)
 {
-	UInt32 theAnswer = 0xFFFFFFFF;
-	IOCycleList::const_iterator theIOCycleIterator = mIOCycleList.begin();
-	if(inCurrentIndex < mIOCycleList.size())
+	//	IO cycles are tracked by absolute number since the store's indexes shift as it discards things
+	UInt64 theFirstIOCycle = mStore.GetNumberIOCyclesDiscarded();
+	UInt64 theEndIOCycle = theFirstIOCycle + mStore.GetNumberIOCycles();
+	if(!inIncludeLastIOCycle && (theEndIOCycle > theFirstIOCycle))
 	{
-		std::advance(theIOCycleIterator, inCurrentIndex);
+		--theEndIOCycle;
 	}
-	if(theIOCycleIterator->HasError())
+	if(mNextIOCycleToAggregate < theFirstIOCycle)
 	{
-		++inCurrentIndex;
-		std::advance(theIOCycleIterator, 1);
+		mNextIOCycleToAggregate = theFirstIOCycle;
 	}
-	while((theAnswer == 0xFFFFFFFF) && (theIOCycleIterator != mIOCycleList.end()))
+	
+	for(; mNextIOCycleToAggregate < theEndIOCycle; ++mNextIOCycleToAggregate)
 	{
-		if(theIOCycleIterator->HasError())
-		{
-			theAnswer = inCurrentIndex;
-		}
-		else
+		CAHALIOCycleTelemetry theIOCycle;
+		if(GetIOCycle((UInt32)(mNextIOCycleToAggregate - theFirstIOCycle), theIOCycle) && (theIOCycle.GetPeriod() > 0))
 		{
-			++inCurrentIndex;
-			std::advance(theIOCycleIterator, 1);
+			Float64 theValues[CAHALIOCycleLoadStatistics::kNumberComponents];
+			theValues[CAHALIOCycleLoadStatistics::kComponentTotalLoad] = theIOCycle.GetTotalLoad();
+			theValues[CAHALIOCycleLoadStatistics::kComponentSchedulingLoad] = theIOCycle.GetSchedulingLoad();
+			theValues[CAHALIOCycleLoadStatistics::kComponentReadLoad] = theIOCycle.GetReadLoad();
+			theValues[CAHALIOCycleLoadStatistics::kComponentIOProcLoad] = theIOCycle.GetIOProcLoad();
+			theValues[CAHALIOCycleLoadStatistics::kComponentWriteLoad] = theIOCycle.GetWriteLoad();
+			theValues[CAHALIOCycleLoadStatistics::kComponentWakeUpJitter] = theIOCycle.GetWakeUpJitter();
+			
+			//	only count the phases the cycle actually went through
+			UInt32 theComponentsPresent = (1UL << CAHALIOCycleLoadStatistics::kComponentTotalLoad) | (1UL << CAHALIOCycleLoadStatistics::kComponentSchedulingLoad) | (1UL << CAHALIOCycleLoadStatistics::kComponentWakeUpJitter);
+			CAHALIOCycleRawTelemetryEvent theEvent;
+			if(theIOCycle.GetRawEventByKind(kHALIOCycleTelemetryEventInputReadEnd, theEvent))
+			{
+				theComponentsPresent |= (1UL << CAHALIOCycleLoadStatistics::kComponentReadLoad);
+			}
+			if(theIOCycle.GetRawEventByKind(kHALIOCycleTelemetryEventIOProcsEnd, theEvent))
+			{
+				theComponentsPresent |= (1UL << CAHALIOCycleLoadStatistics::kComponentIOProcLoad);
+			}
+			if(theIOCycle.GetRawEventByKind(kHALIOCycleTelemetryEventOutputWriteEnd, theEvent))
+			{
+				theComponentsPresent |= (1UL << CAHALIOCycleLoadStatistics::kComponentWriteLoad);
+			}
+			
+			mLoadStatistics.AddIOCycle(mStore.ConvertHostTimeToNanos(theIOCycle.GetStartTime()), theValues, theComponentsPresent);
 		}
 	}
-	
-	return theAnswer;
+}
+
+Float64	CAHALIOCycleTelemetryClient::GetCaptureHostTicksPerSecond() const
+{
+	//	0 means the telemetry is live and this host's time base applies
+	return mStore.IsReadOnly() ? mStore.GetHostTicksPerSecond() : 0;
 }
 
 UInt32	CAHALIOCycleTelemetryClient::GetNumberEventsInIOCycle(UInt32 inIOCycleIndex) const
 {
+	UInt32 theFirstEventIndex = 0;
 	UInt32 theAnswer = 0;
-	
-	IOCycleList::const_iterator theIOCycleIterator = mIOCycleList.begin();
-	std::advance(theIOCycleIterator, inIOCycleIndex);
-	if(theIOCycleIterator != mIOCycleList.end())
-	{
-		theAnswer = theIOCycleIterator->GetNumberRawEvents();
-	}
-	
+	mStore.GetIOCycleEvents(inIOCycleIndex, theFirstEventIndex, theAnswer);
 	return theAnswer;
 }
 
 bool	CAHALIOCycleTelemetryClient::IOCycleHasError(UInt32 inIOCycleIndex) const
 {
-	bool theAnswer = false;
-	IOCycleList::const_iterator theIOCycleIterator = mIOCycleList.begin();
-	std::advance(theIOCycleIterator, inIOCycleIndex);
-	if(theIOCycleIterator != mIOCycleList.end())
-	{
-		theAnswer = theIOCycleIterator->HasError();
-	}
-	return theAnswer;
+	return (mStore.GetIOCycleFlags(inIOCycleIndex) & CAHALTelemetryStore::kIOCycleFlagHasError) != 0;
 }
 
 bool	CAHALIOCycleTelemetryClient::IOCycleHasSignal(UInt32 inIOCycleIndex) const
 {
-	bool theAnswer = false;
-	IOCycleList::const_iterator theIOCycleIterator = mIOCycleList.begin();
-	std::advance(theIOCycleIterator, inIOCycleIndex);
-	if(theIOCycleIterator != mIOCycleList.end())
-	{
-		theAnswer = theIOCycleIterator->HasSignal();
-	}
-	return theAnswer;
+	return (mStore.GetIOCycleFlags(inIOCycleIndex) & CAHALTelemetryStore::kIOCycleFlagHasSignal) != 0;
 }
 
 bool	CAHALIOCycleTelemetryClient::EventInIOCycleHasError(UInt32 inIOCycleIndex, UInt32 inEventIndex) const
 {
 	bool theAnswer = false;
-	IOCycleList::const_iterator theIOCycleIterator = mIOCycleList.begin();
-	std::advance(theIOCycleIterator, inIOCycleIndex);
-	if(theIOCycleIterator != mIOCycleList.end())
+	UInt32 theFirstEventIndex = 0;
+	UInt32 theNumberEvents = 0;
+	if(mStore.GetIOCycleEvents(inIOCycleIndex, theFirstEventIndex, theNumberEvents) && (inEventIndex < theNumberEvents))
 	{
-		CAHALIOCycleRawTelemetryEvent theEvent;
-		if(theIOCycleIterator->GetRawEventByIndex(inEventIndex, theEvent))
-		{
-			theAnswer = IsRawEventError(theEvent);
-		}
+		theAnswer = mStore.IsEventError(theFirstEventIndex + inEventIndex);
 	}
 	return theAnswer;
 }
@@ -783,15 +875,11 @@ bool	CAHALIOCycleTelemetryClient::EventInIOCycleHasError(UInt32 inIOCycleIndex,
 bool	CAHALIOCycleTelemetryClient::EventInIOCycleHasSignal(UInt32 inIOCycleIndex, UInt32 inEventIndex) const
 {
 	bool theAnswer = false;
-	IOCycleList::const_iterator theIOCycleIterator = mIOCycleList.begin();
-	std::advance(theIOCycleIterator, inIOCycleIndex);
-	if(theIOCycleIterator != mIOCycleList.end())
+	UInt32 theFirstEventIndex = 0;
+	UInt32 theNumberEvents = 0;
+	if(mStore.GetIOCycleEvents(inIOCycleIndex, theFirstEventIndex, theNumberEvents) && (inEventIndex < theNumberEvents))
 	{
-		CAHALIOCycleRawTelemetryEvent theEvent;
-		if(theIOCycleIterator->GetRawEventByIndex(inEventIndex, theEvent))
-		{
-			theAnswer = IsRawEventSignal(theEvent);
-		}
+		theAnswer = mStore.IsEventSignal(theFirstEventIndex + inEventIndex);
 	}
 	return theAnswer;
 }
@@ -810,28 +898,30 @@ void	CAHALIOCycleTelemetryClient::CreateSummaryHeaderForIOCycle(char* outSummary
 
 void	CAHALIOCycleTelemetryClient::CreateSummaryForIOCycle(UInt32 inIOCycleIndex, char* outSummary, bool inForSpreadSheet) const
 {
-	UInt64 theAnchorTime = mRawTelemetry.front().mEventTime;
-	IOCycleList::const_iterator theIOCycleIterator = mIOCycleList.begin();
-	std::advance(theIOCycleIterator, inIOCycleIndex);
-	if(theIOCycleIterator != mIOCycleList.end())
+	CAHALIOCycleRawTelemetryEvent theAnchorEvent;
+	mStore.GetEvent(0, theAnchorEvent);
+	UInt64 theAnchorTime = theAnchorEvent.mEventTime;
+	Float64 theHostTicksPerSecond = GetCaptureHostTicksPerSecond();
+	CAHALIOCycleTelemetry theIOCycle;
+	if(GetIOCycle(inIOCycleIndex, theIOCycle))
 	{
-		IOCycleList::const_iterator theIOCyclePreviousIterator = theIOCycleIterator;
-		if(inIOCycleIndex > 0)
+		CAHALIOCycleTelemetry thePreviousIOCycle;
+		if((inIOCycleIndex == 0) || !GetIOCycle(inIOCycleIndex - 1, thePreviousIOCycle))
 		{
-			--theIOCyclePreviousIterator;
+			thePreviousIOCycle = theIOCycle;
 		}
 		AudioTimeStamp theNow, theInput, theOutput, theNext;
-		theIOCycleIterator->GetIOProcTimes(theNow, theInput, theOutput);
-		theIOCycleIterator->GetNextWakeUpTime(theNext);
-		Float64 theStartTime = ConvertHostTimeToDisplayTime(SubtractUInt64(theIOCycleIterator->GetStartTime(), theAnchorTime));
-		Float64 theOffsetFromPreviousStartTime = ConvertHostTimeToDisplayTime(SubtractUInt64(theIOCycleIterator->GetStartTime(), theIOCyclePreviousIterator->GetStartTime()));
-		Float64 theLateness = (theIOCycleIterator->GetIntendedStartTime() > 0) ? ConvertHostTimeToDisplayTime(SubtractUInt64(theIOCycleIterator->GetStartTime(), theIOCycleIterator->GetIntendedStartTime())) : 0;
-		Float64	theRateScalar = theIOCycleIterator->GetRateScalar();
-		Float64 theNowHostTime = ((theNow.mFlags & kAudioTimeStampHostTimeValid) != 0) ? ConvertHostTimeToDisplayTime(SubtractUInt64(theNow.mHostTime, theAnchorTime)) : 0;
-		Float64 theInputHostTime = ((theInput.mFlags & kAudioTimeStampHostTimeValid) != 0) ? ConvertHostTimeToDisplayTime(SubtractUInt64(theInput.mHostTime, theAnchorTime)) : 0;
-		Float64 theOutputHostTime = ((theOutput.mFlags & kAudioTimeStampHostTimeValid) != 0) ? ConvertHostTimeToDisplayTime(SubtractUInt64(theOutput.mHostTime, theAnchorTime)) : 0;
-		Float64 theNextHostTime = ((theNext.mFlags & kAudioTimeStampHostTimeValid) != 0) ? ConvertHostTimeToDisplayTime(SubtractUInt64(theNext.mHostTime, theAnchorTime)) : 0;
-		if(!theIOCycleIterator->HasZeroTime())
+		theIOCycle.GetIOProcTimes(theNow, theInput, theOutput);
+		theIOCycle.GetNextWakeUpTime(theNext);
+		Float64 theStartTime = ConvertHostTimeToDisplayTime(SubtractUInt64(theIOCycle.GetStartTime(), theAnchorTime), theHostTicksPerSecond);
+		Float64 theOffsetFromPreviousStartTime = ConvertHostTimeToDisplayTime(SubtractUInt64(theIOCycle.GetStartTime(), thePreviousIOCycle.GetStartTime()), theHostTicksPerSecond);
+		Float64 theLateness = (theIOCycle.GetIntendedStartTime() > 0) ? ConvertHostTimeToDisplayTime(SubtractUInt64(theIOCycle.GetStartTime(), theIOCycle.GetIntendedStartTime()), theHostTicksPerSecond) : 0;
+		Float64	theRateScalar = theIOCycle.GetRateScalar();
+		Float64 theNowHostTime = ((theNow.mFlags & kAudioTimeStampHostTimeValid) != 0) ? ConvertHostTimeToDisplayTime(SubtractUInt64(theNow.mHostTime, theAnchorTime), theHostTicksPerSecond) : 0;
+		Float64 theInputHostTime = ((theInput.mFlags & kAudioTimeStampHostTimeValid) != 0) ? ConvertHostTimeToDisplayTime(SubtractUInt64(theInput.mHostTime, theAnchorTime), theHostTicksPerSecond) : 0;
+		Float64 theOutputHostTime = ((theOutput.mFlags & kAudioTimeStampHostTimeValid) != 0) ? ConvertHostTimeToDisplayTime(SubtractUInt64(theOutput.mHostTime, theAnchorTime), theHostTicksPerSecond) : 0;
+		Float64 theNextHostTime = ((theNext.mFlags & kAudioTimeStampHostTimeValid) != 0) ? ConvertHostTimeToDisplayTime(SubtractUInt64(theNext.mHostTime, theAnchorTime), theHostTicksPerSecond) : 0;
+		if(!theIOCycle.HasZeroTime())
 		{
 			if(!inForSpreadSheet)
 			{
@@ -845,8 +935,8 @@ void	CAHALIOCycleTelemetryClient::CreateSummaryForIOCycle(UInt32 inIOCycleIndex,
 		else
 		{
 			AudioTimeStamp theZero;
-			theIOCycleIterator->GetZeroTimeStamp(theZero);
-			Float64 theZeroHostTime = ConvertHostTimeToDisplayTime(SubtractUInt64(theZero.mHostTime, theAnchorTime));
+			theIOCycle.GetZeroTimeStamp(theZero);
+			Float64 theZeroHostTime = ConvertHostTimeToDisplayTime(SubtractUInt64(theZero.mHostTime, theAnchorTime), theHostTicksPerSecond);
 			if(!inForSpreadSheet)
 			{
 				sprintf(outSummary, "%12.3f (%+7.3f %+7.3f) %-9.6f {%9.0f, %12.3f} {%9.0f, %12.3f} {%9.0f, %12.3f} {%9.0f, %12.3f} {%9.0f, %12.3f}", theStartTime, theOffsetFromPreviousStartTime, theLateness, theRateScalar, theNow.mSampleTime, theNowHostTime, theInput.mSampleTime, theInputHostTime, theOutput.mSampleTime, theOutputHostTime, theNext.mSampleTime, theNextHostTime, theZero.mSampleTime, theZeroHostTime);
@@ -861,85 +951,38 @@ void	CAHALIOCycleTelemetryClient::CreateSummaryForIOCycle(UInt32 inIOCycleIndex,
 
 void	CAHALIOCycleTelemetryClient::CreateSummaryForEventInIOCycle(UInt32 inIOCycleIndex, UInt32 inEventIndex, char* outSummary) const
 {
-	UInt64 theAnchorTime = mRawTelemetry.front().mEventTime;
-	IOCycleList::const_iterator theIOCycleIterator = mIOCycleList.begin();
-	std::advance(theIOCycleIterator, inIOCycleIndex);
-	if(theIOCycleIterator != mIOCycleList.end())
+	UInt32 theFirstEventIndex = 0;
+	UInt32 theNumberEvents = 0;
+	if(mStore.GetIOCycleEvents(inIOCycleIndex, theFirstEventIndex, theNumberEvents) && (inEventIndex < theNumberEvents))
 	{
+		CAHALIOCycleRawTelemetryEvent theAnchorEvent;
+		mStore.GetEvent(0, theAnchorEvent);
 		CAHALIOCycleRawTelemetryEvent theEvent;
-		if(theIOCycleIterator->GetRawEventByIndex(inEventIndex, theEvent))
+		if(mStore.GetEvent(theFirstEventIndex + inEventIndex, theEvent))
 		{
 			CAHALIOCycleRawTelemetryEvent thePreviousEvent = theEvent;
 			if(inEventIndex > 0)
 			{
-				theIOCycleIterator->GetRawEventByIndex(inEventIndex - 1, thePreviousEvent);
+				mStore.GetEvent(theFirstEventIndex + inEventIndex - 1, thePreviousEvent);
 			}
-			CreateSummaryForRawEvent(theEvent, thePreviousEvent, theAnchorTime, outSummary);
+			CreateSummaryForRawEvent(theEvent, thePreviousEvent, theAnchorEvent.mEventTime, outSummary, GetCaptureHostTicksPerSecond());
 		}
 	}
 }
 
 UInt32	CAHALIOCycleTelemetryClient::GetNumberRawEvents() const
 {
-	return mRawTelemetry.size();
+	return mStore.GetNumberEvents();
 }
 
 UInt32	CAHALIOCycleTelemetryClient::GetPreviousErrorRawEventIndex(UInt32 inCurrentIndex) const
 {
-	UInt32 theAnswer = 0xFFFFFFFF;
-	EventList::const_iterator theIOCycleIterator = mRawTelemetry.begin();
-	if(inCurrentIndex < mRawTelemetry.size())
-	{
-		std::advance(theIOCycleIterator, inCurrentIndex);
-	}
-	if(IsRawEventError(*theIOCycleIterator))
-	{
-		--inCurrentIndex;
-		--theIOCycleIterator;
-	}
-	while((theAnswer == 0xFFFFFFFF) && (theIOCycleIterator != mRawTelemetry.begin()))
-	{
-		if(IsRawEventError(*theIOCycleIterator))
-		{
-			theAnswer = inCurrentIndex;
-		}
-		else
-		{
-			--inCurrentIndex;
-			--theIOCycleIterator;
-		}
-	}
-	
-	return theAnswer;
+	return mStore.GetPreviousErrorEventIndex(inCurrentIndex);
 }
 
 UInt32	CAHALIOCycleTelemetryClient::GetNextErrorRawEventIndex(UInt32 inCurrentIndex) const
 {
-	UInt32 theAnswer = 0xFFFFFFFF;
-	EventList::const_iterator theIOCycleIterator = mRawTelemetry.begin();
-	if(inCurrentIndex < mRawTelemetry.size())
-	{
-		std::advance(theIOCycleIterator, inCurrentIndex);
-	}
-	if(IsRawEventError(*theIOCycleIterator))
-	{
-		++inCurrentIndex;
-		std::advance(theIOCycleIterator, 1);
-	}
-	while((theAnswer == 0xFFFFFFFF) && (theIOCycleIterator != mRawTelemetry.end()))
-	{
-		if(IsRawEventError(*theIOCycleIterator))
-		{
-			theAnswer = inCurrentIndex;
-		}
-		else
-		{
-			++inCurrentIndex;
-			std::advance(theIOCycleIterator, 1);
-		}
-	}
-	
-	return theAnswer;
+	return mStore.GetNextErrorEventIndex(inCurrentIndex);
 }
 
 bool	CAHALIOCycleTelemetryClient::IsRawEventError(const CAHALIOCycleRawTelemetryEvent& inEvent)
@@ -1031,26 +1074,12 @@ bool	CAHALIOCycleTelemetryClient::IsRawEventSignal(const CAHALIOCycleRawTelemetr
 
 bool	CAHALIOCycleTelemetryClient::IsRawEventError(UInt32 inEventIndex) const
 {
-	bool theAnswer = false;
-	EventList::const_iterator theIterator = mRawTelemetry.begin();
-	std::advance(theIterator, inEventIndex);
-	if(theIterator != mRawTelemetry.end())
-	{
-		theAnswer = IsRawEventError(*theIterator);
-	}
-	return theAnswer;
+	return mStore.IsEventError(inEventIndex);
 }
 
 bool	CAHALIOCycleTelemetryClient::IsRawEventSignal(UInt32 inEventIndex) const
 {
-	bool theAnswer = false;
-	EventList::const_iterator theIterator = mRawTelemetry.begin();
-	std::advance(theIterator, inEventIndex);
-	if(theIterator != mRawTelemetry.end())
-	{
-		theAnswer = IsRawEventSignal(*theIterator);
-	}
-	return theAnswer;
+	return mStore.IsEventSignal(inEventIndex);
 }
 
 void	CAHALIOCycleTelemetryClient::CreateSummaryHeaderForRawEvent(char* outSummary) const
@@ -1060,30 +1089,26 @@ void	CAHALIOCycleTelemetryClient::CreateSummaryHeaderForRawEvent(char* outSummar
 
 void	CAHALIOCycleTelemetryClient::CreateSummaryForRawEvent(UInt32 inEventIndex, char* outSummary) const
 {
-	UInt64 theAnchorTime = mRawTelemetry.front().mEventTime;
-	EventList::const_iterator theIterator = mRawTelemetry.begin();
-	std::advance(theIterator, inEventIndex);
-	if(theIterator != mRawTelemetry.end())
+	CAHALIOCycleRawTelemetryEvent theAnchorEvent;
+	mStore.GetEvent(0, theAnchorEvent);
+	CAHALIOCycleRawTelemetryEvent theEvent;
+	if(mStore.GetEvent(inEventIndex, theEvent))
 	{
-		CAHALIOCycleRawTelemetryEvent thePreviousEvent;
-		if(theIterator != mRawTelemetry.begin())
-		{
-			thePreviousEvent = *(theIterator - 1);
-		}
-		else
+		CAHALIOCycleRawTelemetryEvent thePreviousEvent = theEvent;
+		if(inEventIndex > 0)
 		{
-			thePreviousEvent = *theIterator;
+			mStore.GetEvent(inEventIndex - 1, thePreviousEvent);
 		}
-		CreateSummaryForRawEvent(*theIterator, thePreviousEvent, theAnchorTime, outSummary);
+		CreateSummaryForRawEvent(theEvent, thePreviousEvent, theAnchorEvent.mEventTime, outSummary, GetCaptureHostTicksPerSecond());
 	}
 }
 
-void	CAHALIOCycleTelemetryClient::CreateSummaryForRawEvent(const CAHALIOCycleRawTelemetryEvent& inEvent, const CAHALIOCycleRawTelemetryEvent& inPreviousEvent, UInt64 inAnchorTime, char* outSummary)
+void	CAHALIOCycleTelemetryClient::CreateSummaryForRawEvent(const CAHALIOCycleRawTelemetryEvent& inEvent, const CAHALIOCycleRawTelemetryEvent& inPreviousEvent, UInt64 inAnchorTime, char* outSummary, Float64 inHostTicksPerSecond)
 {
-	Float64 theEventTime = ConvertHostTimeToDisplayTime(SubtractUInt64(inEvent.mEventTime, inAnchorTime));
-	Float64 theEventTimeDifference = ConvertHostTimeToDisplayTime(SubtractUInt64(inEvent.mEventTime, inPreviousEvent.mEventTime));
-	Float64 theEventHostTime1 = ConvertHostTimeToDisplayTime(SubtractUInt64(inEvent.mHostTime1, inAnchorTime));
-	Float64 theEventHostTime2 = ConvertHostTimeToDisplayTime(SubtractUInt64(inEvent.mHostTime2, inAnchorTime));
+	Float64 theEventTime = ConvertHostTimeToDisplayTime(SubtractUInt64(inEvent.mEventTime, inAnchorTime), inHostTicksPerSecond);
+	Float64 theEventTimeDifference = ConvertHostTimeToDisplayTime(SubtractUInt64(inEvent.mEventTime, inPreviousEvent.mEventTime), inHostTicksPerSecond);
+	Float64 theEventHostTime1 = ConvertHostTimeToDisplayTime(SubtractUInt64(inEvent.mHostTime1, inAnchorTime), inHostTicksPerSecond);
+	Float64 theEventHostTime2 = ConvertHostTimeToDisplayTime(SubtractUInt64(inEvent.mHostTime2, inAnchorTime), inHostTicksPerSecond);
 	
 	switch(inEvent.mEventKind)
 	{
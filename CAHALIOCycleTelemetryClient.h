@@ -47,13 +47,14 @@
 //=============================================================================
 
 //	PublicUtility Includes
+#include "CAHALIOCycleLoadStatistics.h"
 #include "CAHALTelemetry.h"
+#include "CAHALTelemetryStore.h"
 
 //	System Includes
 #include <CoreAudio/AudioHardware.h>
 
 //	Standard Library Includes
-#include <deque>
 #include <vector>
 
 //=============================================================================
@@ -66,7 +67,8 @@ class	CACFRemoteMessagePort;
 //	CAHALIOCycleTelemetry
 //
 //	This class encapsulates and unifies the raw telemetry data for a single IO cycle.
-//	Host times are convertered to microseconds.
+//	Host times are convertered to microseconds using this host's time base, or
+//	the frequency passed to SetHostTicksPerSecond for telemetry from a capture.
 //=============================================================================
 
 class CAHALIOCycleTelemetry
@@ -79,6 +81,8 @@ public:
 
 //	Operations
 public:
+	void		SetHostTicksPerSecond(Float64 inHostTicksPerSecond) { mHostTicksPerSecond = inHostTicksPerSecond; }
+	
 	UInt32		GetIOCycleNumber() const;
 	UInt64		GetIntendedStartTime() const;
 	UInt64		GetStartTime() const;
@@ -94,6 +98,9 @@ public:
 	bool		GetZeroTimeStamp(AudioTimeStamp& outZeroTime) const;
 	bool		GetNextWakeUpTime(AudioTimeStamp& outWakeTime) const;
 	
+	Float64		GetWakeUpJitter() const;
+	UInt64		GetPeriod() const;
+	
 	Float64		GetTotalLoad() const;
 	Float64		GetSchedulingLoad() const;
 	Float64		GetReadLoad() const;
@@ -114,13 +121,25 @@ public:
 private:
 	typedef std::vector<CAHALIOCycleRawTelemetryEvent>	RawEventList;
 	
+	Float64		GetLoad(UInt64 inBeginTime, UInt64 inEndTime) const;
+	Float64		GetLoadBetweenEvents(UInt32 inBeginEventKind, UInt32 inEndEventKind) const;
+	
 	CAHALIOCycleRawTelemetryEvent	mLastCycleEnd;
 	RawEventList					mRawEvents;
+	Float64							mHostTicksPerSecond;
 
 };
 
 //=============================================================================
 //	CAHALIOCycleTelemetryClient
+//
+//	The telemetry is kept in a bounded CAHALTelemetryStore, so only the most
+//	recent events are available once the store fills up. Passing a capture path
+//	to Initialize also records the telemetry to that file, and OpenCapture
+//	reopens such a file for offline analysis without talking to the HAL.
+//
+//	As IO cycles complete, their loads are added to the load statistics, which
+//	keep running percentiles that outlive the events discarded from the store.
 //=============================================================================
 
 class CAHALIOCycleTelemetryClient
@@ -131,7 +150,8 @@ public:
 							CAHALIOCycleTelemetryClient();
 	virtual					~CAHALIOCycleTelemetryClient();
 
-	bool					Initialize(pid_t inProcess, AudioDeviceID inDevice);
+	bool					Initialize(pid_t inProcess, AudioDeviceID inDevice, const char* inCapturePath = NULL, UInt32 inMaximumNumberEvents = 0);
+	bool					OpenCapture(const char* inCapturePath);
 	void					Teardown();
 
 //	Operations
@@ -144,6 +164,13 @@ public:
 	UInt32					GetNumberIOCycles() const;
 	UInt32					GetPreviousErrorIOCycleIndex(UInt32 inCurrentIndex) const;
 	UInt32					GetNextErrorIOCycleIndex(UInt32 inCurrentIndex) const;
+	UInt32					GetPreviousOverloadIOCycleIndex(UInt32 inCurrentIndex) const;
+	UInt32					GetNextOverloadIOCycleIndex(UInt32 inCurrentIndex) const;
+	bool					GetIOCycle(UInt32 inIOCycleIndex, CAHALIOCycleTelemetry& outIOCycle) const;
+	
+	CAHALIOCycleLoadStatistics&			GetLoadStatistics() { return mLoadStatistics; }
+	const CAHALIOCycleLoadStatistics&	GetLoadStatistics() const { return mLoadStatistics; }
+	
 	UInt32					GetNumberEventsInIOCycle(UInt32 inIOCycleIndex) const;
 	bool					IOCycleHasError(UInt32 inIOCycleIndex) const;
 	bool					IOCycleHasSignal(UInt32 inIOCycleIndex) const;
@@ -160,7 +187,7 @@ public:
 	bool					IsRawEventSignal(UInt32 inEventIndex) const;
 	void					CreateSummaryHeaderForRawEvent(char* outSummary) const;
 	void					CreateSummaryForRawEvent(UInt32 inEventIndex, char* outSummary) const;
-	static void				CreateSummaryForRawEvent(const CAHALIOCycleRawTelemetryEvent& inEvent, const CAHALIOCycleRawTelemetryEvent& inPreviousEvent, UInt64 inAnchorTime, char* outSummary);
+	static void				CreateSummaryForRawEvent(const CAHALIOCycleRawTelemetryEvent& inEvent, const CAHALIOCycleRawTelemetryEvent& inPreviousEvent, UInt64 inAnchorTime, char* outSummary, Float64 inHostTicksPerSecond = 0);
 	static bool				IsRawEventError(const CAHALIOCycleRawTelemetryEvent& inEvent);
 	static bool				IsRawEventSignal(const CAHALIOCycleRawTelemetryEvent& inEvent);
 
@@ -174,16 +201,15 @@ public:
 
 //	Implementation
 private:
-	typedef std::deque<CAHALIOCycleRawTelemetryEvent>	EventList;
-	typedef std::deque<UInt32>							Index;
-	typedef std::deque<CAHALIOCycleTelemetry>			IOCycleList;
+	bool					AssembleIOCycle(UInt32 inIOCycleIndex, CAHALIOCycleTelemetry& outIOCycle) const;
+	void					AggregateIOCycles(bool inIncludeLastIOCycle);
+	Float64					GetCaptureHostTicksPerSecond() const;
 	
 	CACFRemoteMessagePort*	mMessagePort;
 	bool					mServerIsFlipped;
-	EventList				mRawTelemetry;
-	IOCycleList				mIOCycleList;
-	Index					mErrorCycleList;
-	Index					mZerosCycleList;
+	CAHALTelemetryStore		mStore;
+	CAHALIOCycleLoadStatistics	mLoadStatistics;
+	UInt64					mNextIOCycleToAggregate;
 
 };
 
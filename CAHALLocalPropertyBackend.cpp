@@ -0,0 +1,387 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+//==================================================================================================
+//	Includes
+//==================================================================================================
+
+//	Self Include
+#include "CAHALLocalPropertyBackend.h"
+
+//	PublicUtility Includes
+#include "CAHALAudioObject.h"
+#include "CAHostTimeBase.h"
+
+//	System Includes
+#include <unistd.h>
+
+//	Standard Library Includes
+#include <string.h>
+
+//==================================================================================================
+//	CAHALLocalPropertyBackend
+//==================================================================================================
+
+CAHALLocalPropertyBackend::CAHALLocalPropertyBackend()
+:
+	CAHALPropertyBackend(),
+	mMutex("CAHALLocalPropertyBackend"),
+	mProperties(),
+	mListeners(),
+	mRoundTripMicroseconds(0),
+	mNumberRoundTrips(0)
+{
+}
+
+CAHALLocalPropertyBackend::~CAHALLocalPropertyBackend()
+{
+}
+
+void	CAHALLocalPropertyBackend::SetProperty(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, UInt32 inDataSize, const void* inData, bool inIsSettable)
+{
+	bool wasChanged = false;
+	{
+		CAMutex::Locker theLocker(mMutex);
+		PropertyKey theKey(inObjectID, inAddress);
+		PropertyMap::iterator theIterator = mProperties.find(theKey);
+		if(theIterator == mProperties.end())
+		{
+			theIterator = mProperties.insert(PropertyMap::value_type(theKey, Property())).first;
+		}
+		else
+		{
+			wasChanged = true;
+		}
+		theIterator->second.mData.assign(static_cast<const UInt8*>(inData), static_cast<const UInt8*>(inData) + inDataSize);
+		theIterator->second.mIsSettable = inIsSettable;
+	}
+	
+	//	new properties aren't announced, just like they aren't by the HAL
+	if(wasChanged)
+	{
+		SendNotification(inObjectID, inAddress);
+	}
+}
+
+void	CAHALLocalPropertyBackend::RemoveProperty(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress)
+{
+	bool wasRemoved = false;
+	{
+		CAMutex::Locker theLocker(mMutex);
+		wasRemoved = mProperties.erase(PropertyKey(inObjectID, inAddress)) != 0;
+	}
+	if(wasRemoved)
+	{
+		SendNotification(inObjectID, inAddress);
+	}
+}
+
+void	CAHALLocalPropertyBackend::RemoveAllProperties()
+{
+	CAMutex::Locker theLocker(mMutex);
+	mProperties.clear();
+}
+
+bool	CAHALLocalPropertyBackend::HasProperty(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress)
+{
+	CAMutex::Locker theLocker(mMutex);
+	RoundTrip();
+	return mProperties.find(PropertyKey(inObjectID, inAddress)) != mProperties.end();
+}
+
+OSStatus	CAHALLocalPropertyBackend::IsPropertySettable(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, Boolean& outIsSettable)
+{
+	CAMutex::Locker theLocker(mMutex);
+	RoundTrip();
+	PropertyMap::const_iterator theIterator = mProperties.find(PropertyKey(inObjectID, inAddress));
+	if(theIterator == mProperties.end())
+	{
+		return kAudioHardwareUnknownPropertyError;
+	}
+	outIsSettable = theIterator->second.mIsSettable;
+	return 0;
+}
+
+OSStatus	CAHALLocalPropertyBackend::GetPropertyDataSize(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, UInt32 /*inQualifierDataSize*/, const void* /*inQualifierData*/, UInt32& outDataSize)
+{
+	CAMutex::Locker theLocker(mMutex);
+	RoundTrip();
+	PropertyMap::const_iterator theIterator = mProperties.find(PropertyKey(inObjectID, inAddress));
+	if(theIterator == mProperties.end())
+	{
+		return kAudioHardwareUnknownPropertyError;
+	}
+	outDataSize = ToUInt32(theIterator->second.mData.size());
+	return 0;
+}
+
+OSStatus	CAHALLocalPropertyBackend::GetPropertyData(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, UInt32 /*inQualifierDataSize*/, const void* /*inQualifierData*/, UInt32& ioDataSize, void* outData)
+{
+	CAMutex::Locker theLocker(mMutex);
+	RoundTrip();
+	PropertyMap::const_iterator theIterator = mProperties.find(PropertyKey(inObjectID, inAddress));
+	if(theIterator == mProperties.end())
+	{
+		return kAudioHardwareUnknownPropertyError;
+	}
+	
+	//	like the HAL, return as much as fits
+	const std::vector<UInt8>& theData = theIterator->second.mData;
+	if(ioDataSize > theData.size())
+	{
+		ioDataSize = ToUInt32(theData.size());
+	}
+	if(ioDataSize > 0)
+	{
+		memcpy(outData, &theData[0], ioDataSize);
+	}
+	return 0;
+}
+
+OSStatus	CAHALLocalPropertyBackend::SetPropertyData(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, UInt32 /*inQualifierDataSize*/, const void* /*inQualifierData*/, UInt32 inDataSize, const void* inData)
+{
+	{
+		CAMutex::Locker theLocker(mMutex);
+		RoundTrip();
+		PropertyMap::iterator theIterator = mProperties.find(PropertyKey(inObjectID, inAddress));
+		if(theIterator == mProperties.end())
+		{
+			return kAudioHardwareUnknownPropertyError;
+		}
+		if(!theIterator->second.mIsSettable)
+		{
+			return kAudioHardwareIllegalOperationError;
+		}
+		theIterator->second.mData.assign(static_cast<const UInt8*>(inData), static_cast<const UInt8*>(inData) + inDataSize);
+	}
+	SendNotification(inObjectID, inAddress);
+	return 0;
+}
+
+void	CAHALLocalPropertyBackend::GetPropertyDataForAddresses(AudioObjectID inObjectID, PropertyRequestList& ioRequests)
+{
+	//	the whole batch is a single round trip
+	CAMutex::Locker theLocker(mMutex);
+	RoundTrip();
+	for(PropertyRequestList::iterator theRequest = ioRequests.begin(); theRequest != ioRequests.end(); ++theRequest)
+	{
+		PropertyMap::const_iterator theIterator = mProperties.find(PropertyKey(inObjectID, theRequest->mAddress));
+		theRequest->mHasProperty = theIterator != mProperties.end();
+		theRequest->mError = theRequest->mHasProperty ? 0 : static_cast<OSStatus>(kAudioHardwareUnknownPropertyError);
+		if(theRequest->mHasProperty)
+		{
+			theRequest->mData = theIterator->second.mData;
+		}
+		else
+		{
+			theRequest->mData.clear();
+		}
+	}
+}
+
+OSStatus	CAHALLocalPropertyBackend::AddPropertyListener(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, AudioObjectPropertyListenerProc inListenerProc, void* inClientData)
+{
+	CAMutex::Locker theLocker(mMutex);
+	RoundTrip();
+	Listener theListener = { inObjectID, CAPropertyAddress(inAddress), inListenerProc, inClientData };
+	mListeners.push_back(theListener);
+	return 0;
+}
+
+OSStatus	CAHALLocalPropertyBackend::RemovePropertyListener(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, AudioObjectPropertyListenerProc inListenerProc, void* inClientData)
+{
+	CAMutex::Locker theLocker(mMutex);
+	RoundTrip();
+	for(ListenerList::iterator theIterator = mListeners.begin(); theIterator != mListeners.end(); ++theIterator)
+	{
+		if((theIterator->mObjectID == inObjectID) && CAPropertyAddress::IsSameAddress(theIterator->mAddress, inAddress) && (theIterator->mListenerProc == inListenerProc) && (theIterator->mClientData == inClientData))
+		{
+			mListeners.erase(theIterator);
+			return 0;
+		}
+	}
+	return kAudioHardwareIllegalOperationError;
+}
+
+static UInt32	CAHALLocalPropertyBackend_ReadProperty(const CAHALAudioObject& inObject, const AudioObjectPropertyAddress& inAddress, UInt32 inValue)
+{
+	//	reads the property the way clients usually do and returns 1 if the answer is wrong
+	return (inObject.HasProperty(inAddress) && (inObject.GetPropertyData_UInt32(inAddress) == inValue)) ? 0 : 1;
+}
+
+bool	CAHALLocalPropertyBackend::MeasurePropertyCache(UInt32 inNumberProperties, UInt32 inNumberPasses, UInt32 inRoundTripMicroseconds, CacheStatistics& outStatistics)
+{
+	if((inNumberProperties == 0) || (inNumberPasses == 0))
+	{
+		return false;
+	}
+	
+	memset(&outStatistics, 0, sizeof(CacheStatistics));
+	outStatistics.mNumberProperties = inNumberProperties;
+	outStatistics.mRoundTripMicroseconds = inRoundTripMicroseconds;
+	
+	//	one object whose properties hold their own index
+	const AudioObjectID kObjectID = 1;
+	CAHALLocalPropertyBackend theBackend;
+	std::vector<AudioObjectPropertyAddress> theAddresses;
+	for(UInt32 theIndex = 0; theIndex < inNumberProperties; ++theIndex)
+	{
+		theAddresses.push_back(CAPropertyAddress('tst0' + theIndex));
+		theBackend.SetProperty_UInt32(kObjectID, theAddresses.back(), theIndex);
+	}
+	theBackend.SetRoundTripMicroseconds(inRoundTripMicroseconds);
+	
+	//	the objects use it in place of whatever they are using now for the duration
+	CAHALPropertyBackend* thePreviousBackend = &CAHALAudioObject::GetPropertyBackend();
+	CAHALAudioObject::SetPropertyBackend(&theBackend);
+	
+	UInt64 theNumberExtraRoundTrips = 0;
+	bool theAnswer = true;
+	try
+	{
+		CAHALAudioObject theObject(kObjectID);
+		
+		//	without the cache, every read goes to the server
+		theBackend.ResetNumberRoundTrips();
+		UInt64 theStartTime = CAHostTimeBase::GetCurrentTimeInNanos();
+		for(UInt32 thePass = 0; thePass < inNumberPasses; ++thePass)
+		{
+			for(UInt32 theIndex = 0; theIndex < inNumberProperties; ++theIndex)
+			{
+				outStatistics.mNumberWrongAnswers += CAHALLocalPropertyBackend_ReadProperty(theObject, theAddresses[theIndex], theIndex);
+			}
+		}
+		outStatistics.mUncachedReadMicroseconds = static_cast<Float64>(CAHostTimeBase::GetCurrentTimeInNanos() - theStartTime) / (1000.0 * inNumberPasses * inNumberProperties);
+		outStatistics.mUncachedRoundTrips = theBackend.GetNumberRoundTrips();
+		
+		//	with it, they are all fetched at once and then never again
+		theObject.EnablePropertyCache();
+		theBackend.ResetNumberRoundTrips();
+		theObject.PrefetchProperties(inNumberProperties, &theAddresses[0]);
+		outStatistics.mPrefetchRoundTrips = theBackend.GetNumberRoundTrips();
+		
+		theBackend.ResetNumberRoundTrips();
+		theStartTime = CAHostTimeBase::GetCurrentTimeInNanos();
+		for(UInt32 thePass = 0; thePass < inNumberPasses; ++thePass)
+		{
+			for(UInt32 theIndex = 0; theIndex < inNumberProperties; ++theIndex)
+			{
+				outStatistics.mNumberWrongAnswers += CAHALLocalPropertyBackend_ReadProperty(theObject, theAddresses[theIndex], theIndex);
+			}
+		}
+		outStatistics.mCachedReadMicroseconds = static_cast<Float64>(CAHostTimeBase::GetCurrentTimeInNanos() - theStartTime) / (1000.0 * inNumberPasses * inNumberProperties);
+		outStatistics.mCachedRoundTrips = theBackend.GetNumberRoundTrips();
+		
+		//	a change on the server side has to reach the cache through its listener, after which
+		//	the new value is fetched once (HasProperty, then the size and the data) and kept
+		theBackend.SetProperty_UInt32(kObjectID, theAddresses[0], inNumberProperties);
+		theBackend.ResetNumberRoundTrips();
+		outStatistics.mNumberWrongAnswers += CAHALLocalPropertyBackend_ReadProperty(theObject, theAddresses[0], inNumberProperties);
+		outStatistics.mRefetchRoundTrips = theBackend.GetNumberRoundTrips();
+		
+		theBackend.ResetNumberRoundTrips();
+		outStatistics.mNumberWrongAnswers += CAHALLocalPropertyBackend_ReadProperty(theObject, theAddresses[0], inNumberProperties);
+		theNumberExtraRoundTrips = theBackend.GetNumberRoundTrips();
+		
+		//	and so does one going away
+		theBackend.RemoveProperty(kObjectID, theAddresses[0]);
+		if(theObject.HasProperty(theAddresses[0]))
+		{
+			++outStatistics.mNumberWrongAnswers;
+		}
+		
+		theObject.GetPropertyCacheStatistics(outStatistics.mNumberHits, outStatistics.mNumberMisses);
+		
+		//	HasProperty is only cached for the addresses that ask for it
+		CAPropertyAddress theOtherAddress('xtra');
+		theBackend.ResetNumberRoundTrips();
+		theObject.HasProperty(theOtherAddress);
+		theObject.HasProperty(theOtherAddress);
+		outStatistics.mHasPropertyRoundTrips = theBackend.GetNumberRoundTrips();
+		
+		theObject.CacheHasProperty(theOtherAddress);
+		theBackend.ResetNumberRoundTrips();
+		theObject.HasProperty(theOtherAddress);
+		theObject.HasProperty(theOtherAddress);
+		outStatistics.mCachedHasPropertyRoundTrips = theBackend.GetNumberRoundTrips();
+		
+		//	a notification that was already on its way when the cache went away must not touch it
+		Listener theCacheListener = theBackend.mListeners.back();
+		theObject.DisablePropertyCache();
+		theCacheListener.mListenerProc(kObjectID, 1, &theAddresses[0], theCacheListener.mClientData);
+	}
+	catch(...)
+	{
+		theAnswer = false;
+	}
+	CAHALAudioObject::SetPropertyBackend(thePreviousBackend);
+	
+	theAnswer = theAnswer && (outStatistics.mNumberWrongAnswers == 0);
+	theAnswer = theAnswer && (outStatistics.mUncachedRoundTrips == 2ULL * inNumberPasses * inNumberProperties);
+	theAnswer = theAnswer && (outStatistics.mPrefetchRoundTrips == 1) && (outStatistics.mCachedRoundTrips == 0);
+	theAnswer = theAnswer && (outStatistics.mRefetchRoundTrips == 3) && (theNumberExtraRoundTrips == 0);
+	theAnswer = theAnswer && (outStatistics.mHasPropertyRoundTrips == 2) && (outStatistics.mCachedHasPropertyRoundTrips == 1);
+	return theAnswer;
+}
+
+void	CAHALLocalPropertyBackend::RoundTrip()
+{
+	//	the mutex is held, which serializes the calls the same way a single server would
+	++mNumberRoundTrips;
+	if(mRoundTripMicroseconds > 0)
+	{
+		usleep(mRoundTripMicroseconds);
+	}
+}
+
+void	CAHALLocalPropertyBackend::SendNotification(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress)
+{
+	//	the listeners are called with the mutex held so that once RemovePropertyListener returns,
+	//	the listener won't be called again (the mutex is recursive, so they can call back in)
+	CAMutex::Locker theLocker(mMutex);
+	ListenerList theListeners(mListeners);
+	for(ListenerList::const_iterator theIterator = theListeners.begin(); theIterator != theListeners.end(); ++theIterator)
+	{
+		if((theIterator->mObjectID == inObjectID) && CAPropertyAddress::IsCongruentAddress(theIterator->mAddress, inAddress))
+		{
+			theIterator->mListenerProc(inObjectID, 1, &inAddress, theIterator->mClientData);
+		}
+	}
+}
@@ -0,0 +1,169 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+#if !defined(__CAHALLocalPropertyBackend_h__)
+#define __CAHALLocalPropertyBackend_h__
+
+//==================================================================================================
+//	Includes
+//==================================================================================================
+
+//	Super Class Includes
+#include "CAHALPropertyBackend.h"
+
+//	PublicUtility Includes
+#include "CAMutex.h"
+
+//	Standard Library Includes
+#include <map>
+
+//==================================================================================================
+//	CAHALLocalPropertyBackend
+//
+//	A stand in for the HAL that keeps the properties of its objects in memory. The values are set
+//	up with SetProperty, which, like a change on the server side, notifies any listeners of a
+//	property that already existed. Qualifiers are ignored.
+//
+//	Every call a client makes counts as one round trip to the server, including a call to
+//	GetPropertyDataForAddresses, no matter how many properties it fetches. Each round trip can be
+//	made to take a fixed amount of time to approximate the cost of talking to the real server.
+//
+//	MeasurePropertyCache runs a CAHALAudioObject against one of these and checks that its property
+//	cache saves the round trips it should while still answering what the server has.
+//==================================================================================================
+
+class CAHALLocalPropertyBackend
+:
+	public CAHALPropertyBackend
+{
+
+//	Types
+public:
+	struct	CacheStatistics
+	{
+		UInt32	mNumberProperties;
+		UInt32	mRoundTripMicroseconds;
+		UInt64	mUncachedRoundTrips;			//	HasProperty and GetPropertyData on every property without the cache
+		UInt64	mPrefetchRoundTrips;			//	PrefetchProperties for all of them
+		UInt64	mCachedRoundTrips;				//	the same reads once they are cached
+		UInt64	mRefetchRoundTrips;				//	reading a property again after the server changed it
+		UInt64	mHasPropertyRoundTrips;			//	two HasProperty calls on an address that isn't cached
+		UInt64	mCachedHasPropertyRoundTrips;	//	the same once CacheHasProperty is called for it
+		UInt64	mNumberHits;
+		UInt64	mNumberMisses;
+		UInt32	mNumberWrongAnswers;			//	reads that didn't match what the server has
+		Float64	mUncachedReadMicroseconds;		//	per property
+		Float64	mCachedReadMicroseconds;		//	per property
+	};
+
+//	Construction/Destruction
+public:
+								CAHALLocalPropertyBackend();
+	virtual						~CAHALLocalPropertyBackend();
+
+//	Server Side Operations
+public:
+	void						SetProperty(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, UInt32 inDataSize, const void* inData, bool inIsSettable = false);
+	void						SetProperty_UInt32(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, UInt32 inValue, bool inIsSettable = false)	{ SetProperty(inObjectID, inAddress, SizeOf32(UInt32), &inValue, inIsSettable); }
+	void						SetProperty_Float64(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, Float64 inValue, bool inIsSettable = false)	{ SetProperty(inObjectID, inAddress, SizeOf32(Float64), &inValue, inIsSettable); }
+	void						RemoveProperty(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress);
+	void						RemoveAllProperties();
+	
+	void						SetRoundTripMicroseconds(UInt32 inMicroseconds)		{ mRoundTripMicroseconds = inMicroseconds; }
+	UInt32						GetRoundTripMicroseconds() const					{ return mRoundTripMicroseconds; }
+	UInt64						GetNumberRoundTrips() const							{ return mNumberRoundTrips; }
+	void						ResetNumberRoundTrips()								{ mNumberRoundTrips = 0; }
+
+//	CAHALPropertyBackend Overrides
+public:
+	virtual bool				HasProperty(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress);
+	virtual OSStatus			IsPropertySettable(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, Boolean& outIsSettable);
+	virtual OSStatus			GetPropertyDataSize(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, UInt32 inQualifierDataSize, const void* inQualifierData, UInt32& outDataSize);
+	virtual OSStatus			GetPropertyData(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, UInt32 inQualifierDataSize, const void* inQualifierData, UInt32& ioDataSize, void* outData);
+	virtual OSStatus			SetPropertyData(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, UInt32 inQualifierDataSize, const void* inQualifierData, UInt32 inDataSize, const void* inData);
+	virtual void				GetPropertyDataForAddresses(AudioObjectID inObjectID, PropertyRequestList& ioRequests);
+	
+	virtual OSStatus			AddPropertyListener(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, AudioObjectPropertyListenerProc inListenerProc, void* inClientData);
+	virtual OSStatus			RemovePropertyListener(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, AudioObjectPropertyListenerProc inListenerProc, void* inClientData);
+
+//	Benchmarks
+public:
+	static bool					MeasurePropertyCache(UInt32 inNumberProperties, UInt32 inNumberPasses, UInt32 inRoundTripMicroseconds, CacheStatistics& outStatistics);
+
+//	Implementation
+private:
+	struct	PropertyKey
+	{
+		AudioObjectID		mObjectID;
+		CAPropertyAddress	mAddress;
+		
+							PropertyKey(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress) : mObjectID(inObjectID), mAddress(inAddress) {}
+		bool				operator<(const PropertyKey& inKey) const { return (mObjectID != inKey.mObjectID) ? (mObjectID < inKey.mObjectID) : CAPropertyAddress::LessThan()(mAddress, inKey.mAddress); }
+	};
+	
+	struct	Property
+	{
+		std::vector<UInt8>	mData;
+		bool				mIsSettable;
+	};
+	
+	struct	Listener
+	{
+		AudioObjectID					mObjectID;
+		CAPropertyAddress				mAddress;
+		AudioObjectPropertyListenerProc	mListenerProc;
+		void*							mClientData;
+	};
+	
+	typedef std::map<PropertyKey, Property>	PropertyMap;
+	typedef std::vector<Listener>			ListenerList;
+	
+	void						RoundTrip();
+	void						SendNotification(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress);
+	
+	CAMutex						mMutex;
+	PropertyMap					mProperties;
+	ListenerList				mListeners;
+	UInt32						mRoundTripMicroseconds;
+	volatile UInt64				mNumberRoundTrips;
+
+};
+
+#endif
@@ -0,0 +1,120 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+//==================================================================================================
+//	Includes
+//==================================================================================================
+
+//	Self Include
+#include "CAHALPropertyBackend.h"
+
+//==================================================================================================
+//	CAHALPropertyBackend
+//==================================================================================================
+
+CAHALPropertyBackend::CAHALPropertyBackend()
+{
+}
+
+CAHALPropertyBackend::~CAHALPropertyBackend()
+{
+}
+
+CAHALPropertyBackend&	CAHALPropertyBackend::GetHALBackend()
+{
+	static CAHALPropertyBackend	sHALBackend;
+	return sHALBackend;
+}
+
+bool	CAHALPropertyBackend::HasProperty(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress)
+{
+	return AudioObjectHasProperty(inObjectID, &inAddress);
+}
+
+OSStatus	CAHALPropertyBackend::IsPropertySettable(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, Boolean& outIsSettable)
+{
+	return AudioObjectIsPropertySettable(inObjectID, &inAddress, &outIsSettable);
+}
+
+OSStatus	CAHALPropertyBackend::GetPropertyDataSize(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, UInt32 inQualifierDataSize, const void* inQualifierData, UInt32& outDataSize)
+{
+	return AudioObjectGetPropertyDataSize(inObjectID, &inAddress, inQualifierDataSize, inQualifierData, &outDataSize);
+}
+
+OSStatus	CAHALPropertyBackend::GetPropertyData(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, UInt32 inQualifierDataSize, const void* inQualifierData, UInt32& ioDataSize, void* outData)
+{
+	return AudioObjectGetPropertyData(inObjectID, &inAddress, inQualifierDataSize, inQualifierData, &ioDataSize, outData);
+}
+
+OSStatus	CAHALPropertyBackend::SetPropertyData(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, UInt32 inQualifierDataSize, const void* inQualifierData, UInt32 inDataSize, const void* inData)
+{
+	return AudioObjectSetPropertyData(inObjectID, &inAddress, inQualifierDataSize, inQualifierData, inDataSize, inData);
+}
+
+void	CAHALPropertyBackend::GetPropertyDataForAddresses(AudioObjectID inObjectID, PropertyRequestList& ioRequests)
+{
+	for(PropertyRequestList::iterator theRequest = ioRequests.begin(); theRequest != ioRequests.end(); ++theRequest)
+	{
+		theRequest->mData.clear();
+		theRequest->mError = 0;
+		theRequest->mHasProperty = HasProperty(inObjectID, theRequest->mAddress);
+		if(theRequest->mHasProperty)
+		{
+			UInt32 theDataSize = 0;
+			theRequest->mError = GetPropertyDataSize(inObjectID, theRequest->mAddress, 0, NULL, theDataSize);
+			if(theRequest->mError == 0)
+			{
+				theRequest->mData.resize(theDataSize);
+				theRequest->mError = GetPropertyData(inObjectID, theRequest->mAddress, 0, NULL, theDataSize, theRequest->mData.empty() ? NULL : &theRequest->mData[0]);
+				theRequest->mData.resize((theRequest->mError == 0) ? theDataSize : 0);
+			}
+		}
+	}
+}
+
+OSStatus	CAHALPropertyBackend::AddPropertyListener(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, AudioObjectPropertyListenerProc inListenerProc, void* inClientData)
+{
+	return AudioObjectAddPropertyListener(inObjectID, &inAddress, inListenerProc, inClientData);
+}
+
+OSStatus	CAHALPropertyBackend::RemovePropertyListener(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, AudioObjectPropertyListenerProc inListenerProc, void* inClientData)
+{
+	return AudioObjectRemovePropertyListener(inObjectID, &inAddress, inListenerProc, inClientData);
+}
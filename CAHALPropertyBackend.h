@@ -0,0 +1,117 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+#if !defined(__CAHALPropertyBackend_h__)
+#define __CAHALPropertyBackend_h__
+
+//==================================================================================================
+//	Includes
+//==================================================================================================
+
+//	PublicUtility Includes
+#include "CAPropertyAddress.h"
+
+//	System Includes
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudio.h>
+#else
+	#include <CoreAudio.h>
+#endif
+
+//	Standard Library Includes
+#include <vector>
+
+//==================================================================================================
+//	CAHALPropertyBackend
+//
+//	CAHALAudioObject and its subclasses make all their property calls through an instance of this
+//	class. The base class simply passes them on to the HAL. Subclasses can stand in for the HAL,
+//	which makes it possible to exercise the property code without any hardware, or even on a
+//	system that doesn't have the HAL at all.
+//
+//	GetPropertyDataForAddresses fetches several properties of an object at once. The HAL doesn't
+//	have a call for that, so the base class makes them one at a time, but a subclass that can do
+//	better should.
+//==================================================================================================
+
+class CAHALPropertyBackend
+{
+
+//	Types
+public:
+	struct	PropertyRequest
+	{
+		CAPropertyAddress	mAddress;
+		OSStatus			mError;
+		bool				mHasProperty;
+		std::vector<UInt8>	mData;
+		
+							PropertyRequest() : mAddress(), mError(0), mHasProperty(false), mData() {}
+							PropertyRequest(const AudioObjectPropertyAddress& inAddress) : mAddress(inAddress), mError(0), mHasProperty(false), mData() {}
+	};
+	typedef std::vector<PropertyRequest>	PropertyRequestList;
+
+//	Construction/Destruction
+public:
+								CAHALPropertyBackend();
+	virtual						~CAHALPropertyBackend();
+
+	static CAHALPropertyBackend&	GetHALBackend();
+
+//	Operations
+public:
+	virtual bool				HasProperty(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress);
+	virtual OSStatus			IsPropertySettable(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, Boolean& outIsSettable);
+	virtual OSStatus			GetPropertyDataSize(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, UInt32 inQualifierDataSize, const void* inQualifierData, UInt32& outDataSize);
+	virtual OSStatus			GetPropertyData(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, UInt32 inQualifierDataSize, const void* inQualifierData, UInt32& ioDataSize, void* outData);
+	virtual OSStatus			SetPropertyData(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, UInt32 inQualifierDataSize, const void* inQualifierData, UInt32 inDataSize, const void* inData);
+	virtual void				GetPropertyDataForAddresses(AudioObjectID inObjectID, PropertyRequestList& ioRequests);
+	
+	virtual OSStatus			AddPropertyListener(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, AudioObjectPropertyListenerProc inListenerProc, void* inClientData);
+	virtual OSStatus			RemovePropertyListener(AudioObjectID inObjectID, const AudioObjectPropertyAddress& inAddress, AudioObjectPropertyListenerProc inListenerProc, void* inClientData);
+
+//	Implementation
+private:
+								CAHALPropertyBackend(const CAHALPropertyBackend&);
+	CAHALPropertyBackend&		operator=(const CAHALPropertyBackend&);
+
+};
+
+#endif
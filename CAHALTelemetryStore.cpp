@@ -0,0 +1,548 @@
+/*	Copyright: 	 Copyright 2003 Apple Computer, Inc. All rights reserved.
+
+	Disclaimer:	IMPORTANT:  This Apple software is supplied to you by Apple Computer, Inc.
+			("Apple") in consideration of your agreement to the following terms, and your
+			use, installation, modification or redistribution of this Apple software
+			constitutes acceptance of these terms.  If you do not agree with these terms,
+			please do not use, install, modify or redistribute this Apple software.
+
+			In consideration of your agreement to abide by the following terms, and subject
+			to these terms, Apple grants you a personal, non-exclusive license, under Apples
+			copyrights in this original Apple software (the "Apple Software"), to use,
+			reproduce, modify and redistribute the Apple Software, with or without
+			modifications, in source and/or binary forms; provided that if you redistribute
+			the Apple Software in its entirety and without modifications, you must retain
+			this notice and the following text and disclaimers in all such redistributions of
+			the Apple Software.  Neither the name, trademarks, service marks or logos of
+			Apple Computer, Inc. may be used to endorse or promote products derived from the
+			Apple Software without specific prior written permission from Apple.  Except as
+			expressly stated in this notice, no other rights or licenses, express or implied,
+			are granted by Apple herein, including but not limited to any patent rights that
+			may be infringed by your derivative works or by other works in which the Apple
+			Software may be incorporated.
+
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+			WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+			WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+			PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION ALONE OR IN
+			COMBINATION WITH YOUR PRODUCTS.
+
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+			CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+			GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+			ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION AND/OR DISTRIBUTION
+			OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER UNDER THEORY OF CONTRACT, TORT
+			(INCLUDING NEGLIGENCE), STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN
+			ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CAHALTelemetryStore.cpp
+
+=============================================================================*/
+
+//=============================================================================
+//	Includes
+//=============================================================================
+
+//	Self Include
+#include "CAHALTelemetryStore.h"
+
+//	PublicUtility Includes
+#include "CAHostTimeBase.h"
+
+//	System Includes
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//	Standard Library Includes
+#include <algorithm>
+
+//=============================================================================
+//	CAHALTelemetryStore
+//=============================================================================
+
+CAHALTelemetryStore::CAHALTelemetryStore()
+:
+	mMapping(NULL),
+	mMappingSize(0),
+	mIsReadOnly(false),
+	mHeader(NULL),
+	mEvents(NULL),
+	mIOCycles(NULL),
+	mNanosPerHostTick(0),
+	mErrorEvents(),
+	mErrorIOCycles(),
+	mOverloadIOCycles()
+{
+}
+
+CAHALTelemetryStore::~CAHALTelemetryStore()
+{
+	Close();
+}
+
+bool	CAHALTelemetryStore::Open(const char* inCapturePath, UInt32 inMaximumNumberEvents)
+{
+	Close();
+
+	if(inMaximumNumberEvents == 0)
+	{
+		inMaximumNumberEvents = kDefaultMaximumNumberEvents;
+	}
+	UInt64 theSize = sizeof(CaptureHeader) + ((UInt64)inMaximumNumberEvents * (sizeof(CAHALIOCycleRawTelemetryEvent) + sizeof(IOCycleRecord)));
+
+	bool theAnswer = false;
+	if(inCapturePath != NULL)
+	{
+		//	the capture file is sized up front so the mapping never has to grow
+		int theFile = open(inCapturePath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if(theFile >= 0)
+		{
+			if(ftruncate(theFile, theSize) == 0)
+			{
+				theAnswer = Map(theFile, theSize, false);
+			}
+			close(theFile);
+		}
+	}
+	else
+	{
+		//	no capture file, so the store lives in anonymous memory
+		theAnswer = Map(-1, theSize, false);
+	}
+
+	if(theAnswer)
+	{
+		memset(mHeader, 0, sizeof(CaptureHeader));
+		mHeader->mMagic = kCaptureMagic;
+		mHeader->mVersion = kCaptureVersion;
+		mHeader->mHeaderSize = sizeof(CaptureHeader);
+		mHeader->mEventRecordSize = sizeof(CAHALIOCycleRawTelemetryEvent);
+		mHeader->mIOCycleRecordSize = sizeof(IOCycleRecord);
+		mHeader->mMaximumNumberEvents = inMaximumNumberEvents;
+
+		//	this also gets the host clock set up before the first event has to be converted
+		mHeader->mHostTicksPerSecond = CAHostTimeBase::GetFrequency();
+		mNanosPerHostTick = 1000000000.0 / mHeader->mHostTicksPerSecond;
+	}
+
+	return theAnswer;
+}
+
+bool	CAHALTelemetryStore::OpenCapture(const char* inCapturePath)
+{
+	Close();
+
+	bool theAnswer = false;
+	int theFile = open(inCapturePath, O_RDONLY);
+	if(theFile >= 0)
+	{
+		struct stat theFileInfo;
+		if((fstat(theFile, &theFileInfo) == 0) && ((UInt64)theFileInfo.st_size >= sizeof(CaptureHeader)))
+		{
+			theAnswer = Map(theFile, theFileInfo.st_size, true);
+		}
+		close(theFile);
+	}
+
+	if(theAnswer)
+	{
+		//	make sure this is a capture we know how to read, written with the same byte order
+		UInt64 theMaximumNumberEvents = mHeader->mMaximumNumberEvents;
+		bool isValid = (mHeader->mMagic == kCaptureMagic) && (mHeader->mVersion == kCaptureVersion);
+		isValid = isValid && (mHeader->mHeaderSize == sizeof(CaptureHeader));
+		isValid = isValid && (mHeader->mEventRecordSize == sizeof(CAHALIOCycleRawTelemetryEvent));
+		isValid = isValid && (mHeader->mIOCycleRecordSize == sizeof(IOCycleRecord));
+		isValid = isValid && (theMaximumNumberEvents > 0);
+		isValid = isValid && (mHeader->mHostTicksPerSecond > 0);
+		isValid = isValid && (mMappingSize >= sizeof(CaptureHeader) + (theMaximumNumberEvents * (sizeof(CAHALIOCycleRawTelemetryEvent) + sizeof(IOCycleRecord))));
+		isValid = isValid && (mHeader->mFirstIOCycleNumber <= mHeader->mNextIOCycleNumber);
+		isValid = isValid && ((mHeader->mNextIOCycleNumber - mHeader->mFirstIOCycleNumber) <= theMaximumNumberEvents);
+		if(isValid)
+		{
+			mNanosPerHostTick = 1000000000.0 / mHeader->mHostTicksPerSecond;
+			RebuildIndexes();
+		}
+		else
+		{
+			Close();
+			theAnswer = false;
+		}
+	}
+
+	return theAnswer;
+}
+
+void	CAHALTelemetryStore::Close()
+{
+	if(mMapping != NULL)
+	{
+		munmap(mMapping, mMappingSize);
+	}
+	mMapping = NULL;
+	mMappingSize = 0;
+	mIsReadOnly = false;
+	mHeader = NULL;
+	mEvents = NULL;
+	mIOCycles = NULL;
+	mNanosPerHostTick = 0;
+	mErrorEvents.clear();
+	mErrorIOCycles.clear();
+	mOverloadIOCycles.clear();
+}
+
+void	CAHALTelemetryStore::AppendEvent(const CAHALIOCycleRawTelemetryEvent& inEvent, bool inIsError, bool inIsSignal)
+{
+	if(IsOpen() && !mIsReadOnly)
+	{
+		//	make room for the new event
+		UInt64 theEventNumber = mHeader->mNextEventNumber;
+		if(theEventNumber >= mHeader->mMaximumNumberEvents)
+		{
+			DiscardThrough(theEventNumber - mHeader->mMaximumNumberEvents + 1);
+		}
+
+		//	write the event, marking it with what the store needs to know about it
+		CAHALIOCycleRawTelemetryEvent& theRecord = EventRecord(theEventNumber);
+		theRecord = inEvent;
+		theRecord.mFlags &= ~kEventFlagsMask;
+		if(inIsError)
+		{
+			theRecord.mFlags |= kEventFlagIsError;
+			mErrorEvents.push_back(theEventNumber);
+		}
+		if(inIsSignal)
+		{
+			theRecord.mFlags |= kEventFlagIsSignal;
+		}
+		mHeader->mNextEventNumber = theEventNumber + 1;
+
+		//	figure out what the event says about its IO cycle
+		UInt32 theIOCycleFlags = 0;
+		if(inIsError)
+		{
+			theIOCycleFlags |= kIOCycleFlagHasError;
+		}
+		if(inIsSignal)
+		{
+			theIOCycleFlags |= kIOCycleFlagHasSignal;
+		}
+		if((inEvent.mEventKind == kHALIOCycleTelemetryEventWorkLoopOverloadBegin) || (inEvent.mEventKind == kHALIOCycleTelemetryEventWorkLoopOverloadEnd))
+		{
+			theIOCycleFlags |= kIOCycleFlagHasOverload;
+		}
+		if(inEvent.mEventKind == kHALIOCycleTelemetryEventZeroTimeStampRecieved)
+		{
+			theIOCycleFlags |= kIOCycleFlagHasZeroTime;
+		}
+
+		//	the event belongs to the last IO cycle if it has the same cycle number
+		UInt64 theIOCycleNumber = mHeader->mNextIOCycleNumber;
+		UInt32 theOldIOCycleFlags = 0;
+		bool wasPlaced = false;
+		if(mHeader->mFirstIOCycleNumber < mHeader->mNextIOCycleNumber)
+		{
+			IOCycleRecord& theLastIOCycle = IOCycleRecordFor(mHeader->mNextIOCycleNumber - 1);
+			if((theLastIOCycle.mIOCycleNumber == inEvent.mIOCycleNumber) && ((theLastIOCycle.mFirstEventNumber + theLastIOCycle.mNumberEvents) == theEventNumber))
+			{
+				theIOCycleNumber = mHeader->mNextIOCycleNumber - 1;
+				theOldIOCycleFlags = theLastIOCycle.mFlags;
+				++theLastIOCycle.mNumberEvents;
+				theLastIOCycle.mFlags |= theIOCycleFlags;
+				wasPlaced = true;
+			}
+		}
+
+		//	didn't belong there, so start a new one
+		if(!wasPlaced)
+		{
+			IOCycleRecord& theNewIOCycle = IOCycleRecordFor(theIOCycleNumber);
+			theNewIOCycle.mFirstEventNumber = theEventNumber;
+			theNewIOCycle.mNumberEvents = 1;
+			theNewIOCycle.mIOCycleNumber = inEvent.mIOCycleNumber;
+			theNewIOCycle.mFlags = theIOCycleFlags;
+			theNewIOCycle.mReserved = 0;
+			mHeader->mNextIOCycleNumber = theIOCycleNumber + 1;
+		}
+
+		//	index the cycle the first time it picks up an error or an overload
+		UInt32 theNewIOCycleFlags = theIOCycleFlags & ~theOldIOCycleFlags;
+		if((theNewIOCycleFlags & kIOCycleFlagHasError) != 0)
+		{
+			mErrorIOCycles.push_back(theIOCycleNumber);
+		}
+		if((theNewIOCycleFlags & kIOCycleFlagHasOverload) != 0)
+		{
+			mOverloadIOCycles.push_back(theIOCycleNumber);
+		}
+	}
+}
+
+void	CAHALTelemetryStore::Clear()
+{
+	if(!mIsReadOnly)
+	{
+		if(IsOpen())
+		{
+			mHeader->mNextEventNumber = 0;
+			mHeader->mFirstIOCycleNumber = 0;
+			mHeader->mNextIOCycleNumber = 0;
+		}
+		mErrorEvents.clear();
+		mErrorIOCycles.clear();
+		mOverloadIOCycles.clear();
+	}
+}
+
+void	CAHALTelemetryStore::Flush()
+{
+	if(IsOpen() && !mIsReadOnly)
+	{
+		//	schedule the write back of a file backed store without waiting for it
+		msync(mMapping, mMappingSize, MS_ASYNC);
+	}
+}
+
+Float64	CAHALTelemetryStore::GetHostTicksPerSecond() const
+{
+	return IsOpen() ? mHeader->mHostTicksPerSecond : CAHostTimeBase::GetFrequency();
+}
+
+UInt64	CAHALTelemetryStore::ConvertHostTimeToNanos(UInt64 inHostTime) const
+{
+	//	a capture keeps the timebase it was recorded with, the live store uses this host's
+	UInt64 theAnswer;
+	if(mIsReadOnly)
+	{
+		theAnswer = static_cast<UInt64>(static_cast<Float64>(inHostTime) * mNanosPerHostTick);
+	}
+	else
+	{
+		theAnswer = CAHostTimeBase::ConvertToNanos(inHostTime);
+	}
+	return theAnswer;
+}
+
+UInt32	CAHALTelemetryStore::GetMaximumNumberEvents() const
+{
+	return IsOpen() ? mHeader->mMaximumNumberEvents : 0;
+}
+
+UInt64	CAHALTelemetryStore::GetNumberEventsDiscarded() const
+{
+	return GetFirstEventNumber();
+}
+
+UInt32	CAHALTelemetryStore::GetNumberEvents() const
+{
+	return IsOpen() ? (UInt32)(mHeader->mNextEventNumber - GetFirstEventNumber()) : 0;
+}
+
+bool	CAHALTelemetryStore::GetEvent(UInt32 inEventIndex, CAHALIOCycleRawTelemetryEvent& outEvent) const
+{
+	bool theAnswer = false;
+	if(inEventIndex < GetNumberEvents())
+	{
+		outEvent = EventRecord(GetFirstEventNumber() + inEventIndex);
+		outEvent.mFlags &= ~kEventFlagsMask;
+		theAnswer = true;
+	}
+	return theAnswer;
+}
+
+bool	CAHALTelemetryStore::IsEventError(UInt32 inEventIndex) const
+{
+	bool theAnswer = false;
+	if(inEventIndex < GetNumberEvents())
+	{
+		theAnswer = (EventRecord(GetFirstEventNumber() + inEventIndex).mFlags & kEventFlagIsError) != 0;
+	}
+	return theAnswer;
+}
+
+bool	CAHALTelemetryStore::IsEventSignal(UInt32 inEventIndex) const
+{
+	bool theAnswer = false;
+	if(inEventIndex < GetNumberEvents())
+	{
+		theAnswer = (EventRecord(GetFirstEventNumber() + inEventIndex).mFlags & kEventFlagIsSignal) != 0;
+	}
+	return theAnswer;
+}
+
+UInt32	CAHALTelemetryStore::GetPreviousErrorEventIndex(UInt32 inCurrentIndex) const
+{
+	return FindPrevious(mErrorEvents, GetFirstEventNumber(), GetNumberEvents(), inCurrentIndex);
+}
+
+UInt32	CAHALTelemetryStore::GetNextErrorEventIndex(UInt32 inCurrentIndex) const
+{
+	return FindNext(mErrorEvents, GetFirstEventNumber(), GetNumberEvents(), inCurrentIndex);
+}
+
+UInt32	CAHALTelemetryStore::GetNumberIOCycles() const
+{
+	return IsOpen() ? (UInt32)(mHeader->mNextIOCycleNumber - mHeader->mFirstIOCycleNumber) : 0;
+}
+
+UInt64	CAHALTelemetryStore::GetNumberIOCyclesDiscarded() const
+{
+	return IsOpen() ? mHeader->mFirstIOCycleNumber : 0;
+}
+
+bool	CAHALTelemetryStore::GetIOCycleEvents(UInt32 inIOCycleIndex, UInt32& outFirstEventIndex, UInt32& outNumberEvents) const
+{
+	bool theAnswer = false;
+	if(inIOCycleIndex < GetNumberIOCycles())
+	{
+		//	IO cycles are discarded with their first event, so the whole run is still in the store
+		const IOCycleRecord& theIOCycle = IOCycleRecordFor(mHeader->mFirstIOCycleNumber + inIOCycleIndex);
+		outFirstEventIndex = (UInt32)(theIOCycle.mFirstEventNumber - GetFirstEventNumber());
+		outNumberEvents = theIOCycle.mNumberEvents;
+		theAnswer = true;
+	}
+	return theAnswer;
+}
+
+UInt32	CAHALTelemetryStore::GetIOCycleFlags(UInt32 inIOCycleIndex) const
+{
+	UInt32 theAnswer = 0;
+	if(inIOCycleIndex < GetNumberIOCycles())
+	{
+		theAnswer = IOCycleRecordFor(mHeader->mFirstIOCycleNumber + inIOCycleIndex).mFlags;
+	}
+	return theAnswer;
+}
+
+UInt32	CAHALTelemetryStore::GetPreviousErrorIOCycleIndex(UInt32 inCurrentIndex) const
+{
+	return IsOpen() ? FindPrevious(mErrorIOCycles, mHeader->mFirstIOCycleNumber, GetNumberIOCycles(), inCurrentIndex) : kNoIndex;
+}
+
+UInt32	CAHALTelemetryStore::GetNextErrorIOCycleIndex(UInt32 inCurrentIndex) const
+{
+	return IsOpen() ? FindNext(mErrorIOCycles, mHeader->mFirstIOCycleNumber, GetNumberIOCycles(), inCurrentIndex) : kNoIndex;
+}
+
+UInt32	CAHALTelemetryStore::GetPreviousOverloadIOCycleIndex(UInt32 inCurrentIndex) const
+{
+	return IsOpen() ? FindPrevious(mOverloadIOCycles, mHeader->mFirstIOCycleNumber, GetNumberIOCycles(), inCurrentIndex) : kNoIndex;
+}
+
+UInt32	CAHALTelemetryStore::GetNextOverloadIOCycleIndex(UInt32 inCurrentIndex) const
+{
+	return IsOpen() ? FindNext(mOverloadIOCycles, mHeader->mFirstIOCycleNumber, GetNumberIOCycles(), inCurrentIndex) : kNoIndex;
+}
+
+bool	CAHALTelemetryStore::Map(int inFile, UInt64 inSize, bool inReadOnly)
+{
+	int theProtection = inReadOnly ? PROT_READ : (PROT_READ | PROT_WRITE);
+	int theFlags = (inFile >= 0) ? (inReadOnly ? MAP_PRIVATE : MAP_SHARED) : (MAP_PRIVATE | MAP_ANON);
+	void* theMapping = mmap(NULL, inSize, theProtection, theFlags, inFile, 0);
+	bool theAnswer = theMapping != MAP_FAILED;
+	if(theAnswer)
+	{
+		mMapping = theMapping;
+		mMappingSize = inSize;
+		mIsReadOnly = inReadOnly;
+		mHeader = static_cast<CaptureHeader*>(theMapping);
+		mEvents = reinterpret_cast<CAHALIOCycleRawTelemetryEvent*>(static_cast<char*>(theMapping) + sizeof(CaptureHeader));
+
+		//	the cycle ring follows the event ring, which is only known once the header is valid
+		UInt64 theMaximumNumberEvents = inReadOnly ? mHeader->mMaximumNumberEvents : (inSize - sizeof(CaptureHeader)) / (sizeof(CAHALIOCycleRawTelemetryEvent) + sizeof(IOCycleRecord));
+		mIOCycles = reinterpret_cast<IOCycleRecord*>(reinterpret_cast<char*>(mEvents) + (theMaximumNumberEvents * sizeof(CAHALIOCycleRawTelemetryEvent)));
+	}
+	return theAnswer;
+}
+
+void	CAHALTelemetryStore::RebuildIndexes()
+{
+	mErrorEvents.clear();
+	mErrorIOCycles.clear();
+	mOverloadIOCycles.clear();
+
+	for(UInt64 theEventNumber = GetFirstEventNumber(); theEventNumber < mHeader->mNextEventNumber; ++theEventNumber)
+	{
+		if((EventRecord(theEventNumber).mFlags & kEventFlagIsError) != 0)
+		{
+			mErrorEvents.push_back(theEventNumber);
+		}
+	}
+
+	for(UInt64 theIOCycleNumber = mHeader->mFirstIOCycleNumber; theIOCycleNumber < mHeader->mNextIOCycleNumber; ++theIOCycleNumber)
+	{
+		UInt32 theFlags = IOCycleRecordFor(theIOCycleNumber).mFlags;
+		if((theFlags & kIOCycleFlagHasError) != 0)
+		{
+			mErrorIOCycles.push_back(theIOCycleNumber);
+		}
+		if((theFlags & kIOCycleFlagHasOverload) != 0)
+		{
+			mOverloadIOCycles.push_back(theIOCycleNumber);
+		}
+	}
+}
+
+void	CAHALTelemetryStore::DiscardThrough(UInt64 inFirstEventNumber)
+{
+	//	an IO cycle goes as soon as its first event does
+	while((mHeader->mFirstIOCycleNumber < mHeader->mNextIOCycleNumber) && (IOCycleRecordFor(mHeader->mFirstIOCycleNumber).mFirstEventNumber < inFirstEventNumber))
+	{
+		++mHeader->mFirstIOCycleNumber;
+	}
+
+	while(!mErrorEvents.empty() && (mErrorEvents.front() < inFirstEventNumber))
+	{
+		mErrorEvents.pop_front();
+	}
+	while(!mErrorIOCycles.empty() && (mErrorIOCycles.front() < mHeader->mFirstIOCycleNumber))
+	{
+		mErrorIOCycles.pop_front();
+	}
+	while(!mOverloadIOCycles.empty() && (mOverloadIOCycles.front() < mHeader->mFirstIOCycleNumber))
+	{
+		mOverloadIOCycles.pop_front();
+	}
+}
+
+UInt64	CAHALTelemetryStore::GetFirstEventNumber() const
+{
+	UInt64 theAnswer = 0;
+	if(IsOpen() && (mHeader->mNextEventNumber > mHeader->mMaximumNumberEvents))
+	{
+		theAnswer = mHeader->mNextEventNumber - mHeader->mMaximumNumberEvents;
+	}
+	return theAnswer;
+}
+
+UInt32	CAHALTelemetryStore::FindPrevious(const Index& inIndex, UInt64 inFirstNumber, UInt64 inNumberItems, UInt32 inCurrentIndex)
+{
+	//	the last indexed item before the current one, or the last one overall if the current index is out of range
+	UInt32 theAnswer = kNoIndex;
+	UInt64 theLimit = inFirstNumber + ((inCurrentIndex < inNumberItems) ? inCurrentIndex : inNumberItems);
+	Index::const_iterator theIterator = std::lower_bound(inIndex.begin(), inIndex.end(), theLimit);
+	if(theIterator != inIndex.begin())
+	{
+		--theIterator;
+		if(*theIterator >= inFirstNumber)
+		{
+			theAnswer = (UInt32)(*theIterator - inFirstNumber);
+		}
+	}
+	return theAnswer;
+}
+
+UInt32	CAHALTelemetryStore::FindNext(const Index& inIndex, UInt64 inFirstNumber, UInt64 inNumberItems, UInt32 inCurrentIndex)
+{
+	//	the first indexed item after the current one, or the first one overall if the current index is out of range
+	UInt32 theAnswer = kNoIndex;
+	UInt64 theStart = inFirstNumber + ((inCurrentIndex < inNumberItems) ? (inCurrentIndex + 1) : 0);
+	Index::const_iterator theIterator = std::lower_bound(inIndex.begin(), inIndex.end(), theStart);
+	if((theIterator != inIndex.end()) && (*theIterator < inFirstNumber + inNumberItems))
+	{
+		theAnswer = (UInt32)(*theIterator - inFirstNumber);
+	}
+	return theAnswer;
+}
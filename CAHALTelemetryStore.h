@@ -0,0 +1,210 @@
+/*	Copyright: 	 Copyright 2003 Apple Computer, Inc. All rights reserved.
+
+	Disclaimer:	IMPORTANT:  This Apple software is supplied to you by Apple Computer, Inc.
+			("Apple") in consideration of your agreement to the following terms, and your
+			use, installation, modification or redistribution of this Apple software
+			constitutes acceptance of these terms.  If you do not agree with these terms,
+			please do not use, install, modify or redistribute this Apple software.
+
+			In consideration of your agreement to abide by the following terms, and subject
+			to these terms, Apple grants you a personal, non-exclusive license, under Apples
+			copyrights in this original Apple software (the "Apple Software"), to use,
+			reproduce, modify and redistribute the Apple Software, with or without
+			modifications, in source and/or binary forms; provided that if you redistribute
+			the Apple Software in its entirety and without modifications, you must retain
+			this notice and the following text and disclaimers in all such redistributions of
+			the Apple Software.  Neither the name, trademarks, service marks or logos of
+			Apple Computer, Inc. may be used to endorse or promote products derived from the
+			Apple Software without specific prior written permission from Apple.  Except as
+			expressly stated in this notice, no other rights or licenses, express or implied,
+			are granted by Apple herein, including but not limited to any patent rights that
+			may be infringed by your derivative works or by other works in which the Apple
+			Software may be incorporated.
+
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+			WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+			WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+			PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION ALONE OR IN
+			COMBINATION WITH YOUR PRODUCTS.
+
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+			CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+			GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+			ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION AND/OR DISTRIBUTION
+			OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER UNDER THEORY OF CONTRACT, TORT
+			(INCLUDING NEGLIGENCE), STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN
+			ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CAHALTelemetryStore.h
+
+=============================================================================*/
+#if !defined(__CAHALTelemetryStore_h__)
+#define __CAHALTelemetryStore_h__
+
+//=============================================================================
+//	Includes
+//=============================================================================
+
+//	PublicUtility Includes
+#include "CAHALTelemetry.h"
+
+//	Standard Library Includes
+#include <deque>
+
+//=============================================================================
+//	CAHALTelemetryStore
+//
+//	This class keeps a bounded window of raw IO cycle telemetry in a memory
+//	mapped circular buffer. Once the buffer is full, the oldest events and the
+//	IO cycles that started with them are discarded to make room.
+//
+//	The mapping can be backed by a capture file. The file holds a small header,
+//	the ring of fixed size event records and a ring of IO cycle records that
+//	describe the run of events making up each cycle. Because all the state lives
+//	in the mapping, a capture can be reopened later with OpenCapture for offline
+//	analysis. This class only depends on POSIX, so that works on Linux too.
+//
+//	Event times are host times, so the header also records the frequency of the
+//	host clock that wrote them. A reopened capture converts its times with that
+//	instead of the clock of the machine or boot reading it.
+//
+//	Errors, overloads and signal are indexed by absolute event and cycle number.
+//	The indexes are sorted by construction, so finding the next or previous one
+//	is a binary search.
+//
+//	Indexes passed in and out of this class are relative to the oldest event or
+//	IO cycle still in the store. 0xFFFFFFFF means there is no such item.
+//=============================================================================
+
+class CAHALTelemetryStore
+{
+
+//	Constants
+public:
+	enum
+	{
+		kDefaultMaximumNumberEvents	= 256 * 1024,
+		kNoIndex					= 0xFFFFFFFF
+	};
+
+	enum
+	{
+		//	flags the store keeps per event, in the high bits of mFlags
+		kEventFlagIsError			= 0x40000000,
+		kEventFlagIsSignal			= 0x80000000,
+		kEventFlagsMask				= kEventFlagIsError | kEventFlagIsSignal
+	};
+
+	enum
+	{
+		//	flags the store keeps per IO cycle
+		kIOCycleFlagHasError		= (1UL << 0),
+		kIOCycleFlagHasOverload		= (1UL << 1),
+		kIOCycleFlagHasSignal		= (1UL << 2),
+		kIOCycleFlagHasZeroTime		= (1UL << 3)
+	};
+
+//	Construction/Destruction
+public:
+					CAHALTelemetryStore();
+					~CAHALTelemetryStore();
+
+	bool			Open(const char* inCapturePath, UInt32 inMaximumNumberEvents);
+	bool			OpenCapture(const char* inCapturePath);
+	void			Close();
+
+	bool			IsOpen() const { return mHeader != NULL; }
+	bool			IsReadOnly() const { return mIsReadOnly; }
+
+//	Operations
+public:
+	void			AppendEvent(const CAHALIOCycleRawTelemetryEvent& inEvent, bool inIsError, bool inIsSignal);
+	void			Clear();
+	void			Flush();
+
+	Float64			GetHostTicksPerSecond() const;
+	UInt64			ConvertHostTimeToNanos(UInt64 inHostTime) const;
+
+	UInt32			GetMaximumNumberEvents() const;
+	UInt64			GetNumberEventsDiscarded() const;
+
+	UInt32			GetNumberEvents() const;
+	bool			GetEvent(UInt32 inEventIndex, CAHALIOCycleRawTelemetryEvent& outEvent) const;
+	bool			IsEventError(UInt32 inEventIndex) const;
+	bool			IsEventSignal(UInt32 inEventIndex) const;
+	UInt32			GetPreviousErrorEventIndex(UInt32 inCurrentIndex) const;
+	UInt32			GetNextErrorEventIndex(UInt32 inCurrentIndex) const;
+
+	UInt32			GetNumberIOCycles() const;
+	UInt64			GetNumberIOCyclesDiscarded() const;
+	bool			GetIOCycleEvents(UInt32 inIOCycleIndex, UInt32& outFirstEventIndex, UInt32& outNumberEvents) const;
+	UInt32			GetIOCycleFlags(UInt32 inIOCycleIndex) const;
+	UInt32			GetPreviousErrorIOCycleIndex(UInt32 inCurrentIndex) const;
+	UInt32			GetNextErrorIOCycleIndex(UInt32 inCurrentIndex) const;
+	UInt32			GetPreviousOverloadIOCycleIndex(UInt32 inCurrentIndex) const;
+	UInt32			GetNextOverloadIOCycleIndex(UInt32 inCurrentIndex) const;
+
+//	Implementation
+private:
+	enum
+	{
+		kCaptureMagic		= 'halt',
+		kCaptureVersion		= 2
+	};
+
+	struct	CaptureHeader
+	{
+		UInt32	mMagic;
+		UInt32	mVersion;
+		UInt32	mHeaderSize;
+		UInt32	mEventRecordSize;
+		UInt32	mIOCycleRecordSize;
+		UInt32	mMaximumNumberEvents;
+		UInt64	mNextEventNumber;
+		UInt64	mFirstIOCycleNumber;
+		UInt64	mNextIOCycleNumber;
+		Float64	mHostTicksPerSecond;
+		UInt64	mReserved;
+	};
+
+	//	the events are stored as CAHALIOCycleRawTelemetryEvent, which has no padding
+	struct	IOCycleRecord
+	{
+		UInt64	mFirstEventNumber;
+		UInt32	mNumberEvents;
+		UInt32	mIOCycleNumber;
+		UInt32	mFlags;
+		UInt32	mReserved;
+	};
+
+	typedef std::deque<UInt64>	Index;
+
+									CAHALTelemetryStore(const CAHALTelemetryStore&);
+	CAHALTelemetryStore&			operator=(const CAHALTelemetryStore&);
+
+	bool							Map(int inFile, UInt64 inSize, bool inReadOnly);
+	void							RebuildIndexes();
+	void							DiscardThrough(UInt64 inFirstEventNumber);
+
+	UInt64							GetFirstEventNumber() const;
+	CAHALIOCycleRawTelemetryEvent&	EventRecord(UInt64 inEventNumber) const		{ return mEvents[inEventNumber % mHeader->mMaximumNumberEvents]; }
+	IOCycleRecord&					IOCycleRecordFor(UInt64 inIOCycleNumber) const	{ return mIOCycles[inIOCycleNumber % mHeader->mMaximumNumberEvents]; }
+
+	static UInt32					FindPrevious(const Index& inIndex, UInt64 inFirstNumber, UInt64 inNumberItems, UInt32 inCurrentIndex);
+	static UInt32					FindNext(const Index& inIndex, UInt64 inFirstNumber, UInt64 inNumberItems, UInt32 inCurrentIndex);
+
+	void*							mMapping;
+	UInt64							mMappingSize;
+	bool							mIsReadOnly;
+	CaptureHeader*					mHeader;
+	CAHALIOCycleRawTelemetryEvent*	mEvents;
+	IOCycleRecord*					mIOCycles;
+	Float64							mNanosPerHostTick;
+	Index							mErrorEvents;
+	Index							mErrorIOCycles;
+	Index							mOverloadIOCycles;
+
+};
+
+#endif
@@ -44,6 +44,18 @@
 
 #include "CAHostTimeBase.h"
 
+#if defined(__linux__)
+	#include <errno.h>
+	#include <math.h>
+	#include <pthread.h>
+	#include <stdio.h>
+	#include <string.h>
+	#include <vector>
+	#if CAHostTimeBase_Use_TSC
+		#include <cpuid.h>
+	#endif
+#endif
+
 Float64	CAHostTimeBase::sFrequency = 0;
 Float64	CAHostTimeBase::sInverseFrequency = 0;
 UInt32	CAHostTimeBase::sMinDelta = 0;
@@ -56,6 +68,13 @@ bool	CAHostTimeBase::sIsInited = false;
 #if Track_Host_TimeBase
 UInt64	CAHostTimeBase::sLastTime = 0;
 #endif
+#if defined(__linux__)
+UInt32	CAHostTimeBase::sClockSource = CAHostTimeBase::kClockSourceUninitialized;
+UInt64	CAHostTimeBase::sToNanosMultiplier = 1;
+UInt32	CAHostTimeBase::sToNanosShift = 0;
+UInt64	CAHostTimeBase::sFromNanosMultiplier = 1;
+UInt32	CAHostTimeBase::sFromNanosShift = 0;
+#endif
 
 //=============================================================================
 //	CAHostTimeBase
@@ -66,7 +85,12 @@ UInt64	CAHostTimeBase::sLastTime = 0;
 void	CAHostTimeBase::Initialize()
 {
 	//	get the info about Absolute time
-	#if TARGET_OS_MAC
+	#if defined(__linux__)
+		//	calibrating takes a few milliseconds, so only the first thread to get here does it
+		//	and any others wait for it
+		static pthread_once_t sInitializeOnce = PTHREAD_ONCE_INIT;
+		pthread_once(&sInitializeOnce, InitializeClock);
+	#elif TARGET_OS_MAC
 		struct mach_timebase_info	theTimeBaseInfo;
 		mach_timebase_info(&theTimeBaseInfo);
 		sMinDelta = 1;
@@ -100,5 +124,223 @@ void	CAHostTimeBase::Initialize()
 		DebugMessageN1(" From Nanos Denominator: %lu", sFromNanosDenominator);
 	#endif
 
-	sIsInited = true;
+	#if defined(__linux__)
+		//	the inline functions check this without the once guard, so it goes out after the rest
+		__atomic_store_n(&sIsInited, true, __ATOMIC_RELEASE);
+	#else
+		sIsInited = true;
+	#endif
+}
+
+void	CAHostTimeBase::ConvertToNanos(const UInt64* inHostTimes, UInt64* outNanos, UInt32 inNumberTimes)
+{
+#if defined(__linux__)
+	if(!IsInited())
+	{
+		Initialize();
+	}
+	
+	//	the multiplier and shift only need to be loaded once for the whole batch
+	const UInt64 theMultiplier = sToNanosMultiplier;
+	const UInt32 theShift = sToNanosShift;
+	for(UInt32 theIndex = 0; theIndex < inNumberTimes; ++theIndex)
+	{
+		outNanos[theIndex] = MultiplyAndShift(inHostTimes[theIndex], theMultiplier, theShift);
+	}
+#else
+	if(!sIsInited)
+	{
+		Initialize();
+	}
+	
+	const Float64 theRatio = static_cast<Float64>(sToNanosNumerator) / static_cast<Float64>(sToNanosDenominator);
+	for(UInt32 theIndex = 0; theIndex < inNumberTimes; ++theIndex)
+	{
+		outNanos[theIndex] = static_cast<UInt64>(static_cast<Float64>(inHostTimes[theIndex]) * theRatio);
+	}
+#endif
+}
+
+#if defined(__linux__)
+
+void	CAHostTimeBase::InitializeClock()
+{
+	//	use the TSC if it can be, otherwise CLOCK_MONOTONIC_RAW which counts in nanoseconds
+	Float64 theTSCFrequency = CalibrateTSC();
+	sClockSource = (theTSCFrequency > 0.0) ? kClockSourceTSC : kClockSourceMonotonicRaw;
+	sFrequency = (theTSCFrequency > 0.0) ? theTSCFrequency : 1000000000.0;
+	GetMultiplierAndShift(1000000000.0 / sFrequency, sToNanosMultiplier, sToNanosShift);
+	GetMultiplierAndShift(sFrequency / 1000000000.0, sFromNanosMultiplier, sFromNanosShift);
+	
+	//	the numerator and denominator aren't used for the conversions on Linux
+	sMinDelta = 1;
+	sToNanosNumerator = 1;
+	sToNanosDenominator = 1;
+	sFromNanosNumerator = 1;
+	sFromNanosDenominator = 1;
+}
+
+static UInt64	CAHostTimeBaseGetClockNanos(clockid_t inClock)
+{
+	struct timespec theTimeSpec;
+	clock_gettime(inClock, &theTimeSpec);
+	return (static_cast<UInt64>(theTimeSpec.tv_sec) * 1000000000ULL) + static_cast<UInt64>(theTimeSpec.tv_nsec);
+}
+
+static void	CAHostTimeBaseSleep(UInt64 inNanos)
+{
+	struct timespec theTimeSpec;
+	theTimeSpec.tv_sec = static_cast<time_t>(inNanos / 1000000000ULL);
+	theTimeSpec.tv_nsec = static_cast<long>(inNanos % 1000000000ULL);
+	while((nanosleep(&theTimeSpec, &theTimeSpec) != 0) && (errno == EINTR))
+	{
+	}
+}
+
+#if CAHostTimeBase_Use_TSC
+
+static void	CAHostTimeBaseSampleTSC(UInt64& outTSC, UInt64& outNanos)
+{
+	//	keep the sample where the TSC reads on either side of clock_gettime are closest together
+	UInt64 theSmallestWidth = 0xFFFFFFFFFFFFFFFFULL;
+	for(UInt32 theSampleIndex = 0; theSampleIndex < 16; ++theSampleIndex)
+	{
+		UInt64 theTSCBefore = __rdtsc();
+		UInt64 theNanos = CAHostTimeBaseGetClockNanos(CLOCK_MONOTONIC_RAW);
+		UInt64 theTSCAfter = __rdtsc();
+		if((theTSCAfter - theTSCBefore) < theSmallestWidth)
+		{
+			theSmallestWidth = theTSCAfter - theTSCBefore;
+			outTSC = theTSCBefore + (theSmallestWidth / 2);
+			outNanos = theNanos;
+		}
+	}
+}
+
+#endif
+
+Float64	CAHostTimeBase::CalibrateTSC()
+{
+	Float64 theAnswer = 0.0;
+	
+	#if CAHostTimeBase_Use_TSC
+		//	the TSC has to tick at the same rate whatever power state the CPU is in
+		unsigned int theEAX = 0;
+		unsigned int theEBX = 0;
+		unsigned int theECX = 0;
+		unsigned int theEDX = 0;
+		bool theTSCIsInvariant = (__get_cpuid(0x80000000, &theEAX, &theEBX, &theECX, &theEDX) != 0) && (theEAX >= 0x80000007);
+		theTSCIsInvariant = theTSCIsInvariant && (__get_cpuid(0x80000007, &theEAX, &theEBX, &theECX, &theEDX) != 0) && ((theEDX & (1 << 8)) != 0);
+		
+		//	and the kernel has to be using it too, which means it has found it to be in sync across the CPUs
+		bool theKernelUsesTSC = false;
+		FILE* theFile = fopen("/sys/devices/system/clocksource/clocksource0/current_clocksource", "r");
+		if(theFile != NULL)
+		{
+			char theClockSource[32] = { 0 };
+			theKernelUsesTSC = (fgets(theClockSource, sizeof(theClockSource), theFile) != NULL) && (strncmp(theClockSource, "tsc", 3) == 0);
+			fclose(theFile);
+		}
+		
+		if(theTSCIsInvariant && theKernelUsesTSC)
+		{
+			static const UInt64	kCalibrationNanos = 5000000ULL;
+			
+			UInt64 theStartTSC = 0;
+			UInt64 theStartNanos = 0;
+			CAHostTimeBaseSampleTSC(theStartTSC, theStartNanos);
+			CAHostTimeBaseSleep(kCalibrationNanos);
+			UInt64 theEndTSC = 0;
+			UInt64 theEndNanos = 0;
+			CAHostTimeBaseSampleTSC(theEndTSC, theEndNanos);
+			
+			if((theEndNanos > theStartNanos) && (theEndTSC > theStartTSC))
+			{
+				theAnswer = (static_cast<Float64>(theEndTSC - theStartTSC) * 1000000000.0) / static_cast<Float64>(theEndNanos - theStartNanos);
+			}
+			
+			//	anything this slow means something went wrong
+			if(theAnswer < 100000000.0)
+			{
+				theAnswer = 0.0;
+			}
+		}
+	#endif
+	
+	return theAnswer;
+}
+
+void	CAHostTimeBase::GetMultiplierAndShift(Float64 inRatio, UInt64& outMultiplier, UInt32& outShift)
+{
+	//	use the biggest shift that still leaves the multiplier fitting in 63 bits
+	outShift = 63;
+	while((outShift > 0) && (ldexp(inRatio, outShift) >= 9223372036854775808.0))
+	{
+		--outShift;
+	}
+	outMultiplier = static_cast<UInt64>(ldexp(inRatio, outShift) + 0.5);
+}
+
+void	CAHostTimeBase::MeasureClock(UInt32 inNumberCalls, UInt64 inDriftIntervalNanos, ClockStatistics& outStatistics)
+{
+	if(inNumberCalls == 0)
+	{
+		inNumberCalls = 1;
+	}
+	outStatistics.mFrequency = GetFrequency();
+	outStatistics.mClockSource = sClockSource;
+	
+	//	everything is timed with CLOCK_MONOTONIC so that the clock isn't measuring itself
+	volatile UInt64 theSink = 0;
+	UInt64 theStartNanos = CAHostTimeBaseGetClockNanos(CLOCK_MONOTONIC);
+	for(UInt32 theCallIndex = 0; theCallIndex < inNumberCalls; ++theCallIndex)
+	{
+		theSink += GetCurrentTime();
+	}
+	outStatistics.mGetCurrentTimeNanos = static_cast<Float64>(CAHostTimeBaseGetClockNanos(CLOCK_MONOTONIC) - theStartNanos) / inNumberCalls;
+	
+	UInt64 theHostTime = GetCurrentTime();
+	theStartNanos = CAHostTimeBaseGetClockNanos(CLOCK_MONOTONIC);
+	for(UInt32 theCallIndex = 0; theCallIndex < inNumberCalls; ++theCallIndex)
+	{
+		theSink += ConvertToNanos(theHostTime + theCallIndex);
+	}
+	outStatistics.mConvertToNanosNanos = static_cast<Float64>(CAHostTimeBaseGetClockNanos(CLOCK_MONOTONIC) - theStartNanos) / inNumberCalls;
+	
+	std::vector<UInt64> theHostTimes(1024);
+	std::vector<UInt64> theNanos(theHostTimes.size());
+	for(UInt32 theIndex = 0; theIndex < theHostTimes.size(); ++theIndex)
+	{
+		theHostTimes[theIndex] = theHostTime + theIndex;
+	}
+	theStartNanos = CAHostTimeBaseGetClockNanos(CLOCK_MONOTONIC);
+	for(UInt32 theNumberConverted = 0; theNumberConverted < inNumberCalls; theNumberConverted += static_cast<UInt32>(theHostTimes.size()))
+	{
+		ConvertToNanos(&theHostTimes[0], &theNanos[0], static_cast<UInt32>(theHostTimes.size()));
+		theSink += theNanos[theNumberConverted % theNanos.size()];
+	}
+	UInt32 theNumberBatches = (inNumberCalls + static_cast<UInt32>(theHostTimes.size()) - 1) / static_cast<UInt32>(theHostTimes.size());
+	outStatistics.mBatchConvertToNanosNanos = static_cast<Float64>(CAHostTimeBaseGetClockNanos(CLOCK_MONOTONIC) - theStartNanos) / (static_cast<Float64>(theNumberBatches) * theHostTimes.size());
+	
+	theStartNanos = CAHostTimeBaseGetClockNanos(CLOCK_MONOTONIC);
+	for(UInt32 theCallIndex = 0; theCallIndex < inNumberCalls; ++theCallIndex)
+	{
+		theSink += CAHostTimeBaseGetClockNanos(CLOCK_MONOTONIC);
+	}
+	outStatistics.mClockGetTimeNanos = static_cast<Float64>(CAHostTimeBaseGetClockNanos(CLOCK_MONOTONIC) - theStartNanos) / inNumberCalls;
+	
+	//	the drift is how far the host time gets from CLOCK_MONOTONIC over the interval
+	outStatistics.mDriftPartsPerMillion = 0.0;
+	if(inDriftIntervalNanos > 0)
+	{
+		UInt64 theStartHostNanos = GetCurrentTimeInNanos();
+		theStartNanos = CAHostTimeBaseGetClockNanos(CLOCK_MONOTONIC);
+		CAHostTimeBaseSleep(inDriftIntervalNanos);
+		UInt64 theEndHostNanos = GetCurrentTimeInNanos();
+		UInt64 theEndNanos = CAHostTimeBaseGetClockNanos(CLOCK_MONOTONIC);
+		Float64 theKernelNanos = static_cast<Float64>(theEndNanos - theStartNanos);
+		outStatistics.mDriftPartsPerMillion = ((static_cast<Float64>(theEndHostNanos - theStartHostNanos) - theKernelNanos) / theKernelNanos) * 1000000.0;
+	}
 }
+
+#endif
@@ -49,7 +49,13 @@
 #include <CoreAudio/CoreAudioTypes.h>
 #include "CADebugMacros.h"
 
-#if !TARGET_API_MAC_OSX
+#if defined(__linux__)
+	#include <time.h>
+	#if defined(__i386__) || defined(__x86_64__)
+		#include <x86intrin.h>
+		#define	CAHostTimeBase_Use_TSC	1
+	#endif
+#elif !TARGET_API_MAC_OSX
 	#include <DriverServices.h>
 	#include <Timer.h>
 	#define myUnsignedWideToUInt64(x) (*((UInt64*)(&x)))
@@ -65,6 +71,14 @@
 //	CAHostTimeBase
 //
 //	This class provides platform independant access to the host's time base.
+//
+//	On Linux, the host time is the TSC when the CPU has an invariant one that
+//	the kernel also uses as its clock source, and CLOCK_MONOTONIC_RAW in
+//	nanoseconds otherwise. The TSC frequency is calibrated against
+//	CLOCK_MONOTONIC_RAW and conversions are done with a 64 bit fixed point
+//	multiplier and a shift. This is set up the first time any of it is used,
+//	and calibrating takes a few milliseconds, so call GetFrequency() somewhere
+//	other than a real time thread to get it out of the way.
 //=============================================================================
 
 #if CoreAudio_Debug
@@ -78,6 +92,7 @@ class	CAHostTimeBase
 public:
 	static UInt64	ConvertToNanos(UInt64 inHostTime);
 	static UInt64	ConvertFromNanos(UInt64 inNanos);
+	static void		ConvertToNanos(const UInt64* inHostTimes, UInt64* outNanos, UInt32 inNumberTimes);
 
 	static UInt64	GetCurrentTime();
 	static UInt64	GetCurrentTimeInNanos();
@@ -88,6 +103,29 @@ public:
 	static UInt64	AbsoluteHostDeltaToNanos(UInt64 inStartTime, UInt64 inEndTime);
 	static SInt64	HostDeltaToNanos(UInt64 inStartTime, UInt64 inEndTime);
 
+#if defined(__linux__)
+	enum
+	{
+		kClockSourceUninitialized	= 0,
+		kClockSourceTSC				= 1,
+		kClockSourceMonotonicRaw	= 2
+	};
+	
+	struct	ClockStatistics
+	{
+		UInt32	mClockSource;
+		Float64	mFrequency;
+		Float64	mGetCurrentTimeNanos;		//	per call
+		Float64	mConvertToNanosNanos;		//	per call
+		Float64	mBatchConvertToNanosNanos;	//	per time stamp
+		Float64	mClockGetTimeNanos;			//	per call of clock_gettime(CLOCK_MONOTONIC)
+		Float64	mDriftPartsPerMillion;		//	against CLOCK_MONOTONIC
+	};
+	
+	static UInt32	GetClockSource() { return sClockSource; }
+	static void		MeasureClock(UInt32 inNumberCalls, UInt64 inDriftIntervalNanos, ClockStatistics& outStatistics);
+#endif
+
 private:
 	static void		Initialize();
 	
@@ -103,13 +141,43 @@ private:
 #if !TARGET_API_MAC_OSX || Track_Host_TimeBase
 	static UInt64	sLastTime;
 #endif
+#if defined(__linux__)
+	static bool		IsInited() { return __atomic_load_n(&sIsInited, __ATOMIC_ACQUIRE); }
+	static void		InitializeClock();
+	static UInt64	MultiplyAndShift(UInt64 inValue, UInt64 inMultiplier, UInt32 inShift);
+	static void		GetMultiplierAndShift(Float64 inRatio, UInt64& outMultiplier, UInt32& outShift);
+	static Float64	CalibrateTSC();
+	
+	static UInt32	sClockSource;
+	static UInt64	sToNanosMultiplier;
+	static UInt32	sToNanosShift;
+	static UInt64	sFromNanosMultiplier;
+	static UInt32	sFromNanosShift;
+#endif
 };
 
 inline UInt64	CAHostTimeBase::GetCurrentTime()
 {
 	UInt64 theTime;
 
-	#if !TARGET_API_MAC_OSX
+	#if defined(__linux__)
+		if(!IsInited())
+		{
+			Initialize();
+		}
+		#if CAHostTimeBase_Use_TSC
+		if(sClockSource == kClockSourceTSC)
+		{
+			theTime = __rdtsc();
+		}
+		else
+		#endif
+		{
+			struct timespec theTimeSpec;
+			clock_gettime(CLOCK_MONOTONIC_RAW, &theTimeSpec);
+			theTime = (static_cast<UInt64>(theTimeSpec.tv_sec) * 1000000000ULL) + static_cast<UInt64>(theTimeSpec.tv_nsec);
+		}
+	#elif !TARGET_API_MAC_OSX
 		#if	TARGET_OS_MAC
 			if(!sIsInited)
 			{
@@ -161,6 +229,38 @@ inline UInt64	CAHostTimeBase::GetCurrentTime()
 	return theTime;
 }
 
+#if defined(__linux__)
+
+inline UInt64	CAHostTimeBase::MultiplyAndShift(UInt64 inValue, UInt64 inMultiplier, UInt32 inShift)
+{
+	#if defined(__SIZEOF_INT128__)
+		__extension__ typedef unsigned __int128	UInt128;
+		return static_cast<UInt64>((static_cast<UInt128>(inValue) * inMultiplier) >> inShift);
+	#else
+		return static_cast<UInt64>(static_cast<Float64>(inValue) * (static_cast<Float64>(inMultiplier) / static_cast<Float64>(1ULL << inShift)));
+	#endif
+}
+
+inline UInt64	CAHostTimeBase::ConvertToNanos(UInt64 inHostTime)
+{
+	if(!IsInited())
+	{
+		Initialize();
+	}
+	return MultiplyAndShift(inHostTime, sToNanosMultiplier, sToNanosShift);
+}
+
+inline UInt64	CAHostTimeBase::ConvertFromNanos(UInt64 inNanos)
+{
+	if(!IsInited())
+	{
+		Initialize();
+	}
+	return MultiplyAndShift(inNanos, sFromNanosMultiplier, sFromNanosShift);
+}
+
+#else
+
 inline UInt64	CAHostTimeBase::ConvertToNanos(UInt64 inHostTime)
 {
 	if(!sIsInited)
@@ -203,6 +303,8 @@ inline UInt64	CAHostTimeBase::ConvertFromNanos(UInt64 inNanos)
 	return theAnswer;
 }
 
+#endif
+
 
 inline UInt64	CAHostTimeBase::GetCurrentTimeInNanos()
 {
@@ -0,0 +1,413 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CAMatrixMixEngine.cpp
+	
+=============================================================================*/
+
+#include "CAMatrixMixEngine.h"
+#include "CAAtomic.h"
+#include "CAHostTimeBase.h"
+#include <math.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+
+#if TARGET_OS_MAC
+	#include <Accelerate/Accelerate.h>
+#else
+// Portable stand-ins for the vDSP routines used here, unrolled so that the compiler can
+// vectorize them.
+typedef long			vDSP_Stride;
+typedef unsigned long	vDSP_Length;
+
+static void vDSP_vsmul(const float *inA, vDSP_Stride /*inAStride*/, const float *inB, float *outC, vDSP_Stride /*inCStride*/, vDSP_Length inN)
+{
+	const float b = *inB;
+	vDSP_Length i = 0;
+	for (; i + 4 <= inN; i += 4) {
+		outC[i] = inA[i] * b;
+		outC[i+1] = inA[i+1] * b;
+		outC[i+2] = inA[i+2] * b;
+		outC[i+3] = inA[i+3] * b;
+	}
+	for (; i < inN; ++i)
+		outC[i] = inA[i] * b;
+}
+
+static void vDSP_vsma(const float *inA, vDSP_Stride /*inAStride*/, const float *inB, const float *inC, vDSP_Stride /*inCStride*/, float *outD, vDSP_Stride /*inDStride*/, vDSP_Length inN)
+{
+	const float b = *inB;
+	vDSP_Length i = 0;
+	for (; i + 4 <= inN; i += 4) {
+		outD[i] = inA[i] * b + inC[i];
+		outD[i+1] = inA[i+1] * b + inC[i+1];
+		outD[i+2] = inA[i+2] * b + inC[i+2];
+		outD[i+3] = inA[i+3] * b + inC[i+3];
+	}
+	for (; i < inN; ++i)
+		outD[i] = inA[i] * b + inC[i];
+}
+#endif
+
+// ____________________________________________________________________________
+
+CAMatrixMixEngine::CAMatrixMixEngine(UInt32 numIns, UInt32 numOuts) :
+	mIns(numIns),
+	mOuts(numOuts),
+	mRampFramesLeft(0),
+	mKind(kKind_Silence),
+	mPending(NULL)
+{
+	UInt32 n = numIns * numOuts;
+	mGains = new Float32[n];
+	mTargetGains = new Float32[n];
+	mGainSteps = new Float32[n];
+	memset(mGains, 0, n * sizeof(Float32));
+	mTermStart = new UInt32[numOuts + 1];
+	mTermInput = new UInt32[n];
+	mTermGain = new Float32[n];
+	Analyze();
+}
+
+CAMatrixMixEngine::~CAMatrixMixEngine()
+{
+	PendingMap *p = mPending;
+	if (p != NULL) {
+		delete[] p->mGains;
+		delete p;
+	}
+	p = mRetired.pop_all();
+	while (p != NULL) {
+		PendingMap *next = p->mNext;
+		delete[] p->mGains;
+		delete p;
+		p = next;
+	}
+	delete[] mGains;
+	delete[] mTargetGains;
+	delete[] mGainSteps;
+	delete[] mTermStart;
+	delete[] mTermInput;
+	delete[] mTermGain;
+}
+
+void	CAMatrixMixEngine::SetMixMap(const CAMixMap &map, UInt32 rampFrames)
+{
+	// free the maps Mix is done with
+	PendingMap *p = mRetired.pop_all();
+	while (p != NULL) {
+		PendingMap *next = p->mNext;
+		delete[] p->mGains;
+		delete p;
+		p = next;
+	}
+	
+	PendingMap *pm = new PendingMap;
+	pm->mNext = NULL;
+	pm->mRampFrames = rampFrames;
+	pm->mGains = new Float32[mIns * mOuts];
+	for (UInt32 i = 0; i < mIns; ++i)
+		for (UInt32 j = 0; j < mOuts; ++j)
+			pm->mGains[i * mOuts + j] = map.GetCrossPoint(i, j);
+	
+	// replace any map Mix hasn't taken yet
+	PendingMap *old;
+	do {
+		old = mPending;
+	} while (!CAAtomicCompareAndSwapPtrBarrier(old, pm, (void * volatile *)&mPending));
+	if (old != NULL) {
+		delete[] old->mGains;
+		delete old;
+	}
+}
+
+// on the render thread
+void	CAMatrixMixEngine::TakePendingMap()
+{
+	PendingMap *pm;
+	do {
+		pm = mPending;
+		if (pm == NULL)
+			return;
+	} while (!CAAtomicCompareAndSwapPtrBarrier(pm, NULL, (void * volatile *)&mPending));
+	
+	UInt32 n = mIns * mOuts;
+	if (pm->mRampFrames == 0) {
+		memcpy(mGains, pm->mGains, n * sizeof(Float32));
+		mRampFramesLeft = 0;
+	} else {
+		// ramp from wherever we are now, even in the middle of another ramp
+		Float32 scale = 1.f / pm->mRampFrames;
+		for (UInt32 k = 0; k < n; ++k) {
+			mTargetGains[k] = pm->mGains[k];
+			mGainSteps[k] = (mTargetGains[k] - mGains[k]) * scale;
+		}
+		mRampFramesLeft = pm->mRampFrames;
+	}
+	mRetired.push_atomic(pm);
+	Analyze();
+}
+
+void	CAMatrixMixEngine::Analyze()
+{
+	UInt32 nTerms = 0;
+	bool unity = true, single = true;
+	for (UInt32 j = 0; j < mOuts; ++j) {
+		mTermStart[j] = nTerms;
+		for (UInt32 i = 0; i < mIns; ++i) {
+			Float32 g = mGains[i * mOuts + j];
+			if (g == 0.f)
+				continue;
+			mTermInput[nTerms] = i;
+			mTermGain[nTerms] = g;
+			++nTerms;
+			if (g != 1.f)
+				unity = false;
+		}
+		if (nTerms - mTermStart[j] > 1)
+			single = false;
+	}
+	mTermStart[mOuts] = nTerms;
+	
+	if (nTerms == 0)
+		mKind = kKind_Silence;
+	else if (!single)
+		mKind = kKind_Mixing;
+	else
+		mKind = unity ? kKind_Routing : kKind_Scaling;
+}
+
+// ____________________________________________________________________________
+
+void	CAMatrixMixEngine::Mix(const AudioBufferList *src, AudioBufferList *dest, UInt32 nFrames)
+{
+	TakePendingMap();
+	
+	UInt32 offset = 0;
+	if (mRampFramesLeft > 0) {
+		offset = std::min(nFrames, mRampFramesLeft);
+		MixRamp(src, dest, offset);
+		mRampFramesLeft -= offset;
+		if (mRampFramesLeft == 0) {
+			memcpy(mGains, mTargetGains, mIns * mOuts * sizeof(Float32));
+			Analyze();
+		}
+	}
+	if (offset < nFrames)
+		MixStatic(src, dest, offset, nFrames - offset);
+	
+	UInt32 nOuts = std::min(mOuts, dest->mNumberBuffers);
+	for (UInt32 j = 0; j < nOuts; ++j)
+		dest->mBuffers[j].mDataByteSize = nFrames * sizeof(Float32);
+}
+
+void	CAMatrixMixEngine::MixStatic(const AudioBufferList *src, AudioBufferList *dest, UInt32 offset, UInt32 nFrames)
+{
+	UInt32 nOuts = std::min(mOuts, dest->mNumberBuffers);
+	UInt32 nIns = src->mNumberBuffers;
+	for (UInt32 j = 0; j < nOuts; ++j) {
+		Float32 *out = (Float32 *)dest->mBuffers[j].mData + offset;
+		bool first = true;
+		for (UInt32 t = mTermStart[j]; t < mTermStart[j + 1]; ++t) {
+			UInt32 i = mTermInput[t];
+			if (i >= nIns)
+				continue;
+			const Float32 *in = (const Float32 *)src->mBuffers[i].mData + offset;
+			Float32 g = mTermGain[t];
+			if (!first)
+				vDSP_vsma(in, 1, &g, out, 1, out, 1, nFrames);
+			else if (g == 1.f)
+				memcpy(out, in, nFrames * sizeof(Float32));
+			else
+				vDSP_vsmul(in, 1, &g, out, 1, nFrames);
+			first = false;
+		}
+		if (first)
+			memset(out, 0, nFrames * sizeof(Float32));
+	}
+}
+
+// Crosspoints that are 0 at both ends of the ramp are skipped; the rest are interpolated
+// per frame. Only the ramp's first buffer or so goes through here.
+void	CAMatrixMixEngine::MixRamp(const AudioBufferList *src, AudioBufferList *dest, UInt32 nFrames)
+{
+	UInt32 nOuts = std::min(mOuts, dest->mNumberBuffers);
+	UInt32 nIns = std::min(mIns, src->mNumberBuffers);
+	for (UInt32 j = 0; j < nOuts; ++j) {
+		Float32 *out = (Float32 *)dest->mBuffers[j].mData;
+		bool first = true;
+		for (UInt32 i = 0; i < nIns; ++i) {
+			UInt32 k = i * mOuts + j;
+			Float32 g = mGains[k], step = mGainSteps[k];
+			if (g == 0.f && step == 0.f)
+				continue;
+			const Float32 *in = (const Float32 *)src->mBuffers[i].mData;
+			if (first) {
+				for (UInt32 f = 0; f < nFrames; ++f)
+					out[f] = in[f] * (g + step * f);
+			} else {
+				for (UInt32 f = 0; f < nFrames; ++f)
+					out[f] += in[f] * (g + step * f);
+			}
+			first = false;
+		}
+		if (first)
+			memset(out, 0, nFrames * sizeof(Float32));
+	}
+	
+	for (UInt32 k = 0; k < mIns * mOuts; ++k)
+		mGains[k] += mGainSteps[k] * nFrames;
+}
+
+// ____________________________________________________________________________
+// Benchmarks
+
+static AudioBufferList *	AllocateBufferList(UInt32 nBuffers, UInt32 nFrames)
+{
+	AudioBufferList *abl = (AudioBufferList *)calloc(1, offsetof(AudioBufferList, mBuffers) + nBuffers * sizeof(AudioBuffer));
+	abl->mNumberBuffers = nBuffers;
+	for (UInt32 i = 0; i < nBuffers; ++i) {
+		abl->mBuffers[i].mNumberChannels = 1;
+		abl->mBuffers[i].mDataByteSize = nFrames * sizeof(Float32);
+		abl->mBuffers[i].mData = calloc(nFrames, sizeof(Float32));
+	}
+	return abl;
+}
+
+static void	FreeBufferList(AudioBufferList *abl)
+{
+	for (UInt32 i = 0; i < abl->mNumberBuffers; ++i)
+		free(abl->mBuffers[i].mData);
+	free(abl);
+}
+
+// What the engine replaces: every output visits every input, whatever its gain.
+static void	DenseMix(const CAMixMap &map, const AudioBufferList *src, AudioBufferList *dest, UInt32 nFrames)
+{
+	for (UInt32 j = 0; j < map.NumOuts(); ++j) {
+		Float32 *out = (Float32 *)dest->mBuffers[j].mData;
+		memset(out, 0, nFrames * sizeof(Float32));
+		for (UInt32 i = 0; i < map.NumIns(); ++i) {
+			const Float32 *in = (const Float32 *)src->mBuffers[i].mData;
+			Float32 g = map.GetCrossPoint(i, j);
+			for (UInt32 f = 0; f < nFrames; ++f)
+				out[f] += in[f] * g;
+		}
+	}
+}
+
+bool	CAMatrixMixEngine::MeasureMix(const CAMixMap &map, UInt32 nFrames, UInt32 nIterations, MixStatistics &outStats)
+{
+	memset(&outStats, 0, sizeof(outStats));
+	outStats.mNumIns = map.NumIns();
+	outStats.mNumOuts = map.NumOuts();
+	if (map.NumIns() == 0 || map.NumOuts() == 0 || nFrames == 0 || nIterations == 0)
+		return false;
+	
+	AudioBufferList *src = AllocateBufferList(map.NumIns(), nFrames);
+	AudioBufferList *engineOut = AllocateBufferList(map.NumOuts(), nFrames);
+	AudioBufferList *denseOut = AllocateBufferList(map.NumOuts(), nFrames);
+	
+	// full scale noise on every input
+	UInt32 seed = 1;
+	for (UInt32 i = 0; i < map.NumIns(); ++i) {
+		Float32 *in = (Float32 *)src->mBuffers[i].mData;
+		for (UInt32 f = 0; f < nFrames; ++f) {
+			seed = seed * 1664525 + 1013904223;
+			in[f] = Float32(seed >> 8) / Float32(1 << 23) - 1.f;
+		}
+	}
+	
+	CAMatrixMixEngine engine(map.NumIns(), map.NumOuts());
+	engine.SetMixMap(map);
+	engine.Mix(src, engineOut, nFrames);
+	outStats.mKind = engine.GetKind();
+	
+	UInt64 start = CAHostTimeBase::GetCurrentTimeInNanos();
+	for (UInt32 n = 0; n < nIterations; ++n)
+		engine.Mix(src, engineOut, nFrames);
+	outStats.mEngineNanosPerFrame = Float64(CAHostTimeBase::GetCurrentTimeInNanos() - start) / (Float64(nIterations) * nFrames);
+	
+	start = CAHostTimeBase::GetCurrentTimeInNanos();
+	for (UInt32 n = 0; n < nIterations; ++n)
+		DenseMix(map, src, denseOut, nFrames);
+	outStats.mDenseNanosPerFrame = Float64(CAHostTimeBase::GetCurrentTimeInNanos() - start) / (Float64(nIterations) * nFrames);
+	
+	for (UInt32 j = 0; j < map.NumOuts(); ++j) {
+		const Float32 *a = (const Float32 *)engineOut->mBuffers[j].mData;
+		const Float32 *b = (const Float32 *)denseOut->mBuffers[j].mData;
+		for (UInt32 f = 0; f < nFrames; ++f) {
+			Float32 e = fabsf(a[f] - b[f]);
+			if (e > outStats.mMaxError)
+				outStats.mMaxError = e;
+		}
+	}
+	
+	FreeBufferList(src);
+	FreeBufferList(engineOut);
+	FreeBufferList(denseOut);
+	return outStats.mMaxError <= 1.0e-5f * map.NumIns();
+}
+
+bool	CAMatrixMixEngine::MeasureStandardMixes(UInt32 nFrames, UInt32 nIterations, MixStatistics &outDownmix, MixStatistics &outRouting)
+{
+	// L R C LFE Ls Rs Rls Rrs, with the center and surrounds at -3 dB and no LFE
+	const Float32 kMinus3dB = 0.70710678f;
+	CAMixMap downmix(8, 2);
+	downmix.SetCrossPoint(0, 0, 1.f);
+	downmix.SetCrossPoint(1, 1, 1.f);
+	downmix.SetCrossPoint(2, 0, kMinus3dB);
+	downmix.SetCrossPoint(2, 1, kMinus3dB);
+	downmix.SetCrossPoint(4, 0, kMinus3dB);
+	downmix.SetCrossPoint(5, 1, kMinus3dB);
+	downmix.SetCrossPoint(6, 0, kMinus3dB);
+	downmix.SetCrossPoint(7, 1, kMinus3dB);
+	
+	// each input to another output, the way a device's channels get reassigned
+	CAMixMap routing(64, 64);
+	for (UInt32 i = 0; i < 64; ++i)
+		routing.SetCrossPoint(i, (i * 37 + 5) % 64, 1.f);
+	
+	bool passed = MeasureMix(downmix, nFrames, nIterations, outDownmix);
+	return MeasureMix(routing, nFrames, nIterations, outRouting) && passed;
+}
@@ -0,0 +1,148 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CAMatrixMixEngine.h
+	
+=============================================================================*/
+
+#ifndef __CAMatrixMixEngine_h__
+#define __CAMatrixMixEngine_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include "CAMixMap.h"
+#include "CAAtomicStack.h"
+
+// _______________________________________________________________________________________
+// Applies a CAMixMap to deinterleaved Float32 buffers without a matrix mixer AudioUnit.
+//
+// Each new map is reduced to a list of nonzero terms per output, so the cost follows the
+// number of live crosspoints rather than ins * outs: an output fed by one input at unity
+// is a memcpy, one input at another gain a scalar multiply, and only true mixes accumulate.
+// Gain changes can be ramped linearly over a number of frames to avoid zipper noise.
+//
+// SetMixMap may be called from any one thread while another renders; the new map is
+// handed over without locks and picked up at the start of the next Mix.
+class CAMatrixMixEngine {
+public:
+	enum Kind {
+		kKind_Silence,		// every crosspoint is 0
+		kKind_Routing,		// each output has at most one input, at unity gain
+		kKind_Scaling,		// each output has at most one input (e.g. a diagonal map)
+		kKind_Mixing		// some output sums several inputs
+	};
+
+	CAMatrixMixEngine(UInt32 numIns, UInt32 numOuts);
+	~CAMatrixMixEngine();
+	
+	UInt32		NumIns() const { return mIns; }
+	UInt32		NumOuts() const { return mOuts; }
+	
+	void		SetMixMap(const CAMixMap &map, UInt32 rampFrames = 0);
+					// crosspoints beyond the engine's size are ignored
+	
+	void		Mix(const AudioBufferList *src, AudioBufferList *dest, UInt32 nFrames);
+					// src and dest are deinterleaved Float32 with NumIns() and NumOuts() buffers,
+					// and must not overlap
+	
+	Kind		GetKind() const { return mKind; }
+					// of the map in effect, as of the last Mix
+	bool		IsRamping() const { return mRampFramesLeft > 0; }
+	const Float32 *	GetGains() const { return mGains; }
+					// of the map in effect, [in * NumOuts() + out]; on the render thread, and
+					// only final when not ramping
+	
+	void		TakeMixMap() { TakePendingMap(); }
+					// on the render thread; Mix does this itself, but a client that renders a
+					// buffer some other way calls it instead, so that the next ramp starts from
+					// the gains the client is actually using
+
+	struct MixStatistics {
+		UInt32		mNumIns, mNumOuts;
+		Kind		mKind;
+		Float64		mEngineNanosPerFrame;	// Mix with the map in effect
+		Float64		mDenseNanosPerFrame;	// every crosspoint multiplied and summed, as a matrix mixer does
+		Float32		mMaxError;				// between the two, for full scale noise on every input
+	};
+	
+	static bool	MeasureMix(const CAMixMap &map, UInt32 nFrames, UInt32 nIterations, MixStatistics &outStats);
+					// false if the engine's output doesn't match the dense mix
+	static bool	MeasureStandardMixes(UInt32 nFrames, UInt32 nIterations, MixStatistics &outDownmix, MixStatistics &outRouting);
+					// 7.1 to stereo and a 64 to 64 channel routing
+
+private:
+	struct PendingMap {
+		PendingMap *	mNext;
+		UInt32			mRampFrames;
+		Float32 *		mGains;		// [in * numOuts + out]
+		
+		PendingMap *	get_next() { return mNext; }
+		void			set_next(PendingMap *p) { mNext = p; }
+	};
+	
+	void		TakePendingMap();
+	void		Analyze();
+	void		MixStatic(const AudioBufferList *src, AudioBufferList *dest, UInt32 offset, UInt32 nFrames);
+	void		MixRamp(const AudioBufferList *src, AudioBufferList *dest, UInt32 nFrames);
+	
+	UInt32		mIns, mOuts;
+	Float32 *	mGains;				// in effect, or the start of the ramp
+	Float32 *	mTargetGains;		// end of the ramp
+	Float32 *	mGainSteps;			// per frame, while ramping
+	UInt32		mRampFramesLeft;
+	
+	// nonzero terms of mGains, grouped by output
+	UInt32 *	mTermStart;			// [out], into the arrays below; [numOuts] is the end
+	UInt32 *	mTermInput;
+	Float32 *	mTermGain;
+	Kind		mKind;
+	
+	PendingMap * volatile		mPending;		// latest map from SetMixMap, not yet taken
+	TAtomicStack<PendingMap>	mRetired;		// taken by Mix; freed by SetMixMap
+};
+
+#endif // __CAMatrixMixEngine_h__
@@ -45,7 +45,7 @@
 //	Self Include
 #include "CAMutex.h"
 
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || defined(__linux__)
 	#include <errno.h>
 #endif
 
@@ -73,9 +73,17 @@ CAMutex::CAMutex(const char* inName)
 :
 	mName(inName),
 	mOwner(0)
+#if defined(__linux__)
+	,mSpinCount(0)
+#endif
 {
-#if TARGET_OS_MAC
-	OSStatus theError = pthread_mutex_init(&mMutex, NULL);
+#if TARGET_OS_MAC || defined(__linux__)
+	#if defined(__linux__)
+		//	this is a priority inheriting mutex, so a real time thread never waits behind a preempted owner
+		OSStatus theError = CAFutex::InitializeMutex(mMutex);
+	#else
+		OSStatus theError = pthread_mutex_init(&mMutex, NULL);
+	#endif
 	ThrowIf(theError != 0, CAException(theError), "CAMutex::CAMutex: Could not init the mutex");
 	
 	#if	Log_Ownership
@@ -93,7 +101,7 @@ CAMutex::CAMutex(const char* inName)
 
 CAMutex::~CAMutex()
 {
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || defined(__linux__)
 	#if	Log_Ownership
 		DebugPrintfRtn(DebugPrintfFileComma "%p %.4f: CAMutex::~CAMutex: destroying %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), mName, mOwner);
 	#endif
@@ -113,7 +121,7 @@ bool	CAMutex::Lock()
 {
 	bool theAnswer = false;
 	
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || defined(__linux__)
 	pthread_t theCurrentThread = pthread_self();
 	if(!pthread_equal(theCurrentThread, mOwner))
 	{
@@ -125,7 +133,11 @@ bool	CAMutex::Lock()
 			UInt64 lockTryTime = CAHostTimeBase::GetCurrentTimeInNanos();
 		#endif
 		
-		OSStatus theError = pthread_mutex_lock(&mMutex);
+		#if defined(__linux__)
+			OSStatus theError = CAFutex::LockMutex(mMutex, mSpinCount);
+		#else
+			OSStatus theError = pthread_mutex_lock(&mMutex);
+		#endif
 		ThrowIf(theError != 0, CAException(theError), "CAMutex::Lock: Could not lock the mutex");
 		mOwner = theCurrentThread;
 		theAnswer = true;
@@ -163,7 +175,7 @@ bool	CAMutex::Lock()
 
 void	CAMutex::Unlock()
 {
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || defined(__linux__)
 	if(pthread_equal(pthread_self(), mOwner))
 	{
 		#if	Log_Ownership
@@ -209,7 +221,7 @@ bool	CAMutex::Try(bool& outWasLocked)
 	bool theAnswer = false;
 	outWasLocked = false;
 
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || defined(__linux__)
 	pthread_t theCurrentThread = pthread_self();
 	if(!pthread_equal(theCurrentThread, mOwner))
 	{
@@ -310,7 +322,7 @@ bool	CAMutex::IsOwnedByCurrentThread() const
 {
 	bool theAnswer = true;
 	
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || defined(__linux__)
 	theAnswer = pthread_equal(pthread_self(), mOwner);
 #elif TARGET_OS_WIN32
 	theAnswer = (mOwner == GetCurrentThreadId());
@@ -52,7 +52,10 @@
 	#include <CoreAudioTypes.h>
 #endif
 
-#if TARGET_OS_MAC
+#if defined(__linux__)
+	#include <pthread.h>
+	#include "CAFutex.h"
+#elif TARGET_OS_MAC
 	#include <pthread.h>
 #elif TARGET_OS_WIN32
 	#include <windows.h>
@@ -83,7 +86,11 @@ public:
 //	Implementation
 protected:
 	const char*		mName;
-#if TARGET_OS_MAC
+#if defined(__linux__)
+	pthread_t		mOwner;
+	pthread_mutex_t	mMutex;
+	volatile SInt32	mSpinCount;
+#elif TARGET_OS_MAC
 	pthread_t		mOwner;
 	pthread_mutex_t	mMutex;
 #elif TARGET_OS_WIN32
@@ -48,11 +48,15 @@
 #include "CADebugMacros.h"
 #include "CAException.h"
 
+#if defined(__linux__)
+	#include "CAThreadScheduling.h"
+#else
 //	the extern "C" is to make cpp-precomp happy
 extern "C"
 {
 #include <mach/mach.h>
 }
+#endif
 
 //=============================================================================
 //	CAPThread
@@ -64,6 +68,9 @@ CAPThread::CAPThread(ThreadRoutine inThreadRoutine, void* inParameter, UInt32 in
 :
 	mPThread(0),
     mSpawningThreadPriority(getThreadPriority(pthread_self(), CAPTHREAD_SET_PRIORITY)),
+#if defined(__linux__)
+	mThreadID(0),
+#endif
 	mThreadRoutine(inThreadRoutine),
 	mThreadParameter(inParameter),
 	mPriority(inPriority),
@@ -79,6 +86,9 @@ CAPThread::CAPThread(ThreadRoutine inThreadRoutine, void* inParameter, UInt32 in
 :
 	mPThread(0),
     mSpawningThreadPriority(getThreadPriority(pthread_self(), CAPTHREAD_SET_PRIORITY)),
+#if defined(__linux__)
+	mThreadID(0),
+#endif
 	mThreadRoutine(inThreadRoutine),
 	mThreadParameter(inParameter),
 	mPriority(kDefaultThreadPriority),
@@ -96,6 +106,13 @@ CAPThread::~CAPThread()
 
 UInt32	CAPThread::GetScheduledPriority()
 {
+#if defined(__linux__)
+	//	Linux schedules by kernel thread ID, which is only known once the thread is running
+	if(mThreadID != 0)
+	{
+		return CAThreadScheduling::GetPriority(mThreadID);
+	}
+#endif
     return CAPThread::getThreadPriority ( mPThread, CAPTHREAD_SCHEDULED_PRIORITY );
 }
 
@@ -103,6 +120,12 @@ void	CAPThread::SetPriority(UInt32 inPriority)
 {
 	mPriority = inPriority;
 	mTimeConstraintSet = false;
+#if defined(__linux__)
+	if(mThreadID != 0)
+	{
+		CAThreadScheduling::SetPriority(mThreadID, mPriority, false);
+	}
+#else
 	if(mPThread != 0)
 	{
         // We keep a reference to the spawning thread's priority around (initialized in the constructor), 
@@ -112,6 +135,7 @@ void	CAPThread::SetPriority(UInt32 inPriority)
         thePrecedencePolicy.importance = mPriority - mSpawningThreadPriority;
         thread_policy_set (pthread_mach_thread_np(mPThread), THREAD_PRECEDENCE_POLICY, (thread_policy_t)&thePrecedencePolicy, THREAD_PRECEDENCE_POLICY_COUNT);
     }
+#endif
 }
 
 void	CAPThread::SetTimeConstraints(UInt32 inPeriod, UInt32 inComputation, UInt32 inConstraint, bool inIsPreemptible)
@@ -121,6 +145,12 @@ void	CAPThread::SetTimeConstraints(UInt32 inPeriod, UInt32 inComputation, UInt32
 	mConstraint = inConstraint;
 	mIsPreemptible = inIsPreemptible;
 	mTimeConstraintSet = true;
+#if defined(__linux__)
+	if(mThreadID != 0)
+	{
+		CAThreadScheduling::SetTimeConstraints(mThreadID, mPeriod, mComputation, mConstraint, mIsPreemptible);
+	}
+#else
 	if(mPThread != 0)
 	{
 		thread_time_constraint_policy_data_t thePolicy;
@@ -130,6 +160,7 @@ void	CAPThread::SetTimeConstraints(UInt32 inPeriod, UInt32 inComputation, UInt32
 		thePolicy.preemptible = mIsPreemptible;
 		thread_policy_set(pthread_mach_thread_np(mPThread), THREAD_TIME_CONSTRAINT_POLICY, (thread_policy_t)&thePolicy, THREAD_TIME_CONSTRAINT_POLICY_COUNT);
 	}
+#endif
 }
 
 void	CAPThread::Start()
@@ -150,6 +181,8 @@ void	CAPThread::Start()
 		
 		pthread_attr_destroy(&theThreadAttributes);
 		
+	#if !defined(__linux__)
+		//	on Linux, the new thread sets its own policy in Entry once its thread ID is known
 		if(mTimeConstraintSet)
 		{
 			SetTimeConstraints(mPeriod, mComputation, mConstraint, mIsPreemptible);
@@ -158,16 +191,32 @@ void	CAPThread::Start()
 		{
 			SetPriority(mPriority);
 		}
+	#endif
 	}
 }
 
 void*	CAPThread::Entry(CAPThread* inCAPThread)
 {
 	void* theAnswer = NULL;
+#if defined(__linux__)
+	inCAPThread->mThreadID = CAThreadScheduling::GetCurrentThreadID();
+	CAThreadScheduling::PrepareCurrentThread();
+	if(inCAPThread->mTimeConstraintSet)
+	{
+		inCAPThread->SetTimeConstraints(inCAPThread->mPeriod, inCAPThread->mComputation, inCAPThread->mConstraint, inCAPThread->mIsPreemptible);
+	}
+	else
+	{
+		inCAPThread->SetPriority(inCAPThread->mPriority);
+	}
+#endif
 	if(inCAPThread->mThreadRoutine != NULL)
 	{
 		theAnswer = inCAPThread->mThreadRoutine(inCAPThread->mThreadParameter);
 	}
+#if defined(__linux__)
+	inCAPThread->mThreadID = 0;
+#endif
 	inCAPThread->mPThread = 0;
 	return theAnswer;
 }
@@ -177,6 +226,15 @@ void*	CAPThread::Entry(CAPThread* inCAPThread)
 //========================================================================
 UInt32 CAPThread::getThreadPriority (pthread_t inThread, int inPriorityKind)
 {
+#if defined(__linux__)
+	//	only the calling thread's kernel thread ID can be found from a pthread_t
+	(void)inPriorityKind;
+	if(pthread_equal(inThread, pthread_self()))
+	{
+		return CAThreadScheduling::GetPriority(CAThreadScheduling::GetCurrentThreadID());
+	}
+	return kDefaultThreadPriority;
+#else
     thread_basic_info_data_t			threadInfo;
 	policy_info_data_t					thePolicyInfo;
 	unsigned int						count;
@@ -215,4 +273,5 @@ UInt32 CAPThread::getThreadPriority (pthread_t inThread, int inPriorityKind)
 	}
     
     return 0;
+#endif
 }
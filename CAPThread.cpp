@@ -50,7 +50,9 @@
 #include "CAException.h"
 
 //	System Includes
-#if	TARGET_OS_MAC
+#if defined(__linux__)
+	#include "CAThreadScheduling.h"
+#elif TARGET_OS_MAC
 	#include <mach/mach.h>
 #endif
 
@@ -70,7 +72,11 @@
 
 CAPThread::CAPThread(ThreadRoutine inThreadRoutine, void* inParameter, UInt32 inPriority, bool inFixedPriority, bool inAutoDelete)
 :
-#if TARGET_OS_MAC
+#if defined(__linux__)
+	mPThread(0),
+	mSpawningThreadPriority(getScheduledPriority(pthread_self(), CAPTHREAD_SET_PRIORITY)),
+	mThreadID(0),
+#elif TARGET_OS_MAC
 	mPThread(0),
     mSpawningThreadPriority(getScheduledPriority(pthread_self(), CAPTHREAD_SET_PRIORITY)),
 #elif TARGET_OS_WIN32
@@ -92,7 +98,11 @@ CAPThread::CAPThread(ThreadRoutine inThreadRoutine, void* inParameter, UInt32 in
 
 CAPThread::CAPThread(ThreadRoutine inThreadRoutine, void* inParameter, UInt32 inPeriod, UInt32 inComputation, UInt32 inConstraint, bool inIsPreemptible, bool inAutoDelete)
 :
-#if TARGET_OS_MAC
+#if defined(__linux__)
+	mPThread(0),
+	mSpawningThreadPriority(getScheduledPriority(pthread_self(), CAPTHREAD_SET_PRIORITY)),
+	mThreadID(0),
+#elif TARGET_OS_MAC
 	mPThread(0),
     mSpawningThreadPriority(getScheduledPriority(pthread_self(), CAPTHREAD_SET_PRIORITY)),
 #elif TARGET_OS_WIN32
@@ -118,7 +128,10 @@ CAPThread::~CAPThread()
 
 UInt32	CAPThread::GetScheduledPriority()
 {
-#if TARGET_OS_MAC
+#if defined(__linux__)
+	//	Linux schedules by kernel thread ID, which is only known once the thread is running
+	return (mThreadID != 0) ? CAThreadScheduling::GetPriority(mThreadID) : 0;
+#elif TARGET_OS_MAC
     return CAPThread::getScheduledPriority( mPThread, CAPTHREAD_SCHEDULED_PRIORITY );
 #elif TARGET_OS_WIN32
 	UInt32 theAnswer = 0;
@@ -135,7 +148,12 @@ void	CAPThread::SetPriority(UInt32 inPriority, bool inFixedPriority)
 	mPriority = inPriority;
 	mTimeConstraintSet = false;
 	mFixedPriority = inFixedPriority;
-#if TARGET_OS_MAC
+#if defined(__linux__)
+	if(mThreadID != 0)
+	{
+		CAThreadScheduling::SetPriority(mThreadID, mPriority, mFixedPriority);
+	}
+#elif TARGET_OS_MAC
 	if(mPThread != 0)
 	{
 		kern_return_t theError = 0;
@@ -173,7 +191,12 @@ void	CAPThread::SetTimeConstraints(UInt32 inPeriod, UInt32 inComputation, UInt32
 	mConstraint = inConstraint;
 	mIsPreemptible = inIsPreemptible;
 	mTimeConstraintSet = true;
-#if TARGET_OS_MAC
+#if defined(__linux__)
+	if(mThreadID != 0)
+	{
+		CAThreadScheduling::SetTimeConstraints(mThreadID, mPeriod, mComputation, mConstraint, mIsPreemptible);
+	}
+#elif TARGET_OS_MAC
 	if(mPThread != 0)
 	{
 		thread_time_constraint_policy_data_t thePolicy;
@@ -193,7 +216,7 @@ void	CAPThread::SetTimeConstraints(UInt32 inPeriod, UInt32 inComputation, UInt32
 
 void	CAPThread::Start()
 {
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || defined(__linux__)
 	Assert(mPThread == 0, "CAPThread::Start: can't start because the thread is already running");
 	if(mPThread == 0)
 	{
@@ -230,7 +253,7 @@ void	CAPThread::Start()
 #endif
 }
 
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || defined(__linux__)
 
 void*	CAPThread::Entry(CAPThread* inCAPThread)
 {
@@ -238,6 +261,11 @@ void*	CAPThread::Entry(CAPThread* inCAPThread)
 
 	try 
 	{
+	#if defined(__linux__)
+		//	the policy can only be applied once the kernel thread ID is known
+		inCAPThread->mThreadID = CAThreadScheduling::GetCurrentThreadID();
+		CAThreadScheduling::PrepareCurrentThread();
+	#endif
 		if(inCAPThread->mTimeConstraintSet)
 		{
 			inCAPThread->SetTimeConstraints(inCAPThread->mPeriod, inCAPThread->mComputation, inCAPThread->mConstraint, inCAPThread->mIsPreemptible);
@@ -256,12 +284,30 @@ void*	CAPThread::Entry(CAPThread* inCAPThread)
 	{
 		// what should be done here?
 	}
+#if defined(__linux__)
+	inCAPThread->mThreadID = 0;
+#endif
 	inCAPThread->mPThread = 0;
 	if (inCAPThread->mAutoDelete)
 		delete inCAPThread;
 	return theAnswer;
 }
 
+#if defined(__linux__)
+
+UInt32 CAPThread::getScheduledPriority(pthread_t inThread, int inPriorityKind)
+{
+	//	only the calling thread's kernel thread ID can be found from a pthread_t
+	(void)inPriorityKind;
+	if(pthread_equal(inThread, pthread_self()))
+	{
+		return CAThreadScheduling::GetPriority(CAThreadScheduling::GetCurrentThreadID());
+	}
+	return kDefaultThreadPriority;
+}
+
+#else
+
 UInt32 CAPThread::getScheduledPriority(pthread_t inThread, int inPriorityKind)
 {
     thread_basic_info_data_t			threadInfo;
@@ -307,6 +353,8 @@ UInt32 CAPThread::getScheduledPriority(pthread_t inThread, int inPriorityKind)
     return 0;
 }
 
+#endif
+
 #elif TARGET_OS_WIN32
 
 UInt32 WINAPI	CAPThread::Entry(CAPThread* inCAPThread)
@@ -57,6 +57,9 @@
 
 #include <CoreAudio/CoreAudioTypes.h>
 #include <pthread.h>
+#if defined(__linux__)
+	#include <sys/types.h>
+#endif
 
 //=============================================================================
 //	CAPThread
@@ -110,6 +113,9 @@ protected:
     
 	pthread_t			mPThread;
     UInt32				mSpawningThreadPriority;
+#if defined(__linux__)
+	pid_t				mThreadID;
+#endif
 	ThreadRoutine		mThreadRoutine;
 	void*				mThreadParameter;
 	SInt32				mPriority;
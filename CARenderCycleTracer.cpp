@@ -0,0 +1,537 @@
+/*	Copyright: 	 Copyright 2003 Apple Computer, Inc. All rights reserved.
+
+	Disclaimer:	IMPORTANT:  This Apple software is supplied to you by Apple Computer, Inc.
+			("Apple") in consideration of your agreement to the following terms, and your
+			use, installation, modification or redistribution of this Apple software
+			constitutes acceptance of these terms.  If you do not agree with these terms,
+			please do not use, install, modify or redistribute this Apple software.
+
+			In consideration of your agreement to abide by the following terms, and subject
+			to these terms, Apple grants you a personal, non-exclusive license, under Apples
+			copyrights in this original Apple software (the "Apple Software"), to use,
+			reproduce, modify and redistribute the Apple Software, with or without
+			modifications, in source and/or binary forms; provided that if you redistribute
+			the Apple Software in its entirety and without modifications, you must retain
+			this notice and the following text and disclaimers in all such redistributions of
+			the Apple Software.  Neither the name, trademarks, service marks or logos of
+			Apple Computer, Inc. may be used to endorse or promote products derived from the
+			Apple Software without specific prior written permission from Apple.  Except as
+			expressly stated in this notice, no other rights or licenses, express or implied,
+			are granted by Apple herein, including but not limited to any patent rights that
+			may be infringed by your derivative works or by other works in which the Apple
+			Software may be incorporated.
+
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+			WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+			WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+			PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION ALONE OR IN
+			COMBINATION WITH YOUR PRODUCTS.
+
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+			CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+			GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+			ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION AND/OR DISTRIBUTION
+			OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER UNDER THEORY OF CONTRACT, TORT
+			(INCLUDING NEGLIGENCE), STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN
+			ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CARenderCycleTracer.cpp
+
+=============================================================================*/
+
+//=============================================================================
+//	Includes
+//=============================================================================
+
+//	Self Include
+#include "CARenderCycleTracer.h"
+
+//	PublicUtility Includes
+#include "CAAtomic.h"
+#include "CAHostTimeBase.h"
+
+//	System Includes
+#include <unistd.h>
+
+//	Standard Library Includes
+#include <string.h>
+
+//=============================================================================
+//	Local Functions
+//=============================================================================
+
+static void	WriteJSONString(FILE* inFile, const char* inString)
+{
+	fputc('"', inFile);
+	for(const unsigned char* theCharacter = reinterpret_cast<const unsigned char*>(inString); *theCharacter != 0; ++theCharacter)
+	{
+		switch(*theCharacter)
+		{
+			case '"':
+				fputs("\\\"", inFile);
+				break;
+			
+			case '\\':
+				fputs("\\\\", inFile);
+				break;
+			
+			default:
+				if(*theCharacter < 0x20)
+				{
+					fprintf(inFile, "\\u%04x", *theCharacter);
+				}
+				else
+				{
+					fputc(*theCharacter, inFile);
+				}
+				break;
+		};
+	}
+	fputc('"', inFile);
+}
+
+static inline Float64	HostTimeToMicroseconds(UInt64 inHostTime)
+{
+	return static_cast<Float64>(CAHostTimeBase::ConvertToNanos(inHostTime)) / 1000.0;
+}
+
+//=============================================================================
+//	CARenderCycleTracer
+//=============================================================================
+
+CARenderCycleTracer::CARenderCycleTracer(UInt32 inNumberEventsPerThread, UInt32 inMaximumNumberThreads)
+:
+	mNumberEventsPerThread(1),
+	mMaximumNumberThreads(inMaximumNumberThreads),
+	mThreadBuffers(NULL),
+	mThreadBufferKey(),
+	mThreadBufferKeyIsValid(false),
+	mSpikeLimit(0),
+	mNanosBetweenTraces(0),
+	mCaptureLeadTime(0),
+	mLastTraceTime(0),
+	mLastRenderCycleStartTime(0),
+	mCaptureState(kCaptureStateIdle),
+	mCaptureStartTime(0),
+	mCaptureEndTime(0),
+	mCaptureUsage(0),
+	mNumberTracesWritten(0),
+	mCaptureThread(),
+	mCaptureThreadIsRunning(false),
+	mCaptureThreadShouldStop(false)
+{
+	//	the ring buffers are indexed with a mask, so round the size up to a power of 2
+	while((mNumberEventsPerThread < inNumberEventsPerThread) && (mNumberEventsPerThread < 0x80000000))
+	{
+		mNumberEventsPerThread <<= 1;
+	}
+	
+	//	all the memory is allocated up front so that the recording threads never have to
+	mThreadBuffers = new ThreadBuffer[mMaximumNumberThreads];
+	for(UInt32 theThreadIndex = 0; theThreadIndex < mMaximumNumberThreads; ++theThreadIndex)
+	{
+		ThreadBuffer& theThreadBuffer = mThreadBuffers[theThreadIndex];
+		theThreadBuffer.mState = kThreadStateFree;
+		theThreadBuffer.mWriteCount = 0;
+		theThreadBuffer.mRenderCycleStartTime = 0;
+		theThreadBuffer.mEvents = new Event[mNumberEventsPerThread];
+		theThreadBuffer.mName[0] = 0;
+	}
+	
+	//	the thread buffer key's destructor hands a buffer back when its thread exits
+	//	without it no thread can register, and nothing is recorded
+	mThreadBufferKeyIsValid = pthread_key_create(&mThreadBufferKey, ReleaseThreadBuffer) == 0;
+	
+	mTracePathRoot[0] = 0;
+}
+
+CARenderCycleTracer::~CARenderCycleTracer()
+{
+	Disestablish();
+	if(mThreadBufferKeyIsValid)
+	{
+		pthread_key_delete(mThreadBufferKey);
+	}
+	for(UInt32 theThreadIndex = 0; theThreadIndex < mMaximumNumberThreads; ++theThreadIndex)
+	{
+		delete[] mThreadBuffers[theThreadIndex].mEvents;
+	}
+	delete[] mThreadBuffers;
+}
+
+bool	CARenderCycleTracer::RegisterCurrentThread(const char* inThreadName)
+{
+	if(!mThreadBufferKeyIsValid)
+	{
+		return false;
+	}
+	
+	ThreadBuffer* theThreadBuffer = static_cast<ThreadBuffer*>(pthread_getspecific(mThreadBufferKey));
+	if(theThreadBuffer != NULL)
+	{
+		//	already registered, so just update the name
+		if(inThreadName != NULL)
+		{
+			strncpy(theThreadBuffer->mName, inThreadName, sizeof(theThreadBuffer->mName) - 1);
+			theThreadBuffer->mName[sizeof(theThreadBuffer->mName) - 1] = 0;
+		}
+	}
+	else
+	{
+		theThreadBuffer = ClaimThreadBuffer(inThreadName);
+	}
+	return theThreadBuffer != NULL;
+}
+
+bool	CARenderCycleTracer::Establish(const char* inTracePathRoot, Float64 inSpikeLimit, UInt32 inSecondsBetweenTraces)
+{
+	Disestablish();
+	if((inTracePathRoot == NULL) || (strlen(inTracePathRoot) >= sizeof(mTracePathRoot)))
+	{
+		return false;
+	}
+	
+	strcpy(mTracePathRoot, inTracePathRoot);
+	mSpikeLimit = inSpikeLimit;
+	mNanosBetweenTraces = static_cast<UInt64>(inSecondsBetweenTraces) * 1000000000ULL;
+	mCaptureLeadTime = CAHostTimeBase::ConvertFromNanos(1000 * 1000);
+	
+	//	like AUTracer, the first trace can be taken right away
+	mLastTraceTime = 0;
+	mCaptureState = kCaptureStateIdle;
+	
+	mCaptureThreadShouldStop = false;
+	mCaptureThreadIsRunning = pthread_create(&mCaptureThread, NULL, CaptureThreadEntry, this) == 0;
+	return mCaptureThreadIsRunning;
+}
+
+void	CARenderCycleTracer::Disestablish()
+{
+	if(mCaptureThreadIsRunning)
+	{
+		mCaptureThreadShouldStop = true;
+		pthread_join(mCaptureThread, NULL);
+		mCaptureThreadIsRunning = false;
+	}
+}
+
+void	CARenderCycleTracer::BeginRenderCycle()
+{
+	ThreadBuffer* theThreadBuffer = GetCurrentThreadBuffer();
+	if(theThreadBuffer != NULL)
+	{
+		UInt64 theNow = CAHostTimeBase::GetCurrentTime();
+		theThreadBuffer->mRenderCycleStartTime = theNow;
+		mLastRenderCycleStartTime = theNow;
+		Record(theThreadBuffer, kPhaseBegin, "RenderCycle", 0.0, theNow);
+	}
+}
+
+void	CARenderCycleTracer::EndRenderCycle(UInt32 inNumberFrames, Float64 inSampleRate)
+{
+	ThreadBuffer* theThreadBuffer = GetCurrentThreadBuffer();
+	if(theThreadBuffer != NULL)
+	{
+		UInt64 theNow = CAHostTimeBase::GetCurrentTime();
+		Record(theThreadBuffer, kPhaseEnd, "RenderCycle", 0.0, theNow);
+		
+		//	figure out how much of the duty cycle the render cycle took
+		UInt64 theStartTime = theThreadBuffer->mRenderCycleStartTime;
+		if((mSpikeLimit > 0) && (inNumberFrames > 0) && (inSampleRate > 0) && (theStartTime != 0) && (theNow >= theStartTime))
+		{
+			Float64 theDutyCycleNanos = (inNumberFrames / inSampleRate) * 1000000000.0;
+			Float64 theUsage = static_cast<Float64>(CAHostTimeBase::ConvertToNanos(theNow - theStartTime)) / theDutyCycleNanos;
+			if(theUsage > mSpikeLimit)
+			{
+				Record(theThreadBuffer, kPhaseMark, "Spike", theUsage, theNow);
+				TriggerCapture(theStartTime, theNow, theUsage);
+			}
+		}
+	}
+}
+
+void	CARenderCycleTracer::NoteOverload()
+{
+	UInt64 theNow = CAHostTimeBase::GetCurrentTime();
+	ThreadBuffer* theThreadBuffer = GetCurrentThreadBuffer();
+	if(theThreadBuffer != NULL)
+	{
+		Record(theThreadBuffer, kPhaseMark, "Overload", 0.0, theNow);
+	}
+	
+	//	the overload is blamed on the most recent render cycle, whichever thread ran it
+	UInt64 theStartTime = mLastRenderCycleStartTime;
+	TriggerCapture(((theStartTime != 0) && (theStartTime <= theNow)) ? theStartTime : theNow, theNow, -1.0);
+}
+
+bool	CARenderCycleTracer::WriteChromeTrace(const char* inPath, const char* inReason) const
+{
+	bool theAnswer = false;
+	FILE* theFile = fopen(inPath, "w");
+	if(theFile != NULL)
+	{
+		WriteChromeTrace(theFile, 0, 0xFFFFFFFFFFFFFFFFULL, inReason);
+		theAnswer = ferror(theFile) == 0;
+		theAnswer = (fclose(theFile) == 0) && theAnswer;
+	}
+	return theAnswer;
+}
+
+void	CARenderCycleTracer::WriteChromeTrace(FILE* inFile, UInt64 inStartTime, UInt64 inEndTime, const char* inReason) const
+{
+	int thePID = getpid();
+	EventList theEvents;
+	theEvents.reserve(mNumberEventsPerThread);
+	char theThreadName[sizeof(mThreadBuffers[0].mName)];
+	const char* theSeparator = "";
+	
+	fprintf(inFile, "{\"traceEvents\":[");
+	for(UInt32 theThreadIndex = 0; theThreadIndex < mMaximumNumberThreads; ++theThreadIndex)
+	{
+		if(CopyEvents(theThreadIndex, theEvents, theThreadName, sizeof(theThreadName)))
+		{
+			fprintf(inFile, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":", theSeparator, thePID, (unsigned int)theThreadIndex);
+			WriteJSONString(inFile, theThreadName);
+			fprintf(inFile, "}}");
+			theSeparator = ",";
+			
+			//	an End whose Begin has already been overwritten or is before the start time is left out
+			UInt32 theDepth = 0;
+			for(EventList::const_iterator theIterator = theEvents.begin(); theIterator != theEvents.end(); ++theIterator)
+			{
+				if((theIterator->mHostTime >= inStartTime) && (theIterator->mHostTime <= inEndTime))
+				{
+					if(theIterator->mPhase == kPhaseBegin)
+					{
+						++theDepth;
+					}
+					else if(theIterator->mPhase == kPhaseEnd)
+					{
+						if(theDepth == 0)
+						{
+							continue;
+						}
+						--theDepth;
+					}
+					
+					fprintf(inFile, ",\n{\"name\":");
+					WriteJSONString(inFile, theIterator->mName);
+					fprintf(inFile, ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%u", (char)theIterator->mPhase, HostTimeToMicroseconds(theIterator->mHostTime), thePID, (unsigned int)theThreadIndex);
+					if(theIterator->mPhase == kPhaseMark)
+					{
+						fprintf(inFile, ",\"s\":\"t\",\"args\":{\"value\":%.6f}", theIterator->mValue);
+					}
+					fprintf(inFile, "}");
+				}
+			}
+		}
+	}
+	fprintf(inFile, "\n],\n\"displayTimeUnit\":\"ns\"");
+	if(inReason != NULL)
+	{
+		fprintf(inFile, ",\n\"otherData\":{\"reason\":");
+		WriteJSONString(inFile, inReason);
+		fprintf(inFile, "}");
+	}
+	fprintf(inFile, "\n}\n");
+}
+
+CARenderCycleTracer::ThreadBuffer*	CARenderCycleTracer::GetCurrentThreadBuffer()
+{
+	//	claiming a buffer here would mean formatting a name and setting the thread specific
+	//	value, either of which can allocate, so threads that didn't register aren't recorded
+	return mThreadBufferKeyIsValid ? static_cast<ThreadBuffer*>(pthread_getspecific(mThreadBufferKey)) : NULL;
+}
+
+CARenderCycleTracer::ThreadBuffer*	CARenderCycleTracer::ClaimThreadBuffer(const char* inThreadName)
+{
+	//	prefer buffers that have never been used so the events of exited threads stay around
+	//	as long as possible, and only then take over the buffer of a thread that has exited
+	ThreadBuffer* theThreadBuffer = NULL;
+	UInt32 theThreadIndex = 0;
+	for(theThreadIndex = 0; (theThreadBuffer == NULL) && (theThreadIndex < mMaximumNumberThreads); ++theThreadIndex)
+	{
+		if(CAAtomicCompareAndSwap32Barrier(kThreadStateFree, kThreadStateClaimed, &mThreadBuffers[theThreadIndex].mState))
+		{
+			theThreadBuffer = &mThreadBuffers[theThreadIndex];
+		}
+	}
+	for(theThreadIndex = 0; (theThreadBuffer == NULL) && (theThreadIndex < mMaximumNumberThreads); ++theThreadIndex)
+	{
+		if(CAAtomicCompareAndSwap32Barrier(kThreadStateRetired, kThreadStateClaimed, &mThreadBuffers[theThreadIndex].mState))
+		{
+			theThreadBuffer = &mThreadBuffers[theThreadIndex];
+		}
+	}
+	
+	if(theThreadBuffer != NULL)
+	{
+		theThreadBuffer->mWriteCount = 0;
+		theThreadBuffer->mRenderCycleStartTime = 0;
+		if(inThreadName != NULL)
+		{
+			strncpy(theThreadBuffer->mName, inThreadName, sizeof(theThreadBuffer->mName) - 1);
+			theThreadBuffer->mName[sizeof(theThreadBuffer->mName) - 1] = 0;
+		}
+		else
+		{
+			snprintf(theThreadBuffer->mName, sizeof(theThreadBuffer->mName), "Thread %u", (unsigned int)(theThreadBuffer - mThreadBuffers));
+		}
+		if(pthread_setspecific(mThreadBufferKey, theThreadBuffer) == 0)
+		{
+			CAMemoryBarrier();
+			theThreadBuffer->mState = kThreadStateActive;
+		}
+		else
+		{
+			//	the events that were in it are gone already, so it goes back as never used
+			theThreadBuffer->mName[0] = 0;
+			CAMemoryBarrier();
+			theThreadBuffer->mState = kThreadStateFree;
+			theThreadBuffer = NULL;
+		}
+	}
+	return theThreadBuffer;
+}
+
+void	CARenderCycleTracer::ReleaseThreadBuffer(void* inThreadBuffer)
+{
+	ThreadBuffer* theThreadBuffer = static_cast<ThreadBuffer*>(inThreadBuffer);
+	CAAtomicCompareAndSwap32Barrier(kThreadStateActive, kThreadStateRetired, &theThreadBuffer->mState);
+}
+
+void	CARenderCycleTracer::Record(UInt32 inPhase, const char* inName, Float64 inValue)
+{
+	ThreadBuffer* theThreadBuffer = GetCurrentThreadBuffer();
+	if(theThreadBuffer != NULL)
+	{
+		Record(theThreadBuffer, inPhase, inName, inValue, CAHostTimeBase::GetCurrentTime());
+	}
+}
+
+void	CARenderCycleTracer::Record(ThreadBuffer* inThreadBuffer, UInt32 inPhase, const char* inName, Float64 inValue, UInt64 inHostTime)
+{
+	//	only this thread writes to the buffer, so the event can be filled out in place and then
+	//	published by bumping the write count once it is visible
+	UInt32 theWriteCount = inThreadBuffer->mWriteCount;
+	Event& theEvent = inThreadBuffer->mEvents[theWriteCount & (mNumberEventsPerThread - 1)];
+	theEvent.mHostTime = inHostTime;
+	theEvent.mName = inName;
+	theEvent.mValue = inValue;
+	theEvent.mPhase = inPhase;
+	CAMemoryBarrier();
+	inThreadBuffer->mWriteCount = theWriteCount + 1;
+}
+
+bool	CARenderCycleTracer::CopyEvents(UInt32 inThreadIndex, EventList& outEvents, char* outName, UInt32 inNameSize) const
+{
+	const ThreadBuffer& theThreadBuffer = mThreadBuffers[inThreadIndex];
+	outEvents.clear();
+	
+	SInt32 theState = theThreadBuffer.mState;
+	if((theState != kThreadStateActive) && (theState != kThreadStateRetired))
+	{
+		return false;
+	}
+	
+	//	copy everything the writer has published so far
+	CAMemoryBarrier();
+	UInt32 theFirstWriteCount = theThreadBuffer.mWriteCount;
+	CAMemoryBarrier();
+	UInt32 theNumberEvents = (theFirstWriteCount < mNumberEventsPerThread) ? theFirstWriteCount : mNumberEventsPerThread;
+	UInt32 theFirstEventNumber = theFirstWriteCount - theNumberEvents;
+	for(UInt32 theEventIndex = 0; theEventIndex < theNumberEvents; ++theEventIndex)
+	{
+		outEvents.push_back(theThreadBuffer.mEvents[(theFirstEventNumber + theEventIndex) & (mNumberEventsPerThread - 1)]);
+	}
+	strncpy(outName, theThreadBuffer.mName, inNameSize - 1);
+	outName[inNameSize - 1] = 0;
+	CAMemoryBarrier();
+	
+	//	if the buffer was handed to a new thread while copying, none of it can be trusted
+	UInt32 theSecondWriteCount = theThreadBuffer.mWriteCount;
+	if((theThreadBuffer.mState != theState) || (theSecondWriteCount < theFirstWriteCount))
+	{
+		outEvents.clear();
+		return false;
+	}
+	
+	//	otherwise, only the events the writer got around to overwriting have to go, and
+	//	that includes the one it might be in the middle of writing
+	if(theSecondWriteCount - theFirstEventNumber >= mNumberEventsPerThread)
+	{
+		UInt32 theNumberOverwritten = theSecondWriteCount - theFirstEventNumber - mNumberEventsPerThread + 1;
+		outEvents.erase(outEvents.begin(), outEvents.begin() + ((theNumberOverwritten < theNumberEvents) ? theNumberOverwritten : theNumberEvents));
+	}
+	return true;
+}
+
+void	CARenderCycleTracer::TriggerCapture(UInt64 inStartTime, UInt64 inEndTime, Float64 inUsage)
+{
+	if(!mCaptureThreadIsRunning)
+	{
+		return;
+	}
+	
+	//	don't take another trace until enough time has passed since the last one
+	UInt64 theLastTraceTime = mLastTraceTime;
+	if((theLastTraceTime != 0) && ((inEndTime <= theLastTraceTime) || (CAHostTimeBase::ConvertToNanos(inEndTime - theLastTraceTime) < mNanosBetweenTraces)))
+	{
+		return;
+	}
+	
+	//	hand the capture off to the capture thread, unless it is still busy with the last one
+	if(CAAtomicCompareAndSwap32Barrier(kCaptureStateIdle, kCaptureStateClaimed, &mCaptureState))
+	{
+		mLastTraceTime = inEndTime;
+		mCaptureStartTime = (inStartTime > mCaptureLeadTime) ? inStartTime - mCaptureLeadTime : 0;
+		mCaptureEndTime = inEndTime;
+		mCaptureUsage = inUsage;
+		CAMemoryBarrier();
+		mCaptureState = kCaptureStatePending;
+	}
+}
+
+void*	CARenderCycleTracer::CaptureThreadEntry(void* inTracer)
+{
+	static_cast<CARenderCycleTracer*>(inTracer)->CaptureThread();
+	return NULL;
+}
+
+void	CARenderCycleTracer::CaptureThread()
+{
+	while(!mCaptureThreadShouldStop)
+	{
+		if(mCaptureState == kCaptureStatePending)
+		{
+			CAMemoryBarrier();
+			
+			char theReason[256];
+			if(mCaptureUsage >= 0)
+			{
+				snprintf(theReason, sizeof(theReason), "Spiked render cycle: time taken=%.2f%% of the duty cycle, spike limit=%.2f%%", mCaptureUsage * 100.0, mSpikeLimit * 100.0);
+			}
+			else
+			{
+				snprintf(theReason, sizeof(theReason), "Overload");
+			}
+			
+			char thePath[sizeof(mTracePathRoot) + 16];
+			snprintf(thePath, sizeof(thePath), "%s-%u.json", mTracePathRoot, (unsigned int)(mNumberTracesWritten + 1));
+			FILE* theFile = fopen(thePath, "w");
+			if(theFile != NULL)
+			{
+				WriteChromeTrace(theFile, mCaptureStartTime, mCaptureEndTime, theReason);
+				fclose(theFile);
+				++mNumberTracesWritten;
+			}
+			
+			CAMemoryBarrier();
+			mCaptureState = kCaptureStateIdle;
+		}
+		
+		//	the buffers hold a good deal more than this, so polling loses nothing
+		usleep(10 * 1000);
+	}
+}
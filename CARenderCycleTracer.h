@@ -0,0 +1,227 @@
+/*	Copyright: 	 Copyright 2003 Apple Computer, Inc. All rights reserved.
+
+	Disclaimer:	IMPORTANT:  This Apple software is supplied to you by Apple Computer, Inc.
+			("Apple") in consideration of your agreement to the following terms, and your
+			use, installation, modification or redistribution of this Apple software
+			constitutes acceptance of these terms.  If you do not agree with these terms,
+			please do not use, install, modify or redistribute this Apple software.
+
+			In consideration of your agreement to abide by the following terms, and subject
+			to these terms, Apple grants you a personal, non-exclusive license, under Apples
+			copyrights in this original Apple software (the "Apple Software"), to use,
+			reproduce, modify and redistribute the Apple Software, with or without
+			modifications, in source and/or binary forms; provided that if you redistribute
+			the Apple Software in its entirety and without modifications, you must retain
+			this notice and the following text and disclaimers in all such redistributions of
+			the Apple Software.  Neither the name, trademarks, service marks or logos of
+			Apple Computer, Inc. may be used to endorse or promote products derived from the
+			Apple Software without specific prior written permission from Apple.  Except as
+			expressly stated in this notice, no other rights or licenses, express or implied,
+			are granted by Apple herein, including but not limited to any patent rights that
+			may be infringed by your derivative works or by other works in which the Apple
+			Software may be incorporated.
+
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE MAKES NO
+			WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION THE IMPLIED
+			WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+			PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND OPERATION ALONE OR IN
+			COMBINATION WITH YOUR PRODUCTS.
+
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL OR
+			CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+			GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+			ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION, MODIFICATION AND/OR DISTRIBUTION
+			OF THE APPLE SOFTWARE, HOWEVER CAUSED AND WHETHER UNDER THEORY OF CONTRACT, TORT
+			(INCLUDING NEGLIGENCE), STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN
+			ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CARenderCycleTracer.h
+
+=============================================================================*/
+#if !defined(__CARenderCycleTracer_h__)
+#define __CARenderCycleTracer_h__
+
+//=============================================================================
+//	Includes
+//=============================================================================
+
+//	System Includes
+#include <CoreAudio/CoreAudioTypes.h>
+#include <pthread.h>
+
+//	Standard Library Includes
+#include <stdio.h>
+#include <vector>
+
+//=============================================================================
+//	CARenderCycleTracer
+//
+//	This class records what the render thread, and any other thread that cares
+//	to, is doing into a ring buffer that belongs to that thread. Recording an
+//	event is a time stamp, a couple of stores and a memory barrier. It never
+//	takes a lock, allocates memory or makes a system call, so it is safe to do
+//	from the IO thread. The buffers are read without stopping the writers. Any
+//	event that was overwritten while it was being copied is dropped.
+//
+//	A thread has to call RegisterCurrentThread before anything it records is
+//	kept. Claiming a buffer can allocate, so do it when the thread starts up,
+//	not from the IO proc. The events of threads that never registered are
+//	dropped.
+//
+//	The names passed to Begin, End and Mark are not copied, so they have to stay
+//	valid for the life of the tracer. String literals are the usual choice.
+//
+//	The events can be written out at any time in the Chrome trace event format,
+//	which Perfetto and chrome://tracing both read. The time stamps come from
+//	CAHostTimeBase.
+//
+//	Establish turns on automatic capture in the same way AUTracer does, but
+//	without needing root or kdebug. Put BeginRenderCycle and EndRenderCycle
+//	around the render work. With a spike limit greater than 0, any render cycle
+//	that takes more than that fraction of its duty cycle is captured. With a
+//	spike limit of 0, the client calls NoteOverload when the device reports an
+//	overload instead. Either way, the capture runs from 1 millisecond before the
+//	start of the offending cycle up to when it was noticed. It is written to
+//	<root>-<N>.json by a helper thread, and after a capture no new one is taken
+//	for the given number of seconds.
+//=============================================================================
+
+class CARenderCycleTracer
+{
+
+//	Constants
+public:
+	enum
+	{
+		kDefaultNumberEventsPerThread	= 8 * 1024,
+		kDefaultMaximumNumberThreads	= 8,
+		kDefaultSecondsBetweenTraces	= 20
+	};
+
+//	Construction/Destruction
+public:
+						CARenderCycleTracer(UInt32 inNumberEventsPerThread = kDefaultNumberEventsPerThread, UInt32 inMaximumNumberThreads = kDefaultMaximumNumberThreads);
+						~CARenderCycleTracer();
+
+//	Recording
+public:
+	bool				RegisterCurrentThread(const char* inThreadName);
+							//	not real time safe; returns false if there is no buffer left
+
+	void				Begin(const char* inName)							{ Record(kPhaseBegin, inName, 0.0); }
+	void				End(const char* inName)								{ Record(kPhaseEnd, inName, 0.0); }
+	void				Mark(const char* inName, Float64 inValue = 0.0)		{ Record(kPhaseMark, inName, inValue); }
+
+	class Scope
+	{
+	public:
+						Scope(CARenderCycleTracer& inTracer, const char* inName) : mTracer(inTracer), mName(inName) { mTracer.Begin(mName); }
+						~Scope() { mTracer.End(mName); }
+	private:
+						Scope(const Scope&);
+		Scope&			operator=(const Scope&);
+		CARenderCycleTracer&	mTracer;
+		const char*		mName;
+	};
+
+//	Spike Capture
+public:
+	bool				Establish(const char* inTracePathRoot, Float64 inSpikeLimit = 0, UInt32 inSecondsBetweenTraces = kDefaultSecondsBetweenTraces);
+	void				Disestablish();
+	bool				IsEstablished() const { return mCaptureThreadIsRunning; }
+
+	void				BeginRenderCycle();
+	void				EndRenderCycle(UInt32 inNumberFrames, Float64 inSampleRate);
+	void				NoteOverload();
+
+	UInt32				GetNumberTracesWritten() const { return mNumberTracesWritten; }
+
+//	Output
+public:
+	bool				WriteChromeTrace(const char* inPath, const char* inReason = NULL) const;
+	void				WriteChromeTrace(FILE* inFile, UInt64 inStartTime = 0, UInt64 inEndTime = 0xFFFFFFFFFFFFFFFFULL, const char* inReason = NULL) const;
+
+//	Implementation
+private:
+	enum
+	{
+		//	these are the Chrome trace event phases
+		kPhaseBegin		= 'B',
+		kPhaseEnd		= 'E',
+		kPhaseMark		= 'i'
+	};
+
+	enum
+	{
+		kThreadStateFree		= 0,
+		kThreadStateClaimed		= 1,
+		kThreadStateActive		= 2,
+		kThreadStateRetired		= 3
+	};
+
+	enum
+	{
+		kCaptureStateIdle		= 0,
+		kCaptureStateClaimed	= 1,
+		kCaptureStatePending	= 2
+	};
+
+	struct	Event
+	{
+		UInt64			mHostTime;
+		const char*		mName;
+		Float64			mValue;
+		UInt32			mPhase;
+	};
+
+	struct	ThreadBuffer
+	{
+		volatile SInt32	mState;
+		volatile UInt32	mWriteCount;
+		UInt64			mRenderCycleStartTime;
+		Event*			mEvents;
+		char			mName[64];
+	};
+
+	typedef std::vector<Event>	EventList;
+
+						CARenderCycleTracer(const CARenderCycleTracer&);
+	CARenderCycleTracer&	operator=(const CARenderCycleTracer&);
+
+	ThreadBuffer*		GetCurrentThreadBuffer();
+	ThreadBuffer*		ClaimThreadBuffer(const char* inThreadName);
+	static void			ReleaseThreadBuffer(void* inThreadBuffer);
+	void				Record(UInt32 inPhase, const char* inName, Float64 inValue);
+	void				Record(ThreadBuffer* inThreadBuffer, UInt32 inPhase, const char* inName, Float64 inValue, UInt64 inHostTime);
+	bool				CopyEvents(UInt32 inThreadIndex, EventList& outEvents, char* outName, UInt32 inNameSize) const;
+
+	void				TriggerCapture(UInt64 inStartTime, UInt64 inEndTime, Float64 inUsage);
+	static void*		CaptureThreadEntry(void* inTracer);
+	void				CaptureThread();
+
+	UInt32				mNumberEventsPerThread;
+	UInt32				mMaximumNumberThreads;
+	ThreadBuffer*		mThreadBuffers;
+	pthread_key_t		mThreadBufferKey;
+	bool				mThreadBufferKeyIsValid;
+
+	char				mTracePathRoot[1024];
+	Float64				mSpikeLimit;
+	UInt64				mNanosBetweenTraces;
+	UInt64				mCaptureLeadTime;
+	UInt64				mLastTraceTime;
+	volatile UInt64		mLastRenderCycleStartTime;
+	volatile SInt32		mCaptureState;
+	UInt64				mCaptureStartTime;
+	UInt64				mCaptureEndTime;
+	Float64				mCaptureUsage;
+	volatile UInt32		mNumberTracesWritten;
+
+	pthread_t			mCaptureThread;
+	volatile bool		mCaptureThreadIsRunning;
+	volatile bool		mCaptureThreadShouldStop;
+
+};
+
+#endif
@@ -42,14 +42,16 @@
 #include "CABitOperations.h"
 #include "CAAutoDisposer.h"
 #include "CAAtomic.h"
+#include "CAHostTimeBase.h"
 
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <algorithm>
 #include <libkern/OSAtomic.h>
 
 CARingBuffer::CARingBuffer() :
-	mBuffers(NULL), mNumberChannels(0), mCapacityFrames(0), mCapacityBytes(0)
+	mBuffers(NULL), mNumberChannels(0), mNumberBuffers(0), mInterleaved(false), mBytesPerFrame(0), mBytesPerRingFrame(0), mCapacityFrames(0), mCapacityFramesMask(0), mCapacityBytes(0)
 {
 
 }
@@ -60,25 +62,30 @@ CARingBuffer::~CARingBuffer()
 }
 
 
-void	CARingBuffer::Allocate(int nChannels, UInt32 bytesPerFrame, UInt32 capacityFrames)
+void	CARingBuffer::Allocate(int nChannels, UInt32 bytesPerFrame, UInt32 capacityFrames, bool interleaved)
 {
 	Deallocate();
 	
-	//capacityFrames = NextPowerOfTwo(capacityFrames);
+	// a power of 2 capacity lets FrameOffset mask instead of dividing
+	capacityFrames = NextPowerOfTwo(capacityFrames);
 	
 	mNumberChannels = nChannels;
+	mInterleaved = interleaved && nChannels > 1;
+	mNumberBuffers = mInterleaved ? 1 : nChannels;
 	mBytesPerFrame = bytesPerFrame;
+	mBytesPerRingFrame = mInterleaved ? bytesPerFrame * nChannels : bytesPerFrame;
 	mCapacityFrames = capacityFrames;
-	//mCapacityFramesMask = capacityFrames - 1;
-	mCapacityBytes = bytesPerFrame * capacityFrames;
+	mCapacityFramesMask = capacityFrames - 1;
+	mCapacityBytes = mBytesPerRingFrame * capacityFrames;
 
 	// put everything in one memory allocation, first the pointers, then the deinterleaved channels
-	UInt32 allocSize = (mCapacityBytes + sizeof(Byte *)) * nChannels;
+	// (or the single interleaved buffer)
+	UInt32 allocSize = (mCapacityBytes + sizeof(Byte *)) * mNumberBuffers;
 	Byte *p = (Byte *)CA_malloc(allocSize);
 	memset(p, 0, allocSize);
 	mBuffers = (Byte **)p;
-	p += nChannels * sizeof(Byte *);
-	for (int i = 0; i < nChannels; ++i) {
+	p += mNumberBuffers * sizeof(Byte *);
+	for (int i = 0; i < mNumberBuffers; ++i) {
 		mBuffers[i] = p;
 		p += mCapacityBytes;
 	}
@@ -99,8 +106,11 @@ void	CARingBuffer::Deallocate()
 		mBuffers = NULL;
 	}
 	mNumberChannels = 0;
+	mNumberBuffers = 0;
+	mInterleaved = false;
 	mCapacityBytes = 0;
 	mCapacityFrames = 0;
+	mCapacityFramesMask = 0;
 }
 
 inline void ZeroRange(Byte **buffers, int nchannels, int offset, int nbytes)
@@ -133,12 +143,134 @@ inline void FetchABL(AudioBufferList *abl, int destOffset, Byte **buffers, int s
 	}
 }
 
-inline void ZeroABL(AudioBufferList *abl, int destOffset, int nbytes)
+// Copy nframes samples of one channel into (Interleave) or out of (Deinterleave) a buffer whose
+// frames are stride samples apart. Converting layouts walks each channel once, straight between
+// the client's buffers and ours, without an intermediate buffer.
+template <class T>
+inline void InterleaveSamples(T *dest, const T *src, int stride, int nframes)
 {
+	while (--nframes >= 0) {
+		*dest = *src++;
+		dest += stride;
+	}
+}
+
+template <class T>
+inline void DeinterleaveSamples(T *dest, const T *src, int stride, int nframes)
+{
+	while (--nframes >= 0) {
+		*dest++ = *src;
+		src += stride;
+	}
+}
+
+inline void Interleave(Byte *dest, const Byte *src, int nchannels, int nframes, int bytesPerSample)
+{
+	switch (bytesPerSample) {
+	case 2:
+		InterleaveSamples((UInt16 *)dest, (const UInt16 *)src, nchannels, nframes);
+		break;
+	case 4:
+		InterleaveSamples((UInt32 *)dest, (const UInt32 *)src, nchannels, nframes);
+		break;
+	case 8:
+		InterleaveSamples((UInt64 *)dest, (const UInt64 *)src, nchannels, nframes);
+		break;
+	default:
+		for (int destStride = nchannels * bytesPerSample; --nframes >= 0; dest += destStride, src += bytesPerSample)
+			memcpy(dest, src, bytesPerSample);
+		break;
+	}
+}
+
+inline void Deinterleave(Byte *dest, const Byte *src, int nchannels, int nframes, int bytesPerSample)
+{
+	switch (bytesPerSample) {
+	case 2:
+		DeinterleaveSamples((UInt16 *)dest, (const UInt16 *)src, nchannels, nframes);
+		break;
+	case 4:
+		DeinterleaveSamples((UInt32 *)dest, (const UInt32 *)src, nchannels, nframes);
+		break;
+	case 8:
+		DeinterleaveSamples((UInt64 *)dest, (const UInt64 *)src, nchannels, nframes);
+		break;
+	default:
+		for (int srcStride = nchannels * bytesPerSample; --nframes >= 0; dest += bytesPerSample, src += srcStride)
+			memcpy(dest, src, bytesPerSample);
+		break;
+	}
+}
+
+// a client buffer list is interleaved if it is a single buffer of more than one channel
+bool	CARingBuffer::ABLMatchesLayout(const AudioBufferList *abl) const
+{
+	bool ablInterleaved = abl->mNumberBuffers == 1 && abl->mBuffers[0].mNumberChannels > 1;
+	return ablInterleaved == mInterleaved;
+}
+
+// the size of one frame within each of the client's buffers
+UInt32	CARingBuffer::ABLBytesPerFrame(const AudioBufferList *abl) const
+{
+	if (ABLMatchesLayout(abl))
+		return mBytesPerRingFrame;
+	return mInterleaved ? mBytesPerFrame : mBytesPerFrame * mNumberChannels;
+}
+
+void	CARingBuffer::StoreFrames(UInt32 destFrame, const AudioBufferList *abl, UInt32 srcFrame, UInt32 nFrames)
+{
+	if (ABLMatchesLayout(abl)) {
+		StoreABL(mBuffers, destFrame * mBytesPerRingFrame, abl, srcFrame * mBytesPerRingFrame, nFrames * mBytesPerRingFrame);
+	} else if (mInterleaved) {
+		// deinterleaved client buffers -> our interleaved buffer
+		int nchannels = std::min((int)abl->mNumberBuffers, mNumberChannels);
+		Byte *dest = mBuffers[0] + destFrame * mBytesPerRingFrame;
+		for (int ch = 0; ch < nchannels; ++ch, dest += mBytesPerFrame)
+			Interleave(dest, (const Byte *)abl->mBuffers[ch].mData + srcFrame * mBytesPerFrame, mNumberChannels, nFrames, mBytesPerFrame);
+	} else {
+		// interleaved client buffer -> our deinterleaved buffers
+		const Byte *src = (const Byte *)abl->mBuffers[0].mData + srcFrame * mBytesPerFrame * mNumberChannels;
+		for (int ch = 0; ch < mNumberChannels; ++ch, src += mBytesPerFrame)
+			Deinterleave(mBuffers[ch] + destFrame * mBytesPerFrame, src, mNumberChannels, nFrames, mBytesPerFrame);
+	}
+}
+
+void	CARingBuffer::FetchFrames(AudioBufferList *abl, UInt32 destFrame, UInt32 srcFrame, UInt32 nFrames)
+{
+	if (ABLMatchesLayout(abl)) {
+		FetchABL(abl, destFrame * mBytesPerRingFrame, mBuffers, srcFrame * mBytesPerRingFrame, nFrames * mBytesPerRingFrame);
+	} else if (mInterleaved) {
+		// our interleaved buffer -> deinterleaved client buffers
+		int nchannels = std::min((int)abl->mNumberBuffers, mNumberChannels);
+		const Byte *src = mBuffers[0] + srcFrame * mBytesPerRingFrame;
+		for (int ch = 0; ch < nchannels; ++ch, src += mBytesPerFrame)
+			Deinterleave((Byte *)abl->mBuffers[ch].mData + destFrame * mBytesPerFrame, src, mNumberChannels, nFrames, mBytesPerFrame);
+	} else {
+		// our deinterleaved buffers -> interleaved client buffer
+		Byte *dest = (Byte *)abl->mBuffers[0].mData + destFrame * mBytesPerFrame * mNumberChannels;
+		for (int ch = 0; ch < mNumberChannels; ++ch, dest += mBytesPerFrame)
+			Interleave(dest, mBuffers[ch] + srcFrame * mBytesPerFrame, mNumberChannels, nFrames, mBytesPerFrame);
+	}
+}
+
+void	CARingBuffer::SetABLDataByteSize(AudioBufferList *abl, UInt32 nFrames)
+{
+	UInt32 nbytes = nFrames * ABLBytesPerFrame(abl);
+	int nBuffers = abl->mNumberBuffers;
+	AudioBuffer *dest = abl->mBuffers;
+	while (--nBuffers >= 0) {
+		dest->mDataByteSize = nbytes;
+		++dest;
+	}
+}
+
+void	CARingBuffer::ZeroABL(AudioBufferList *abl, UInt32 destFrame, UInt32 nFrames)
+{
+	UInt32 bytesPerFrame = ABLBytesPerFrame(abl);
 	int nBuffers = abl->mNumberBuffers;
 	AudioBuffer *dest = abl->mBuffers;
 	while (--nBuffers >= 0) {
-		memset((Byte *)dest->mData + destOffset, 0, nbytes);
+		memset((Byte *)dest->mData + destFrame * bytesPerFrame, 0, nFrames * bytesPerFrame);
 		++dest;
 	}
 }
@@ -165,8 +297,8 @@ CARingBufferError	CARingBuffer::Store(const AudioBufferList *abl, UInt32 framesT
 	
 	// write the new frames
 	Byte **buffers = mBuffers;
-	int nchannels = mNumberChannels;
-	int offset0, offset1, nbytes;
+	int nchannels = mNumberBuffers;
+	int offset0, offset1;
 	SampleTime curEnd = EndTime();
 	
 	if (startWrite > curEnd) {
@@ -179,19 +311,13 @@ CARingBufferError	CARingBuffer::Store(const AudioBufferList *abl, UInt32 framesT
 			ZeroRange(buffers, nchannels, offset0, mCapacityBytes - offset0);
 			ZeroRange(buffers, nchannels, 0, offset1);
 		}
-		offset0 = offset1;
-	} else {
-		offset0 = FrameOffset(startWrite);
 	}
 
-	offset1 = FrameOffset(endWrite);
-	if (offset0 < offset1)
-		StoreABL(buffers, offset0, abl, 0, offset1 - offset0);
-	else {
-		nbytes = mCapacityBytes - offset0;
-		StoreABL(buffers, offset0, abl, 0, nbytes);
-		StoreABL(buffers, 0, abl, nbytes, offset1);
-	}
+	UInt32 frame0 = FrameIndex(startWrite);
+	UInt32 nframes = std::min(framesToWrite, mCapacityFrames - frame0);
+	StoreFrames(frame0, abl, 0, nframes);
+	if (nframes < framesToWrite)
+		StoreFrames(0, abl, nframes, framesToWrite - nframes);
 	
 	// now update the end time
 	SetTimeBounds(StartTime(), endWrite);
@@ -235,29 +361,28 @@ CARingBufferError	CARingBuffer::CheckTimeBounds(SampleTime& startRead, SampleTim
 	CARingBufferError err = GetTimeBounds(startTime, endTime);
 	if (err) return err;
 	
-	startRead = std::max(startRead, startTime);
-	endRead = std::min(endRead, endTime);
-
+	// classify the request before clamping it to the valid range, otherwise it always looks in bounds
 	if (startRead < startTime)
 	{
 		if (endRead > endTime)
-			return kCARingBufferError_TooMuch;
-	
-		if (endRead < startTime)
-			return kCARingBufferError_WayBehind;
+			err = kCARingBufferError_TooMuch;
+		else if (endRead < startTime)
+			err = kCARingBufferError_WayBehind;
 		else
-			return kCARingBufferError_SlightlyBehind;
+			err = kCARingBufferError_SlightlyBehind;
 	}
-	
-	if (endRead > endTime)	// we are going to read chunks of zeros its okay
+	else if (endRead > endTime)	// we are going to read chunks of zeros its okay
 	{
 		if (startRead > endTime)
-			return kCARingBufferError_WayAhead;
+			err = kCARingBufferError_WayAhead;
 		else
-			return kCARingBufferError_SlightlyAhead;
+			err = kCARingBufferError_SlightlyAhead;
 	}
 	
-	return kCARingBufferError_OK;	// success
+	startRead = std::max(startRead, startTime);
+	endRead = std::min(endRead, endTime);
+	
+	return err;
 }
 
 CARingBufferError worse(CARingBufferError a, CARingBufferError b)
@@ -278,51 +403,169 @@ CARingBufferError	CARingBuffer::Fetch(AudioBufferList *abl, UInt32 nFrames, Samp
 	SampleTime size;
 		
 	CARingBufferError err = CheckTimeBounds(startRead, endRead);
+	if (err == kCARingBufferError_CPUOverload)
+		return err;
 	size = endRead - startRead;
-	if (err) {
-		if (!outOfBoundsOK) return err;
-		if (size <= 0) return err; // there is nothing to read
+	if (size <= 0) {
+		// there is nothing to read (WayBehind or WayAhead), so the client gets silence
+		ZeroABL(abl, 0, nFrames);
+		SetABLDataByteSize(abl, nFrames);
+		return err;
 	}
+	if (!outOfBoundsOK)
+		err = kCARingBufferError_OK;	// a partial read is zero padded, and was always reported as OK
 	
-	SInt32 destStartOffset = startRead - startRead0; 
-	if (destStartOffset > 0) {
-		ZeroABL(abl, 0, destStartOffset * mBytesPerFrame);
+	UInt32 destStartFrame = (UInt32)(startRead - startRead0);
+	if (destStartFrame > 0) {
+		ZeroABL(abl, 0, destStartFrame);
 	}
 
-	SInt32 destEndSize = endRead0 - endRead; 
-	if (destEndSize > 0) {
-		ZeroABL(abl, destStartOffset + size, destEndSize * mBytesPerFrame);
+	UInt32 destEndFrames = (UInt32)(endRead0 - endRead);
+	if (destEndFrames > 0) {
+		ZeroABL(abl, destStartFrame + (UInt32)size, destEndFrames);
 	}
 	
-	Byte **buffers = mBuffers;
-	int offset0 = FrameOffset(startRead);
-	int offset1 = FrameOffset(endRead);
-	int nbytes;
+	UInt32 frame0 = FrameIndex(startRead);
+	UInt32 nframes = std::min((UInt32)size, mCapacityFrames - frame0);
+	FetchFrames(abl, destStartFrame, frame0, nframes);
+	if (nframes < size)
+		FetchFrames(abl, destStartFrame + nframes, 0, (UInt32)size - nframes);
+
+	SetABLDataByteSize(abl, (UInt32)size);
+
+	// The data may have been overwritten before we could finish reading it. A writer that keeps
+	// appending shows up as the start time having passed the start of what we copied. A Store
+	// that went backwards reset the bounds to where it wrote, which shows up as the end time
+	// being before the end of what we copied, unless that Store has already written past it.
+	SampleTime startTime, endTime;
+	CARingBufferError err2 = GetTimeBounds(startTime, endTime);
+	if (!err2) {
+		if (startRead < startTime)
+			err2 = (endRead < startTime) ? kCARingBufferError_WayBehind : kCARingBufferError_SlightlyBehind;
+		else if (endRead > endTime)
+			err2 = (startRead > endTime) ? kCARingBufferError_WayAhead : kCARingBufferError_SlightlyAhead;
+	}
+	return worse(err, err2);
+}
+
+// ____________________________________________________________________________
+
+CARingBufferError	CARingBuffer::FetchModulo(AudioBufferList *abl, UInt32 nFrames, SampleTime startRead)
+{
+	SampleTime endRead = startRead + nFrames;
+	CARingBufferError err = CheckTimeBounds(startRead, endRead);
+	if (err)
+		return err;
 	
+	int offset0 = (int)((startRead % mCapacityFrames) * mBytesPerRingFrame);
+	int offset1 = (int)((endRead % mCapacityFrames) * mBytesPerRingFrame);
 	if (offset0 < offset1) {
-		FetchABL(abl, destStartOffset, buffers, offset0, nbytes = offset1 - offset0);
+		FetchABL(abl, 0, mBuffers, offset0, offset1 - offset0);
 	} else {
-		nbytes = mCapacityBytes - offset0;
-		FetchABL(abl, destStartOffset, buffers, offset0, nbytes);
-		FetchABL(abl, destStartOffset + nbytes, buffers, 0, offset1);
-		nbytes += offset1;
+		int nbytes = mCapacityBytes - offset0;
+		FetchABL(abl, 0, mBuffers, offset0, nbytes);
+		FetchABL(abl, nbytes, mBuffers, 0, offset1);
 	}
+	SetABLDataByteSize(abl, nFrames);
+	
+	return worse(err, CheckTimeBounds(startRead, endRead));
+}
 
-	int nchannels = abl->mNumberBuffers;
-	AudioBuffer *dest = abl->mBuffers;
-	while (--nchannels >= 0)
-	{
-		dest->mDataByteSize = nbytes;
-		dest++;
+static AudioBufferList *	AllocateBufferList(int nBuffers, UInt32 nFrames)
+{
+	AudioBufferList *abl = (AudioBufferList *)calloc(1, offsetof(AudioBufferList, mBuffers) + nBuffers * sizeof(AudioBuffer));
+	abl->mNumberBuffers = nBuffers;
+	for (int i = 0; i < nBuffers; ++i) {
+		abl->mBuffers[i].mNumberChannels = 1;
+		abl->mBuffers[i].mDataByteSize = nFrames * sizeof(Float32);
+		abl->mBuffers[i].mData = calloc(nFrames, sizeof(Float32));
 	}
+	return abl;
+}
 
-	// have to check bounds again because the data may have been overwritten before we could finish reading it. 
-	OSStatus err2 = CheckTimeBounds(startRead, endRead);
-	err2 = worse(err, err2);
-	size = endRead - startRead;
-	if (err2) {
-		if (!outOfBoundsOK) return err2;
-		if (size <= 0) return err2; // there is nothing to read
+static void	FreeBufferList(AudioBufferList *abl)
+{
+	for (UInt32 i = 0; i < abl->mNumberBuffers; ++i)
+		free(abl->mBuffers[i].mData);
+	free(abl);
+}
+
+bool	CARingBuffer::MeasureFetch(int nChannels, UInt32 framesPerFetch, UInt32 nFetches, FetchStatistics &outStats)
+{
+	memset(&outStats, 0, sizeof(outStats));
+	if (nChannels < 1 || framesPerFetch == 0 || nFetches == 0)
+		return false;
+	
+	CARingBuffer ring;
+	ring.Allocate(nChannels, sizeof(Float32), 4 * framesPerFetch);
+	const UInt32 capacity = ring.GetCapacityFrames();
+	outStats.mNumberChannels = nChannels;
+	outStats.mFramesPerFetch = framesPerFetch;
+	outStats.mCapacityFrames = capacity;
+	
+	// fill the buffer starting half way in, so the valid range wraps around its end
+	const SampleTime startTime = capacity / 2;
+	AudioBufferList *abl = AllocateBufferList(nChannels, framesPerFetch);
+	AudioBufferList *moduloABL = AllocateBufferList(nChannels, framesPerFetch);
+	for (UInt32 frame = 0; frame < capacity; frame += framesPerFetch) {
+		for (int ch = 0; ch < nChannels; ++ch) {
+			Float32 *p = (Float32 *)abl->mBuffers[ch].mData;
+			for (UInt32 i = 0; i < framesPerFetch; ++i)
+				p[i] = Float32((startTime + frame + i) * 64 + ch);
+		}
+		ring.Store(abl, framesPerFetch, startTime + frame);
 	}
-	return err2;
+	
+	// scattered start times; 977 is prime, so they cover every offset when the span allows
+	const UInt32 span = capacity - framesPerFetch + 1;
+	UInt32 pos = 0;
+	
+	// the two paths must agree, and Fetch must return what was stored
+	for (UInt32 k = 0; k < 64; ++k, pos = (pos + 977) % span) {
+		CARingBufferError err = ring.Fetch(abl, framesPerFetch, startTime + pos, false);
+		CARingBufferError err2 = ring.FetchModulo(moduloABL, framesPerFetch, startTime + pos);
+		bool same = (err == kCARingBufferError_OK && err2 == kCARingBufferError_OK);
+		for (int ch = 0; same && ch < nChannels; ++ch) {
+			const Float32 *p = (const Float32 *)abl->mBuffers[ch].mData;
+			same = memcmp(p, moduloABL->mBuffers[ch].mData, framesPerFetch * sizeof(Float32)) == 0
+				&& p[0] == Float32((startTime + pos) * 64 + ch);
+		}
+		if (!same)
+			++outStats.mMismatches;
+	}
+	
+	UInt64 t0 = CAHostTimeBase::GetCurrentTimeInNanos();
+	pos = 0;
+	for (UInt32 k = 0; k < nFetches; ++k, pos = (pos + 977) % span)
+		ring.Fetch(abl, framesPerFetch, startTime + pos, false);
+	UInt64 t1 = CAHostTimeBase::GetCurrentTimeInNanos();
+	pos = 0;
+	for (UInt32 k = 0; k < nFetches; ++k, pos = (pos + 977) % span)
+		ring.FetchModulo(moduloABL, framesPerFetch, startTime + pos);
+	UInt64 t2 = CAHostTimeBase::GetCurrentTimeInNanos();
+	
+	outStats.mMaskedNanosPerFetch = Float64(t1 - t0) / nFetches;
+	outStats.mModuloNanosPerFetch = Float64(t2 - t1) / nFetches;
+	
+	FreeBufferList(abl);
+	FreeBufferList(moduloABL);
+	return outStats.mMismatches == 0;
+}
+
+bool	CARingBuffer::MeasureFetches(UInt32 nFetches, FILE *report)
+{
+	static const int kChannels[] = { 1, 2, 8, 32 };
+	static const UInt32 kFrames[] = { 64, 512, 4096 };
+	bool passed = true;
+	for (size_t c = 0; c < sizeof(kChannels) / sizeof(kChannels[0]); ++c)
+		for (size_t f = 0; f < sizeof(kFrames) / sizeof(kFrames[0]); ++f) {
+			FetchStatistics stats;
+			if (!MeasureFetch(kChannels[c], kFrames[f], nFetches, stats))
+				passed = false;
+			if (report != NULL)
+				fprintf(report, "%2d ch, %4u frames (capacity %u): masked %.0f ns, modulo %.0f ns per fetch, %u mismatches\n",
+					stats.mNumberChannels, (unsigned)stats.mFramesPerFetch, (unsigned)stats.mCapacityFrames,
+					stats.mMaskedNanosPerFetch, stats.mModuloNanosPerFetch, (unsigned)stats.mMismatches);
+		}
+	return passed;
 }
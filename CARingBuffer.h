@@ -48,6 +48,8 @@
 #ifndef CARingBuffer_Header
 #define CARingBuffer_Header
 
+#include <stdio.h>
+
 enum {
 	kCARingBufferError_WayBehind = -2, // both fetch times are earlier than buffer start time
 	kCARingBufferError_SlightlyBehind = -1, // fetch start time is earlier than buffer start time (fetch end time OK)
@@ -70,8 +72,13 @@ public:
 	CARingBuffer();
 	~CARingBuffer();
 	
-	void					Allocate(int nChannels, UInt32 bytesPerFrame, UInt32 capacityFrames);
+	void					Allocate(int nChannels, UInt32 bytesPerFrame, UInt32 capacityFrames, bool interleaved = false);
 								// capacityFrames will be rounded up to a power of 2
+								// bytesPerFrame is the size of one channel's sample in a frame.
+								// If interleaved is true, the channels are stored interleaved in a single buffer.
+								// Store and Fetch accept buffer lists in either layout: a single buffer with
+								// mNumberChannels > 1 is interleaved, anything else is one buffer per channel.
+								// When the layouts differ, the data is (de)interleaved on the fly.
 	void					Deallocate();
 	
 	CARingBufferError	Store(const AudioBufferList *abl, UInt32 nFrames, SampleTime frameNumber);
@@ -84,15 +91,88 @@ public:
 							
 							// Return false for failure (buffer not large enough).
 				
-	CARingBufferError	Fetch(AudioBufferList *abl, UInt32 nFrames, SampleTime frameNumber, bool aheadOK);
+	CARingBufferError	Fetch(AudioBufferList *abl, UInt32 nFrames, SampleTime frameNumber, bool outOfBoundsOK);
 								// will alter mNumDataBytes of the buffers
+								// Frames outside the buffer's time bounds are zeroed. A read that only
+								// partly overlaps them returns OK, unless outOfBoundsOK, in which case it
+								// returns SlightlyBehind, SlightlyAhead or TooMuch. A read entirely out
+								// of bounds returns WayBehind or WayAhead either way, with abl zeroed.
 	
 	CARingBufferError	GetTimeBounds(SampleTime &startTime, SampleTime &endTime);
 	
+	UInt32					GetCapacityFrames() const { return mCapacityFrames; }
+	bool					IsInterleaved() const { return mInterleaved; }
+
+	struct FetchStatistics {
+		int						mNumberChannels;
+		UInt32					mFramesPerFetch;
+		UInt32					mCapacityFrames;
+		Float64					mMaskedNanosPerFetch;	// Fetch
+		Float64					mModuloNanosPerFetch;	// the same reads with 64-bit modulo offsets and the
+														// bounds checked again after copying, as before masking
+		UInt32					mMismatches;			// fetches whose data or result differ between the two
+	};
+	
+	static bool				MeasureFetch(int nChannels, UInt32 framesPerFetch, UInt32 nFetches, FetchStatistics &outStats);
+								// deinterleaved Float32 reads at scattered, in bounds times, some wrapping
+								// around the end of the buffer; false if the two paths disagree
+	static bool				MeasureFetches(UInt32 nFetches, FILE *report);
+								// 1, 2, 8 and 32 channels at 64, 512 and 4096 frames per fetch, one line
+								// each to report if not NULL
+
+	// A Reader is an independent consumer's cursor into a ring buffer. Any number of Readers
+	// may fetch from one writer, each at its own sample time; each Fetch advances the cursor
+	// by the number of frames requested, whether or not they were all in bounds.
+	class Reader {
+	public:
+		Reader() : mRingBuffer(NULL), mNextTime(0) { }
+		Reader(CARingBuffer &ring, SampleTime startTime) : mRingBuffer(&ring), mNextTime(startTime) { }
+		
+		void				Attach(CARingBuffer &ring, SampleTime startTime) { mRingBuffer = &ring; mNextTime = startTime; }
+		
+		SampleTime			GetNextTime() const { return mNextTime; }
+		void				SetNextTime(SampleTime t) { mNextTime = t; }
+		
+		CARingBufferError	Fetch(AudioBufferList *abl, UInt32 nFrames, bool outOfBoundsOK)
+							{
+								CARingBufferError err = mRingBuffer->Fetch(abl, nFrames, mNextTime, outOfBoundsOK);
+								mNextTime += nFrames;
+								return err;
+							}
+		
+		// number of frames that can be fetched from the cursor without running past the writer
+		SampleTime			GetFramesAvailable() const
+							{
+								SampleTime startTime, endTime;
+								if (mRingBuffer->GetTimeBounds(startTime, endTime) || mNextTime < startTime)
+									return 0;
+								return endTime > mNextTime ? endTime - mNextTime : 0;
+							}
+		
+	private:
+		CARingBuffer *		mRingBuffer;
+		SampleTime			mNextTime;
+	};
+	
 protected:
 
-	int						FrameOffset(SampleTime frameNumber) { return (frameNumber % mCapacityFrames) * mBytesPerFrame; }
+	UInt32					FrameIndex(SampleTime frameNumber) const { return (UInt32)(frameNumber & mCapacityFramesMask); }
+	int						FrameOffset(SampleTime frameNumber) const { return (int)(FrameIndex(frameNumber) * mBytesPerRingFrame); }
+
+	bool					ABLMatchesLayout(const AudioBufferList *abl) const;
+	UInt32					ABLBytesPerFrame(const AudioBufferList *abl) const;
+	
+	// these copy frames that do not wrap around the end of the buffer
+	void					StoreFrames(UInt32 destFrame, const AudioBufferList *abl, UInt32 srcFrame, UInt32 nFrames);
+	void					FetchFrames(AudioBufferList *abl, UInt32 destFrame, UInt32 srcFrame, UInt32 nFrames);
+	void					ZeroABL(AudioBufferList *abl, UInt32 destFrame, UInt32 nFrames);
+	void					SetABLDataByteSize(AudioBufferList *abl, UInt32 nFrames);
+	CARingBufferError		FetchModulo(AudioBufferList *abl, UInt32 nFrames, SampleTime startRead);
+								// for MeasureFetch; in bounds reads into a matching layout only
 
+	// Classifies [startRead, endRead) against the buffer's time bounds, then clamps it to
+	// them. A range that only partly overlaps the bounds is SlightlyBehind, SlightlyAhead or
+	// TooMuch; before the classification came ahead of the clamping, it was reported as OK.
 	CARingBufferError	CheckTimeBounds(SampleTime& startRead, SampleTime& endRead);
 	
 	// these should only be called from Store.
@@ -103,10 +183,13 @@ protected:
 protected:
 	Byte **					mBuffers;				// allocated in one chunk of memory
 	int						mNumberChannels;
+	int						mNumberBuffers;			// 1 if interleaved, else mNumberChannels
+	bool					mInterleaved;
 	UInt32					mBytesPerFrame;			// within one deinterleaved channel
+	UInt32					mBytesPerRingFrame;		// within one of mBuffers
 	UInt32					mCapacityFrames;		// per channel, must be a power of 2
-	//UInt32				mCapacityFramesMask;
-	UInt32					mCapacityBytes;			// per channel
+	UInt32					mCapacityFramesMask;
+	UInt32					mCapacityBytes;			// per buffer
 	
 	// range of valid sample time in the buffer
 	typedef struct {
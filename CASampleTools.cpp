@@ -45,12 +45,22 @@
 //=============================================================================
 
 #include "CASampleTools.h"
+#include "CAVectorUnit.h"
+#include "CAStreamBasicDescription.h"
+#include "CAHostTimeBase.h"
+#include <string.h>
+#include <math.h>
 
 #define ASM __asm__ volatile		// bad things happen with plain "asm"
 
 // ____________________________________________________________________________
 //
 //	Types for use in algorithms
+// a packed 24 bit sample
+struct CAPacked24 {
+	u_int8_t	mBytes[3];
+};
+
 class CAFloat32 {
 public:
 	typedef float value_type;
@@ -153,6 +163,51 @@ public:
 	typedef CASInt32Swap	CASInt32Big;
 #endif
 
+// packed 24 bit samples are handled a byte at a time, so they don't depend on the host's byte order;
+// the value is sign extended from 24 bits
+class CASInt24Little {
+public:
+	typedef CAPacked24 value_type;
+	
+	static int32_t load(const value_type *p)
+	{
+		return int32_t((u_int32_t(p->mBytes[0]) << 8) | (u_int32_t(p->mBytes[1]) << 16) | (u_int32_t(p->mBytes[2]) << 24)) >> 8;
+	}
+	static void store(value_type *p, int val)
+	{
+		p->mBytes[0] = val;
+		p->mBytes[1] = val >> 8;
+		p->mBytes[2] = val >> 16;
+	}
+};
+
+class CASInt24Big {
+public:
+	typedef CAPacked24 value_type;
+	
+	static int32_t load(const value_type *p)
+	{
+		return int32_t((u_int32_t(p->mBytes[2]) << 8) | (u_int32_t(p->mBytes[1]) << 16) | (u_int32_t(p->mBytes[0]) << 24)) >> 8;
+	}
+	static void store(value_type *p, int val)
+	{
+		p->mBytes[2] = val;
+		p->mBytes[1] = val >> 8;
+		p->mBytes[0] = val >> 16;
+	}
+};
+
+// 20 bit samples aligned high in 24 bits load as 24 bit samples; the 4 low bits are cleared on store
+class CASInt20In24Little : public CASInt24Little {
+public:
+	static void store(value_type *p, int val)	{ CASInt24Little::store(p, val & ~0xF); }
+};
+
+class CASInt20In24Big : public CASInt24Big {
+public:
+	static void store(value_type *p, int val)	{ CASInt24Big::store(p, val & ~0xF); }
+};
+
 // ____________________________________________________________________________
 //
 // CAFloatToInt
@@ -172,6 +227,12 @@ inline int32_t CAFloatToInt(double inf)
 	i = u.i[1];
 	return i;
 #else
+	// saturate out of range values (and NaN, to the negative limit) as fctiw does;
+	// a plain conversion's result is undefined for them
+	if (inf >= 2147483648.0)
+		return 0x7FFFFFFF;
+	if (!(inf > -2147483649.0))
+		return (int32_t)0x80000000;
 	return (int32_t)inf;
 #endif
 }
@@ -249,6 +310,495 @@ public:
 #endif
 };
 
+// ____________________________________________________________________________
+//
+//	Vector kernels
+//
+//	Each kernel class converts whole vectors of samples and returns the number of samples it
+//	handled; the caller finishes the remainder with the scalar loops below. The kernels use the
+//	same scale factors and the same saturating truncation as the scalar code, so their output is
+//	bit-for-bit identical to it. Big endian formats are byte swapped in the vector registers.
+//
+//	The load and store overloads are selected by the sample type classes above.
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+	#define CA_SAMPLETOOLS_SSE2	1
+	#include <emmintrin.h>
+	#if defined(__GNUC__)
+		// the AVX2 kernels are compiled for AVX2 function by function, so that the rest of the
+		// file still runs on any SSE2 machine
+		#define CA_SAMPLETOOLS_AVX2	1
+		#define CA_AVX2_TARGET	__attribute__((target("avx2")))
+		#include <immintrin.h>
+	#endif
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+	#define CA_SAMPLETOOLS_NEON	1
+	#include <arm_neon.h>
+#endif
+
+#if CA_SAMPLETOOLS_SSE2
+class CASSE2Kernels {
+public:
+	enum { kSamplesPerVector = 4 };
+
+	static __m128i	Swap16(__m128i v) { return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)); }
+	static __m128i	Swap32(__m128i v)
+	{
+		v = Swap16(v);
+		v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+		return _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+	}
+	
+	static __m128i	load(CASInt8, const int8_t *p)
+	{
+		int32_t x;
+		memcpy(&x, p, sizeof(x));
+		__m128i v = _mm_cvtsi32_si128(x);
+		v = _mm_unpacklo_epi8(v, v);
+		return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 24);
+	}
+	static __m128i	load(CASInt16Native, const int16_t *p)
+	{
+		__m128i v = _mm_loadl_epi64((const __m128i *)p);
+		return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+	}
+	static __m128i	load(CASInt16Swap, const int16_t *p)
+	{
+		__m128i v = Swap16(_mm_loadl_epi64((const __m128i *)p));
+		return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+	}
+	static __m128i	load(CASInt32Native, const int32_t *p) { return _mm_loadu_si128((const __m128i *)p); }
+	static __m128i	load(CASInt32Swap, const u_int32_t *p) { return Swap32(_mm_loadu_si128((const __m128i *)p)); }
+
+	// the values stored have already been shifted into range, so the saturating packs don't clip
+	static void		store(CASInt8, int8_t *p, __m128i v)
+	{
+		v = _mm_packs_epi32(v, v);
+		int32_t x = _mm_cvtsi128_si32(_mm_packs_epi16(v, v));
+		memcpy(p, &x, sizeof(x));
+	}
+	static void		store(CASInt16Native, int16_t *p, __m128i v) { _mm_storel_epi64((__m128i *)p, _mm_packs_epi32(v, v)); }
+	static void		store(CASInt16Swap, int16_t *p, __m128i v) { _mm_storel_epi64((__m128i *)p, Swap16(_mm_packs_epi32(v, v))); }
+	static void		store(CASInt32Native, int32_t *p, __m128i v) { _mm_storeu_si128((__m128i *)p, v); }
+	static void		store(CASInt32Swap, u_int32_t *p, __m128i v) { _mm_storeu_si128((__m128i *)p, Swap32(v)); }
+
+	// SSE2 has no byte shuffle, so packed 24 bit samples are gathered and scattered a sample at a time
+	template <class S>
+	static __m128i	Load24(const CAPacked24 *p) { return _mm_setr_epi32(S::load(p), S::load(p + 1), S::load(p + 2), S::load(p + 3)); }
+	template <class D>
+	static void		Store24(CAPacked24 *p, __m128i v)
+	{
+		int32_t x[kSamplesPerVector];
+		_mm_storeu_si128((__m128i *)x, v);
+		for (int i = 0; i < kSamplesPerVector; ++i)
+			D::store(p + i, x[i]);
+	}
+	static __m128i	load(CASInt24Little, const CAPacked24 *p) { return Load24<CASInt24Little>(p); }
+	static __m128i	load(CASInt24Big, const CAPacked24 *p) { return Load24<CASInt24Big>(p); }
+	static void		store(CASInt24Little, CAPacked24 *p, __m128i v) { Store24<CASInt24Little>(p, v); }
+	static void		store(CASInt24Big, CAPacked24 *p, __m128i v) { Store24<CASInt24Big>(p, v); }
+	static void		store(CASInt20In24Little, CAPacked24 *p, __m128i v) { Store24<CASInt24Little>(p, _mm_and_si128(v, _mm_set1_epi32(~0xF))); }
+	static void		store(CASInt20In24Big, CAPacked24 *p, __m128i v) { Store24<CASInt24Big>(p, _mm_and_si128(v, _mm_set1_epi32(~0xF))); }
+	
+	// saturating truncation, as CAFloatToInt: cvttps2dq returns 0x80000000 on overflow, which
+	// flipping all the bits turns into 0x7FFFFFFF for the positive side
+	static __m128i	FloatToInt(__m128 f)
+	{
+		__m128i overflow = _mm_castps_si128(_mm_cmpge_ps(f, _mm_set1_ps(2147483648.0f)));
+		return _mm_xor_si128(_mm_cvttps_epi32(f), overflow);
+	}
+
+	template <class S>
+	static u_int32_t	CopyToFloat32(const typename S::value_type *src, float *dest, u_int32_t inNumberSamples, float scale)
+	{
+		__m128 vscale = _mm_set1_ps(scale);
+		for (u_int32_t count = inNumberSamples / kSamplesPerVector; count--; src += kSamplesPerVector, dest += kSamplesPerVector)
+			_mm_storeu_ps(dest, _mm_mul_ps(_mm_cvtepi32_ps(load(S(), src)), vscale));
+		return inNumberSamples & ~(kSamplesPerVector - 1);
+	}
+	
+	template <class D>
+	static u_int32_t	CopyFromFloat32(const float *src, typename D::value_type *dest, u_int32_t inNumberSamples, int shift)
+	{
+		__m128 vscale = _mm_set1_ps(2147483648.0f);
+		__m128i vshift = _mm_cvtsi32_si128(shift);
+		for (u_int32_t count = inNumberSamples / kSamplesPerVector; count--; src += kSamplesPerVector, dest += kSamplesPerVector)
+			store(D(), dest, _mm_sra_epi32(FloatToInt(_mm_mul_ps(_mm_loadu_ps(src), vscale)), vshift));
+		return inNumberSamples & ~(kSamplesPerVector - 1);
+	}
+	
+	static u_int32_t	MixFloat32(const float *src, float *dest, u_int32_t inNumberSamples)
+	{
+		for (u_int32_t count = inNumberSamples / kSamplesPerVector; count--; src += kSamplesPerVector, dest += kSamplesPerVector)
+			_mm_storeu_ps(dest, _mm_add_ps(_mm_loadu_ps(dest), _mm_loadu_ps(src)));
+		return inNumberSamples & ~(kSamplesPerVector - 1);
+	}
+	// xorshift32 in each lane
+	static __m128i	NextRandom(__m128i &ioSeed)
+	{
+		ioSeed = _mm_xor_si128(ioSeed, _mm_slli_epi32(ioSeed, 13));
+		ioSeed = _mm_xor_si128(ioSeed, _mm_srli_epi32(ioSeed, 17));
+		ioSeed = _mm_xor_si128(ioSeed, _mm_slli_epi32(ioSeed, 5));
+		return ioSeed;
+	}
+	
+	// triangular noise in (-1, 1) from the difference of the two halves of a random word
+	static __m128	TPDF(__m128i r)
+	{
+		__m128i d = _mm_sub_epi32(_mm_and_si128(r, _mm_set1_epi32(0xFFFF)), _mm_srli_epi32(r, 16));
+		return _mm_mul_ps(_mm_cvtepi32_ps(d), _mm_set1_ps(1.0f / 65536.0f));
+	}
+	
+	// floor(v + 0.5), as the scalar code rounds; _mm_cvtps_epi32 would round halves to even
+	static __m128i	RoundHalfUp(__m128 v)
+	{
+		v = _mm_add_ps(v, _mm_set1_ps(0.5f));
+		__m128i i = _mm_cvttps_epi32(v);
+		return _mm_add_epi32(i, _mm_castps_si128(_mm_cmplt_ps(v, _mm_cvtepi32_ps(i))));	// -1 where truncation went up
+	}
+	
+	// scale, add TPDF dither, clip, round to nearest and shift into the container
+	template <class D>
+	static u_int32_t	CopyFromFloat32TPDF(const float *src, typename D::value_type *dest, u_int32_t inNumberSamples, float scale, int shift, u_int32_t *ioSeeds)
+	{
+		__m128i seed = _mm_loadu_si128((const __m128i *)ioSeeds);
+		__m128 vscale = _mm_set1_ps(scale), vmin = _mm_set1_ps(-scale), vmax = _mm_set1_ps(scale - 1.0f);
+		__m128i vshift = _mm_cvtsi32_si128(shift);
+		for (u_int32_t count = inNumberSamples / kSamplesPerVector; count--; src += kSamplesPerVector, dest += kSamplesPerVector) {
+			__m128 v = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src), vscale), TPDF(NextRandom(seed)));
+			v = _mm_max_ps(_mm_min_ps(v, vmax), vmin);
+			__m128i overflow = _mm_castps_si128(_mm_cmpge_ps(v, _mm_set1_ps(2147483648.0f)));
+			store(D(), dest, _mm_sll_epi32(_mm_xor_si128(RoundHalfUp(v), overflow), vshift));
+		}
+		_mm_storeu_si128((__m128i *)ioSeeds, seed);
+		return inNumberSamples & ~(kSamplesPerVector - 1);
+	}
+};
+#endif
+
+#if CA_SAMPLETOOLS_AVX2
+class CAAVX2Kernels {
+public:
+	enum { kSamplesPerVector = 8 };
+
+	CA_AVX2_TARGET static __m128i	Swap16(__m128i v) { return _mm_shuffle_epi8(v, _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14)); }
+	CA_AVX2_TARGET static __m256i	Swap32(__m256i v)
+	{
+		return _mm256_shuffle_epi8(v, _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+														3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+	}
+	// pack 8 32 bit values to 16 bits, in order
+	CA_AVX2_TARGET static __m128i	Pack16(__m256i v) { return _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)); }
+
+	CA_AVX2_TARGET static __m256i	load(CASInt8, const int8_t *p) { return _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *)p)); }
+	CA_AVX2_TARGET static __m256i	load(CASInt16Native, const int16_t *p) { return _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)p)); }
+	CA_AVX2_TARGET static __m256i	load(CASInt16Swap, const int16_t *p) { return _mm256_cvtepi16_epi32(Swap16(_mm_loadu_si128((const __m128i *)p))); }
+	CA_AVX2_TARGET static __m256i	load(CASInt32Native, const int32_t *p) { return _mm256_loadu_si256((const __m256i *)p); }
+	CA_AVX2_TARGET static __m256i	load(CASInt32Swap, const u_int32_t *p) { return Swap32(_mm256_loadu_si256((const __m256i *)p)); }
+
+	CA_AVX2_TARGET static void		store(CASInt8, int8_t *p, __m256i v)
+	{
+		__m128i v16 = Pack16(v);
+		_mm_storel_epi64((__m128i *)p, _mm_packs_epi16(v16, v16));
+	}
+	CA_AVX2_TARGET static void		store(CASInt16Native, int16_t *p, __m256i v) { _mm_storeu_si128((__m128i *)p, Pack16(v)); }
+	CA_AVX2_TARGET static void		store(CASInt16Swap, int16_t *p, __m256i v) { _mm_storeu_si128((__m128i *)p, Swap16(Pack16(v))); }
+	CA_AVX2_TARGET static void		store(CASInt32Native, int32_t *p, __m256i v) { _mm256_storeu_si256((__m256i *)p, v); }
+	CA_AVX2_TARGET static void		store(CASInt32Swap, u_int32_t *p, __m256i v) { _mm256_storeu_si256((__m256i *)p, Swap32(v)); }
+
+	// Packed 24 bit samples: each group of 4 samples (12 bytes) is shuffled into the high 3 bytes
+	// of 4 lanes and shifted down to sign extend it, or shuffled back out of the low 3 bytes.
+	// The 12 bytes are copied through a register sized temporary so that we never touch memory
+	// past the last sample.
+	CA_AVX2_TARGET static __m128i	Load24(const CAPacked24 *p, __m128i inShuffle)
+	{
+		// exactly 12 bytes, in two loads; going through memory to fill a register stalls
+		int32_t last;
+		memcpy(&last, (const u_int8_t *)p + 8, sizeof(last));
+		__m128i v = _mm_insert_epi32(_mm_loadl_epi64((const __m128i *)p), last, 2);
+		return _mm_srai_epi32(_mm_shuffle_epi8(v, inShuffle), 8);
+	}
+	CA_AVX2_TARGET static __m256i	Load24(const CAPacked24 *p, bool inBigEndian)
+	{
+		__m128i shuffle = inBigEndian	? _mm_setr_epi8(-1, 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9)
+										: _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+		return _mm256_inserti128_si256(_mm256_castsi128_si256(Load24(p, shuffle)), Load24(p + 4, shuffle), 1);
+	}
+	CA_AVX2_TARGET static void		Store24(CAPacked24 *p, __m128i v, __m128i inShuffle)
+	{
+		v = _mm_shuffle_epi8(v, inShuffle);
+		memcpy(p, &v, 4 * sizeof(CAPacked24));
+	}
+	CA_AVX2_TARGET static void		Store24(CAPacked24 *p, __m256i v, bool inBigEndian)
+	{
+		__m128i shuffle = inBigEndian	? _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)
+										: _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+		Store24(p, _mm256_castsi256_si128(v), shuffle);
+		Store24(p + 4, _mm256_extracti128_si256(v, 1), shuffle);
+	}
+	CA_AVX2_TARGET static __m256i	load(CASInt24Little, const CAPacked24 *p) { return Load24(p, false); }
+	CA_AVX2_TARGET static __m256i	load(CASInt24Big, const CAPacked24 *p) { return Load24(p, true); }
+	CA_AVX2_TARGET static void		store(CASInt24Little, CAPacked24 *p, __m256i v) { Store24(p, v, false); }
+	CA_AVX2_TARGET static void		store(CASInt24Big, CAPacked24 *p, __m256i v) { Store24(p, v, true); }
+	CA_AVX2_TARGET static void		store(CASInt20In24Little, CAPacked24 *p, __m256i v) { Store24(p, _mm256_and_si256(v, _mm256_set1_epi32(~0xF)), false); }
+	CA_AVX2_TARGET static void		store(CASInt20In24Big, CAPacked24 *p, __m256i v) { Store24(p, _mm256_and_si256(v, _mm256_set1_epi32(~0xF)), true); }
+
+	CA_AVX2_TARGET static __m256i	FloatToInt(__m256 f)
+	{
+		__m256i overflow = _mm256_castps_si256(_mm256_cmp_ps(f, _mm256_set1_ps(2147483648.0f), _CMP_GE_OQ));
+		return _mm256_xor_si256(_mm256_cvttps_epi32(f), overflow);
+	}
+
+	template <class S>
+	CA_AVX2_TARGET static u_int32_t	CopyToFloat32(const typename S::value_type *src, float *dest, u_int32_t inNumberSamples, float scale)
+	{
+		__m256 vscale = _mm256_set1_ps(scale);
+		for (u_int32_t count = inNumberSamples / kSamplesPerVector; count--; src += kSamplesPerVector, dest += kSamplesPerVector)
+			_mm256_storeu_ps(dest, _mm256_mul_ps(_mm256_cvtepi32_ps(load(S(), src)), vscale));
+		return inNumberSamples & ~(kSamplesPerVector - 1);
+	}
+	
+	template <class D>
+	CA_AVX2_TARGET static u_int32_t	CopyFromFloat32(const float *src, typename D::value_type *dest, u_int32_t inNumberSamples, int shift)
+	{
+		__m256 vscale = _mm256_set1_ps(2147483648.0f);
+		__m128i vshift = _mm_cvtsi32_si128(shift);
+		for (u_int32_t count = inNumberSamples / kSamplesPerVector; count--; src += kSamplesPerVector, dest += kSamplesPerVector)
+			store(D(), dest, _mm256_sra_epi32(FloatToInt(_mm256_mul_ps(_mm256_loadu_ps(src), vscale)), vshift));
+		return inNumberSamples & ~(kSamplesPerVector - 1);
+	}
+	
+	CA_AVX2_TARGET static u_int32_t	MixFloat32(const float *src, float *dest, u_int32_t inNumberSamples)
+	{
+		for (u_int32_t count = inNumberSamples / kSamplesPerVector; count--; src += kSamplesPerVector, dest += kSamplesPerVector)
+			_mm256_storeu_ps(dest, _mm256_add_ps(_mm256_loadu_ps(dest), _mm256_loadu_ps(src)));
+		return inNumberSamples & ~(kSamplesPerVector - 1);
+	}
+	CA_AVX2_TARGET static __m256i	NextRandom(__m256i &ioSeed)
+	{
+		ioSeed = _mm256_xor_si256(ioSeed, _mm256_slli_epi32(ioSeed, 13));
+		ioSeed = _mm256_xor_si256(ioSeed, _mm256_srli_epi32(ioSeed, 17));
+		ioSeed = _mm256_xor_si256(ioSeed, _mm256_slli_epi32(ioSeed, 5));
+		return ioSeed;
+	}
+	
+	CA_AVX2_TARGET static __m256	TPDF(__m256i r)
+	{
+		__m256i d = _mm256_sub_epi32(_mm256_and_si256(r, _mm256_set1_epi32(0xFFFF)), _mm256_srli_epi32(r, 16));
+		return _mm256_mul_ps(_mm256_cvtepi32_ps(d), _mm256_set1_ps(1.0f / 65536.0f));
+	}
+	
+	CA_AVX2_TARGET static __m256i	RoundHalfUp(__m256 v)
+	{
+		return _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_add_ps(v, _mm256_set1_ps(0.5f))));
+	}
+	
+	template <class D>
+	CA_AVX2_TARGET static u_int32_t	CopyFromFloat32TPDF(const float *src, typename D::value_type *dest, u_int32_t inNumberSamples, float scale, int shift, u_int32_t *ioSeeds)
+	{
+		__m256i seed = _mm256_loadu_si256((const __m256i *)ioSeeds);
+		__m256 vscale = _mm256_set1_ps(scale), vmin = _mm256_set1_ps(-scale), vmax = _mm256_set1_ps(scale - 1.0f);
+		__m128i vshift = _mm_cvtsi32_si128(shift);
+		for (u_int32_t count = inNumberSamples / kSamplesPerVector; count--; src += kSamplesPerVector, dest += kSamplesPerVector) {
+			__m256 v = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(src), vscale), TPDF(NextRandom(seed)));
+			v = _mm256_max_ps(_mm256_min_ps(v, vmax), vmin);
+			__m256i overflow = _mm256_castps_si256(_mm256_cmp_ps(v, _mm256_set1_ps(2147483648.0f), _CMP_GE_OQ));
+			store(D(), dest, _mm256_sll_epi32(_mm256_xor_si256(RoundHalfUp(v), overflow), vshift));
+		}
+		_mm256_storeu_si256((__m256i *)ioSeeds, seed);
+		return inNumberSamples & ~(kSamplesPerVector - 1);
+	}
+};
+#endif
+
+#if CA_SAMPLETOOLS_NEON
+class CANeonKernels {
+public:
+	enum { kSamplesPerVector = 4 };
+
+	static int16x4_t	Swap16(int16x4_t v) { return vreinterpret_s16_u8(vrev16_u8(vreinterpret_u8_s16(v))); }
+	static int32x4_t	Swap32(int32x4_t v) { return vreinterpretq_s32_u8(vrev32q_u8(vreinterpretq_u8_s32(v))); }
+
+	static int32x4_t	load(CASInt8, const int8_t *p)
+	{
+		int32_t x;
+		memcpy(&x, p, sizeof(x));
+		return vmovl_s16(vget_low_s16(vmovl_s8(vreinterpret_s8_s32(vdup_n_s32(x)))));
+	}
+	static int32x4_t	load(CASInt16Native, const int16_t *p) { return vmovl_s16(vld1_s16(p)); }
+	static int32x4_t	load(CASInt16Swap, const int16_t *p) { return vmovl_s16(Swap16(vld1_s16(p))); }
+	static int32x4_t	load(CASInt32Native, const int32_t *p) { return vld1q_s32(p); }
+	static int32x4_t	load(CASInt32Swap, const u_int32_t *p) { return Swap32(vld1q_s32((const int32_t *)p)); }
+
+	static void			store(CASInt8, int8_t *p, int32x4_t v)
+	{
+		int16x4_t v16 = vmovn_s32(v);
+		int32_t x = vget_lane_s32(vreinterpret_s32_s8(vmovn_s16(vcombine_s16(v16, v16))), 0);
+		memcpy(p, &x, sizeof(x));
+	}
+	static void			store(CASInt16Native, int16_t *p, int32x4_t v) { vst1_s16(p, vmovn_s32(v)); }
+	static void			store(CASInt16Swap, int16_t *p, int32x4_t v) { vst1_s16(p, Swap16(vmovn_s32(v))); }
+	static void			store(CASInt32Native, int32_t *p, int32x4_t v) { vst1q_s32(p, v); }
+	static void			store(CASInt32Swap, u_int32_t *p, int32x4_t v) { vst1q_s32((int32_t *)p, Swap32(v)); }
+
+	// packed 24 bit samples are gathered and scattered a sample at a time
+	template <class S>
+	static int32x4_t	Load24(const CAPacked24 *p)
+	{
+		int32_t x[kSamplesPerVector] = { S::load(p), S::load(p + 1), S::load(p + 2), S::load(p + 3) };
+		return vld1q_s32(x);
+	}
+	template <class D>
+	static void			Store24(CAPacked24 *p, int32x4_t v)
+	{
+		int32_t x[kSamplesPerVector];
+		vst1q_s32(x, v);
+		for (int i = 0; i < kSamplesPerVector; ++i)
+			D::store(p + i, x[i]);
+	}
+	static int32x4_t	load(CASInt24Little, const CAPacked24 *p) { return Load24<CASInt24Little>(p); }
+	static int32x4_t	load(CASInt24Big, const CAPacked24 *p) { return Load24<CASInt24Big>(p); }
+	static void			store(CASInt24Little, CAPacked24 *p, int32x4_t v) { Store24<CASInt24Little>(p, v); }
+	static void			store(CASInt24Big, CAPacked24 *p, int32x4_t v) { Store24<CASInt24Big>(p, v); }
+	static void			store(CASInt20In24Little, CAPacked24 *p, int32x4_t v) { Store24<CASInt24Little>(p, vandq_s32(v, vdupq_n_s32(~0xF))); }
+	static void			store(CASInt20In24Big, CAPacked24 *p, int32x4_t v) { Store24<CASInt24Big>(p, vandq_s32(v, vdupq_n_s32(~0xF))); }
+
+	// vcvtq_s32_f32 truncates and saturates as CAFloatToInt does (NaN becomes 0 rather than 0x80000000)
+	static int32x4_t	FloatToInt(float32x4_t f) { return vcvtq_s32_f32(f); }
+
+	template <class S>
+	static u_int32_t	CopyToFloat32(const typename S::value_type *src, float *dest, u_int32_t inNumberSamples, float scale)
+	{
+		for (u_int32_t count = inNumberSamples / kSamplesPerVector; count--; src += kSamplesPerVector, dest += kSamplesPerVector)
+			vst1q_f32(dest, vmulq_n_f32(vcvtq_f32_s32(load(S(), src)), scale));
+		return inNumberSamples & ~(kSamplesPerVector - 1);
+	}
+	
+	template <class D>
+	static u_int32_t	CopyFromFloat32(const float *src, typename D::value_type *dest, u_int32_t inNumberSamples, int shift)
+	{
+		int32x4_t vshift = vdupq_n_s32(-shift);	// a negative left shift is an arithmetic right shift
+		for (u_int32_t count = inNumberSamples / kSamplesPerVector; count--; src += kSamplesPerVector, dest += kSamplesPerVector)
+			store(D(), dest, vshlq_s32(FloatToInt(vmulq_n_f32(vld1q_f32(src), 2147483648.0f)), vshift));
+		return inNumberSamples & ~(kSamplesPerVector - 1);
+	}
+	
+	static u_int32_t	MixFloat32(const float *src, float *dest, u_int32_t inNumberSamples)
+	{
+		for (u_int32_t count = inNumberSamples / kSamplesPerVector; count--; src += kSamplesPerVector, dest += kSamplesPerVector)
+			vst1q_f32(dest, vaddq_f32(vld1q_f32(dest), vld1q_f32(src)));
+		return inNumberSamples & ~(kSamplesPerVector - 1);
+	}
+	static uint32x4_t	NextRandom(uint32x4_t &ioSeed)
+	{
+		ioSeed = veorq_u32(ioSeed, vshlq_n_u32(ioSeed, 13));
+		ioSeed = veorq_u32(ioSeed, vshrq_n_u32(ioSeed, 17));
+		ioSeed = veorq_u32(ioSeed, vshlq_n_u32(ioSeed, 5));
+		return ioSeed;
+	}
+	
+	static float32x4_t	TPDF(uint32x4_t r)
+	{
+		int32x4_t d = vsubq_s32(vreinterpretq_s32_u32(vandq_u32(r, vdupq_n_u32(0xFFFF))), vreinterpretq_s32_u32(vshrq_n_u32(r, 16)));
+		return vmulq_n_f32(vcvtq_f32_s32(d), 1.0f / 65536.0f);
+	}
+	
+	template <class D>
+	static u_int32_t	CopyFromFloat32TPDF(const float *src, typename D::value_type *dest, u_int32_t inNumberSamples, float scale, int shift, u_int32_t *ioSeeds)
+	{
+		uint32x4_t seed = vld1q_u32(ioSeeds);
+		float32x4_t vmin = vdupq_n_f32(-scale), vmax = vdupq_n_f32(scale - 1.0f), vhalf = vdupq_n_f32(0.5f);
+		int32x4_t vshift = vdupq_n_s32(shift);
+		for (u_int32_t count = inNumberSamples / kSamplesPerVector; count--; src += kSamplesPerVector, dest += kSamplesPerVector) {
+			float32x4_t v = vaddq_f32(vmulq_n_f32(vld1q_f32(src), scale), TPDF(NextRandom(seed)));
+			v = vaddq_f32(vmaxq_f32(vminq_f32(v, vmax), vmin), vhalf);
+			// floor(v + 0.5), as the scalar code rounds: vcvtq_s32_f32 truncates (and saturates),
+			// so take 1 off where that went up
+			int32x4_t i = vcvtq_s32_f32(v);
+			i = vaddq_s32(i, vreinterpretq_s32_u32(vcltq_f32(v, vcvtq_f32_s32(i))));
+			store(D(), dest, vshlq_s32(i, vshift));
+		}
+		vst1q_u32(ioSeeds, seed);
+		return inNumberSamples & ~(kSamplesPerVector - 1);
+	}
+};
+#endif
+
+// ____________________________________________________________________________
+//
+//	Vector kernel dispatch, using the vector unit found at runtime.
+//	Each returns the number of samples converted, which is 0 if there is no vector unit.
+template <class S>
+inline u_int32_t CAVectorCopyToFloat32(const typename S::value_type *src, float *dest, u_int32_t inNumberSamples, float scale)
+{
+#if CA_SAMPLETOOLS_AVX2
+	if (CAVectorUnit::HasAVX2())
+		return CAAVX2Kernels::CopyToFloat32<S>(src, dest, inNumberSamples, scale);
+#endif
+#if CA_SAMPLETOOLS_SSE2
+	if (CAVectorUnit::HasSSE2())
+		return CASSE2Kernels::CopyToFloat32<S>(src, dest, inNumberSamples, scale);
+#endif
+#if CA_SAMPLETOOLS_NEON
+	if (CAVectorUnit::HasNeon())
+		return CANeonKernels::CopyToFloat32<S>(src, dest, inNumberSamples, scale);
+#endif
+	return 0;
+}
+
+template <class D>
+inline u_int32_t CAVectorCopyFromFloat32(const float *src, typename D::value_type *dest, u_int32_t inNumberSamples, int shift)
+{
+#if CA_SAMPLETOOLS_AVX2
+	if (CAVectorUnit::HasAVX2())
+		return CAAVX2Kernels::CopyFromFloat32<D>(src, dest, inNumberSamples, shift);
+#endif
+#if CA_SAMPLETOOLS_SSE2
+	if (CAVectorUnit::HasSSE2())
+		return CASSE2Kernels::CopyFromFloat32<D>(src, dest, inNumberSamples, shift);
+#endif
+#if CA_SAMPLETOOLS_NEON
+	if (CAVectorUnit::HasNeon())
+		return CANeonKernels::CopyFromFloat32<D>(src, dest, inNumberSamples, shift);
+#endif
+	return 0;
+}
+
+template <class D>
+inline u_int32_t CAVectorCopyFromFloat32TPDF(const float *src, typename D::value_type *dest, u_int32_t inNumberSamples, float scale, int shift, u_int32_t *ioSeeds)
+{
+#if CA_SAMPLETOOLS_AVX2
+	if (CAVectorUnit::HasAVX2())
+		return CAAVX2Kernels::CopyFromFloat32TPDF<D>(src, dest, inNumberSamples, scale, shift, ioSeeds);
+#endif
+#if CA_SAMPLETOOLS_SSE2
+	if (CAVectorUnit::HasSSE2())
+		return CASSE2Kernels::CopyFromFloat32TPDF<D>(src, dest, inNumberSamples, scale, shift, ioSeeds);
+#endif
+#if CA_SAMPLETOOLS_NEON
+	if (CAVectorUnit::HasNeon())
+		return CANeonKernels::CopyFromFloat32TPDF<D>(src, dest, inNumberSamples, scale, shift, ioSeeds);
+#endif
+	return 0;
+}
+
+inline u_int32_t CAVectorMixFloat32(const float *src, float *dest, u_int32_t inNumberSamples)
+{
+#if CA_SAMPLETOOLS_AVX2
+	if (CAVectorUnit::HasAVX2())
+		return CAAVX2Kernels::MixFloat32(src, dest, inNumberSamples);
+#endif
+#if CA_SAMPLETOOLS_SSE2
+	if (CAVectorUnit::HasSSE2())
+		return CASSE2Kernels::MixFloat32(src, dest, inNumberSamples);
+#endif
+#if CA_SAMPLETOOLS_NEON
+	if (CAVectorUnit::HasNeon())
+		return CANeonKernels::MixFloat32(src, dest, inNumberSamples);
+#endif
+	return 0;
+}
+
 //=============================================================================
 //	CASampleTools
 //=============================================================================
@@ -267,6 +817,11 @@ const float	CASampleTools::sMinSInt16Float32Sample = static_cast<float>(sMinSInt
 
 void	CASampleTools::CopySInt8ToFloat32Samples(const int8_t* inSource, float* outDestination, u_int32_t inNumberSamples)
 {
+	u_int32_t vectorSamples = CAVectorCopyToFloat32<CASInt8>((const CASInt8::value_type *)inSource, outDestination, inNumberSamples, 1.0f / 128.0f);
+	inSource += vectorSamples;
+	outDestination += vectorSamples;
+	inNumberSamples -= vectorSamples;
+	
 	const CASInt8::value_type *src = (const CASInt8::value_type *)inSource - 1;
 	CAFloat32::value_type *dest = (CAFloat32::value_type *)outDestination - 1;
 	CAFastInt16ToFloat32 i2f(1.0 / float(1UL << (8 - 1)), 8);
@@ -298,6 +853,11 @@ void	CASampleTools::CopySInt8ToFloat32Samples(const int8_t* inSource, float* out
 
 void	CASampleTools::CopyLESInt16ToFloat32Samples(const int16_t* inSource, float* outDestination, u_int32_t inNumberSamples)
 {
+	u_int32_t vectorSamples = CAVectorCopyToFloat32<CASInt16Little>((const CASInt16Little::value_type *)inSource, outDestination, inNumberSamples, 1.0f / 32768.0f);
+	inSource += vectorSamples;
+	outDestination += vectorSamples;
+	inNumberSamples -= vectorSamples;
+	
 	const CASInt16Little::value_type *src = (const CASInt16Little::value_type *)inSource - 1;
 	CAFloat32::value_type *dest = (CAFloat32::value_type *)outDestination - 1;
 	CAFastInt16ToFloat32 i2f(1.0 / float(1UL << (16 - 1)), 16);
@@ -329,6 +889,11 @@ void	CASampleTools::CopyLESInt16ToFloat32Samples(const int16_t* inSource, float*
 
 void	CASampleTools::CopyBESInt16ToFloat32Samples(const int16_t* inSource, float* outDestination, u_int32_t inNumberSamples)
 {
+	u_int32_t vectorSamples = CAVectorCopyToFloat32<CASInt16Big>((const CASInt16Big::value_type *)inSource, outDestination, inNumberSamples, 1.0f / 32768.0f);
+	inSource += vectorSamples;
+	outDestination += vectorSamples;
+	inNumberSamples -= vectorSamples;
+	
 	const CASInt16Big::value_type *src = (const CASInt16Big::value_type *)inSource - 1;
 	CAFloat32::value_type *dest = (CAFloat32::value_type *)outDestination - 1;
 	CAFastInt16ToFloat32 i2f(1.0 / float(1UL << (16 - 1)), 16);
@@ -360,6 +925,11 @@ void	CASampleTools::CopyBESInt16ToFloat32Samples(const int16_t* inSource, float*
 
 void	CASampleTools::CopyLESInt32ToFloat32Samples(const int32_t* inSource, float* outDestination, u_int32_t inNumberSamples)
 {
+	u_int32_t vectorSamples = CAVectorCopyToFloat32<CASInt32Little>((const CASInt32Little::value_type *)inSource, outDestination, inNumberSamples, 1.0f / 2147483648.0f);
+	inSource += vectorSamples;
+	outDestination += vectorSamples;
+	inNumberSamples -= vectorSamples;
+	
 	const CASInt32Little::value_type *src = (const CASInt32Little::value_type *)inSource - 1;
 	CAFloat32::value_type *dest = (CAFloat32::value_type *)outDestination - 1;
 	CAFastInt32ToFloat64 i2f(1.0 / float(1UL << (32 - 1)), 32);
@@ -391,6 +961,11 @@ void	CASampleTools::CopyLESInt32ToFloat32Samples(const int32_t* inSource, float*
 
 void	CASampleTools::CopyBESInt32ToFloat32Samples(const int32_t* inSource, float* outDestination, u_int32_t inNumberSamples)
 {
+	u_int32_t vectorSamples = CAVectorCopyToFloat32<CASInt32Big>((const CASInt32Big::value_type *)inSource, outDestination, inNumberSamples, 1.0f / 2147483648.0f);
+	inSource += vectorSamples;
+	outDestination += vectorSamples;
+	inNumberSamples -= vectorSamples;
+	
 	const CASInt32Big::value_type *src = (const CASInt32Big::value_type *)inSource - 1;
 	CAFloat32::value_type *dest = (CAFloat32::value_type *)outDestination - 1;
 	CAFastInt32ToFloat64 i2f(1.0 / float(1UL << (32 - 1)), 32);
@@ -422,6 +997,11 @@ void	CASampleTools::CopyBESInt32ToFloat32Samples(const int32_t* inSource, float*
 
 void	CASampleTools::CopyFloat32ToSInt8Samples(const float* inSource, int8_t* outDestination, u_int32_t inNumberSamples)
 {
+	u_int32_t vectorSamples = CAVectorCopyFromFloat32<CASInt8>(inSource, (CASInt8::value_type *)outDestination, inNumberSamples, 24);
+	inSource += vectorSamples;
+	outDestination += vectorSamples;
+	inNumberSamples -= vectorSamples;
+	
 	const CAFloat32::value_type *src = (const CAFloat32::value_type *)inSource - 1;
 	CASInt8::value_type *dest = (CASInt8::value_type *)outDestination - 1;
 	float maxInt32 = 2147483648.0;	// 1 << 31
@@ -453,6 +1033,11 @@ void	CASampleTools::CopyFloat32ToSInt8Samples(const float* inSource, int8_t* out
 
 void	CASampleTools::CopyFloat32ToLESInt16Samples(const float* inSource, int16_t* outDestination, u_int32_t inNumberSamples)
 {
+	u_int32_t vectorSamples = CAVectorCopyFromFloat32<CASInt16Little>(inSource, (CASInt16Little::value_type *)outDestination, inNumberSamples, 16);
+	inSource += vectorSamples;
+	outDestination += vectorSamples;
+	inNumberSamples -= vectorSamples;
+	
 	const CAFloat32::value_type *src = (const CAFloat32::value_type *)inSource - 1;
 	CASInt16Little::value_type *dest = (CASInt16Little::value_type *)outDestination - 1;
 	float maxInt32 = 2147483648.0;	// 1 << 31
@@ -484,6 +1069,11 @@ void	CASampleTools::CopyFloat32ToLESInt16Samples(const float* inSource, int16_t*
 
 void	CASampleTools::CopyFloat32ToBESInt16Samples(const float* inSource, int16_t* outDestination, u_int32_t inNumberSamples)
 {
+	u_int32_t vectorSamples = CAVectorCopyFromFloat32<CASInt16Big>(inSource, (CASInt16Big::value_type *)outDestination, inNumberSamples, 16);
+	inSource += vectorSamples;
+	outDestination += vectorSamples;
+	inNumberSamples -= vectorSamples;
+	
 	const CAFloat32::value_type *src = (const CAFloat32::value_type *)inSource - 1;
 	CASInt16Big::value_type *dest = (CASInt16Big::value_type *)outDestination - 1;
 	float maxInt32 = 2147483648.0;	// 1 << 31
@@ -515,6 +1105,11 @@ void	CASampleTools::CopyFloat32ToBESInt16Samples(const float* inSource, int16_t*
 
 void	CASampleTools::CopyFloat32ToLESInt32Samples(const float* inSource, int32_t* outDestination, u_int32_t inNumberSamples)
 {
+	u_int32_t vectorSamples = CAVectorCopyFromFloat32<CASInt32Little>(inSource, (CASInt32Little::value_type *)outDestination, inNumberSamples, 0);
+	inSource += vectorSamples;
+	outDestination += vectorSamples;
+	inNumberSamples -= vectorSamples;
+	
 	const CAFloat32::value_type *src = (const CAFloat32::value_type *)inSource - 1;
 	CASInt32Little::value_type *dest = (CASInt32Little::value_type *)outDestination - 1;
 	float maxInt32 = 2147483648.0;	// 1 << 31
@@ -546,6 +1141,11 @@ void	CASampleTools::CopyFloat32ToLESInt32Samples(const float* inSource, int32_t*
 
 void	CASampleTools::CopyFloat32ToBESInt32Samples(const float* inSource, int32_t* outDestination, u_int32_t inNumberSamples)
 {
+	u_int32_t vectorSamples = CAVectorCopyFromFloat32<CASInt32Big>(inSource, (CASInt32Big::value_type *)outDestination, inNumberSamples, 0);
+	inSource += vectorSamples;
+	outDestination += vectorSamples;
+	inNumberSamples -= vectorSamples;
+	
 	const CAFloat32::value_type *src = (const CAFloat32::value_type *)inSource - 1;
 	CASInt32Big::value_type *dest = (CASInt32Big::value_type *)outDestination - 1;
 	float maxInt32 = 2147483648.0;	// 1 << 31
@@ -577,6 +1177,11 @@ void	CASampleTools::CopyFloat32ToBESInt32Samples(const float* inSource, int32_t*
 
 void	CASampleTools::MixFloat32Samples(const float* inSource, float* outDestination, u_int32_t inNumberSamples)
 {
+	u_int32_t vectorSamples = CAVectorMixFloat32(inSource, outDestination, inNumberSamples);
+	inSource += vectorSamples;
+	outDestination += vectorSamples;
+	inNumberSamples -= vectorSamples;
+	
 	const CAFloat32::value_type *src = (const CAFloat32::value_type *)inSource - 1;
 	CAFloat32::value_type *dest = (CAFloat32::value_type *)outDestination - 1;
 	int count;
@@ -587,10 +1192,10 @@ void	CASampleTools::MixFloat32Samples(const float* inSource, float* outDestinati
 		CAFloat32::value_type f2a = CAFloat32::load(++src);
 		CAFloat32::value_type f3a = CAFloat32::load(++src);
 		CAFloat32::value_type f4a = CAFloat32::load(++src);
-		CAFloat32::value_type f1b = CAFloat32::load(dest + 0);
-		CAFloat32::value_type f2b = CAFloat32::load(dest + 1);
-		CAFloat32::value_type f3b = CAFloat32::load(dest + 2);
-		CAFloat32::value_type f4b = CAFloat32::load(dest + 3);
+		CAFloat32::value_type f1b = CAFloat32::load(dest + 1);
+		CAFloat32::value_type f2b = CAFloat32::load(dest + 2);
+		CAFloat32::value_type f3b = CAFloat32::load(dest + 3);
+		CAFloat32::value_type f4b = CAFloat32::load(dest + 4);
 		CAFloat32::store(++dest, f1a + f1b);
 		CAFloat32::store(++dest, f2a + f2b);
 		CAFloat32::store(++dest, f3a + f3b);
@@ -600,7 +1205,550 @@ void	CASampleTools::MixFloat32Samples(const float* inSource, float* outDestinati
 	count = inNumberSamples & 3;
 	while (count--) {
 		CAFloat32::value_type f1a = CAFloat32::load(++src);
-		CAFloat32::value_type f1b = CAFloat32::load(dest);
+		CAFloat32::value_type f1b = CAFloat32::load(dest + 1);
 		CAFloat32::store(++dest, f1a + f1b);
 	}
 }
+
+// ____________________________________________________________________________
+//
+//	Packed 24 bit conversions
+
+template <class S>
+inline void	CACopyToFloat32(const typename S::value_type *src, float *dest, u_int32_t inNumberSamples, float scale)
+{
+	u_int32_t vectorSamples = CAVectorCopyToFloat32<S>(src, dest, inNumberSamples, scale);
+	src += vectorSamples;
+	dest += vectorSamples;
+	inNumberSamples -= vectorSamples;
+	
+	while (inNumberSamples--)
+		*dest++ = float(S::load(src++)) * scale;
+}
+
+template <class D>
+inline void	CACopyFromFloat32(const float *src, typename D::value_type *dest, u_int32_t inNumberSamples, int shift)
+{
+	u_int32_t vectorSamples = CAVectorCopyFromFloat32<D>(src, dest, inNumberSamples, shift);
+	src += vectorSamples;
+	dest += vectorSamples;
+	inNumberSamples -= vectorSamples;
+	
+	float maxInt32 = 2147483648.0;	// 1 << 31
+	while (inNumberSamples--)
+		D::store(dest++, CAFloatToInt(*src++ * maxInt32) >> shift);
+}
+
+void	CASampleTools::CopyLESInt24ToFloat32Samples(const u_int8_t* inSource, float* outDestination, u_int32_t inNumberSamples)
+{
+	CACopyToFloat32<CASInt24Little>((const CAPacked24 *)inSource, outDestination, inNumberSamples, 1.0f / 8388608.0f);
+}
+
+void	CASampleTools::CopyBESInt24ToFloat32Samples(const u_int8_t* inSource, float* outDestination, u_int32_t inNumberSamples)
+{
+	CACopyToFloat32<CASInt24Big>((const CAPacked24 *)inSource, outDestination, inNumberSamples, 1.0f / 8388608.0f);
+}
+
+void	CASampleTools::CopyFloat32ToLESInt24Samples(const float* inSource, u_int8_t* outDestination, u_int32_t inNumberSamples)
+{
+	CACopyFromFloat32<CASInt24Little>(inSource, (CAPacked24 *)outDestination, inNumberSamples, 32 - 24);
+}
+
+void	CASampleTools::CopyFloat32ToBESInt24Samples(const float* inSource, u_int8_t* outDestination, u_int32_t inNumberSamples)
+{
+	CACopyFromFloat32<CASInt24Big>(inSource, (CAPacked24 *)outDestination, inNumberSamples, 32 - 24);
+}
+
+void	CASampleTools::CopyFloat32ToLESInt20In24Samples(const float* inSource, u_int8_t* outDestination, u_int32_t inNumberSamples)
+{
+	CACopyFromFloat32<CASInt20In24Little>(inSource, (CAPacked24 *)outDestination, inNumberSamples, 32 - 24);
+}
+
+void	CASampleTools::CopyFloat32ToBESInt20In24Samples(const float* inSource, u_int8_t* outDestination, u_int32_t inNumberSamples)
+{
+	CACopyFromFloat32<CASInt20In24Big>(inSource, (CAPacked24 *)outDestination, inNumberSamples, 32 - 24);
+}
+
+// ____________________________________________________________________________
+//
+//	Format dispatch
+
+enum {
+	kCASampleFormat_Unsupported,
+	kCASampleFormat_Float32,
+	kCASampleFormat_SInt8,
+	kCASampleFormat_LESInt16,
+	kCASampleFormat_BESInt16,
+	kCASampleFormat_LESInt24,
+	kCASampleFormat_BESInt24,
+	kCASampleFormat_LESInt20In24,
+	kCASampleFormat_BESInt20In24,
+	kCASampleFormat_LESInt32,
+	kCASampleFormat_BESInt32
+};
+
+static int	CASampleFormatOf(const CAStreamBasicDescription& inFormat)
+{
+	if (!inFormat.IsPCM() || (inFormat.mFormatFlags & kLinearPCMFormatFlagsSampleFractionMask))
+		return kCASampleFormat_Unsupported;
+	
+	UInt32 wordSize = inFormat.SampleWordSize();
+	UInt32 bits = inFormat.mBitsPerChannel;
+	bool bigEndian = (inFormat.mFormatFlags & kAudioFormatFlagIsBigEndian) != 0;
+	
+	if (inFormat.mFormatFlags & kAudioFormatFlagIsFloat) {
+		bool nativeEndian = bigEndian == ((kAudioFormatFlagsNativeEndian & kAudioFormatFlagIsBigEndian) != 0);
+		return (wordSize == 4 && bits == 32 && nativeEndian) ? kCASampleFormat_Float32 : kCASampleFormat_Unsupported;
+	}
+	if (!(inFormat.mFormatFlags & kAudioFormatFlagIsSignedInteger))
+		return kCASampleFormat_Unsupported;
+	
+	switch (wordSize) {
+	case 1:
+		if (bits == 8)
+			return kCASampleFormat_SInt8;
+		break;
+	case 2:
+		if (bits == 16)
+			return bigEndian ? kCASampleFormat_BESInt16 : kCASampleFormat_LESInt16;
+		break;
+	case 3:
+		if (bits == 24)
+			return bigEndian ? kCASampleFormat_BESInt24 : kCASampleFormat_LESInt24;
+		if (bits == 20 && (inFormat.mFormatFlags & kAudioFormatFlagIsAlignedHigh))
+			return bigEndian ? kCASampleFormat_BESInt20In24 : kCASampleFormat_LESInt20In24;
+		break;
+	case 4:
+		if (bits == 32)
+			return bigEndian ? kCASampleFormat_BESInt32 : kCASampleFormat_LESInt32;
+		break;
+	}
+	return kCASampleFormat_Unsupported;
+}
+
+bool	CASampleTools::ConvertSamples(const CAStreamBasicDescription& inSourceFormat, const void* inSource, const CAStreamBasicDescription& inDestinationFormat, void* outDestination, u_int32_t inNumberSamples)
+{
+	int sourceFormat = CASampleFormatOf(inSourceFormat);
+	int destinationFormat = CASampleFormatOf(inDestinationFormat);
+	
+	if (sourceFormat == kCASampleFormat_Float32) {
+		const float* source = static_cast<const float*>(inSource);
+		switch (destinationFormat) {
+		case kCASampleFormat_Float32:
+			memcpy(outDestination, inSource, inNumberSamples * sizeof(float));
+			return true;
+		case kCASampleFormat_SInt8:
+			CopyFloat32ToSInt8Samples(source, static_cast<int8_t*>(outDestination), inNumberSamples);
+			return true;
+		case kCASampleFormat_LESInt16:
+			CopyFloat32ToLESInt16Samples(source, static_cast<int16_t*>(outDestination), inNumberSamples);
+			return true;
+		case kCASampleFormat_BESInt16:
+			CopyFloat32ToBESInt16Samples(source, static_cast<int16_t*>(outDestination), inNumberSamples);
+			return true;
+		case kCASampleFormat_LESInt24:
+			CopyFloat32ToLESInt24Samples(source, static_cast<u_int8_t*>(outDestination), inNumberSamples);
+			return true;
+		case kCASampleFormat_BESInt24:
+			CopyFloat32ToBESInt24Samples(source, static_cast<u_int8_t*>(outDestination), inNumberSamples);
+			return true;
+		case kCASampleFormat_LESInt20In24:
+			CopyFloat32ToLESInt20In24Samples(source, static_cast<u_int8_t*>(outDestination), inNumberSamples);
+			return true;
+		case kCASampleFormat_BESInt20In24:
+			CopyFloat32ToBESInt20In24Samples(source, static_cast<u_int8_t*>(outDestination), inNumberSamples);
+			return true;
+		case kCASampleFormat_LESInt32:
+			CopyFloat32ToLESInt32Samples(source, static_cast<int32_t*>(outDestination), inNumberSamples);
+			return true;
+		case kCASampleFormat_BESInt32:
+			CopyFloat32ToBESInt32Samples(source, static_cast<int32_t*>(outDestination), inNumberSamples);
+			return true;
+		}
+	} else if (destinationFormat == kCASampleFormat_Float32) {
+		float* destination = static_cast<float*>(outDestination);
+		switch (sourceFormat) {
+		case kCASampleFormat_SInt8:
+			CopySInt8ToFloat32Samples(static_cast<const int8_t*>(inSource), destination, inNumberSamples);
+			return true;
+		case kCASampleFormat_LESInt16:
+			CopyLESInt16ToFloat32Samples(static_cast<const int16_t*>(inSource), destination, inNumberSamples);
+			return true;
+		case kCASampleFormat_BESInt16:
+			CopyBESInt16ToFloat32Samples(static_cast<const int16_t*>(inSource), destination, inNumberSamples);
+			return true;
+		case kCASampleFormat_LESInt24:
+		case kCASampleFormat_LESInt20In24:
+			CopyLESInt24ToFloat32Samples(static_cast<const u_int8_t*>(inSource), destination, inNumberSamples);
+			return true;
+		case kCASampleFormat_BESInt24:
+		case kCASampleFormat_BESInt20In24:
+			CopyBESInt24ToFloat32Samples(static_cast<const u_int8_t*>(inSource), destination, inNumberSamples);
+			return true;
+		case kCASampleFormat_LESInt32:
+			CopyLESInt32ToFloat32Samples(static_cast<const int32_t*>(inSource), destination, inNumberSamples);
+			return true;
+		case kCASampleFormat_BESInt32:
+			CopyBESInt32ToFloat32Samples(static_cast<const int32_t*>(inSource), destination, inNumberSamples);
+			return true;
+		}
+	}
+	return false;
+}
+
+//=============================================================================
+//	CASampleTools::DitherState
+//=============================================================================
+
+CASampleTools::DitherState::DitherState(u_int32_t inNumberChannels, int inType, u_int32_t inSeed)
+:
+	mNumberChannels(inNumberChannels > 0 ? inNumberChannels : 1),
+	mType(inType),
+	mNextChannel(0),
+	mError(new double[2 * mNumberChannels])
+{
+	//	each stream owns its generator, so no locking is needed; seed it from the state's
+	//	address if the caller doesn't care, so that streams don't share a noise sequence
+	if (inSeed == 0)
+		inSeed = (u_int32_t)(size_t)this;
+	for (int i = 0; i < kNumberSeeds; ++i) {
+		inSeed = inSeed * 1664525UL + 1013904223UL;
+		mSeeds[i] = (inSeed != 0) ? inSeed : 0x9E3779B9UL;	// xorshift must not be seeded with 0
+	}
+	Reset();
+}
+
+CASampleTools::DitherState::~DitherState()
+{
+	delete[] mError;
+}
+
+void	CASampleTools::DitherState::Reset()
+{
+	memset(mError, 0, 2 * mNumberChannels * sizeof(double));
+	mNextChannel = 0;
+}
+
+// ____________________________________________________________________________
+//
+//	CADitherToInt
+//
+//	Converts interleaved float samples to inValidBits of resolution with TPDF dither and,
+//	optionally, first or second order noise shaping of the total error, then shifts them up
+//	into the destination container. Every path rounds with floor(x + 0.5).
+//
+//	Plain TPDF dither has no state between samples, so it is vectorized, in single precision.
+//	That keeps 8 bits of the dither below the LSB at 16 bits, but not at 24, so deeper
+//	samples and the noise shapers, which feed each channel's error back sample by sample,
+//	are done in double precision.
+template <class D>
+void	CADitherToInt(const float *src, typename D::value_type *dest, u_int32_t inNumberSamples, CASampleTools::DitherState &ioState, int inValidBits, int inContainerBits)
+{
+	if (inValidBits < 2)
+		inValidBits = 2;
+	else if (inValidBits > inContainerBits)
+		inValidBits = inContainerBits;
+	double scale = double(1UL << (inValidBits - 2)) * 2.0;	// 1 << (inValidBits - 1) doesn't fit in 32 bits when inValidBits is 32
+	int shift = inContainerBits - inValidBits;
+	u_int32_t nchannels = ioState.mNumberChannels;
+	
+	if (ioState.mType == CASampleTools::kDither_TPDF && inValidBits <= 16) {
+		u_int32_t vectorSamples = CAVectorCopyFromFloat32TPDF<D>(src, dest, inNumberSamples, float(scale), shift, ioState.mSeeds);
+		src += vectorSamples;
+		dest += vectorSamples;
+		inNumberSamples -= vectorSamples;
+		ioState.mNextChannel = (ioState.mNextChannel + vectorSamples) % nchannels;
+	}
+	
+	double minValue = -scale, maxValue = scale - 1.0;
+	u_int32_t seed = ioState.mSeeds[0];
+	u_int32_t channel = ioState.mNextChannel;
+	while (inNumberSamples--) {
+		double *error = ioState.mError + 2 * channel;
+		double u = *src++ * scale;
+		switch (ioState.mType) {
+		case CASampleTools::kDither_NoiseShapedFirstOrder:
+			u -= error[0];							// noise transfer function 1 - z^-1
+			break;
+		case CASampleTools::kDither_NoiseShapedSecondOrder:
+			u -= 2.0 * error[0] - error[1];			// noise transfer function (1 - z^-1)^2
+			break;
+		}
+		
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		double dither = double(int32_t(seed & 0xFFFF) - int32_t(seed >> 16)) * (1.0 / 65536.0);
+		
+		double q = floor(u + dither + 0.5);
+		error[1] = error[0];
+		error[0] = q - u;			// the unclipped error, so that clipping can't make the shaper run away
+		
+		if (q < minValue)
+			q = minValue;
+		else if (q > maxValue)
+			q = maxValue;
+		D::store(dest++, int32_t(u_int32_t(int32_t(q)) << shift));
+		
+		if (++channel == nchannels)
+			channel = 0;
+	}
+	ioState.mSeeds[0] = seed;
+	ioState.mNextChannel = channel;
+}
+
+void	CASampleTools::CopyFloat32ToLESInt16SamplesDithered(const float* inSource, int16_t* outDestination, u_int32_t inNumberSamples, DitherState& ioState)
+{
+	CADitherToInt<CASInt16Little>(inSource, (CASInt16Little::value_type *)outDestination, inNumberSamples, ioState, 16, 16);
+}
+
+void	CASampleTools::CopyFloat32ToBESInt16SamplesDithered(const float* inSource, int16_t* outDestination, u_int32_t inNumberSamples, DitherState& ioState)
+{
+	CADitherToInt<CASInt16Big>(inSource, (CASInt16Big::value_type *)outDestination, inNumberSamples, ioState, 16, 16);
+}
+
+void	CASampleTools::CopyFloat32ToLESInt32SamplesDithered(const float* inSource, int32_t* outDestination, u_int32_t inNumberSamples, DitherState& ioState, u_int32_t inValidBits)
+{
+	CADitherToInt<CASInt32Little>(inSource, (CASInt32Little::value_type *)outDestination, inNumberSamples, ioState, inValidBits, 32);
+}
+
+void	CASampleTools::CopyFloat32ToBESInt32SamplesDithered(const float* inSource, int32_t* outDestination, u_int32_t inNumberSamples, DitherState& ioState, u_int32_t inValidBits)
+{
+	CADitherToInt<CASInt32Big>(inSource, (CASInt32Big::value_type *)outDestination, inNumberSamples, ioState, inValidBits, 32);
+}
+
+//=============================================================================
+//	CASampleTools::MeasureKernels
+//=============================================================================
+
+typedef void (*CASampleToolsTestProc)(const void* inSource, void* outDestination, u_int32_t inNumberSamples);
+
+struct CASampleToolsTestRoutine
+{
+	const char*				mName;
+	CASampleToolsTestProc	mProc;
+	u_int32_t				mSourceBytes;			//	per sample
+	u_int32_t				mDestinationBytes;		//	per sample
+	bool					mSourceIsFloat;
+	bool					mMixes;					//	adds into the destination
+	int						mDitherBits;			//	0 if undithered
+	bool					mDestinationIsBigEndian;
+};
+
+#define CASampleToolsTestCopy(routine, srcType, destType) \
+	static void Test##routine(const void* inSource, void* outDestination, u_int32_t inNumberSamples) \
+	{ CASampleTools::routine(static_cast<const srcType*>(inSource), static_cast<destType*>(outDestination), inNumberSamples); }
+
+CASampleToolsTestCopy(CopySInt8ToFloat32Samples, int8_t, float)
+CASampleToolsTestCopy(CopyLESInt16ToFloat32Samples, int16_t, float)
+CASampleToolsTestCopy(CopyBESInt16ToFloat32Samples, int16_t, float)
+CASampleToolsTestCopy(CopyLESInt24ToFloat32Samples, u_int8_t, float)
+CASampleToolsTestCopy(CopyBESInt24ToFloat32Samples, u_int8_t, float)
+CASampleToolsTestCopy(CopyLESInt32ToFloat32Samples, int32_t, float)
+CASampleToolsTestCopy(CopyBESInt32ToFloat32Samples, int32_t, float)
+CASampleToolsTestCopy(CopyFloat32ToSInt8Samples, float, int8_t)
+CASampleToolsTestCopy(CopyFloat32ToLESInt16Samples, float, int16_t)
+CASampleToolsTestCopy(CopyFloat32ToBESInt16Samples, float, int16_t)
+CASampleToolsTestCopy(CopyFloat32ToLESInt24Samples, float, u_int8_t)
+CASampleToolsTestCopy(CopyFloat32ToBESInt24Samples, float, u_int8_t)
+CASampleToolsTestCopy(CopyFloat32ToLESInt20In24Samples, float, u_int8_t)
+CASampleToolsTestCopy(CopyFloat32ToBESInt20In24Samples, float, u_int8_t)
+CASampleToolsTestCopy(CopyFloat32ToLESInt32Samples, float, int32_t)
+CASampleToolsTestCopy(CopyFloat32ToBESInt32Samples, float, int32_t)
+CASampleToolsTestCopy(MixFloat32Samples, float, float)
+
+//	the same seed every time, so that each run of a unit is repeatable; 16 valid bits, which
+//	is as deep as the vector dither goes
+static void TestCopyFloat32ToLESInt16SamplesDithered(const void* inSource, void* outDestination, u_int32_t inNumberSamples)
+{
+	CASampleTools::DitherState state(2, CASampleTools::kDither_TPDF, 1);
+	CASampleTools::CopyFloat32ToLESInt16SamplesDithered(static_cast<const float*>(inSource), static_cast<int16_t*>(outDestination), inNumberSamples, state);
+}
+
+static void TestCopyFloat32ToBESInt16SamplesDithered(const void* inSource, void* outDestination, u_int32_t inNumberSamples)
+{
+	CASampleTools::DitherState state(2, CASampleTools::kDither_TPDF, 1);
+	CASampleTools::CopyFloat32ToBESInt16SamplesDithered(static_cast<const float*>(inSource), static_cast<int16_t*>(outDestination), inNumberSamples, state);
+}
+
+static void TestCopyFloat32ToLESInt32SamplesDithered(const void* inSource, void* outDestination, u_int32_t inNumberSamples)
+{
+	CASampleTools::DitherState state(2, CASampleTools::kDither_TPDF, 1);
+	CASampleTools::CopyFloat32ToLESInt32SamplesDithered(static_cast<const float*>(inSource), static_cast<int32_t*>(outDestination), inNumberSamples, state, 16);
+}
+
+static void TestCopyFloat32ToBESInt32SamplesDithered(const void* inSource, void* outDestination, u_int32_t inNumberSamples)
+{
+	CASampleTools::DitherState state(2, CASampleTools::kDither_TPDF, 1);
+	CASampleTools::CopyFloat32ToBESInt32SamplesDithered(static_cast<const float*>(inSource), static_cast<int32_t*>(outDestination), inNumberSamples, state, 16);
+}
+
+static const CASampleToolsTestRoutine sTestRoutines[] =
+{
+	{ "SInt8 to Float32",			TestCopySInt8ToFloat32Samples,				1, 4, false, false, 0, false },
+	{ "LE SInt16 to Float32",		TestCopyLESInt16ToFloat32Samples,			2, 4, false, false, 0, false },
+	{ "BE SInt16 to Float32",		TestCopyBESInt16ToFloat32Samples,			2, 4, false, false, 0, false },
+	{ "LE SInt24 to Float32",		TestCopyLESInt24ToFloat32Samples,			3, 4, false, false, 0, false },
+	{ "BE SInt24 to Float32",		TestCopyBESInt24ToFloat32Samples,			3, 4, false, false, 0, false },
+	{ "LE SInt32 to Float32",		TestCopyLESInt32ToFloat32Samples,			4, 4, false, false, 0, false },
+	{ "BE SInt32 to Float32",		TestCopyBESInt32ToFloat32Samples,			4, 4, false, false, 0, false },
+	{ "Float32 to SInt8",			TestCopyFloat32ToSInt8Samples,				4, 1, true, false, 0, false },
+	{ "Float32 to LE SInt16",		TestCopyFloat32ToLESInt16Samples,			4, 2, true, false, 0, false },
+	{ "Float32 to BE SInt16",		TestCopyFloat32ToBESInt16Samples,			4, 2, true, false, 0, true },
+	{ "Float32 to LE SInt24",		TestCopyFloat32ToLESInt24Samples,			4, 3, true, false, 0, false },
+	{ "Float32 to BE SInt24",		TestCopyFloat32ToBESInt24Samples,			4, 3, true, false, 0, true },
+	{ "Float32 to LE SInt20In24",	TestCopyFloat32ToLESInt20In24Samples,		4, 3, true, false, 0, false },
+	{ "Float32 to BE SInt20In24",	TestCopyFloat32ToBESInt20In24Samples,		4, 3, true, false, 0, true },
+	{ "Float32 to LE SInt32",		TestCopyFloat32ToLESInt32Samples,			4, 4, true, false, 0, false },
+	{ "Float32 to BE SInt32",		TestCopyFloat32ToBESInt32Samples,			4, 4, true, false, 0, true },
+	{ "Float32 mix",				TestMixFloat32Samples,						4, 4, true, true, 0, false },
+	{ "Float32 to LE SInt16 TPDF",	TestCopyFloat32ToLESInt16SamplesDithered,	4, 2, true, false, 16, false },
+	{ "Float32 to BE SInt16 TPDF",	TestCopyFloat32ToBESInt16SamplesDithered,	4, 2, true, false, 16, true },
+	{ "Float32 to LE SInt32 TPDF",	TestCopyFloat32ToLESInt32SamplesDithered,	4, 4, true, false, 16, false },
+	{ "Float32 to BE SInt32 TPDF",	TestCopyFloat32ToBESInt32SamplesDithered,	4, 4, true, false, 16, true }
+};
+
+static u_int32_t CASampleToolsTestRandom(u_int32_t& ioSeed)
+{
+	ioSeed ^= ioSeed << 13;
+	ioSeed ^= ioSeed >> 17;
+	ioSeed ^= ioSeed << 5;
+	return ioSeed;
+}
+
+//	a dithered sample, with its container's low bits shifted out
+static int32_t CASampleToolsTestLoadDithered(const u_int8_t* inSample, u_int32_t inBytes, bool inBigEndian, int inDitherBits)
+{
+	u_int32_t value = 0;
+	for (u_int32_t i = 0; i < inBytes; ++i)
+		value |= u_int32_t(inSample[inBigEndian ? i : inBytes - 1 - i]) << (8 * (inBytes - 1 - i));
+	value <<= 32 - 8 * inBytes;
+	return int32_t(value) >> (32 - inDitherBits);
+}
+
+bool	CASampleTools::MeasureKernels(u_int32_t inNumberSamples, u_int32_t inNumberPasses, FILE* inReport)
+{
+	//	the units to compare with the scalar code (kVecNone), of those this build and host have
+	SInt32 units[4];
+	const char* unitNames[4];
+	int numberUnits = 0;
+	SInt32 hostUnit = CAVectorUnit::GetVectorUnitType();
+	units[numberUnits] = kVecNone;
+	unitNames[numberUnits++] = "scalar";
+#if CA_SAMPLETOOLS_SSE2
+	if (hostUnit >= kVecSSE2) {
+		units[numberUnits] = kVecSSE2;
+		unitNames[numberUnits++] = "SSE2";
+	}
+#endif
+#if CA_SAMPLETOOLS_AVX2
+	if (hostUnit >= kVecAVX2) {
+		units[numberUnits] = kVecAVX2;
+		unitNames[numberUnits++] = "AVX2";
+	}
+#endif
+#if CA_SAMPLETOOLS_NEON
+	if (hostUnit == kVecNeon) {
+		units[numberUnits] = kVecNeon;
+		unitNames[numberUnits++] = "NEON";
+	}
+#endif
+	
+	//	start one sample in and stop one short of the end, so that no buffer is aligned and the
+	//	length is never a whole number of vectors
+	if (inNumberSamples < 3)
+		inNumberSamples = 3;
+	if (inNumberPasses < 1)
+		inNumberPasses = 1;
+	u_int32_t count = inNumberSamples - 2;
+	u_int8_t* source = new u_int8_t[inNumberSamples * 4];
+	u_int8_t* mixInput = new u_int8_t[inNumberSamples * 4];
+	u_int8_t* scalarOutput = new u_int8_t[inNumberSamples * 4];
+	u_int8_t* vectorOutput = new u_int8_t[inNumberSamples * 4];
+	bool passed = true;
+	
+	for (size_t r = 0; r < sizeof(sTestRoutines) / sizeof(sTestRoutines[0]); ++r) {
+		const CASampleToolsTestRoutine& routine = sTestRoutines[r];
+		
+		//	floats span 1.25 times full scale, with the edges and zero among them; integers are
+		//	random bits
+		u_int32_t seed = 0x12345678UL + u_int32_t(r);
+		if (routine.mSourceIsFloat) {
+			float* f = reinterpret_cast<float*>(source);
+			for (u_int32_t i = 0; i < inNumberSamples; ++i)
+				f[i] = (float(int32_t(CASampleToolsTestRandom(seed))) / 2147483648.0f) * 1.25f;
+			static const float kEdges[] = { 1.0f, -1.0f, 0.0f, -0.0f, 32767.0f / 32768.0f, -32768.5f / 32768.0f, 0.5f / 32768.0f, 1.5f / 32768.0f };
+			for (u_int32_t i = 0; i < sizeof(kEdges) / sizeof(kEdges[0]) && 1 + 3 * i < inNumberSamples; ++i)
+				f[1 + 3 * i] = kEdges[i];
+			float* m = reinterpret_cast<float*>(mixInput);
+			for (u_int32_t i = 0; i < inNumberSamples; ++i)
+				m[i] = float(int32_t(CASampleToolsTestRandom(seed))) / 2147483648.0f;
+		} else {
+			for (u_int32_t i = 0; i < inNumberSamples * 4; ++i)
+				source[i] = u_int8_t(CASampleToolsTestRandom(seed) >> 24);
+		}
+		const u_int8_t* src = source + routine.mSourceBytes;
+		u_int32_t outputBytes = inNumberSamples * routine.mDestinationBytes;
+		
+		double samplesPerSecond[4];
+		u_int32_t mismatches[4];
+		for (int u = 0; u < numberUnits; ++u) {
+			gCAVectorUnitType = units[u];
+			u_int8_t* output = (u == 0) ? scalarOutput : vectorOutput;
+			u_int8_t* dest = output + routine.mDestinationBytes;
+			
+			//	the samples outside the range converted are compared too, to catch overruns
+			if (routine.mMixes)
+				memcpy(output, mixInput, outputBytes);
+			else
+				memset(output, 0xA5, outputBytes);
+			(*routine.mProc)(src, dest, count);
+			
+			mismatches[u] = 0;
+			if (u > 0 && routine.mDitherBits == 0) {
+				for (u_int32_t i = 0; i < inNumberSamples; ++i)
+					if (memcmp(scalarOutput + i * routine.mDestinationBytes, vectorOutput + i * routine.mDestinationBytes, routine.mDestinationBytes) != 0)
+						++mismatches[u];
+			} else if (routine.mDitherBits != 0) {
+				//	TPDF dither is within 1 LSB, and rounding adds half of one
+				double scale = double(1UL << (routine.mDitherBits - 1));
+				const float* f = reinterpret_cast<const float*>(src);
+				for (u_int32_t i = 0; i < count; ++i) {
+					double exact = f[i] * scale;
+					if (exact < -scale)
+						exact = -scale;
+					else if (exact > scale - 1.0)
+						exact = scale - 1.0;
+					int32_t q = CASampleToolsTestLoadDithered(dest + i * routine.mDestinationBytes, routine.mDestinationBytes, routine.mDestinationIsBigEndian, routine.mDitherBits);
+					if (fabs(q - exact) > 1.5)
+						++mismatches[u];
+				}
+			}
+			if (mismatches[u] != 0)
+				passed = false;
+			
+			//	into the vector output, which is refilled before it is checked, so that a mix
+			//	doesn't change the scalar output the other units are compared with
+			dest = vectorOutput + routine.mDestinationBytes;
+			UInt64 startTime = CAHostTimeBase::GetCurrentTimeInNanos();
+			for (u_int32_t pass = 0; pass < inNumberPasses; ++pass)
+				(*routine.mProc)(src, dest, count);
+			UInt64 elapsed = CAHostTimeBase::GetCurrentTimeInNanos() - startTime;
+			samplesPerSecond[u] = (elapsed > 0) ? double(count) * inNumberPasses * 1.0e9 / double(elapsed) : 0.0;
+		}
+		
+		if (inReport != NULL) {
+			fprintf(inReport, "%-26s", routine.mName);
+			for (int u = 0; u < numberUnits; ++u)
+				fprintf(inReport, "  %s %7.1f M/s%s", unitNames[u], samplesPerSecond[u] * 1.0e-6, (mismatches[u] != 0) ? " MISMATCH" : "");
+			fprintf(inReport, "\n");
+		}
+	}
+	
+	gCAVectorUnitType = hostUnit;
+	delete[] source;
+	delete[] mixInput;
+	delete[] scalarOutput;
+	delete[] vectorOutput;
+	return passed;
+}
@@ -70,11 +70,17 @@
 #endif
 #endif
 
+#include <stdio.h>
+
+class CAStreamBasicDescription;
+
 //=============================================================================
 //	CASampleTools
 //
 //	This class contains routines for converting between
-//	various linear PCM sample formats.
+//	various linear PCM sample formats. The copy and mix routines
+//	use the vector unit (SSE2, AVX2 or NEON) found at runtime by
+//	CAVectorUnit, and produce the same results as the scalar code.
 //=============================================================================
 
 class	CASampleTools
@@ -233,6 +239,92 @@ public:
 	//	mix two native endian 32 bit float buffers
 	static void				MixFloat32Samples(const float* inSource, float* outDestination, u_int32_t inNumberSamples);
 
+//	Packed 24 Bit Copy Routines
+public:
+	//	signed little endian packed 24 bit integer to native endian 32 bit float
+	//	(this also reads 20 bit samples aligned high in 24 bits)
+	static void				CopyLESInt24ToFloat32Samples(const u_int8_t* inSource, float* outDestination, u_int32_t inNumberSamples);
+
+	//	signed big endian packed 24 bit integer to native endian 32 bit float
+	//	(this also reads 20 bit samples aligned high in 24 bits)
+	static void				CopyBESInt24ToFloat32Samples(const u_int8_t* inSource, float* outDestination, u_int32_t inNumberSamples);
+
+	//	native endian 32 bit float to signed little endian packed 24 bit integer
+	static void				CopyFloat32ToLESInt24Samples(const float* inSource, u_int8_t* outDestination, u_int32_t inNumberSamples);
+
+	//	native endian 32 bit float to signed big endian packed 24 bit integer
+	static void				CopyFloat32ToBESInt24Samples(const float* inSource, u_int8_t* outDestination, u_int32_t inNumberSamples);
+
+	//	native endian 32 bit float to signed little endian 20 bit integer aligned high in 24 bits
+	static void				CopyFloat32ToLESInt20In24Samples(const float* inSource, u_int8_t* outDestination, u_int32_t inNumberSamples);
+
+	//	native endian 32 bit float to signed big endian 20 bit integer aligned high in 24 bits
+	static void				CopyFloat32ToBESInt20In24Samples(const float* inSource, u_int8_t* outDestination, u_int32_t inNumberSamples);
+
+//	Format Dispatch
+public:
+	//	converts inNumberSamples samples between two linear PCM formats, picking the copy routine
+	//	from the formats' flags and sizes. One of the formats must be native endian 32 bit float,
+	//	and the channel layout is not changed. Returns false if there is no routine for the pair.
+	static bool				ConvertSamples(const CAStreamBasicDescription& inSourceFormat, const void* inSource, const CAStreamBasicDescription& inDestinationFormat, void* outDestination, u_int32_t inNumberSamples);
+
+//	Dithered Copy Routines
+public:
+	enum {
+		kDither_TPDF						= 0,	//	triangular PDF dither, +/- 1 LSB
+		kDither_NoiseShapedFirstOrder		= 1,	//	TPDF dither, error shaped by 1 - z^-1
+		kDither_NoiseShapedSecondOrder		= 2		//	TPDF dither, error shaped by (1 - z^-1)^2
+	};
+	
+	//	The state carried from one buffer to the next by the dithered copy routines: the
+	//	type of dither, the random number generator and each channel's error feedback.
+	//	The samples are interleaved with inNumberChannels channels and need not be passed
+	//	in whole frames. Each stream (and so each thread) should have its own state.
+	class DitherState
+	{
+	public:
+		DitherState(u_int32_t inNumberChannels, int inType = kDither_TPDF, u_int32_t inSeed = 0);
+		~DitherState();
+		
+		void				Reset();
+		
+		enum { kNumberSeeds = 8 };	// one per lane of the widest vector unit
+		
+		u_int32_t			mNumberChannels;
+		int					mType;
+		u_int32_t			mNextChannel;
+		double*				mError;				//	the last two errors of each channel
+		u_int32_t			mSeeds[kNumberSeeds];
+		
+	private:
+		DitherState(const DitherState&);
+		DitherState& operator=(const DitherState&);
+	};
+	
+	//	native endian 32 bit float to dithered signed little endian 16 bit integer
+	static void				CopyFloat32ToLESInt16SamplesDithered(const float* inSource, int16_t* outDestination, u_int32_t inNumberSamples, DitherState& ioState);
+
+	//	native endian 32 bit float to dithered signed big endian 16 bit integer
+	static void				CopyFloat32ToBESInt16SamplesDithered(const float* inSource, int16_t* outDestination, u_int32_t inNumberSamples, DitherState& ioState);
+
+	//	native endian 32 bit float to signed little endian 32 bit integer, dithered to inValidBits
+	//	(24 for 24 bit samples aligned high in 32 bits); inValidBits is clamped to 2 through 32
+	static void				CopyFloat32ToLESInt32SamplesDithered(const float* inSource, int32_t* outDestination, u_int32_t inNumberSamples, DitherState& ioState, u_int32_t inValidBits = 24);
+
+	//	native endian 32 bit float to signed big endian 32 bit integer, dithered to inValidBits
+	static void				CopyFloat32ToBESInt32SamplesDithered(const float* inSource, int32_t* outDestination, u_int32_t inNumberSamples, DitherState& ioState, u_int32_t inValidBits = 24);
+
+//	Self Test
+public:
+	//	runs every copy, mix and TPDF dithered copy routine with no vector unit and then with
+	//	each one the host has (SSE2, AVX2 or NEON), on random samples including out of range
+	//	floats, between unaligned buffers that aren't a whole number of vectors long. Undithered
+	//	outputs must match the scalar output bit for bit; dithered ones, whose noise differs by
+	//	design, must be within 1.5 LSB of the exact value. Prints each routine's samples per
+	//	second on each unit to inReport, if not NULL, and returns false on any mismatch.
+	//	It switches the vector unit for the whole process, so nothing else may convert meanwhile.
+	static bool				MeasureKernels(u_int32_t inNumberSamples, u_int32_t inNumberPasses, FILE* inReport);
+
 };
 
 #endif
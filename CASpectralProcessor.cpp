@@ -42,10 +42,218 @@
 //#include "AudioFormulas.h"
 #include "CASpectralProcessor.h"
 #include "CABitOperations.h"
+#include "CAAtomic.h"
+#include "CAHostTimeBase.h"
 
 
-#include <vecLib/vectorOps.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
 
+#if TARGET_OS_MAC
+	#include <vecLib/vectorOps.h>
+#else
+
+#pragma mark ___Portable FFT___
+
+// A small stand-in for the parts of vDSP this class uses. The real FFT follows vDSP_fft_zrip:
+// the forward transform returns twice the DFT with the Nyquist bin packed into imagp[0], and a
+// forward/inverse round trip scales by 2N.
+
+typedef long			vDSP_Stride;
+typedef unsigned long	vDSP_Length;
+typedef int				FFTDirection;
+typedef int				FFTRadix;
+
+enum { FFT_FORWARD = 1, FFT_INVERSE = -1 };
+enum { FFT_RADIX2 = 0 };
+
+struct OpaqueFFTSetup
+{
+	vDSP_Length	mLog2MaxSize;
+	float*		mCos;		// cos(2 pi j / maxsize), j < maxsize / 2
+	float*		mSin;
+};
+
+static FFTSetup vDSP_create_fftsetup(vDSP_Length inLog2N, FFTRadix /*inRadix*/)
+{
+	FFTSetup theSetup = new OpaqueFFTSetup;
+	vDSP_Length theHalf = (1UL << inLog2N) >> 1;
+	theSetup->mLog2MaxSize = inLog2N;
+	theSetup->mCos = new float[theHalf + 1];
+	theSetup->mSin = new float[theHalf + 1];
+	double w = 2. * M_PI / (double)(1UL << inLog2N);
+	for (vDSP_Length j = 0; j <= theHalf; ++j) {
+		theSetup->mCos[j] = cos(w * (double)j);
+		theSetup->mSin[j] = sin(w * (double)j);
+	}
+	return theSetup;
+}
+
+static void vDSP_destroy_fftsetup(FFTSetup inSetup)
+{
+	if (inSetup == NULL) return;
+	delete[] inSetup->mCos;
+	delete[] inSetup->mSin;
+	delete inSetup;
+}
+
+// in place complex FFT of 2^inLog2M points, e^(inSign * i...) kernel, no scaling
+static void CAComplexFFT(FFTSetup inSetup, float* re, float* im, vDSP_Length inLog2M, float inSign)
+{
+	vDSP_Length n = 1UL << inLog2M;
+	for (vDSP_Length i = 1, j = 0; i < n; ++i) {
+		vDSP_Length bit = n >> 1;
+		for ( ; j & bit; bit >>= 1)
+			j ^= bit;
+		j |= bit;
+		if (i < j) {
+			float t = re[i]; re[i] = re[j]; re[j] = t;
+			t = im[i]; im[i] = im[j]; im[j] = t;
+		}
+	}
+	for (vDSP_Length len = 2, shift = inSetup->mLog2MaxSize - 1; len <= n; len <<= 1, --shift) {
+		vDSP_Length half = len >> 1;
+		for (vDSP_Length j = 0; j < half; ++j) {
+			float wr = inSetup->mCos[j << shift];
+			float wi = inSign * inSetup->mSin[j << shift];
+			for (vDSP_Length a = j; a < n; a += len) {
+				vDSP_Length b = a + half;
+				float tr = re[b] * wr - im[b] * wi;
+				float ti = re[b] * wi + im[b] * wr;
+				re[b] = re[a] - tr; im[b] = im[a] - ti;
+				re[a] += tr; im[a] += ti;
+			}
+		}
+	}
+}
+
+static void vDSP_fft_zrip(FFTSetup inSetup, const DSPSplitComplex* ioData, vDSP_Stride /*inStride*/, vDSP_Length inLog2N, FFTDirection inDirection)
+{
+	float* re = ioData->realp;
+	float* im = ioData->imagp;
+	vDSP_Length m = (1UL << inLog2N) >> 1;
+	vDSP_Length shift = inSetup->mLog2MaxSize - inLog2N;	// twiddle table step for N points
+	
+	if (inDirection == FFT_FORWARD) {
+		// even samples are in realp and odd samples in imagp: transform as N/2 complex points,
+		// then split into the spectrum of the real sequence
+		if (m > 1) CAComplexFFT(inSetup, re, im, inLog2N - 1, -1.f);
+		float r0 = re[0], i0 = im[0];
+		re[0] = 2.f * (r0 + i0);
+		im[0] = 2.f * (r0 - i0);
+		for (vDSP_Length k = 1; k <= (m >> 1); ++k) {
+			vDSP_Length mk = m - k;
+			float ar = re[k], ai = im[k], br = re[mk], bi = im[mk];
+			float sr = ar + br, si = ai - bi;		// Z[k] + conj(Z[m-k])
+			float dr = ar - br, di = ai + bi;		// Z[k] - conj(Z[m-k])
+			float wr = inSetup->mCos[k << shift], wi = -inSetup->mSin[k << shift];
+			// out[k] = s - i W^k d
+			float tr = wr * dr - wi * di, ti = wr * di + wi * dr;
+			re[k] = sr + ti;
+			im[k] = si - tr;
+			if (mk != k) {
+				// out[m-k] = conj(s) - i conj(W^k d)
+				re[mk] = sr - ti;
+				im[mk] = -si - tr;
+			}
+		}
+	} else {
+		float y0 = re[0], ym = im[0];
+		re[0] = y0 + ym;
+		im[0] = y0 - ym;
+		for (vDSP_Length k = 1; k <= (m >> 1); ++k) {
+			vDSP_Length mk = m - k;
+			float ar = re[k], ai = im[k], br = re[mk], bi = im[mk];
+			float sr = ar + br, si = ai - bi;		// Y[k] + conj(Y[m-k])
+			float dr = ar - br, di = ai + bi;		// Y[k] - conj(Y[m-k])
+			float wr = inSetup->mCos[k << shift], wi = inSetup->mSin[k << shift];
+			// Z[k] = s + i W^-k d
+			float tr = wr * dr - wi * di, ti = wr * di + wi * dr;
+			re[k] = sr - ti;
+			im[k] = si + tr;
+			if (mk != k) {
+				// Z[m-k] = conj(s) + i conj(W^-k d)
+				re[mk] = sr + ti;
+				im[mk] = -si + tr;
+			}
+		}
+		if (m > 1) CAComplexFFT(inSetup, re, im, inLog2N - 1, 1.f);
+	}
+}
+
+static void vDSP_fft_zripm(FFTSetup inSetup, const DSPSplitComplex* ioData, vDSP_Stride inStride, vDSP_Stride inMatrixStride, vDSP_Length inLog2N, vDSP_Length inCount, FFTDirection inDirection)
+{
+	for (vDSP_Length i = 0; i < inCount; ++i) {
+		DSPSplitComplex theSignal = { ioData->realp + i * inMatrixStride, ioData->imagp + i * inMatrixStride };
+		vDSP_fft_zrip(inSetup, &theSignal, inStride, inLog2N, inDirection);
+	}
+}
+
+static void vDSP_ctoz(const DSPComplex* inC, vDSP_Stride inCStride, const DSPSplitComplex* outZ, vDSP_Stride inZStride, vDSP_Length inCount)
+{
+	const float* c = (const float*)inC;
+	for (vDSP_Length i = 0; i < inCount; ++i) {
+		outZ->realp[i * inZStride] = c[i * inCStride];
+		outZ->imagp[i * inZStride] = c[i * inCStride + 1];
+	}
+}
+
+static void vDSP_ztoc(const DSPSplitComplex* inZ, vDSP_Stride inZStride, DSPComplex* outC, vDSP_Stride inCStride, vDSP_Length inCount)
+{
+	float* c = (float*)outC;
+	for (vDSP_Length i = 0; i < inCount; ++i) {
+		c[i * inCStride] = inZ->realp[i * inZStride];
+		c[i * inCStride + 1] = inZ->imagp[i * inZStride];
+	}
+}
+
+static void vDSP_vmul(const float* inA, vDSP_Stride inAStride, const float* inB, vDSP_Stride inBStride, float* outC, vDSP_Stride inCStride, vDSP_Length inCount)
+{
+	for (vDSP_Length i = 0; i < inCount; ++i)
+		outC[i * inCStride] = inA[i * inAStride] * inB[i * inBStride];
+}
+
+static void vDSP_vadd(const float* inA, vDSP_Stride inAStride, const float* inB, vDSP_Stride inBStride, float* outC, vDSP_Stride inCStride, vDSP_Length inCount)
+{
+	for (vDSP_Length i = 0; i < inCount; ++i)
+		outC[i * inCStride] = inA[i * inAStride] + inB[i * inBStride];
+}
+
+static void vDSP_vsmul(const float* inA, vDSP_Stride inAStride, const float* inScale, float* outC, vDSP_Stride inCStride, vDSP_Length inCount)
+{
+	float theScale = *inScale;
+	for (vDSP_Length i = 0; i < inCount; ++i)
+		outC[i * inCStride] = inA[i * inAStride] * theScale;
+}
+
+static void vDSP_zvabs(const DSPSplitComplex* inA, vDSP_Stride inAStride, float* outC, vDSP_Stride inCStride, vDSP_Length inCount)
+{
+	for (vDSP_Length i = 0; i < inCount; ++i) {
+		float re = inA->realp[i * inAStride], im = inA->imagp[i * inAStride];
+		outC[i * inCStride] = sqrtf(re * re + im * im);
+	}
+}
+
+static void vDSP_maxmgv(const float* inA, vDSP_Stride inAStride, float* outC, vDSP_Length inCount)
+{
+	float theMax = 0.f;
+	for (vDSP_Length i = 0; i < inCount; ++i)
+		if (fabsf(inA[i * inAStride]) > theMax) theMax = fabsf(inA[i * inAStride]);
+	*outC = theMax;
+}
+
+static void vDSP_minmgv(const float* inA, vDSP_Stride inAStride, float* outC, vDSP_Length inCount)
+{
+	float theMin = HUGE_VALF;
+	for (vDSP_Length i = 0; i < inCount; ++i)
+		if (fabsf(inA[i * inAStride]) < theMin) theMin = fabsf(inA[i * inAStride]);
+	*outC = theMin;
+}
+
+#endif
 
 #define OFFSETOF(class, field)((size_t)&((class*)0)->field)
 
@@ -59,7 +267,9 @@ CASpectralProcessor::CASpectralProcessor(UInt32 inFFTSize, UInt32 inHopSize, UIn
 	mInputSize(0),
 	mInputPos(0), mOutputPos(-mFFTSize & mIOMask), 
 	mInFFTPos(0), mOutFFTPos(0),
-	mSpectralFunction(0), mUserData(0)
+	mSpectralFunction(0), mUserData(0),
+	mHopCount(0), mTapCapacity(0), mTapDecimation(1), mTapContents(0), mTapHopsUntilPublish(1),
+	mTapWriteCount(0), mTapReadCount(0), mTapDropped(0)
 {
 	mWindow.alloc(mFFTSize, false);
 	SineWindow(); // set default window.
@@ -67,14 +277,18 @@ CASpectralProcessor::CASpectralProcessor(UInt32 inFFTSize, UInt32 inHopSize, UIn
 	mChannels.alloc(mNumChannels);
 	mSpectralBufferList.allocBytes(OFFSETOF(SpectralBufferList, mDSPSplitComplex[mNumChannels]), true);
 	mSpectralBufferList->mNumberSpectra = mNumChannels;
+	
+	// one block per stage for all channels; malloc's alignment is enough for vDSP
+	UInt32 half = mFFTSize >> 1;
+	mFFTBlock.alloc(mNumChannels * mFFTSize, true);
+	mSplitFFTBlock.alloc(mNumChannels * mFFTSize, true);
 	for (UInt32 i = 0; i < mNumChannels; ++i) 
 	{
 		mChannels[i].mInputBuf.alloc(mIOBufSize, true);
 		mChannels[i].mOutputBuf.alloc(mIOBufSize, true);
-		mChannels[i].mFFTBuf.alloc(mFFTSize, true);
-		mChannels[i].mSplitFFTBuf.alloc(mFFTSize, true);
-		mSpectralBufferList->mDSPSplitComplex[i].realp = mChannels[i].mSplitFFTBuf();
-		mSpectralBufferList->mDSPSplitComplex[i].imagp = mChannels[i].mSplitFFTBuf() + (mFFTSize >> 1);
+		mChannels[i].mFFTBuf = mFFTBlock() + i * mFFTSize;
+		mSpectralBufferList->mDSPSplitComplex[i].realp = mSplitFFTBlock() + i * half;
+		mSpectralBufferList->mDSPSplitComplex[i].imagp = mSplitFFTBlock() + (mNumChannels + i) * half;
 	}
 
 	mFFTSetup = vDSP_create_fftsetup (mLog2FFTSize, FFT_RADIX2);
@@ -85,7 +299,10 @@ CASpectralProcessor::~CASpectralProcessor()
 {
 	mWindow.free();
 	mChannels.free();
+	mFFTBlock.free();
+	mSplitFFTBlock.free();
 	mSpectralBufferList.free();
+	SetAnalysisTap(0);
 	vDSP_destroy_fftsetup(mFFTSetup);
 }
 
@@ -95,13 +312,15 @@ void CASpectralProcessor::Reset()
 	mOutputPos = -mFFTSize & mIOMask;
 	mInFFTPos = 0;
 	mOutFFTPos = 0;
+	mHopCount = 0;
+	mTapHopsUntilPublish = 1;
 	
 	for (UInt32 i = 0; i < mNumChannels; ++i) 
 	{
 		memset(mChannels[i].mInputBuf(), 0, mIOBufSize * sizeof(Float32));
 		memset(mChannels[i].mOutputBuf(), 0, mIOBufSize * sizeof(Float32));
-		memset(mChannels[i].mFFTBuf(), 0, mFFTSize * sizeof(Float32));
 	}
+	memset(mFFTBlock(), 0, mNumChannels * mFFTByteSize);
 }
 
 const double two_pi = 2. * M_PI;
@@ -138,6 +357,7 @@ void CASpectralProcessor::Process(UInt32 inNumFrames, AudioBufferList* inInput,
 		DoWindowing();
 		DoFwdFFT();
 		ProcessSpectrum(mFFTSize, mSpectralBufferList());
+		PublishTapFrame();
 		DoInvFFT();
 		DoWindowing();
 		OverlapAddOutput();
@@ -152,7 +372,7 @@ void CASpectralProcessor::DoWindowing()
 	Float32 *win = mWindow();
 	if (!win) return;
 	for (UInt32 i=0; i<mNumChannels; ++i) {
-		Float32 *x = mChannels[i].mFFTBuf();
+		Float32 *x = mChannels[i].mFFTBuf;
 		vDSP_vmul(x, 1, win, 1, x, 1, mFFTSize);
 	}
 	//printf("DoWindowing %g %g\n", mChannels[0].mFFTBuf()[0], mChannels[0].mFFTBuf()[200]);
@@ -231,12 +451,12 @@ void CASpectralProcessor::CopyInputToFFT()
 	if (firstPartBytes < mFFTByteSize) {
 		UInt32 secondPartBytes = mFFTByteSize - firstPartBytes;
 		for (UInt32 i=0; i<mNumChannels; ++i) {
-			memcpy(mChannels[i].mFFTBuf(), mChannels[i].mInputBuf() + mInFFTPos, firstPartBytes);
-			memcpy((UInt8*)mChannels[i].mFFTBuf() + firstPartBytes, mChannels[i].mInputBuf(), secondPartBytes);
+			memcpy(mChannels[i].mFFTBuf, mChannels[i].mInputBuf() + mInFFTPos, firstPartBytes);
+			memcpy((UInt8*)mChannels[i].mFFTBuf + firstPartBytes, mChannels[i].mInputBuf(), secondPartBytes);
 		}
 	} else {
 		for (UInt32 i=0; i<mNumChannels; ++i) {
-			memcpy(mChannels[i].mFFTBuf(), mChannels[i].mInputBuf() + mInFFTPos, mFFTByteSize);
+			memcpy(mChannels[i].mFFTBuf, mChannels[i].mInputBuf() + mInFFTPos, mFFTByteSize);
 		}
 	}
 	mInputSize -= mHopSize;
@@ -252,14 +472,14 @@ void CASpectralProcessor::OverlapAddOutput()
 		UInt32 secondPart = mFFTSize - firstPart;
 		for (UInt32 i=0; i<mNumChannels; ++i) {
 			float* out1 = mChannels[i].mOutputBuf() + mOutFFTPos;
-			vDSP_vadd(out1, 1, mChannels[i].mFFTBuf(), 1, out1, 1, firstPart);
+			vDSP_vadd(out1, 1, mChannels[i].mFFTBuf, 1, out1, 1, firstPart);
 			float* out2 = mChannels[i].mOutputBuf();
-			vDSP_vadd(out2, 1, mChannels[i].mFFTBuf() + firstPart, 1, out2, 1, secondPart);
+			vDSP_vadd(out2, 1, mChannels[i].mFFTBuf + firstPart, 1, out2, 1, secondPart);
 		}
 	} else {
 		for (UInt32 i=0; i<mNumChannels; ++i) {
 			float* out1 = mChannels[i].mOutputBuf() + mOutFFTPos;
-			vDSP_vadd(out1, 1, mChannels[i].mFFTBuf(), 1, out1, 1, mFFTSize);
+			vDSP_vadd(out1, 1, mChannels[i].mFFTBuf, 1, out1, 1, mFFTSize);
 		}
 	}
 	//printf("OverlapAddOutput %g %g\n", mChannels[0].mOutputBuf[mOutFFTPos], mChannels[0].mOutputBuf[(mOutFFTPos + 200) & mIOMask]);
@@ -270,12 +490,12 @@ void CASpectralProcessor::OverlapAddOutput()
 void CASpectralProcessor::DoFwdFFT()
 {
 	//printf("->DoFwdFFT %g %g\n", mChannels[0].mFFTBuf()[0], mChannels[0].mFFTBuf()[200]);
+	// channel i's realp and imagp sit at i * half in their halves of mSplitFFTBlock, so one
+	// ctoz over the whole frame block and one multiple-signal FFT cover every channel.
 	UInt32 half = mFFTSize >> 1;
-	for (UInt32 i=0; i<mNumChannels; ++i) 
-	{
-		vDSP_ctoz((DSPComplex*)mChannels[i].mFFTBuf(), 2, &mSpectralBufferList->mDSPSplitComplex[i], 1, half);
-		vDSP_fft_zrip(mFFTSetup, &mSpectralBufferList->mDSPSplitComplex[i], 1, mLog2FFTSize, FFT_FORWARD);
-	}
+	DSPSplitComplex theSplit = { mSplitFFTBlock(), mSplitFFTBlock() + mNumChannels * half };
+	vDSP_ctoz((DSPComplex*)mFFTBlock(), 2, &theSplit, 1, mNumChannels * half);
+	vDSP_fft_zripm(mFFTSetup, &theSplit, 1, half, mLog2FFTSize, mNumChannels, FFT_FORWARD);
 	//printf("<-DoFwdFFT %g %g\n", direction, mChannels[0].mFFTBuf()[0], mChannels[0].mFFTBuf()[200]);
 }
 
@@ -283,13 +503,11 @@ void CASpectralProcessor::DoInvFFT()
 {
 	//printf("->DoInvFFT %g %g\n", mChannels[0].mFFTBuf()[0], mChannels[0].mFFTBuf()[200]);
 	UInt32 half = mFFTSize >> 1;
-	for (UInt32 i=0; i<mNumChannels; ++i) 
-	{
-		vDSP_fft_zrip(mFFTSetup, &mSpectralBufferList->mDSPSplitComplex[i], 1, mLog2FFTSize, FFT_INVERSE);
-		vDSP_ztoc(&mSpectralBufferList->mDSPSplitComplex[i], 1, (DSPComplex*)mChannels[i].mFFTBuf(), 2, half);		
-		float scale = 0.5 / mFFTSize;
-		vDSP_vsmul(mChannels[i].mFFTBuf(), 1, &scale, mChannels[i].mFFTBuf(), 1, mFFTSize );
-	}
+	DSPSplitComplex theSplit = { mSplitFFTBlock(), mSplitFFTBlock() + mNumChannels * half };
+	vDSP_fft_zripm(mFFTSetup, &theSplit, 1, half, mLog2FFTSize, mNumChannels, FFT_INVERSE);
+	vDSP_ztoc(&theSplit, 1, (DSPComplex*)mFFTBlock(), 2, mNumChannels * half);
+	float scale = 0.5 / mFFTSize;
+	vDSP_vsmul(mFFTBlock(), 1, &scale, mFFTBlock(), 1, mNumChannels * mFFTSize);
 	//printf("<-DoInvFFT %g %g\n", direction, mChannels[0].mFFTBuf()[0], mChannels[0].mFFTBuf()[200]);
 }
 
@@ -305,6 +523,97 @@ void CASpectralProcessor::ProcessSpectrum(UInt32 inFFTSize, SpectralBufferList*
 		(mSpectralFunction)(inSpectra, mUserData);
 }
 
+#pragma mark ___Analysis Tap___
+
+void CASpectralProcessor::SetAnalysisTap(UInt32 inNumberFrames, UInt32 inDecimation, UInt32 inContents)
+{
+	mTapFrames.free();
+	mTapSpectra.free();
+	mTapStorage.free();
+	mTapCapacity = 0;
+	mTapWriteCount = 0;
+	mTapReadCount = 0;
+	mTapDropped = 0;
+	mTapDecimation = (inDecimation > 0) ? inDecimation : 1;
+	mTapHopsUntilPublish = 1;
+	mTapContents = inContents & (kTapMagnitudes | kTapSpectra);
+	if (inNumberFrames == 0 || mTapContents == 0) return;
+	inNumberFrames = NextPowerOfTwo(inNumberFrames);	// keeps slot indexing consistent when the counts wrap
+	
+	// a frame's magnitudes are channels * half floats and its spectra channels * FFT size
+	UInt32 half = mFFTSize >> 1;
+	UInt32 magFloats = (mTapContents & kTapMagnitudes) ? mNumChannels * half : 0;
+	UInt32 specFloats = (mTapContents & kTapSpectra) ? mNumChannels * mFFTSize : 0;
+	UInt32 frameFloats = magFloats + specFloats;
+	
+	mTapFrames.alloc(inNumberFrames, true);
+	mTapStorage.alloc(inNumberFrames * frameFloats, true);
+	if (specFloats) mTapSpectra.alloc(inNumberFrames * mNumChannels, true);
+	for (UInt32 f = 0; f < inNumberFrames; ++f)
+	{
+		SpectralTapFrame& frame = mTapFrames[f];
+		Float32* storage = mTapStorage() + f * frameFloats;
+		frame.mNumberChannels = mNumChannels;
+		frame.mNumberBins = half;
+		frame.mMagnitudes = magFloats ? storage : NULL;
+		frame.mSpectra = NULL;
+		if (specFloats) {
+			// same layout as mSplitFFTBlock so publishing is one memcpy
+			Float32* split = storage + magFloats;
+			frame.mSpectra = mTapSpectra() + f * mNumChannels;
+			for (UInt32 i = 0; i < mNumChannels; ++i) {
+				frame.mSpectra[i].realp = split + i * half;
+				frame.mSpectra[i].imagp = split + (mNumChannels + i) * half;
+			}
+		}
+	}
+	mTapCapacity = inNumberFrames;
+}
+
+void CASpectralProcessor::PublishTapFrame()
+{
+	++mHopCount;
+	if (mTapCapacity == 0 || --mTapHopsUntilPublish > 0) return;
+	mTapHopsUntilPublish = mTapDecimation;
+	
+	SInt32 writeCount = mTapWriteCount;
+	if ((UInt32)(writeCount - mTapReadCount) >= mTapCapacity) {
+		++mTapDropped;
+		return;
+	}
+	
+	SpectralTapFrame& frame = mTapFrames[(UInt32)writeCount & (mTapCapacity - 1)];
+	UInt32 half = mFFTSize >> 1;
+	frame.mHopIndex = mHopCount - 1;
+	if (frame.mMagnitudes) {
+		// the realp and imagp halves of every channel are contiguous, so one call covers them all
+		DSPSplitComplex theSplit = { mSplitFFTBlock(), mSplitFFTBlock() + mNumChannels * half };
+		vDSP_zvabs(&theSplit, 1, frame.mMagnitudes, 1, mNumChannels * half);
+	}
+	if (frame.mSpectra)
+		memcpy(frame.mSpectra[0].realp, mSplitFFTBlock(), mNumChannels * mFFTByteSize);
+	
+	// the frame must be complete before the reader can see it
+	CAMemoryBarrier();
+	mTapWriteCount = writeCount + 1;
+}
+
+const SpectralTapFrame* CASpectralProcessor::GetTapFrame()
+{
+	SInt32 readCount = mTapReadCount;
+	if (mTapCapacity == 0 || readCount == mTapWriteCount) return NULL;
+	CAMemoryBarrier();
+	return &mTapFrames[(UInt32)readCount & (mTapCapacity - 1)];
+}
+
+void CASpectralProcessor::ReleaseTapFrame()
+{
+	if (mTapCapacity == 0 || mTapReadCount == mTapWriteCount) return;
+	// finish reading the slot before handing it back to the writer
+	CAMemoryBarrier();
+	mTapReadCount = mTapReadCount + 1;
+}
+
 #pragma mark ___Utility___
 
 void CASpectralProcessor::GetMagnitude(AudioBufferList* list, Float32* min, Float32* max) 
@@ -347,6 +656,7 @@ bool CASpectralProcessor::ProcessForwards(UInt32 inNumFrames, AudioBufferList* i
 		DoWindowing();
 		DoFwdFFT();
 		ProcessSpectrum(mFFTSize, mSpectralBufferList()); // here you would copy the fft results out to a buffer indicated in mUserData, say for sonogram drawing
+		PublishTapFrame();
 		processed = true;
 	}
 	
@@ -367,4 +677,169 @@ bool CASpectralProcessor::ProcessBackwards(UInt32 inNumFrames, AudioBufferList*
 	return true;
 }
 
+#pragma mark ___Measurement___
+
+static AudioBufferList* AllocateBufferList(UInt32 inNumberBuffers, UInt32 inNumberFrames)
+{
+	AudioBufferList* abl = (AudioBufferList*)calloc(1, OFFSETOF(AudioBufferList, mBuffers[inNumberBuffers]));
+	abl->mNumberBuffers = inNumberBuffers;
+	for (UInt32 i = 0; i < inNumberBuffers; ++i)
+	{
+		abl->mBuffers[i].mNumberChannels = 1;
+		abl->mBuffers[i].mDataByteSize = inNumberFrames * sizeof(Float32);
+		abl->mBuffers[i].mData = calloc(inNumberFrames, sizeof(Float32));
+	}
+	return abl;
+}
+
+static void FreeBufferList(AudioBufferList* abl)
+{
+	for (UInt32 i = 0; i < abl->mNumberBuffers; ++i)
+		free(abl->mBuffers[i].mData);
+	free(abl);
+}
 
+static inline Float32 NextNoise(UInt32& ioSeed)
+{
+	ioSeed = ioSeed * 1664525 + 1013904223;
+	return (Float32)((SInt32)ioSeed) * (1.f / 2147483648.f);
+}
+
+bool CASpectralProcessor::MeasureHops(UInt32 inFFTSize, UInt32 inNumChannels, UInt32 inNumberHops, HopStatistics& outStats)
+{
+	UInt32 hop = inFFTSize >> 2;
+	CASpectralProcessor proc(inFFTSize, hop, inNumChannels, hop);
+	AudioBufferList* input = AllocateBufferList(inNumChannels, hop);
+	AudioBufferList* output = AllocateBufferList(inNumChannels, hop);
+	UInt32 seed = 1;
+	for (UInt32 i = 0; i < inNumChannels; ++i)
+	{
+		Float32* p = (Float32*)input->mBuffers[i].mData;
+		for (UInt32 j = 0; j < hop; ++j)
+			p[j] = NextNoise(seed);
+	}
+	
+	// fill the first frame so that every timed call runs exactly one hop
+	UInt32 warmup = (inFFTSize / hop) + 4;
+	for (UInt32 i = 0; i < warmup; ++i)
+		proc.Process(hop, input, output);
+	
+	UInt64 start = CAHostTimeBase::GetCurrentTimeInNanos();
+	for (UInt32 i = 0; i < inNumberHops; ++i)
+		proc.Process(hop, input, output);
+	UInt64 elapsed = CAHostTimeBase::GetCurrentTimeInNanos() - start;
+	
+	bool finite = true;
+	for (UInt32 i = 0; i < inNumChannels; ++i)
+	{
+		const Float32* p = (const Float32*)output->mBuffers[i].mData;
+		for (UInt32 j = 0; j < hop; ++j)
+			if (!(fabsf(p[j]) < 1e6f)) finite = false;
+	}
+	FreeBufferList(input);
+	FreeBufferList(output);
+	
+	outStats.mFFTSize = inFFTSize;
+	outStats.mNumChannels = inNumChannels;
+	outStats.mNumberHops = inNumberHops;
+	if (elapsed == 0) elapsed = 1;
+	outStats.mHopsPerSecond = (Float64)inNumberHops * 1e9 / (Float64)elapsed;
+	outStats.mNanosPerChannelHop = (Float64)elapsed / ((Float64)inNumberHops * inNumChannels);
+	return finite;
+}
+
+bool CASpectralProcessor::MeasureStandardHops(UInt32 inNumberHops, FILE* inReport)
+{
+	static const UInt32 kChannels[] = { 1, 2, 8, 32 };
+	static const UInt32 kFFTSizes[] = { 256, 1024, 4096 };
+	bool ok = true;
+	if (inReport)
+		fprintf(inReport, "%8s %8s %14s %16s\n", "fftsize", "channels", "hops/sec", "ns/channel hop");
+	for (UInt32 f = 0; f < sizeof(kFFTSizes) / sizeof(kFFTSizes[0]); ++f)
+	{
+		for (UInt32 c = 0; c < sizeof(kChannels) / sizeof(kChannels[0]); ++c)
+		{
+			HopStatistics stats;
+			if (!MeasureHops(kFFTSizes[f], kChannels[c], inNumberHops, stats))
+				ok = false;
+			if (inReport)
+				fprintf(inReport, "%8u %8u %14.0f %16.1f\n", (unsigned)stats.mFFTSize, (unsigned)stats.mNumChannels,
+					stats.mHopsPerSecond, stats.mNanosPerChannelHop);
+		}
+	}
+	return ok;
+}
+
+bool CASpectralProcessor::TestFFT(UInt32 inLog2MaxSize, Float32 inTolerance, FILE* inReport)
+{
+	// the reference DFT costs N per bin, so above this size only a spread of bins is checked
+	const UInt32 kMaxBinsChecked = 1024;
+	
+	UInt32 maxSize = 1UL << inLog2MaxSize;
+	FFTSetup setup = vDSP_create_fftsetup(inLog2MaxSize, FFT_RADIX2);
+	if (setup == NULL) return false;
+	Float32* input = (Float32*)malloc(maxSize * sizeof(Float32));
+	Float32* output = (Float32*)malloc(maxSize * sizeof(Float32));
+	Float32* realp = (Float32*)malloc((maxSize >> 1) * sizeof(Float32));
+	Float32* imagp = (Float32*)malloc((maxSize >> 1) * sizeof(Float32));
+	DSPSplitComplex split = { realp, imagp };
+	UInt32 seed = 1;
+	bool ok = true;
+	
+	if (inReport)
+		fprintf(inReport, "%8s %14s %14s\n", "size", "dft error", "round trip");
+	for (UInt32 log2n = 1; log2n <= inLog2MaxSize; ++log2n)
+	{
+		UInt32 n = 1UL << log2n, half = n >> 1;
+		for (UInt32 i = 0; i < n; ++i)
+			input[i] = NextNoise(seed);
+		vDSP_ctoz((const DSPComplex*)input, 2, &split, 1, half);
+		vDSP_fft_zrip(setup, &split, 1, log2n, FFT_FORWARD);
+		
+		// bin k of twice the DFT; bin 0 and the Nyquist bin are real and share realp[0]/imagp[0]
+		UInt32 step = (half > kMaxBinsChecked) ? half / kMaxBinsChecked : 1;
+		double maxError = 0., maxValue = 0.;
+		for (UInt32 k = 0; ; k = std::min(k + step, half))
+		{
+			double re = 0., im = 0., w = 2. * M_PI / (double)n;
+			for (UInt32 j = 0; j < n; ++j)
+			{
+				double phase = w * (double)((UInt64)j * k % n);
+				re += input[j] * cos(phase);
+				im -= input[j] * sin(phase);
+			}
+			re *= 2.; im *= 2.;
+			double gotRe, gotIm;
+			if (k == 0)				{ gotRe = realp[0]; gotIm = 0.; }
+			else if (k == half)		{ gotRe = imagp[0]; gotIm = 0.; }
+			else					{ gotRe = realp[k]; gotIm = imagp[k]; }
+			maxError = std::max(maxError, std::max(fabs(gotRe - re), fabs(gotIm - im)));
+			maxValue = std::max(maxValue, std::max(fabs(re), fabs(im)));
+			if (k == half) break;
+		}
+		double dftError = maxValue > 0. ? maxError / maxValue : maxError;
+		
+		vDSP_fft_zrip(setup, &split, 1, log2n, FFT_INVERSE);
+		vDSP_ztoc(&split, 1, (DSPComplex*)output, 2, half);
+		double tripError = 0., tripValue = 0.;
+		for (UInt32 i = 0; i < n; ++i)
+		{
+			tripError = std::max(tripError, fabs(output[i] / (2. * n) - input[i]));
+			tripValue = std::max(tripValue, (double)fabs(input[i]));
+		}
+		if (tripValue > 0.) tripError /= tripValue;
+		
+		if (!(dftError <= inTolerance && tripError <= inTolerance))
+			ok = false;
+		if (inReport)
+			fprintf(inReport, "%8u %14.3g %14.3g%s\n", (unsigned)n, dftError, tripError,
+				(dftError <= inTolerance && tripError <= inTolerance) ? "" : "  FAILED");
+	}
+	
+	free(input);
+	free(output);
+	free(realp);
+	free(imagp);
+	vDSP_destroy_fftsetup(setup);
+	return ok;
+}
@@ -49,9 +49,18 @@
 #include <CoreFoundation.h>
 #endif
 
-#include <Accelerate/Accelerate.h>
+#if TARGET_OS_MAC
+	#include <Accelerate/Accelerate.h>
+#else
+	// Without Accelerate, CASpectralProcessor.cpp supplies a portable radix-2 backend that
+	// uses the same split complex packing and scaling as vDSP_fft_zrip.
+	typedef struct DSPComplex { float real; float imag; } DSPComplex;
+	typedef struct DSPSplitComplex { float* realp; float* imagp; } DSPSplitComplex;
+	typedef struct OpaqueFFTSetup* FFTSetup;
+#endif
 
 #include "CAAutoDisposer.h"
+#include <stdio.h>
 
 struct SpectralBufferList
 {
@@ -59,6 +68,16 @@ struct SpectralBufferList
 	DSPSplitComplex mDSPSplitComplex[1];
 };
 
+// one published analysis frame; storage belongs to the processor's tap pool
+struct SpectralTapFrame
+{
+	UInt64 mHopIndex;					// forward hops since Reset()
+	UInt32 mNumberChannels;
+	UInt32 mNumberBins;					// FFT size / 2
+	Float32* mMagnitudes;				// channels * bins, channel i at i * bins; NULL if not tapped
+	DSPSplitComplex* mSpectra;			// one per channel, same packing as SpectralBufferList; NULL if not tapped
+};
+
 class CASpectralProcessor 
 {
 public:
@@ -86,12 +105,47 @@ public:
 	void GetFrequencies(Float32* freqs, Float32 sampleRate);				// only for processed forward
 	void GetMagnitude(AudioBufferList* inCopy, Float32* min, Float32* max); // only for processed forward
 	
+	// Analysis tap: the audio thread publishes every inDecimation'th forward spectrum into a
+	// preallocated pool of inNumberFrames frames (rounded up to a power of two), and one reader thread takes them with
+	// GetTapFrame/ReleaseTapFrame. Nothing allocates or locks after SetAnalysisTap. When the
+	// reader falls behind the newest frame is dropped and counted. SetAnalysisTap itself
+	// allocates and must not be called while Process is running; 0 frames removes the tap.
+	enum {
+		kTapMagnitudes	= (1 << 0),
+		kTapSpectra		= (1 << 1)
+	};
+	void SetAnalysisTap(UInt32 inNumberFrames, UInt32 inDecimation = 1, UInt32 inContents = kTapMagnitudes);
+	const SpectralTapFrame* GetTapFrame();		// oldest unread frame or NULL; valid until ReleaseTapFrame
+	void ReleaseTapFrame();
+	UInt32 TapFramesDropped() const { return mTapDropped; }
+	
 	virtual bool ProcessForwards(UInt32 inNumFrames, AudioBufferList* inInput);
 	bool ProcessBackwards(UInt32 inNumFrames, AudioBufferList* outOutput);
 
 
 	void PrintSpectralBufferList();
 	
+	// Measurement: Process on white noise, one hop per call, hop size FFT size / 4.
+	struct HopStatistics
+	{
+		UInt32 mFFTSize;
+		UInt32 mNumChannels;
+		UInt32 mNumberHops;
+		Float64 mHopsPerSecond;
+		Float64 mNanosPerChannelHop;
+	};
+	static bool MeasureHops(UInt32 inFFTSize, UInt32 inNumChannels, UInt32 inNumberHops, HopStatistics& outStats);
+		// false if the output isn't finite
+	static bool MeasureStandardHops(UInt32 inNumberHops, FILE* inReport);
+		// 1, 2, 8 and 32 channels at FFT sizes 256, 1024 and 4096
+	
+	// Checks the FFT backend (vDSP, or the portable one) for every size from 2 to 2^inLog2MaxSize,
+	// all on one setup made for the largest: the forward transform against a double precision
+	// DFT of the same noise, in vDSP_fft_zrip's packing and scaling, and the round trip against
+	// the input. Errors are relative to the largest value; returns false if any exceeds
+	// inTolerance, printing one line per size to inReport if not NULL.
+	static bool TestFFT(UInt32 inLog2MaxSize, Float32 inTolerance, FILE* inReport);
+	
 protected:
 	void CopyInput(UInt32 inNumFrames, AudioBufferList* inInput);
 	void CopyInputToFFT();
@@ -101,6 +155,7 @@ protected:
 	void OverlapAddOutput();
 	void CopyOutput(UInt32 inNumFrames, AudioBufferList* inOutput);
 	void ProcessSpectrum(UInt32 inFFTSize, SpectralBufferList* inSpectra);
+	void PublishTapFrame();
 	
 	UInt32 mFFTSize;
 	UInt32 mHopSize;
@@ -124,16 +179,34 @@ protected:
 	{
 		CAAutoFree<Float32> mInputBuf;		// log2ceil(FFT size + max frames)
 		CAAutoFree<Float32> mOutputBuf;		// log2ceil(FFT size + max frames)
-		CAAutoFree<Float32> mFFTBuf;		// FFT size
-		CAAutoFree<Float32> mSplitFFTBuf;	// FFT size
+		Float32* mFFTBuf;					// FFT size, points into mFFTBlock
 	};
 	CAAutoArrayDelete<SpectralChannel> mChannels;
 
+	// every channel's time domain frame and split spectrum live in one block each, so that a hop
+	// runs a single ctoz/FFT/ztoc/scale over all channels instead of one call per channel.
+	CAAutoFree<Float32> mFFTBlock;			// channels * FFT size, channel i at i * FFT size
+	CAAutoFree<Float32> mSplitFFTBlock;		// all channels' realp, then all channels' imagp
+
 	CAAutoFree<SpectralBufferList> mSpectralBufferList;
 	
 	SpectralFunction mSpectralFunction;
 	void *mUserData;
 	
+	// analysis tap: a single producer/single consumer ring of frame slots. The producer
+	// only advances mTapWriteCount and the consumer only advances mTapReadCount.
+	UInt64 mHopCount;
+	UInt32 mTapCapacity;
+	UInt32 mTapDecimation;
+	UInt32 mTapContents;
+	UInt32 mTapHopsUntilPublish;
+	volatile SInt32 mTapWriteCount;
+	volatile SInt32 mTapReadCount;
+	volatile UInt32 mTapDropped;
+	CAAutoFree<SpectralTapFrame> mTapFrames;
+	CAAutoFree<DSPSplitComplex> mTapSpectra;		// capacity * channels
+	CAAutoFree<Float32> mTapStorage;
+	
 };
 
 
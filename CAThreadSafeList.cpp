@@ -0,0 +1,161 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CAThreadSafeList.cpp
+	
+=============================================================================*/
+
+#include "CAThreadSafeList.h"
+#include "CAHostTimeBase.h"
+#include "CAAtomic.h"
+#include <pthread.h>
+#include <string.h>
+
+// ____________________________________________________________________________
+
+static Float64	NanosPerObject(UInt64 startNanos, UInt32 nObjects)
+{
+	return Float64(CAHostTimeBase::GetCurrentTimeInNanos() - startNanos) / nObjects;
+}
+
+template <class List>
+static void	MeasureUpdates(List &list, UInt32 nObjects, Float64 &outAddNanos, Float64 &outRemoveNanos)
+{
+	// all the events are posted before the update, as when many listeners come and go in
+	// one render cycle
+	for (UInt32 i = 0; i < nObjects; ++i)
+		list.deferred_add(i);
+	UInt64 start = CAHostTimeBase::GetCurrentTimeInNanos();
+	list.update();
+	outAddNanos = NanosPerObject(start, nObjects);
+	
+	for (UInt32 i = nObjects; i-- > 0; )
+		list.deferred_remove(i);
+	start = CAHostTimeBase::GetCurrentTimeInNanos();
+	list.update();
+	outRemoveNanos = NanosPerObject(start, nObjects);
+}
+
+// ____________________________________________________________________________
+
+enum { kStressSetSize = 64 };
+
+struct CAThreadSafeListStress {
+	TThreadSafeHashedList<UInt32> *	mList;
+	volatile SInt32					mDone;
+	UInt32							mNumberSnapshotsRead;
+	UInt32							mNumberTornSnapshots;
+};
+
+// Each update replaces the set with kStressSetSize consecutive objects, so a snapshot is
+// either empty (before the first update) or exactly one update's objects, in order.
+static void *	StressReaderEntry(void *param)
+{
+	CAThreadSafeListStress *stress = static_cast<CAThreadSafeListStress *>(param);
+	while (stress->mDone == 0) {
+		TThreadSafeHashedList<UInt32>::Reader reader(*stress->mList);
+		++stress->mNumberSnapshotsRead;
+		if (reader.size() == 0)
+			continue;
+		bool torn = (reader.size() != kStressSetSize);
+		UInt32 first = *reader.begin();
+		UInt32 expected = first;
+		for (const UInt32 *p = reader.begin(); p != reader.end() && !torn; ++p, ++expected)
+			torn = (*p != expected) || (first % kStressSetSize != 0);
+		if (torn)
+			++stress->mNumberTornSnapshots;
+	}
+	return NULL;
+}
+
+bool	CAMeasureThreadSafeLists(UInt32 inNumberObjects, UInt32 inNumberUpdates, CAThreadSafeListStatistics &outStatistics)
+{
+	memset(&outStatistics, 0, sizeof(outStatistics));
+	if (inNumberObjects == 0)
+		inNumberObjects = 1;
+	outStatistics.mNumberObjects = inNumberObjects;
+	volatile UInt32 sink = 0;
+	
+	{
+		TThreadSafeList<UInt32> list;
+		MeasureUpdates(list, inNumberObjects, outStatistics.mListAddNanos, outStatistics.mListRemoveNanos);
+		for (UInt32 i = 0; i < inNumberObjects; ++i)
+			list.deferred_add(i);
+		list.update();
+		UInt64 start = CAHostTimeBase::GetCurrentTimeInNanos();
+		for (TThreadSafeList<UInt32>::iterator it = list.begin(); it != list.end(); ++it)
+			sink += *it;
+		outStatistics.mListIterateNanos = NanosPerObject(start, inNumberObjects);
+	}
+	{
+		TThreadSafeHashedList<UInt32> list;
+		MeasureUpdates(list, inNumberObjects, outStatistics.mHashedListAddNanos, outStatistics.mHashedListRemoveNanos);
+		for (UInt32 i = 0; i < inNumberObjects; ++i)
+			list.deferred_add(i);
+		list.update();
+		UInt64 start = CAHostTimeBase::GetCurrentTimeInNanos();
+		{
+			TThreadSafeHashedList<UInt32>::Reader reader(list);
+			for (const UInt32 *p = reader.begin(); p != reader.end(); ++p)
+				sink += *p;
+		}
+		outStatistics.mHashedListIterateNanos = NanosPerObject(start, inNumberObjects);
+	}
+	
+	// the stress test: this thread updates, another reads
+	TThreadSafeHashedList<UInt32> list;
+	CAThreadSafeListStress stress = { &list, 0, 0, 0 };
+	pthread_t reader;
+	if (pthread_create(&reader, NULL, StressReaderEntry, &stress) != 0)
+		return false;
+	for (UInt32 u = 0; u < inNumberUpdates; ++u) {
+		UInt32 base = (u % (0xFFFFFFFFU / kStressSetSize)) * kStressSetSize;
+		list.deferred_clear();
+		for (UInt32 i = 0; i < kStressSetSize; ++i)
+			list.deferred_add(base + i);
+		list.update();
+	}
+	CAAtomicIncrement32Barrier(&stress.mDone);
+	pthread_join(reader, NULL);
+	outStatistics.mNumberSnapshotsRead = stress.mNumberSnapshotsRead;
+	outStatistics.mNumberTornSnapshots = stress.mNumberTornSnapshots;
+	return stress.mNumberTornSnapshots == 0;
+}
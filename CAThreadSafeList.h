@@ -247,4 +247,309 @@ private:
 	NodeStack	mFreeList;		// free nodes for reuse - threadsafe
 };
 
+// ____________________________________________________________________________
+
+//	Default hash for TThreadSafeHashedList: FNV-1a over the object's bytes. Good for pointers,
+//	integers and padding-free structs; supply your own for anything else.
+template <class T>
+struct TThreadSafeListHash {
+	UInt32 operator () (const T &obj) const
+	{
+		const unsigned char *p = reinterpret_cast<const unsigned char *>(&obj);
+		UInt32 h = 2166136261U;
+		for (size_t i = 0; i < sizeof(T); ++i)
+			h = (h ^ p[i]) * 16777619U;
+		return h;
+	}
+};
+
+//	Set of T's with the same deferred add/remove/clear interface as TThreadSafeList.
+//	update() applies each event in O(1) amortized, using a hash table from object to
+//	position in a dense array (removal swaps the last object into the hole, so order is not
+//	preserved). If anything changed it then publishes a copy of the array. One reader
+//	thread, typically the real-time thread, iterates the last published array through a
+//	Reader: no locks, no allocation and no pointer chasing. Published arrays are
+//	triple buffered, so update() never writes to the one being read.
+//	update() may allocate and must only be called from one thread; it may be the reader.
+//	T must define operator == and be default constructible and assignable.
+template <class T, class THash = TThreadSafeListHash<T> >
+class TThreadSafeHashedList {
+private:
+	enum EEventType { kAdd, kRemove, kClear };
+	class Node {
+	public:
+		Node *		mNext;
+		EEventType	mEventType;
+		T			mObject;
+		
+		void	set_next(Node *node) { mNext = node; }
+		Node *	get_next() { return mNext; }
+	};
+	
+	struct Snapshot {
+		T *			mItems;
+		UInt32		mCount;
+		UInt32		mCapacity;
+	};
+	enum { kNumberSnapshots = 3 };
+
+public:
+	class Reader {
+	public:
+		Reader(TThreadSafeHashedList &list) : mList(list), mSnapshot(list.BeginRead()) { }
+		~Reader() { mList.EndRead(); }
+		
+		const T *	begin() const { return mSnapshot->mItems; }
+		const T *	end() const { return mSnapshot->mItems + mSnapshot->mCount; }
+		UInt32		size() const { return mSnapshot->mCount; }
+		
+	private:
+		Reader(const Reader &);
+		Reader &operator = (const Reader &);
+		
+		TThreadSafeHashedList &	mList;
+		const Snapshot *		mSnapshot;
+	};
+	
+	TThreadSafeHashedList() :
+		mItems(NULL), mCount(0), mCapacity(0),
+		mTable(NULL), mTableMask(0),
+		mPublished(&mSnapshots[0]), mReading(NULL)
+	{
+		for (int i = 0; i < kNumberSnapshots; ++i) {
+			mSnapshots[i].mItems = NULL;
+			mSnapshots[i].mCount = 0;
+			mSnapshots[i].mCapacity = 0;
+		}
+	}
+	~TThreadSafeHashedList()
+	{
+		FreeNodes(mPendingList.pop_all());
+		Node *node;
+		while ((node = mFreeList.pop_atomic()) != NULL)
+			free(node);
+		for (int i = 0; i < kNumberSnapshots; ++i)
+			delete[] mSnapshots[i].mItems;
+		delete[] mItems;
+		delete[] mTable;
+	}
+	
+	// These may be called on any thread
+	
+	void	deferred_add(const T &obj) { PostEvent(kAdd, &obj); }
+	void	deferred_remove(const T &obj) { PostEvent(kRemove, &obj); }
+	void	deferred_clear() { PostEvent(kClear, NULL); }
+	
+	// These must be called from only one thread
+	
+	void	update()
+	{
+		Node *event = mPendingList.pop_all_reversed();
+		if (event == NULL)
+			return;
+		bool changed = false;
+		while (event != NULL) {
+			Node *next = event->mNext;
+			switch (event->mEventType) {
+			case kAdd:
+				changed |= Insert(event->mObject);
+				break;
+			case kRemove:
+				changed |= Erase(event->mObject);
+				break;
+			case kClear:
+				changed |= (mCount > 0);
+				for (UInt32 i = 0; i <= mTableMask && mTable != NULL; ++i)
+					mTable[i] = 0;
+				mCount = 0;
+				break;
+			}
+			mFreeList.push_atomic(event);
+			event = next;
+		}
+		if (changed)
+			Publish();
+	}
+	
+	bool	contains(const T &obj) const { return Find(obj) != kNotFound; }
+	UInt32	size() const { return mCount; }
+	
+private:
+	enum { kNotFound = 0xFFFFFFFF };
+	
+	void	PostEvent(EEventType type, const T *obj)
+	{
+		Node *node = mFreeList.pop_atomic();
+		if (node == NULL)
+			node = (Node *)CA_malloc(sizeof(Node));
+		node->mEventType = type;
+		if (obj != NULL)
+			node->mObject = *obj;
+		mPendingList.push_atomic(node);
+	}
+	
+	void	FreeNodes(Node *node)
+	{
+		while (node != NULL) {
+			Node *next = node->mNext;
+			free(node);
+			node = next;
+		}
+	}
+	
+	// mTable holds (index into mItems) + 1, 0 for an empty slot; linear probing
+	UInt32	Find(const T &obj) const
+	{
+		if (mTable == NULL)
+			return kNotFound;
+		for (UInt32 slot = THash()(obj) & mTableMask; mTable[slot] != 0; slot = (slot + 1) & mTableMask)
+			if (mItems[mTable[slot] - 1] == obj)
+				return slot;
+		return kNotFound;
+	}
+	
+	bool	Insert(const T &obj)
+	{
+		if (Find(obj) != kNotFound)
+			return false;
+		if (mCount == mCapacity)
+			Grow();
+		mItems[mCount] = obj;
+		++mCount;
+		UInt32 slot = THash()(obj) & mTableMask;
+		while (mTable[slot] != 0)
+			slot = (slot + 1) & mTableMask;
+		mTable[slot] = mCount;
+		return true;
+	}
+	
+	bool	Erase(const T &obj)
+	{
+		UInt32 slot = Find(obj);
+		if (slot == kNotFound)
+			return false;
+		UInt32 index = mTable[slot] - 1;
+		
+		// move the last object into the hole and repoint its table slot
+		UInt32 last = mCount - 1;
+		if (index != last) {
+			UInt32 lastSlot = Find(mItems[last]);
+			mItems[index] = mItems[last];
+			mTable[lastSlot] = index + 1;
+		}
+		--mCount;
+		
+		// backward shift deletion keeps probe chains intact without tombstones
+		UInt32 hole = slot;
+		for (UInt32 s = (hole + 1) & mTableMask; mTable[s] != 0; s = (s + 1) & mTableMask) {
+			UInt32 home = THash()(mItems[mTable[s] - 1]) & mTableMask;
+			if (((s - home) & mTableMask) >= ((s - hole) & mTableMask)) {
+				mTable[hole] = mTable[s];
+				hole = s;
+			}
+		}
+		mTable[hole] = 0;
+		return true;
+	}
+	
+	void	Grow()
+	{
+		UInt32 capacity = (mCapacity > 0) ? mCapacity * 2 : 16;
+		T *items = new T[capacity];
+		for (UInt32 i = 0; i < mCount; ++i)
+			items[i] = mItems[i];
+		delete[] mItems;
+		mItems = items;
+		mCapacity = capacity;
+		
+		// keep the table at most half full
+		delete[] mTable;
+		mTableMask = capacity * 2 - 1;
+		mTable = new UInt32[mTableMask + 1];
+		for (UInt32 i = 0; i <= mTableMask; ++i)
+			mTable[i] = 0;
+		for (UInt32 i = 0; i < mCount; ++i) {
+			UInt32 slot = THash()(mItems[i]) & mTableMask;
+			while (mTable[slot] != 0)
+				slot = (slot + 1) & mTableMask;
+			mTable[slot] = i + 1;
+		}
+	}
+	
+	void	Publish()
+	{
+		// of three snapshots, at most one is published and one being read; the barrier pairs
+		// with BeginRead's, so that a reader either sees the last mPublished store or has
+		// already set mReading where this load will see it
+		CAMemoryBarrier();
+		Snapshot *reading = mReading;
+		Snapshot *s = &mSnapshots[0];
+		while (s == mPublished || s == reading)
+			++s;
+		if (s->mCapacity < mCount) {
+			delete[] s->mItems;
+			s->mItems = new T[mCapacity];
+			s->mCapacity = mCapacity;
+		}
+		for (UInt32 i = 0; i < mCount; ++i)
+			s->mItems[i] = mItems[i];
+		s->mCount = mCount;
+		CAMemoryBarrier();
+		mPublished = s;
+	}
+	
+	const Snapshot *	BeginRead()
+	{
+		Snapshot *s;
+		do {
+			s = mPublished;
+			mReading = s;
+			CAMemoryBarrier();
+			// if update() republished in between, it may have picked s to overwrite
+		} while (s != mPublished);
+		return s;
+	}
+	
+	void	EndRead()
+	{
+		CAMemoryBarrier();
+		mReading = NULL;
+	}
+
+private:
+	T *					mItems;			// dense, update() thread only
+	UInt32				mCount;
+	UInt32				mCapacity;
+	UInt32 *			mTable;
+	UInt32				mTableMask;
+	
+	Snapshot			mSnapshots[kNumberSnapshots];
+	Snapshot * volatile	mPublished;
+	Snapshot * volatile	mReading;
+	
+	TAtomicStack<Node>			mPendingList;	// add or remove requests - threadsafe
+	TAtomicTaggedStack<Node>	mFreeList;		// free nodes for reuse - threadsafe
+};
+
+// ____________________________________________________________________________
+
+//	Benchmark of the two lists, and a stress test of TThreadSafeHashedList's snapshots
+//	(CAThreadSafeList.cpp). Times are per object.
+struct CAThreadSafeListStatistics {
+	UInt32		mNumberObjects;
+	Float64		mListAddNanos;				// update() applying deferred adds of every object
+	Float64		mListRemoveNanos;			// then removes, in the reverse order
+	Float64		mListIterateNanos;
+	Float64		mHashedListAddNanos;
+	Float64		mHashedListRemoveNanos;
+	Float64		mHashedListIterateNanos;
+	UInt32		mNumberSnapshotsRead;		// by the stress test's reader thread
+	UInt32		mNumberTornSnapshots;		// that didn't hold exactly one update's objects
+};
+
+//	Times each list with inNumberObjects objects, then has one thread replace the whole
+//	hashed list inNumberUpdates times while another reads it. Returns false if the reader
+//	thread couldn't be started or read a torn snapshot.
+bool	CAMeasureThreadSafeLists(UInt32 inNumberObjects, UInt32 inNumberUpdates, CAThreadSafeListStatistics &outStatistics);
+
 #endif // __CAThreadSafeList_h__
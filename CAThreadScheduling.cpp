@@ -0,0 +1,371 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+//==================================================================================================
+//	Includes
+//==================================================================================================
+
+//	Self Include
+#include "CAThreadScheduling.h"
+
+#if defined(__linux__)
+
+//	PublicUtility Includes
+#include "CAAtomic.h"
+#include "CAHALIOCycleLoadStatistics.h"
+#include "CAHostTimeBase.h"
+
+//	System Includes
+#include <alloca.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+//==================================================================================================
+//	SCHED_DEADLINE
+//
+//	glibc doesn't wrap sched_setattr, so the call is made directly.
+//==================================================================================================
+
+#if !defined(SCHED_DEADLINE)
+	#define	SCHED_DEADLINE	6
+#endif
+
+struct	CAThreadSchedulingAttributes
+{
+	UInt32	size;
+	UInt32	sched_policy;
+	UInt64	sched_flags;
+	SInt32	sched_nice;
+	UInt32	sched_priority;
+	UInt64	sched_runtime;
+	UInt64	sched_deadline;
+	UInt64	sched_period;
+};
+
+//	what MeasureWakeUpLatency hands to the thread it measures
+struct	CAThreadSchedulingWakeUpParameters
+{
+	SInt32						mPolicy;
+	UInt64						mPeriodNanos;
+	UInt32						mNumberWakeUps;
+	CAHALTelemetryHistogram*	mHistogram;
+};
+
+//==================================================================================================
+//	CAThreadScheduling
+//==================================================================================================
+
+CAThreadScheduling::Options	CAThreadScheduling::sOptions = { true, 80, -1, false, 0 };
+
+void	CAThreadScheduling::GetOptions(Options& outOptions)
+{
+	outOptions = sOptions;
+}
+
+void	CAThreadScheduling::SetOptions(const Options& inOptions)
+{
+	sOptions = inOptions;
+}
+
+pid_t	CAThreadScheduling::GetCurrentThreadID()
+{
+	return static_cast<pid_t>(syscall(SYS_gettid));
+}
+
+void	CAThreadScheduling::PrepareCurrentThread()
+{
+	//	locking the memory is for the whole process, so it only needs doing once
+	static volatile SInt32 sMemoryIsLocked = 0;
+	if(sOptions.mLockMemory && CAAtomicCompareAndSwap32Barrier(0, 1, &sMemoryIsLocked))
+	{
+		mlockall(MCL_CURRENT | MCL_FUTURE);
+	}
+	
+	//	touch each page of the stack that will be used so the thread doesn't fault on it later
+	if(sOptions.mPrefaultStackBytes > 0)
+	{
+		volatile char* theStack = static_cast<volatile char*>(alloca(sOptions.mPrefaultStackBytes));
+		for(UInt32 theOffset = 0; theOffset < sOptions.mPrefaultStackBytes; theOffset += 4096)
+		{
+			theStack[theOffset] = 0;
+		}
+	}
+}
+
+SInt32	CAThreadScheduling::SetTimeConstraints(pid_t inThreadID, UInt64 inPeriod, UInt64 inComputation, UInt64 inConstraint, bool /*inIsPreemptible*/)
+{
+	//	the constraints are in host time, and a period of 0 means the thread isn't periodic
+	UInt64 thePeriod = CAHostTimeBase::ConvertToNanos(inPeriod);
+	UInt64 theComputation = CAHostTimeBase::ConvertToNanos(inComputation);
+	UInt64 theConstraint = CAHostTimeBase::ConvertToNanos(inConstraint);
+	if(theConstraint == 0)
+	{
+		theConstraint = thePeriod;
+	}
+	if(thePeriod < theConstraint)
+	{
+		thePeriod = theConstraint;
+	}
+	
+	if(sOptions.mAllowDeadline && SetDeadline(inThreadID, theComputation, theConstraint, thePeriod))
+	{
+		return kPolicyDeadline;
+	}
+	
+	if(SetFIFOPriority(inThreadID, sOptions.mTimeConstraintFIFOPriority))
+	{
+		if(sOptions.mCPU >= 0)
+		{
+			cpu_set_t theCPUs;
+			CPU_ZERO(&theCPUs);
+			CPU_SET(sOptions.mCPU, &theCPUs);
+			sched_setaffinity(inThreadID, sizeof(cpu_set_t), &theCPUs);
+		}
+		return kPolicyFIFO;
+	}
+	
+	//	no real time policy is allowed, so do the best that time sharing can do
+	SetTimeSharePriority(inThreadID, kMaximumPriority);
+	return kPolicyTimeShare;
+}
+
+SInt32	CAThreadScheduling::SetPriority(pid_t inThreadID, UInt32 inPriority, bool inIsFixedPriority)
+{
+	if(inPriority > kMaximumPriority)
+	{
+		inPriority = kMaximumPriority;
+	}
+	
+	//	fixed priorities above the default are spread out below the time constraint priority
+	if(inIsFixedPriority && (inPriority > kDefaultPriority))
+	{
+		SInt32 theFIFOPriority = 1 + static_cast<SInt32>(((inPriority - kDefaultPriority - 1) * (sOptions.mTimeConstraintFIFOPriority - 2)) / (kMaximumPriority - kDefaultPriority - 1));
+		if(SetFIFOPriority(inThreadID, theFIFOPriority))
+		{
+			return kPolicyFIFO;
+		}
+	}
+	
+	struct sched_param theParameters;
+	theParameters.sched_priority = 0;
+	sched_setscheduler(inThreadID, SCHED_OTHER, &theParameters);
+	SetTimeSharePriority(inThreadID, inPriority);
+	return kPolicyTimeShare;
+}
+
+UInt32	CAThreadScheduling::GetPriority(pid_t inThreadID)
+{
+	//	this maps the policy back onto the Mach priorities, so it is only approximately what was set
+	UInt32 theAnswer = kDefaultPriority;
+	int thePolicy = sched_getscheduler(inThreadID);
+	if(thePolicy == SCHED_DEADLINE)
+	{
+		theAnswer = kTimeConstraintPriority;
+	}
+	else if((thePolicy == SCHED_FIFO) || (thePolicy == SCHED_RR))
+	{
+		struct sched_param theParameters;
+		sched_getparam(inThreadID, &theParameters);
+		if(theParameters.sched_priority >= sOptions.mTimeConstraintFIFOPriority)
+		{
+			theAnswer = kTimeConstraintPriority;
+		}
+		else
+		{
+			theAnswer = kDefaultPriority + 1 + static_cast<UInt32>(((theParameters.sched_priority - 1) * (kMaximumPriority - kDefaultPriority - 1)) / (sOptions.mTimeConstraintFIFOPriority - 2));
+		}
+	}
+	else if(thePolicy >= 0)
+	{
+		errno = 0;
+		int theNice = getpriority(PRIO_PROCESS, static_cast<id_t>(inThreadID));
+		if(errno == 0)
+		{
+			theAnswer = (theNice < 0) ? kDefaultPriority + ((-theNice * (kMaximumPriority - kDefaultPriority)) / 20) : kDefaultPriority - ((theNice * kDefaultPriority) / 19);
+		}
+	}
+	return theAnswer;
+}
+
+bool	CAThreadScheduling::MeasureWakeUpLatency(SInt32 inPolicy, UInt64 inPeriodNanos, UInt32 inNumberWakeUps, WakeUpLatency& outLatency)
+{
+	//	the measurement is made on a new thread so that the caller's policy is left alone
+	CAHALTelemetryHistogram* theHistogram = new CAHALTelemetryHistogram();
+	CAThreadSchedulingWakeUpParameters theParameters = { inPolicy, inPeriodNanos, inNumberWakeUps, theHistogram };
+	
+	pthread_t theThread;
+	bool theAnswer = pthread_create(&theThread, NULL, MeasureWakeUpLatencyEntry, &theParameters) == 0;
+	if(theAnswer)
+	{
+		pthread_join(theThread, NULL);
+		outLatency.mPolicy = theParameters.mPolicy;
+		outLatency.mNumberWakeUps = static_cast<UInt32>(theHistogram->GetTotalCount());
+		outLatency.mP50 = theHistogram->GetValueAtPercentile(50.0) / 1000.0;
+		outLatency.mP99 = theHistogram->GetValueAtPercentile(99.0) / 1000.0;
+		outLatency.mP999 = theHistogram->GetValueAtPercentile(99.9) / 1000.0;
+		outLatency.mMaximum = theHistogram->GetMaximum() / 1000.0;
+	}
+	delete theHistogram;
+	return theAnswer;
+}
+
+bool	CAThreadScheduling::SetDeadline(pid_t inThreadID, UInt64 inRuntimeNanos, UInt64 inDeadlineNanos, UInt64 inPeriodNanos)
+{
+	bool theAnswer = false;
+	#if defined(SYS_sched_setattr)
+		//	the kernel wants runtime <= deadline <= period and a runtime of at least 1024ns
+		if((inRuntimeNanos >= 1024) && (inRuntimeNanos <= inDeadlineNanos) && (inDeadlineNanos <= inPeriodNanos))
+		{
+			CAThreadSchedulingAttributes theAttributes;
+			memset(&theAttributes, 0, sizeof(theAttributes));
+			theAttributes.size = sizeof(theAttributes);
+			theAttributes.sched_policy = SCHED_DEADLINE;
+			theAttributes.sched_runtime = inRuntimeNanos;
+			theAttributes.sched_deadline = inDeadlineNanos;
+			theAttributes.sched_period = inPeriodNanos;
+			theAnswer = syscall(SYS_sched_setattr, inThreadID, &theAttributes, 0) == 0;
+		}
+	#endif
+	return theAnswer;
+}
+
+bool	CAThreadScheduling::SetFIFOPriority(pid_t inThreadID, SInt32 inPriority)
+{
+	SInt32 theMinimumPriority = sched_get_priority_min(SCHED_FIFO);
+	SInt32 theMaximumPriority = sched_get_priority_max(SCHED_FIFO);
+	if(inPriority < theMinimumPriority)
+	{
+		inPriority = theMinimumPriority;
+	}
+	if(inPriority > theMaximumPriority)
+	{
+		inPriority = theMaximumPriority;
+	}
+	
+	struct sched_param theParameters;
+	theParameters.sched_priority = inPriority;
+	bool theAnswer = sched_setscheduler(inThreadID, SCHED_FIFO, &theParameters) == 0;
+	if(!theAnswer && (errno == EPERM))
+	{
+		//	without privileges, the most that can be had is RLIMIT_RTPRIO
+		struct rlimit theLimit;
+		if((getrlimit(RLIMIT_RTPRIO, &theLimit) == 0) && (theLimit.rlim_cur >= static_cast<rlim_t>(theMinimumPriority)) && (theLimit.rlim_cur < static_cast<rlim_t>(inPriority)))
+		{
+			theParameters.sched_priority = static_cast<int>(theLimit.rlim_cur);
+			theAnswer = sched_setscheduler(inThreadID, SCHED_FIFO, &theParameters) == 0;
+		}
+	}
+	return theAnswer;
+}
+
+void	CAThreadScheduling::SetTimeSharePriority(pid_t inThreadID, UInt32 inPriority)
+{
+	//	the default priority is a nice value of 0, the maximum is -20 and 0 is 19
+	int theNice = (inPriority >= kDefaultPriority) ? -static_cast<int>(((inPriority - kDefaultPriority) * 20) / (kMaximumPriority - kDefaultPriority)) : static_cast<int>(((kDefaultPriority - inPriority) * 19) / kDefaultPriority);
+	
+	//	raising the priority isn't allowed without privileges, in which case it stays where it is
+	setpriority(PRIO_PROCESS, static_cast<id_t>(inThreadID), theNice);
+}
+
+void*	CAThreadScheduling::MeasureWakeUpLatencyEntry(void* inParameters)
+{
+	CAThreadSchedulingWakeUpParameters* theParameters = static_cast<CAThreadSchedulingWakeUpParameters*>(inParameters);
+	
+	//	ask for the policy being measured, and report the one that was actually granted
+	pid_t theThreadID = GetCurrentThreadID();
+	SInt32 thePolicy = kPolicyTimeShare;
+	switch(theParameters->mPolicy)
+	{
+		case kPolicyDeadline:
+			if(SetDeadline(theThreadID, theParameters->mPeriodNanos / 4, theParameters->mPeriodNanos, theParameters->mPeriodNanos))
+			{
+				thePolicy = kPolicyDeadline;
+			}
+			break;
+		
+		case kPolicyFIFO:
+			if(SetFIFOPriority(theThreadID, sOptions.mTimeConstraintFIFOPriority))
+			{
+				thePolicy = kPolicyFIFO;
+			}
+			break;
+		
+		default:
+			SetPriority(theThreadID, kDefaultPriority, false);
+			break;
+	}
+	theParameters->mPolicy = thePolicy;
+	PrepareCurrentThread();
+	
+	//	sleep until each wake up time and record how late the thread actually got to run
+	struct timespec theTime;
+	clock_gettime(CLOCK_MONOTONIC, &theTime);
+	UInt64 theWakeUpTime = (static_cast<UInt64>(theTime.tv_sec) * 1000000000ULL) + theTime.tv_nsec + theParameters->mPeriodNanos;
+	for(UInt32 theWakeUpIndex = 0; theWakeUpIndex < theParameters->mNumberWakeUps; ++theWakeUpIndex)
+	{
+		struct timespec theWakeUpTimeSpec;
+		theWakeUpTimeSpec.tv_sec = static_cast<time_t>(theWakeUpTime / 1000000000ULL);
+		theWakeUpTimeSpec.tv_nsec = static_cast<long>(theWakeUpTime % 1000000000ULL);
+		while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &theWakeUpTimeSpec, NULL) == EINTR)
+		{
+		}
+		
+		clock_gettime(CLOCK_MONOTONIC, &theTime);
+		UInt64 theNow = (static_cast<UInt64>(theTime.tv_sec) * 1000000000ULL) + theTime.tv_nsec;
+		theParameters->mHistogram->Record((theNow > theWakeUpTime) ? theNow - theWakeUpTime : 0);
+		
+		//	if a wake up was missed entirely, start over from now rather than running to catch up
+		theWakeUpTime += theParameters->mPeriodNanos;
+		if(theWakeUpTime <= theNow)
+		{
+			theWakeUpTime = theNow + theParameters->mPeriodNanos;
+		}
+	}
+	return NULL;
+}
+
+#endif
@@ -0,0 +1,145 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+#if !defined(__CAThreadScheduling_h__)
+#define __CAThreadScheduling_h__
+
+//==================================================================================================
+//	Includes
+//==================================================================================================
+
+//	System Includes
+#include <CoreAudio/CoreAudioTypes.h>
+#include <sys/types.h>
+
+#if defined(__linux__)
+
+//==================================================================================================
+//	CAThreadScheduling
+//
+//	This class maps the scheduling requests that CAPThread makes in terms of Mach thread policies
+//	onto the policies Linux has. It works on kernel thread IDs so that it can be used on threads
+//	other than the calling one.
+//
+//	A time constraint thread becomes a SCHED_DEADLINE thread with the computation as its runtime,
+//	the constraint as its deadline and the same period. The kernel only allows that with
+//	CAP_SYS_NICE and when the thread may run on every CPU. If it isn't allowed, the thread becomes
+//	a SCHED_FIFO thread at the time constraint priority instead and, optionally, is pinned to a
+//	CPU. The preemptible flag has no equivalent and is ignored.
+//
+//	A fixed priority thread above the default priority becomes a SCHED_FIFO thread below the time
+//	constraint priority. Every other thread stays SCHED_OTHER, with its priority mapped onto the
+//	nice value. When SCHED_FIFO isn't allowed, the FIFO priority is clipped to RLIMIT_RTPRIO, and
+//	if that isn't enough either, the thread is left as it was.
+//
+//	The options are process wide and should be set up before any threads are started.
+//==================================================================================================
+
+class CAThreadScheduling
+{
+
+//	Constants
+public:
+	enum
+	{
+		kPolicyTimeShare		= 0,
+		kPolicyFIFO				= 1,
+		kPolicyDeadline			= 2
+	};
+	
+	enum
+	{
+		kDefaultPriority		= 31,
+		kMaximumPriority		= 63,
+		kTimeConstraintPriority	= 97
+	};
+
+//	Types
+public:
+	struct	Options
+	{
+		bool	mAllowDeadline;					//	try SCHED_DEADLINE for time constraint threads
+		SInt32	mTimeConstraintFIFOPriority;	//	the SCHED_FIFO priority for time constraint threads
+		SInt32	mCPU;							//	the CPU to pin SCHED_FIFO time constraint threads to, -1 for none
+		bool	mLockMemory;					//	call mlockall the first time a thread is prepared
+		UInt32	mPrefaultStackBytes;			//	how much of its stack a thread touches when prepared
+	};
+	
+	//	the policy the thread actually got and how late it woke up, in microseconds
+	struct	WakeUpLatency
+	{
+		SInt32	mPolicy;
+		UInt32	mNumberWakeUps;
+		Float64	mP50;
+		Float64	mP99;
+		Float64	mP999;
+		Float64	mMaximum;
+	};
+
+//	Options
+public:
+	static void			GetOptions(Options& outOptions);
+	static void			SetOptions(const Options& inOptions);
+
+//	Operations
+public:
+	static pid_t		GetCurrentThreadID();
+	static void			PrepareCurrentThread();
+	
+	static SInt32		SetTimeConstraints(pid_t inThreadID, UInt64 inPeriod, UInt64 inComputation, UInt64 inConstraint, bool inIsPreemptible);
+	static SInt32		SetPriority(pid_t inThreadID, UInt32 inPriority, bool inIsFixedPriority);
+	static UInt32		GetPriority(pid_t inThreadID);
+	
+	static bool			MeasureWakeUpLatency(SInt32 inPolicy, UInt64 inPeriodNanos, UInt32 inNumberWakeUps, WakeUpLatency& outLatency);
+
+//	Implementation
+private:
+	static bool			SetDeadline(pid_t inThreadID, UInt64 inRuntimeNanos, UInt64 inDeadlineNanos, UInt64 inPeriodNanos);
+	static bool			SetFIFOPriority(pid_t inThreadID, SInt32 inPriority);
+	static void			SetTimeSharePriority(pid_t inThreadID, UInt32 inPriority);
+	static void*		MeasureWakeUpLatencyEntry(void* inParameters);
+	
+	static Options		sOptions;
+
+};
+
+#endif
+
+#endif
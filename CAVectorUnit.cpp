@@ -40,7 +40,7 @@
 */
 #include "CAVectorUnit.h"
 
-#if !TARGET_OS_WIN32
+#if TARGET_OS_MAC
 	#include <sys/sysctl.h>
 #elif HAS_IPP
 	#include "ippdefs.h"
@@ -164,18 +164,44 @@ SInt32	CAVectorUnit_Examine()
 	#elif (TARGET_CPU_X86 || TARGET_CPU_X86_64)
 		int answer = 0;
 		size_t length = sizeof(answer);
-		int error = sysctlbyname("hw.optional.sse3", &answer, &length, NULL, 0);
+		int error = sysctlbyname("hw.optional.avx2_0", &answer, &length, NULL, 0);
 		if (!error && answer)
-			result = kVecSSE3;
+			result = kVecAVX2;
 		else {
 			answer = 0;
 			length = sizeof(answer);
-			error = sysctlbyname("hw.optional.sse2", &answer, &length, NULL, 0);
+			error = sysctlbyname("hw.optional.sse3", &answer, &length, NULL, 0);
 			if (!error && answer)
-				result = kVecSSE2;
+				result = kVecSSE3;
+			else {
+				answer = 0;
+				length = sizeof(answer);
+				error = sysctlbyname("hw.optional.sse2", &answer, &length, NULL, 0);
+				if (!error && answer)
+					result = kVecSSE2;
+			}
 		}
+	#elif (TARGET_CPU_ARM || TARGET_CPU_ARM64)
+		result = kVecNeon;
 	#endif
 	}
+#else
+	if (getenv("CA_NoVector")) {
+		fprintf(stderr, "CA_NoVector set; Vector unit optimized routines will be bypassed\n");
+		gCAVectorUnitType = result;		// so that the environment is only read, and the message printed, once
+		return result;
+	}
+	#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			result = kVecAVX2;
+		else if (__builtin_cpu_supports("sse3"))
+			result = kVecSSE3;
+		else if (__builtin_cpu_supports("sse2"))
+			result = kVecSSE2;
+	#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+		result = kVecNeon;
+	#endif
 #endif
 	gCAVectorUnitType = result;
 	return result;
@@ -86,7 +86,9 @@ public:
 	static bool			HasVectorUnit() { return GetVectorUnitType() > kVecNone; }
 	static bool			HasAltivec() { return GetVectorUnitType() == kVecAltivec; }
 	static bool			HasSSE2() { return GetVectorUnitType() >= kVecSSE2; }
-	static bool			HasSSE3() { return GetVectorUnitType() == kVecSSE3; }
+	static bool			HasSSE3() { return GetVectorUnitType() >= kVecSSE3; }
+	static bool			HasAVX2() { return GetVectorUnitType() >= kVecAVX2; }
+	static bool			HasNeon() { return GetVectorUnitType() == kVecNeon; }
 };
 #endif
 
@@ -45,8 +45,10 @@ enum {
 	kVecUninitialized = -1,
 	kVecNone = 0,
 	kVecAltivec = 1,
+	kVecNeon = 2,
 	kVecSSE2 = 100,
-	kVecSSE3 = 101
+	kVecSSE3 = 101,
+	kVecAVX2 = 102
 };
 
 #endif
@@ -46,7 +46,153 @@
 
 #include "CAVolumeCurve.h"
 #include "CADebugMacros.h"
+#include "CAHostTimeBase.h"
+#include "CAVectorUnit.h"
 #include <math.h>
+#include <string.h>
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+	#define CA_VOLUMECURVE_SSE2	1
+	#include <emmintrin.h>
+#endif
+
+//=============================================================================
+//	CAVolumeCurveSSE2Kernels
+//
+//	Each kernel converts whole vectors of values and returns the number of
+//	values it handled. The caller finishes the remainder with the scalar code.
+//	The kernels do the same arithmetic in the same order as the scalar code, so
+//	their output is bit-for-bit identical to it.
+//=============================================================================
+
+#if CA_VOLUMECURVE_SSE2
+class CAVolumeCurveSSE2Kernels
+{
+
+public:
+	enum { kValuesPerVector = 2 };
+
+	static __m128d	LoadRaw(const SInt32* inRaw) { return _mm_cvtepi32_pd(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(inRaw))); }
+	static void		StoreRaw(SInt32* outRaw, __m128i inRaw) { _mm_storel_epi64(reinterpret_cast<__m128i*>(outRaw), inRaw); }
+	static __m128d	Select(__m128d inMask, __m128d inTrue, __m128d inFalse) { return _mm_or_pd(_mm_and_pd(inMask, inTrue), _mm_andnot_pd(inMask, inFalse)); }
+	
+	//	rounds half way cases away from zero, like round(), for values that fit in an SInt32
+	static __m128d	Round(__m128d inValue)
+	{
+		__m128d theTruncated = _mm_cvtepi32_pd(_mm_cvttpd_epi32(inValue));
+		__m128d theFraction = _mm_sub_pd(inValue, theTruncated);
+		__m128d theOne = _mm_set1_pd(1.0);
+		__m128d theUp = _mm_and_pd(_mm_cmpge_pd(theFraction, _mm_set1_pd(0.5)), theOne);
+		__m128d theDown = _mm_and_pd(_mm_cmple_pd(theFraction, _mm_set1_pd(-0.5)), theOne);
+		return _mm_sub_pd(_mm_add_pd(theTruncated, theUp), theDown);
+	}
+	
+	static UInt32	RawToDB(const CAVolumeCurve& inCurve, const SInt32* inRaw, Float64* outDB, UInt32 inNumberValues)
+	{
+		const CAVolumeCurve::Segment* theSegments = &inCurve.mSegments[0];
+		UInt32 theNumberSegments = static_cast<UInt32>(inCurve.mSegments.size());
+		__m128d theMinimumRaw = _mm_set1_pd(inCurve.mMinimumRaw);
+		__m128d theMaximumRaw = _mm_set1_pd(inCurve.mMaximumRaw);
+		__m128d theDBStart = _mm_set1_pd(theSegments[0].mDBStart);
+		__m128d theDBEnd = _mm_set1_pd(inCurve.mDBEnd);
+		
+		UInt32 theIndex = 0;
+		for(; (theIndex + kValuesPerVector) <= inNumberValues; theIndex += kValuesPerVector)
+		{
+			__m128d theNumberRawSteps = _mm_sub_pd(_mm_min_pd(_mm_max_pd(LoadRaw(inRaw + theIndex), theMinimumRaw), theMaximumRaw), theMinimumRaw);
+			
+			//	each value takes its answer from the first segment it lands in
+			__m128d isDone = _mm_cmple_pd(theNumberRawSteps, _mm_setzero_pd());
+			__m128d theAnswer = Select(isDone, theDBStart, theDBEnd);
+			for(UInt32 theSegmentIndex = 0; (theSegmentIndex < theNumberSegments) && (_mm_movemask_pd(isDone) != 3); ++theSegmentIndex)
+			{
+				const CAVolumeCurve::Segment& theSegment = theSegments[theSegmentIndex];
+				__m128d theSegmentSteps = _mm_sub_pd(theNumberRawSteps, _mm_set1_pd(theSegment.mRawSteps));
+				__m128d isInSegment = _mm_andnot_pd(isDone, _mm_cmple_pd(theSegmentSteps, _mm_set1_pd(theSegment.mRawRange)));
+				__m128d theDB = _mm_add_pd(_mm_set1_pd(theSegment.mDBStart), _mm_mul_pd(theSegmentSteps, _mm_set1_pd(theSegment.mDBPerRaw)));
+				theAnswer = Select(isInSegment, theDB, theAnswer);
+				isDone = _mm_or_pd(isDone, isInSegment);
+			}
+			
+			_mm_storeu_pd(outDB + theIndex, theAnswer);
+		}
+		return theIndex;
+	}
+	
+	static UInt32	DBToRaw(const CAVolumeCurve& inCurve, const Float64* inDB, SInt32* outRaw, UInt32 inNumberValues)
+	{
+		const CAVolumeCurve::Segment* theSegments = &inCurve.mSegments[0];
+		UInt32 theNumberSegments = static_cast<UInt32>(inCurve.mSegments.size());
+		__m128d theMinimumDB = _mm_set1_pd(inCurve.mMinimumDB);
+		__m128d theMaximumDB = _mm_set1_pd(inCurve.mMaximumDB);
+		__m128d theRawEnd = _mm_set1_pd(inCurve.mRawEnd);
+		
+		UInt32 theIndex = 0;
+		for(; (theIndex + kValuesPerVector) <= inNumberValues; theIndex += kValuesPerVector)
+		{
+			//	the operands are in this order so that NaNs pass through the clamp like they do in the scalar code
+			__m128d theDB = _mm_min_pd(theMaximumDB, _mm_max_pd(theMinimumDB, _mm_loadu_pd(inDB + theIndex)));
+			
+			__m128d isDone = _mm_setzero_pd();
+			__m128d theAnswer = theRawEnd;
+			for(UInt32 theSegmentIndex = 0; (theSegmentIndex < theNumberSegments) && (_mm_movemask_pd(isDone) != 3); ++theSegmentIndex)
+			{
+				const CAVolumeCurve::Segment& theSegment = theSegments[theSegmentIndex];
+				__m128d isInSegment = _mm_andnot_pd(isDone, _mm_cmpngt_pd(theDB, _mm_set1_pd(theSegment.mDBMaximum)));
+				__m128d theNumberRawSteps = Round(_mm_div_pd(_mm_sub_pd(theDB, _mm_set1_pd(theSegment.mDBMinimum)), _mm_set1_pd(theSegment.mDBPerRaw)));
+				theAnswer = Select(isInSegment, _mm_add_pd(_mm_set1_pd(theSegment.mRawStart), theNumberRawSteps), theAnswer);
+				isDone = _mm_or_pd(isDone, isInSegment);
+			}
+			
+			StoreRaw(outRaw + theIndex, _mm_cvttpd_epi32(theAnswer));
+		}
+		return theIndex;
+	}
+	
+	static UInt32	RawToScalar(const CAVolumeCurve& inCurve, const SInt32* inRaw, Float64* outScalar, UInt32 inNumberValues)
+	{
+		__m128d theMinimumRaw = _mm_set1_pd(inCurve.mMinimumRaw);
+		__m128d theMaximumRaw = _mm_set1_pd(inCurve.mMaximumRaw);
+		__m128d theRawRange = _mm_set1_pd(static_cast<Float64>(inCurve.mMaximumRaw - inCurve.mMinimumRaw));
+		
+		UInt32 theIndex = 0;
+		for(; (theIndex + kValuesPerVector) <= inNumberValues; theIndex += kValuesPerVector)
+		{
+			__m128d theRaw = _mm_min_pd(_mm_max_pd(LoadRaw(inRaw + theIndex), theMinimumRaw), theMaximumRaw);
+			__m128d theAnswer = _mm_div_pd(_mm_sub_pd(theRaw, theMinimumRaw), theRawRange);
+			if(inCurve.mIsScalarCurved)
+			{
+				theAnswer = _mm_mul_pd(theAnswer, theAnswer);
+			}
+			_mm_storeu_pd(outScalar + theIndex, theAnswer);
+		}
+		return theIndex;
+	}
+	
+	static UInt32	ScalarToRaw(const CAVolumeCurve& inCurve, const Float64* inScalar, SInt32* outRaw, UInt32 inNumberValues)
+	{
+		__m128d theZero = _mm_setzero_pd();
+		__m128d theOne = _mm_set1_pd(1.0);
+		__m128d theRawRange = _mm_set1_pd(static_cast<Float64>(inCurve.mMaximumRaw - inCurve.mMinimumRaw));
+		__m128i theMinimumRaw = _mm_set1_epi32(inCurve.mMinimumRaw);
+		
+		UInt32 theIndex = 0;
+		for(; (theIndex + kValuesPerVector) <= inNumberValues; theIndex += kValuesPerVector)
+		{
+			//	the operands are in this order so that NaNs become 0 like they do with std::max
+			__m128d theScalar = _mm_min_pd(_mm_max_pd(_mm_loadu_pd(inScalar + theIndex), theZero), theOne);
+			if(inCurve.mIsScalarCurved)
+			{
+				theScalar = _mm_sqrt_pd(theScalar);
+			}
+			__m128d theNumberRawSteps = Round(_mm_mul_pd(theScalar, theRawRange));
+			StoreRaw(outRaw + theIndex, _mm_add_epi32(theMinimumRaw, _mm_cvttpd_epi32(theNumberRawSteps)));
+		}
+		return theIndex;
+	}
+
+};
+#endif
 
 //=============================================================================
 //	CAVolumeCurve
@@ -54,7 +200,17 @@
 
 CAVolumeCurve::CAVolumeCurve()
 :
-	mCurveMap()
+	mCurveMap(),
+	mSegments(),
+	mMinimumRaw(0),
+	mMaximumRaw(0),
+	mMinimumDB(0),
+	mMaximumDB(0),
+	mRawEnd(0),
+	mDBEnd(0),
+	mIsScalarCurved(false),
+	mMaximumLookUpTableSize(0),
+	mRawToDBTable()
 {
 }
 
@@ -64,56 +220,22 @@ CAVolumeCurve::~CAVolumeCurve()
 
 SInt32	CAVolumeCurve::GetMinimumRaw() const
 {
-	SInt32 theAnswer = 0;
-	
-	if(!mCurveMap.empty())
-	{
-		CurveMap::const_iterator theIterator = mCurveMap.begin();
-		theAnswer = theIterator->first.mMinimum;
-	}
-	
-	return theAnswer;
+	return mMinimumRaw;
 }
 
 SInt32	CAVolumeCurve::GetMaximumRaw() const
 {
-	SInt32 theAnswer = 0;
-	
-	if(!mCurveMap.empty())
-	{
-		CurveMap::const_iterator theIterator = mCurveMap.begin();
-		std::advance(theIterator, mCurveMap.size() - 1);
-		theAnswer = theIterator->first.mMaximum;
-	}
-	
-	return theAnswer;
+	return mMaximumRaw;
 }
 
 Float64	CAVolumeCurve::GetMinimumDB() const
 {
-	Float64 theAnswer = 0;
-	
-	if(!mCurveMap.empty())
-	{
-		CurveMap::const_iterator theIterator = mCurveMap.begin();
-		theAnswer = theIterator->second.mMinimum;
-	}
-	
-	return theAnswer;
+	return mMinimumDB;
 }
 
 Float64	CAVolumeCurve::GetMaximumDB() const
 {
-	Float64 theAnswer = 0;
-	
-	if(!mCurveMap.empty())
-	{
-		CurveMap::const_iterator theIterator = mCurveMap.begin();
-		std::advance(theIterator, mCurveMap.size() - 1);
-		theAnswer = theIterator->second.mMaximum;
-	}
-	
-	return theAnswer;
+	return mMaximumDB;
 }
 
 void	CAVolumeCurve::AddRange(SInt32 inMinRaw, SInt32 inMaxRaw, Float64 inMinDB, Float64 inMaxDB)
@@ -138,6 +260,7 @@ void	CAVolumeCurve::AddRange(SInt32 inMinRaw, SInt32 inMaxRaw, Float64 inMinDB,
 	if(!isOverlapped)
 	{
 		mCurveMap.insert(CurveMap::value_type(theRaw, theDB));
+		CompileCurve();
 	}
 	else
 	{
@@ -148,6 +271,7 @@ void	CAVolumeCurve::AddRange(SInt32 inMinRaw, SInt32 inMaxRaw, Float64 inMinDB,
 void	CAVolumeCurve::ResetRange()
 {
 	mCurveMap.clear();
+	CompileCurve();
 }
 
 bool	CAVolumeCurve::CheckForContinuity() const
@@ -185,9 +309,414 @@ bool	CAVolumeCurve::CheckForContinuity() const
 
 SInt32	CAVolumeCurve::ConvertDBToRaw(Float64 inDB) const
 {
-	//	clamp the value to the dB range
-	Float64 theOverallDBMin = GetMinimumDB();
-	Float64 theOverallDBMax = GetMaximumDB();
+	SInt32 theAnswer = 0;
+	
+	if(!mSegments.empty())
+	{
+		//	clamp the value to the dB range
+		if(inDB < mMinimumDB) inDB = mMinimumDB;
+		if(inDB > mMaximumDB) inDB = mMaximumDB;
+		
+		//	find the first segment that doesn't end before the value
+		SegmentList::const_iterator theIterator = mSegments.begin();
+		while((theIterator != mSegments.end()) && (inDB > theIterator->mDBMaximum))
+		{
+			std::advance(theIterator, 1);
+		}
+		
+		if(theIterator != mSegments.end())
+		{
+			//	figure out how many steps into the segment it is, only moving in whole steps
+			Float64 theNumberRawSteps = inDB - theIterator->mDBMinimum;
+			theNumberRawSteps /= theIterator->mDBPerRaw;
+			theNumberRawSteps = round(theNumberRawSteps);
+			
+			theAnswer = theIterator->mRawStart + static_cast<SInt32>(theNumberRawSteps);
+		}
+		else
+		{
+			//	it's past the end of every segment
+			theAnswer = mRawEnd;
+		}
+	}
+	
+	return theAnswer;
+}
+
+Float64	CAVolumeCurve::ConvertRawToDB(SInt32 inRaw) const
+{
+	Float64 theAnswer = 0;
+	
+	if(!mRawToDBTable.empty())
+	{
+		//	clamp the raw value and look it up
+		if(inRaw < mMinimumRaw) inRaw = mMinimumRaw;
+		if(inRaw > mMaximumRaw) inRaw = mMaximumRaw;
+		theAnswer = mRawToDBTable[static_cast<UInt32>(inRaw - mMinimumRaw)];
+	}
+	else
+	{
+		theAnswer = ConvertRawToDBWithSegments(inRaw);
+	}
+	
+	return theAnswer;
+}
+
+Float64	CAVolumeCurve::ConvertRawToScalar(SInt32 inRaw) const
+{
+	SInt32	theRawRange = mMaximumRaw - mMinimumRaw;
+	
+	//	range the raw value
+	if(inRaw < mMinimumRaw) inRaw = mMinimumRaw;
+	if(inRaw > mMaximumRaw) inRaw = mMaximumRaw;
+
+	//	calculate the distance in the range inRaw is
+	Float64 theAnswer = static_cast<Float64>(inRaw - mMinimumRaw) / static_cast<Float64>(theRawRange);
+
+	//	only apply a curve to the scalar values if the dB range is greater than 30
+	if(mIsScalarCurved)
+	{
+		theAnswer = theAnswer * theAnswer;
+	}
+
+	return theAnswer;
+}
+
+Float64	CAVolumeCurve::ConvertDBToScalar(Float64 inDB) const
+{
+	SInt32 theRawValue = ConvertDBToRaw(inDB);
+	Float64 theAnswer = ConvertRawToScalar(theRawValue);
+	return theAnswer;
+}
+
+SInt32	CAVolumeCurve::ConvertScalarToRaw(Float64 inScalar) const
+{
+	//	range the scalar value
+	inScalar = std::min(1.0, std::max(0.0, inScalar));
+	
+	SInt32	theRawRange = mMaximumRaw - mMinimumRaw;
+	
+	//	have to undo the curve if the dB range is greater than 30
+	if(mIsScalarCurved)
+	{
+		inScalar = sqrt(inScalar);
+	}
+	
+	//	now we can figure out how many raw steps this is
+	Float64 theNumberRawSteps = inScalar * static_cast<Float64>(theRawRange);
+	theNumberRawSteps = round(theNumberRawSteps);
+	
+	//	the answer is the minimum raw value plus the number of raw steps
+	SInt32 theAnswer = mMinimumRaw + static_cast<SInt32>(theNumberRawSteps);
+	
+	return theAnswer;
+}
+
+Float64	CAVolumeCurve::ConvertScalarToDB(Float64 inScalar) const
+{
+	SInt32 theRawValue = ConvertScalarToRaw(inScalar);
+	Float64 theAnswer = ConvertRawToDB(theRawValue);
+	return theAnswer;
+}
+
+void	CAVolumeCurve::ConvertDBToRaw(const Float64* inDB, SInt32* outRaw, UInt32 inNumberValues) const
+{
+	UInt32 theIndex = 0;
+#if CA_VOLUMECURVE_SSE2
+	if(!mSegments.empty() && CAVectorUnit::HasSSE2())
+	{
+		theIndex = CAVolumeCurveSSE2Kernels::DBToRaw(*this, inDB, outRaw, inNumberValues);
+	}
+#endif
+	for(; theIndex < inNumberValues; ++theIndex)
+	{
+		outRaw[theIndex] = ConvertDBToRaw(inDB[theIndex]);
+	}
+}
+
+void	CAVolumeCurve::ConvertRawToDB(const SInt32* inRaw, Float64* outDB, UInt32 inNumberValues) const
+{
+	UInt32 theIndex = 0;
+	if(!mRawToDBTable.empty())
+	{
+		//	a table look up is already cheaper than the vector code
+		const Float64* theTable = &mRawToDBTable[0];
+		for(; theIndex < inNumberValues; ++theIndex)
+		{
+			SInt32 theRaw = inRaw[theIndex];
+			if(theRaw < mMinimumRaw) theRaw = mMinimumRaw;
+			if(theRaw > mMaximumRaw) theRaw = mMaximumRaw;
+			outDB[theIndex] = theTable[static_cast<UInt32>(theRaw - mMinimumRaw)];
+		}
+	}
+#if CA_VOLUMECURVE_SSE2
+	else if(!mSegments.empty() && CAVectorUnit::HasSSE2())
+	{
+		theIndex = CAVolumeCurveSSE2Kernels::RawToDB(*this, inRaw, outDB, inNumberValues);
+	}
+#endif
+	for(; theIndex < inNumberValues; ++theIndex)
+	{
+		outDB[theIndex] = ConvertRawToDB(inRaw[theIndex]);
+	}
+}
+
+void	CAVolumeCurve::ConvertRawToScalar(const SInt32* inRaw, Float64* outScalar, UInt32 inNumberValues) const
+{
+	UInt32 theIndex = 0;
+#if CA_VOLUMECURVE_SSE2
+	if(CAVectorUnit::HasSSE2())
+	{
+		theIndex = CAVolumeCurveSSE2Kernels::RawToScalar(*this, inRaw, outScalar, inNumberValues);
+	}
+#endif
+	for(; theIndex < inNumberValues; ++theIndex)
+	{
+		outScalar[theIndex] = ConvertRawToScalar(inRaw[theIndex]);
+	}
+}
+
+void	CAVolumeCurve::ConvertScalarToRaw(const Float64* inScalar, SInt32* outRaw, UInt32 inNumberValues) const
+{
+	UInt32 theIndex = 0;
+#if CA_VOLUMECURVE_SSE2
+	if(CAVectorUnit::HasSSE2())
+	{
+		theIndex = CAVolumeCurveSSE2Kernels::ScalarToRaw(*this, inScalar, outRaw, inNumberValues);
+	}
+#endif
+	for(; theIndex < inNumberValues; ++theIndex)
+	{
+		outRaw[theIndex] = ConvertScalarToRaw(inScalar[theIndex]);
+	}
+}
+
+bool	CAVolumeCurve::EnableLookUpTable(UInt32 inMaximumNumberEntries)
+{
+	mMaximumLookUpTableSize = inMaximumNumberEntries;
+	BuildLookUpTable();
+	return HasLookUpTable();
+}
+
+void	CAVolumeCurve::DisableLookUpTable()
+{
+	mMaximumLookUpTableSize = 0;
+	LookUpTable().swap(mRawToDBTable);
+}
+
+void	CAVolumeCurve::MeasureConversions(UInt32 inNumberValues, ConversionStatistics& outStatistics) const
+{
+	memset(&outStatistics, 0, sizeof(ConversionStatistics));
+	outStatistics.mNumberSegments = static_cast<UInt32>(mSegments.size());
+	outStatistics.mHasLookUpTable = HasLookUpTable();
+	if(mSegments.empty())
+	{
+		return;
+	}
+	if(inNumberValues == 0)
+	{
+		inNumberValues = 1;
+	}
+	
+	//	the values are spread a little past both ends of the curve so that the clamping gets exercised
+	std::vector<SInt32> theRaw(inNumberValues);
+	std::vector<Float64> theDB(inNumberValues);
+	std::vector<Float64> theScalar(inNumberValues);
+	Float64 theRawSpan = static_cast<Float64>(mMaximumRaw) - static_cast<Float64>(mMinimumRaw);
+	Float64 theDBSpan = mMaximumDB - mMinimumDB;
+	UInt32 theSeed = 1;
+	for(UInt32 theIndex = 0; theIndex < inNumberValues; ++theIndex)
+	{
+		theSeed = (theSeed * 1664525) + 1013904223;
+		Float64 thePosition = (static_cast<Float64>(theSeed >> 8) / static_cast<Float64>(1 << 24)) * 1.2 - 0.1;
+		theRaw[theIndex] = static_cast<SInt32>(static_cast<Float64>(mMinimumRaw) + (thePosition * theRawSpan));
+		theDB[theIndex] = mMinimumDB + (thePosition * theDBSpan);
+		theScalar[theIndex] = thePosition;
+	}
+	std::vector<SInt32> theRawResults(inNumberValues);
+	std::vector<Float64> theFloatResults(inNumberValues);
+	volatile Float64 theFloatSink = 0;
+	volatile SInt32 theRawSink = 0;
+	Float64 theNumberValues = static_cast<Float64>(inNumberValues);
+	UInt64 theStartNanos = 0;
+	
+	//	raw to dB
+	theStartNanos = CAHostTimeBase::GetCurrentTimeInNanos();
+	for(UInt32 theIndex = 0; theIndex < inNumberValues; ++theIndex)
+	{
+		theFloatSink += ConvertRawToDBWithMap(theRaw[theIndex]);
+	}
+	outStatistics.mMapRawToDBNanos = static_cast<Float64>(CAHostTimeBase::GetCurrentTimeInNanos() - theStartNanos) / theNumberValues;
+	
+	theStartNanos = CAHostTimeBase::GetCurrentTimeInNanos();
+	for(UInt32 theIndex = 0; theIndex < inNumberValues; ++theIndex)
+	{
+		theFloatSink += ConvertRawToDB(theRaw[theIndex]);
+	}
+	outStatistics.mRawToDBNanos = static_cast<Float64>(CAHostTimeBase::GetCurrentTimeInNanos() - theStartNanos) / theNumberValues;
+	
+	theStartNanos = CAHostTimeBase::GetCurrentTimeInNanos();
+	ConvertRawToDB(&theRaw[0], &theFloatResults[0], inNumberValues);
+	outStatistics.mBatchRawToDBNanos = static_cast<Float64>(CAHostTimeBase::GetCurrentTimeInNanos() - theStartNanos) / theNumberValues;
+	theFloatSink += theFloatResults[inNumberValues - 1];
+	
+	//	dB to raw
+	theStartNanos = CAHostTimeBase::GetCurrentTimeInNanos();
+	for(UInt32 theIndex = 0; theIndex < inNumberValues; ++theIndex)
+	{
+		theRawSink += ConvertDBToRawWithMap(theDB[theIndex]);
+	}
+	outStatistics.mMapDBToRawNanos = static_cast<Float64>(CAHostTimeBase::GetCurrentTimeInNanos() - theStartNanos) / theNumberValues;
+	
+	theStartNanos = CAHostTimeBase::GetCurrentTimeInNanos();
+	for(UInt32 theIndex = 0; theIndex < inNumberValues; ++theIndex)
+	{
+		theRawSink += ConvertDBToRaw(theDB[theIndex]);
+	}
+	outStatistics.mDBToRawNanos = static_cast<Float64>(CAHostTimeBase::GetCurrentTimeInNanos() - theStartNanos) / theNumberValues;
+	
+	theStartNanos = CAHostTimeBase::GetCurrentTimeInNanos();
+	ConvertDBToRaw(&theDB[0], &theRawResults[0], inNumberValues);
+	outStatistics.mBatchDBToRawNanos = static_cast<Float64>(CAHostTimeBase::GetCurrentTimeInNanos() - theStartNanos) / theNumberValues;
+	theRawSink += theRawResults[inNumberValues - 1];
+	
+	//	raw to scalar
+	theStartNanos = CAHostTimeBase::GetCurrentTimeInNanos();
+	for(UInt32 theIndex = 0; theIndex < inNumberValues; ++theIndex)
+	{
+		theFloatSink += ConvertRawToScalar(theRaw[theIndex]);
+	}
+	outStatistics.mRawToScalarNanos = static_cast<Float64>(CAHostTimeBase::GetCurrentTimeInNanos() - theStartNanos) / theNumberValues;
+	
+	theStartNanos = CAHostTimeBase::GetCurrentTimeInNanos();
+	ConvertRawToScalar(&theRaw[0], &theFloatResults[0], inNumberValues);
+	outStatistics.mBatchRawToScalarNanos = static_cast<Float64>(CAHostTimeBase::GetCurrentTimeInNanos() - theStartNanos) / theNumberValues;
+	theFloatSink += theFloatResults[inNumberValues - 1];
+	
+	//	scalar to raw
+	theStartNanos = CAHostTimeBase::GetCurrentTimeInNanos();
+	for(UInt32 theIndex = 0; theIndex < inNumberValues; ++theIndex)
+	{
+		theRawSink += ConvertScalarToRaw(theScalar[theIndex]);
+	}
+	outStatistics.mScalarToRawNanos = static_cast<Float64>(CAHostTimeBase::GetCurrentTimeInNanos() - theStartNanos) / theNumberValues;
+	
+	theStartNanos = CAHostTimeBase::GetCurrentTimeInNanos();
+	ConvertScalarToRaw(&theScalar[0], &theRawResults[0], inNumberValues);
+	outStatistics.mBatchScalarToRawNanos = static_cast<Float64>(CAHostTimeBase::GetCurrentTimeInNanos() - theStartNanos) / theNumberValues;
+	theRawSink += theRawResults[inNumberValues - 1];
+}
+
+void	CAVolumeCurve::CompileCurve()
+{
+	mSegments.clear();
+	mMinimumRaw = 0;
+	mMaximumRaw = 0;
+	mMinimumDB = 0;
+	mMaximumDB = 0;
+	mRawEnd = 0;
+	mDBEnd = 0;
+	
+	if(!mCurveMap.empty())
+	{
+		mSegments.reserve(mCurveMap.size());
+		mMinimumRaw = mCurveMap.begin()->first.mMinimum;
+		mMaximumRaw = mCurveMap.rbegin()->first.mMaximum;
+		mMinimumDB = mCurveMap.begin()->second.mMinimum;
+		mMaximumDB = mCurveMap.rbegin()->second.mMaximum;
+		
+		//	the running totals are accumulated in the same order the map walk adds them up
+		SInt32 theNumberRawSteps = 0;
+		Float64 theDB = mMinimumDB;
+		for(CurveMap::const_iterator theIterator = mCurveMap.begin(); theIterator != mCurveMap.end(); std::advance(theIterator, 1))
+		{
+			Segment theSegment;
+			theSegment.mRawStart = mMinimumRaw + theNumberRawSteps;
+			theSegment.mRawSteps = theNumberRawSteps;
+			theSegment.mRawRange = theIterator->first.mMaximum - theIterator->first.mMinimum;
+			theSegment.mDBMinimum = theIterator->second.mMinimum;
+			theSegment.mDBMaximum = theIterator->second.mMaximum;
+			theSegment.mDBStart = theDB;
+			theSegment.mDBPerRaw = (theSegment.mDBMaximum - theSegment.mDBMinimum) / static_cast<Float64>(theSegment.mRawRange);
+			mSegments.push_back(theSegment);
+			
+			theNumberRawSteps += theSegment.mRawRange;
+			theDB += theSegment.mRawRange * theSegment.mDBPerRaw;
+		}
+		
+		mRawEnd = mMinimumRaw + theNumberRawSteps;
+		mDBEnd = theDB;
+	}
+	
+	mIsScalarCurved = (mMaximumDB - mMinimumDB) > 30.0;
+	BuildLookUpTable();
+}
+
+void	CAVolumeCurve::BuildLookUpTable()
+{
+	mRawToDBTable.clear();
+	
+	if((mMaximumLookUpTableSize > 0) && !mSegments.empty() && (mMaximumRaw >= mMinimumRaw))
+	{
+		UInt64 theNumberEntries = static_cast<UInt64>(static_cast<SInt64>(mMaximumRaw) - static_cast<SInt64>(mMinimumRaw)) + 1;
+		if(theNumberEntries <= mMaximumLookUpTableSize)
+		{
+			mRawToDBTable.resize(static_cast<UInt32>(theNumberEntries));
+			for(UInt32 theIndex = 0; theIndex < theNumberEntries; ++theIndex)
+			{
+				mRawToDBTable[theIndex] = ConvertRawToDBWithSegments(mMinimumRaw + static_cast<SInt32>(theIndex));
+			}
+		}
+	}
+}
+
+Float64	CAVolumeCurve::ConvertRawToDBWithSegments(SInt32 inRaw) const
+{
+	Float64 theAnswer = 0;
+	
+	if(!mSegments.empty())
+	{
+		//	clamp the raw value
+		if(inRaw < mMinimumRaw) inRaw = mMinimumRaw;
+		if(inRaw > mMaximumRaw) inRaw = mMaximumRaw;
+		
+		//	figure out how many raw steps need to be taken from the first one
+		SInt32 theNumberRawSteps = inRaw - mMinimumRaw;
+		
+		if(theNumberRawSteps > 0)
+		{
+			//	find the first segment that the steps don't run past the end of
+			SegmentList::const_iterator theIterator = mSegments.begin();
+			while((theIterator != mSegments.end()) && (theNumberRawSteps > (theIterator->mRawSteps + theIterator->mRawRange)))
+			{
+				std::advance(theIterator, 1);
+			}
+			
+			if(theIterator != mSegments.end())
+			{
+				theAnswer = theIterator->mDBStart + ((theNumberRawSteps - theIterator->mRawSteps) * theIterator->mDBPerRaw);
+			}
+			else
+			{
+				theAnswer = mDBEnd;
+			}
+		}
+		else
+		{
+			theAnswer = mSegments.front().mDBStart;
+		}
+	}
+	
+	return theAnswer;
+}
+
+SInt32	CAVolumeCurve::ConvertDBToRawWithMap(Float64 inDB) const
+{
+	//	clamp the value to the dB range, finding the ends of it the way GetMinimumDB and GetMaximumDB used to
+	CurveMap::const_iterator theLastIterator = mCurveMap.begin();
+	std::advance(theLastIterator, mCurveMap.size() - 1);
+	Float64 theOverallDBMin = mCurveMap.begin()->second.mMinimum;
+	Float64 theOverallDBMax = theLastIterator->second.mMaximum;
 	
 	if(inDB < theOverallDBMin) inDB = theOverallDBMin;
 	if(inDB > theOverallDBMax) inDB = theOverallDBMax;
@@ -242,13 +771,15 @@ SInt32	CAVolumeCurve::ConvertDBToRaw(Float64 inDB) const
 	return theAnswer;
 }
 
-Float64	CAVolumeCurve::ConvertRawToDB(SInt32 inRaw) const
+Float64	CAVolumeCurve::ConvertRawToDBWithMap(SInt32 inRaw) const
 {
 	Float64 theAnswer = 0;
 	
-	//	clamp the raw value
-	SInt32 theOverallRawMin = GetMinimumRaw();
-	SInt32 theOverallRawMax = GetMaximumRaw();
+	//	clamp the raw value, finding the ends of the range the way GetMinimumRaw and GetMaximumRaw used to
+	CurveMap::const_iterator theLastIterator = mCurveMap.begin();
+	std::advance(theLastIterator, mCurveMap.size() - 1);
+	SInt32 theOverallRawMin = mCurveMap.begin()->first.mMinimum;
+	SInt32 theOverallRawMax = theLastIterator->first.mMaximum;
 	
 	if(inRaw < theOverallRawMin) inRaw = theOverallRawMin;
 	if(inRaw > theOverallRawMax) inRaw = theOverallRawMax;
@@ -291,72 +822,3 @@ Float64	CAVolumeCurve::ConvertRawToDB(SInt32 inRaw) const
 	
 	return theAnswer;
 }
-
-Float64	CAVolumeCurve::ConvertRawToScalar(SInt32 inRaw) const
-{
-	//	get some important values
-	Float64	theDBMin = GetMinimumDB();
-	Float64	theDBMax = GetMaximumDB();
-	Float64	theDBRange = theDBMax - theDBMin;
-	SInt32	theRawMin = GetMinimumRaw();
-	SInt32	theRawMax = GetMaximumRaw();
-	SInt32	theRawRange = theRawMax - theRawMin;
-	
-	//	range the raw value
-	if(inRaw < theRawMin) inRaw = theRawMin;
-	if(inRaw > theRawMax) inRaw = theRawMax;
-
-	//	calculate the distance in the range inRaw is
-	Float64 theAnswer = static_cast<Float64>(inRaw - theRawMin) / static_cast<Float64>(theRawRange);
-
-	//	only apply a curve to the scalar values if the dB range is greater than 30
-	if(theDBRange > 30.0)
-	{
-		theAnswer = pow(theAnswer, 2.0 / 1.0);
-	}
-
-	return theAnswer;
-}
-
-Float64	CAVolumeCurve::ConvertDBToScalar(Float64 inDB) const
-{
-	SInt32 theRawValue = ConvertDBToRaw(inDB);
-	Float64 theAnswer = ConvertRawToScalar(theRawValue);
-	return theAnswer;
-}
-
-SInt32	CAVolumeCurve::ConvertScalarToRaw(Float64 inScalar) const
-{
-	//	range the scalar value
-	inScalar = std::min(1.0, std::max(0.0, inScalar));
-	
-	//	get some important values
-	Float64	theDBMin = GetMinimumDB();
-	Float64	theDBMax = GetMaximumDB();
-	Float64	theDBRange = theDBMax - theDBMin;
-	SInt32	theRawMin = GetMinimumRaw();
-	SInt32	theRawMax = GetMaximumRaw();
-	SInt32	theRawRange = theRawMax - theRawMin;
-	
-	//	have to undo the curve if the dB range is greater than 30
-	if(theDBRange > 30.0)
-	{
-		inScalar = pow(inScalar, 1.0 / 2.0);
-	}
-	
-	//	now we can figure out how many raw steps this is
-	Float64 theNumberRawSteps = inScalar * static_cast<Float64>(theRawRange);
-	theNumberRawSteps = round(theNumberRawSteps);
-	
-	//	the answer is the minimum raw value plus the number of raw steps
-	SInt32 theAnswer = theRawMin + static_cast<SInt32>(theNumberRawSteps);
-	
-	return theAnswer;
-}
-
-Float64	CAVolumeCurve::ConvertScalarToDB(Float64 inScalar) const
-{
-	SInt32 theRawValue = ConvertScalarToRaw(inScalar);
-	Float64 theAnswer = ConvertRawToDB(theRawValue);
-	return theAnswer;
-}
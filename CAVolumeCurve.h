@@ -48,6 +48,7 @@
 
 #include <CoreAudio/CoreAudioTypes.h>
 #include <map>
+#include <vector>
 
 //=============================================================================
 //	Types
@@ -95,11 +96,46 @@ inline bool	operator>(const CADBPoint& x, const CADBPoint& y) { return !((x < y)
 
 //=============================================================================
 //	CAVolumeCurve
+//
+//	The ranges that make up the curve are kept in a map, but the conversions
+//	don't walk it. Every time the curve changes, it is compiled into a flat
+//	array of segments that carry the running raw and dB totals, so a conversion
+//	is a short scan of that array. The overall minimums and maximums are cached
+//	too. The results are the same as walking the map.
+//
+//	When the raw range is small enough, a table of the dB value for every raw
+//	value can be built as well, which turns ConvertRawToDB into a table look up.
+//
+//	The batch conversions produce the same values as calling the single value
+//	conversions in a loop, but use SSE2 where it is available.
 //=============================================================================
 
 class CAVolumeCurve
 {
 
+//	Constants
+public:
+	enum
+	{
+		kDefaultMaximumLookUpTableSize	= 4096
+	};
+
+	struct	ConversionStatistics
+	{
+		UInt32	mNumberSegments;
+		bool	mHasLookUpTable;
+		Float64	mMapRawToDBNanos;
+		Float64	mRawToDBNanos;
+		Float64	mBatchRawToDBNanos;
+		Float64	mMapDBToRawNanos;
+		Float64	mDBToRawNanos;
+		Float64	mBatchDBToRawNanos;
+		Float64	mRawToScalarNanos;
+		Float64	mBatchRawToScalarNanos;
+		Float64	mScalarToRawNanos;
+		Float64	mBatchScalarToRawNanos;
+	};
+
 //	Construction/Destruction
 public:
 					CAVolumeCurve();
@@ -125,11 +161,59 @@ public:
 	SInt32			ConvertScalarToRaw(Float64 inScalar) const;
 	Float64			ConvertScalarToDB(Float64 inScalar) const;
 
+	void			ConvertDBToRaw(const Float64* inDB, SInt32* outRaw, UInt32 inNumberValues) const;
+	void			ConvertRawToDB(const SInt32* inRaw, Float64* outDB, UInt32 inNumberValues) const;
+	void			ConvertRawToScalar(const SInt32* inRaw, Float64* outScalar, UInt32 inNumberValues) const;
+	void			ConvertScalarToRaw(const Float64* inScalar, SInt32* outRaw, UInt32 inNumberValues) const;
+
+//	Look Up Table
+public:
+	bool			EnableLookUpTable(UInt32 inMaximumNumberEntries = kDefaultMaximumLookUpTableSize);
+	void			DisableLookUpTable();
+	bool			HasLookUpTable() const { return !mRawToDBTable.empty(); }
+
+//	Benchmarking
+public:
+	void			MeasureConversions(UInt32 inNumberValues, ConversionStatistics& outStatistics) const;
+
 //	Implementation
 private:
+	friend class	CAVolumeCurveSSE2Kernels;
+
+	struct	Segment
+	{
+		SInt32	mRawStart;		//	the raw value the segment starts at, counting from the start of the curve
+		SInt32	mRawSteps;		//	the number of raw steps in the segments before this one
+		SInt32	mRawRange;
+		Float64	mDBMinimum;
+		Float64	mDBMaximum;
+		Float64	mDBStart;		//	the dB value the segment starts at, counting from the start of the curve
+		Float64	mDBPerRaw;
+	};
+
 	typedef	std::map<CARawPoint, CADBPoint>	CurveMap;
+	typedef	std::vector<Segment>			SegmentList;
+	typedef	std::vector<Float64>			LookUpTable;
+	
+	void			CompileCurve();
+	void			BuildLookUpTable();
+	Float64			ConvertRawToDBWithSegments(SInt32 inRaw) const;
+	
+	//	these walk the map the way the conversions used to, for MeasureConversions to compare against
+	SInt32			ConvertDBToRawWithMap(Float64 inDB) const;
+	Float64			ConvertRawToDBWithMap(SInt32 inRaw) const;
 	
 	CurveMap		mCurveMap;
+	SegmentList		mSegments;
+	SInt32			mMinimumRaw;
+	SInt32			mMaximumRaw;
+	Float64			mMinimumDB;
+	Float64			mMaximumDB;
+	SInt32			mRawEnd;
+	Float64			mDBEnd;
+	bool			mIsScalarCurved;
+	UInt32			mMaximumLookUpTableSize;
+	LookUpTable		mRawToDBTable;
 
 };
 